@@ -0,0 +1,237 @@
+// Benchmark suite for the control hot paths, with regression gating. Each
+// case times a batch of calls to one firmware entry point under the mocks,
+// repeated --reps times after a warm-up batch; the report gives the median,
+// p99 and minimum time per call over the repetitions, so one descheduled
+// batch moves the p99 but not the median. The macro case runs the unmodified
+// loop() through a simulated day of a house that cools when the heater is
+// off. Settings go to the in-memory NVS and the learning log to the RAM
+// SPIFFS of the host HAL.
+//
+// --out writes the results as CSV (case,median_ns,p99_ns,min_ns,reps,calls).
+// --baseline reads such a file and marks every case whose median is more
+// than --threshold percent slower; the exit code is then 1.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+#include <Arduino.h>
+#include "config.h"
+#include "controller.h"
+#include "hvac_logic.h"
+#include "hvac_tests.h"
+#include "learning.h"
+#include "main.h"
+#include "nvs.h"
+#include "persistence.h"
+#include "scheduler.h"
+#include "utils.h"
+#include "SPIFFS.h"
+
+static const int INPUTS = 1024; // Power of two: inputs cycle by mask
+static const unsigned long TICK_MS = 5000;
+static const unsigned long DAY_MS = 24 * 3600UL * 1000UL;
+static const unsigned long WALL_START_MS = (2 * 1440 + 9 * 60) * 60000UL; // Millisecond 0 is Tue 09:00
+
+struct BenchCase {
+  const char* name;
+  int calls;                        // Per repetition
+  std::function<void(int)> call;    // Call n of the batch
+};
+
+struct BenchResult {
+  std::string name;
+  double medianNs, p99Ns, minNs;
+  int reps, calls;
+};
+
+// Indoor temperatures swinging across the deadband, outdoor temperatures
+// across every performance bin, humidity across the humidifier band.
+static CentiC indoorInputs[INPUTS], outdoorInputs[INPUTS];
+static CentiRH humidityInputs[INPUTS];
+static float indoorInputsC[INPUTS], outdoorInputsC[INPUTS];
+
+// What the simulated days did, so the macro figure can be read per pass.
+static unsigned long dayPasses, daysSimulated, heaterOnMs;
+
+static void makeInputs() {
+  for (int n = 0; n < INPUTS; n++) {
+    float phase = n * 6.2832f / INPUTS;
+    indoorInputs[n] = centiCFromF(68 + 3 * sinf(phase * 7));
+    outdoorInputs[n] = centiCFromF(-10 + 110.0f * n / INPUTS);
+    humidityInputs[n] = centiRH(40 + 15 * sinf(phase * 3));
+    indoorInputsC[n] = indoorInputs[n] / 100.0f;
+    outdoorInputsC[n] = outdoorInputs[n] / 100.0f;
+  }
+}
+
+static void setWallClock(unsigned long ms) {
+  unsigned long minute = (ms + WALL_START_MS) / 60000;
+  g_mockTime.dayOfWeek = (int)(minute / 1440 % 7);
+  g_mockTime.hour = (int)(minute / 60 % 24);
+  g_mockTime.minute = (int)(minute % 60);
+  g_mockTime.second = (int)(ms / 1000 % 60);
+}
+
+// The house for the macro case: 2 F/h down with the heater off, 6 F/h up with it on.
+static void advanceHouse(unsigned long from, unsigned long to) {
+  float hours = (to - from) / 3600000.0f;
+  if (g_mockRelayStates[HEATER_RELAY_PIN]) heaterOnMs += to - from;
+  g_mockIndoorTempF += g_mockRelayStates[HEATER_RELAY_PIN] ? 6 * hours : -2 * hours;
+  setWallClock(to);
+}
+
+static void simulateDay() {
+  unsigned long end = g_mockMillis + DAY_MS;
+  while ((long)(end - g_mockMillis) > 0) { loop(); dayPasses++; }
+  daysSimulated++;
+}
+
+// Every case starts from the same cold boot on empty NVS and flash, so no
+// case inherits another's timers, lockouts, learned rates or logs.
+static void bootFresh() {
+  host_nvs_reset();
+  SPIFFS.format();
+  g_mockMillis = 0;
+  g_mockTime = { 1, 13, 2, 9, 0, 0 };
+  g_mockIndoorTempF = 67; g_mockOutdoorTempF = 30; g_mockHumidity = 40;
+  for (int pin = 0; pin < 10; pin++) g_mockRelayStates[pin] = LOW;
+  setup();
+}
+
+static std::vector<BenchCase> makeCases() {
+  std::vector<BenchCase> cases;
+  cases.push_back({ "control_temperature", 4096, [](int n) {
+    g_mockMillis += TICK_MS;
+    controlTemperature(indoorInputs[n & (INPUTS - 1)], centiCFromF(68), outdoorInputs[n & (INPUTS - 1)]);
+  } });
+  cases.push_back({ "control_fan", 4096, [](int) {
+    g_mockMillis += TICK_MS;
+    controlFan(FAN_CIRCULATE);
+  } });
+  cases.push_back({ "control_humidity", 4096, [](int n) {
+    controlHumidity(humidityInputs[n & (INPUTS - 1)], indoorInputs[n & (INPUTS - 1)], outdoorInputs[n & (INPUTS - 1)]);
+  } });
+  cases.push_back({ "max_humidity_for_window", 4096, [](int n) {
+    volatile float limit = calculateMaxHumidityForWindow(indoorInputsC[n & (INPUTS - 1)], outdoorInputsC[n & (INPUTS - 1)]);
+    (void)limit;
+  } });
+  cases.push_back({ "schedule_settings", 4096, [](int n) {
+    setWallClock((unsigned long)n * 149 * 60000UL); // Steps through every day and most minutes
+    getCurrentScheduleSettings();
+  } });
+  cases.push_back({ "performance_bin", 4096, [](int n) {
+    volatile int bin = getPerformanceBin(outdoorInputs[n & (INPUTS - 1)]);
+    (void)bin;
+  } });
+  cases.push_back({ "update_performance", 4096, [](int n) {
+    // A heating cycle just long enough to count, started 2 F below where it ends.
+    ControllerBatch& b = deviceController;
+    g_mockMillis += TICK_MS;
+    b.cycleInProgress[0] = true;
+    b.cycleStartTime[0] = g_mockMillis - MIN_HEATER_RUN_TIME_MS;
+    b.cycleStartTemp[0] = centiCFromF(g_mockIndoorTempF - 2);
+    b.cycleStartOutdoorTemp[0] = outdoorInputs[n & (INPUTS - 1)];
+    updatePerformanceData(true);
+  } });
+  cases.push_back({ "save_settings", 64, [](int) { saveSettings(); } });
+  cases.push_back({ "load_settings", 64, [](int) { loadSettings(); } });
+  cases.push_back({ "log_manual_adjustment", 1024, [](int n) {
+    log_manual_adjustment(66 + (n & 7));
+  } });
+  cases.push_back({ "simulated_day", 1, [](int) { simulateDay(); } });
+  return cases;
+}
+
+static BenchResult runCase(const BenchCase& c, int reps) {
+  bootFresh();
+  for (int n = 0; n < c.calls; n++) c.call(n); // Warm-up
+  std::vector<double> ns(reps);
+  for (int r = 0; r < reps; r++) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (int n = 0; n < c.calls; n++) c.call(n);
+    ns[r] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / c.calls;
+  }
+  std::sort(ns.begin(), ns.end());
+  // Nearest rank: with fewer than 100 repetitions the p99 is the slowest one.
+  int p99 = std::min(reps - 1, (int)ceil(reps * 0.99) - 1);
+  double median = reps % 2 ? ns[reps / 2] : (ns[reps / 2 - 1] + ns[reps / 2]) / 2;
+  return { c.name, median, ns[p99], ns[0], reps, c.calls };
+}
+
+static bool writeResults(const char* path, const std::vector<BenchResult>& results) {
+  FILE* f = fopen(path, "w");
+  if (!f) return false;
+  fprintf(f, "case,median_ns,p99_ns,min_ns,reps,calls\n");
+  for (const BenchResult& r : results) fprintf(f, "%s,%.1f,%.1f,%.1f,%d,%d\n", r.name.c_str(), r.medianNs, r.p99Ns, r.minNs, r.reps, r.calls);
+  return fclose(f) == 0;
+}
+
+static bool readResults(const char* path, std::vector<BenchResult>& results) {
+  FILE* f = fopen(path, "r");
+  if (!f) return false;
+  char line[256], name[128];
+  while (fgets(line, sizeof(line), f)) {
+    BenchResult r;
+    if (sscanf(line, "%127[^,],%lf,%lf,%lf,%d,%d", name, &r.medianNs, &r.p99Ns, &r.minNs, &r.reps, &r.calls) != 6) continue; // Header
+    r.name = name;
+    results.push_back(r);
+  }
+  fclose(f);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  int reps = 31;
+  double threshold = 10;
+  const char* out = nullptr;
+  const char* baselinePath = nullptr;
+  const char* filter = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--reps") && i + 1 < argc) reps = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--out") && i + 1 < argc) out = argv[++i];
+    else if (!strcmp(argv[i], "--baseline") && i + 1 < argc) baselinePath = argv[++i];
+    else if (!strcmp(argv[i], "--threshold") && i + 1 < argc) threshold = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--filter") && i + 1 < argc) filter = argv[++i];
+    else { fprintf(stderr, "Usage: %s [--reps N] [--out FILE] [--baseline FILE] [--threshold PCT] [--filter NAME]\n", argv[0]); return 2; }
+  }
+  if (reps < 1 || threshold <= 0) { fprintf(stderr, "Need one repetition or more and a positive threshold\n"); return 2; }
+
+  std::vector<BenchResult> baseline;
+  if (baselinePath && !readResults(baselinePath, baseline)) { fprintf(stderr, "Cannot read %s\n", baselinePath); return 2; }
+
+  g_isTesting = true;
+  Serial.setMuted(true);
+  setVirtualTimeHook(advanceHouse);
+  makeInputs();
+
+  std::vector<BenchResult> results;
+  int regressions = 0;
+  printf("Control hot paths, %d repetitions, ns per call\n", reps);
+  printf("  %-24s %12s %12s %12s %10s\n", "Case", "median", "p99", "min", "baseline");
+  for (const BenchCase& c : makeCases()) {
+    if (filter && !strstr(c.name, filter)) continue;
+    BenchResult r = runCase(c, reps);
+    results.push_back(r);
+    printf("  %-24s %12.1f %12.1f %12.1f", r.name.c_str(), r.medianNs, r.p99Ns, r.minNs);
+    auto base = std::find_if(baseline.begin(), baseline.end(), [&](const BenchResult& b) { return b.name == r.name; });
+    if (base == baseline.end()) { printf(baselinePath ? " %10s\n" : "\n", "new"); continue; }
+    double change = (r.medianNs / base->medianNs - 1) * 100;
+    bool regressed = change > threshold;
+    regressions += regressed;
+    printf(" %+9.1f%%%s\n", change, regressed ? "  REGRESSION" : "");
+  }
+
+  if (daysSimulated) {
+    printf("  Simulated day: %.0f passes, heater on %.0f%% of the time\n", (double)dayPasses / daysSimulated,
+           100.0 * heaterOnMs / (daysSimulated * DAY_MS));
+  }
+  if (out && !writeResults(out, results)) { fprintf(stderr, "Cannot write %s\n", out); return 2; }
+  if (baselinePath) printf("  %d of %zu cases more than %.0f%% slower than %s\n", regressions, results.size(), threshold, baselinePath);
+  return regressions ? 1 : 0;
+}
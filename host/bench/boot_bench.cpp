@@ -0,0 +1,91 @@
+// Boot-to-first-decision latency for the cold and warm paths. Each run calls
+// the unmodified setup() and loop() under the mocks: a power-on boot of a
+// cold house, a few passes until the heater is running, then a task-watchdog
+// reset with the controller's RAM state wiped, then a panic early in the warm
+// boot before its first pass. Time is reported twice: the firmware clock,
+// which includes deliberate waits (delay() is virtual here), and host
+// execution time. The exit code is non-zero if the warm path does
+// not resume the running heater with its original start time, or if the
+// boot after the panic keeps the heater latched.
+
+#include <Arduino.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "config.h"
+#include "controller.h"
+#include "hvac_tests.h"
+#include "main.h"
+#include "nvs.h"
+#include "esp_system.h"
+#include "warmstart.h"
+
+// What a reset does to the controller: every RAM field back to zero. The
+// mock relays keep their levels, as the held pads do.
+static void wipeControllerRam() {
+  ControllerBatch& b = deviceController;
+  b.lastHeaterOnTime[0] = b.lastHeaterOffTime[0] = b.lastCoolerOnTime[0] = b.lastCoolerOffTime[0] = 0;
+  b.lastFanCycleTime[0] = b.cycleStartTime[0] = 0;
+  b.firstHeaterMaxRunTriggerTime[0] = b.firstCoolerMaxRunTriggerTime[0] = 0;
+  b.heaterMaxRunTriggers[0] = b.coolerMaxRunTriggers[0] = 0;
+  b.isFanCirculating[0] = b.freshAirForHeating[0] = b.cycleInProgress[0] = b.systemLockedOut[0] = false;
+  b.cycleStartTemp[0] = b.cycleStartOutdoorTemp[0] = 0;
+}
+
+static void firstDecision() {
+  while (!bootStats.decided) loop();
+}
+
+int main(int argc, char** argv) {
+  int runs = 20;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--runs") && i + 1 < argc) runs = atoi(argv[++i]);
+    else { fprintf(stderr, "Usage: %s [--runs N]\n", argv[0]); return 2; }
+  }
+
+  g_isTesting = true;
+  Serial.setMuted(true);
+  host_nvs_reset();
+  g_mockTime = { 1, 13, 2, 9, 0, 0 }; // Tue 09:00 in January
+  g_mockIndoorTempF = 64; g_mockOutdoorTempF = 30; g_mockHumidity = 40;
+
+  double coldMs = 0, coldUs = 0, warmMs = 0, warmUs = 0;
+  int failures = 0, crashLoopFailures = 0;
+  for (int run = 0; run < runs; run++) {
+    for (int pin = 0; pin < 10; pin++) g_mockRelayStates[pin] = LOW;
+    host_set_reset_reason(ESP_RST_POWERON);
+    setup();
+    firstDecision();
+    coldMs += bootStats.decisionMs - bootStats.setupMs; coldUs += bootStats.decisionUs - bootStats.setupUs;
+
+    for (int pass = 0; pass < 3; pass++) loop();
+    unsigned long heaterOnAge = deviceController.now - deviceController.lastHeaterOnTime[0];
+    bool heating = g_mockRelayStates[HEATER_RELAY_PIN];
+
+    wipeControllerRam();
+    host_set_reset_reason(ESP_RST_TASK_WDT);
+    setup();
+    firstDecision();
+    warmMs += bootStats.decisionMs - bootStats.setupMs; warmUs += bootStats.decisionUs - bootStats.setupUs;
+    unsigned long resumedAge = deviceController.now - deviceController.lastHeaterOnTime[0];
+    if (!bootStats.warm || !heating || !g_mockRelayStates[HEATER_RELAY_PIN] || resumedAge < heaterOnAge) failures++;
+
+    // A boot that panics early in setup(), after claiming the state but before
+    // its first pass saves it again: the next boot must not resume the latch.
+    for (int pass = 0; pass < 3; pass++) loop();
+    bool latched = g_mockRelayStates[HEATER_RELAY_PIN];
+    host_set_reset_reason(ESP_RST_PANIC);
+    claimWarmState();
+    wipeControllerRam();
+    setup();
+    if (!latched || bootStats.warm || g_mockRelayStates[HEATER_RELAY_PIN]) crashLoopFailures++;
+  }
+  Serial.setMuted(false);
+
+  printf("Boot to first control decision, mean of %d runs\n", runs);
+  printf("  %-26s %8.0f ms firmware clock %10.1f us executing\n", "cold (power-on)", coldMs / runs, coldUs / runs);
+  printf("  %-26s %8.0f ms firmware clock %10.1f us executing\n", "warm (task watchdog)", warmMs / runs, warmUs / runs);
+  printf("  Warm restarts resuming the running heater: %d of %d\n", runs - failures, runs);
+  printf("  Second resets before a pass that dropped the heater: %d of %d\n", runs - crashLoopFailures, runs);
+  return failures + crashLoopFailures;
+}
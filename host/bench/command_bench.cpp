@@ -0,0 +1,149 @@
+// Command queue benchmark, in two parts. First the bare ring (mpsc_ring.h):
+// producer threads push numbered items as fast as they can while one
+// consumer pops, checking that every item arrives exactly once and each
+// producer's items in order, and timing a push. Then the firmware end to
+// end: setup() and loop() run under the mocks on the main thread, as the
+// control task, while producer threads submit holds, mode and vacation
+// changes at random intervals. The report gives submit-to-relay-commit
+// latency (the PROBE_COMMAND_LATENCY stage) in host time, the deepest the
+// queue got and how often it was full. The exit code is 1 if any item or
+// command is lost or duplicated.
+
+#include <Arduino.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+#include "commands.h"
+#include "config.h"
+#include "hvac_tests.h"
+#include "main.h"
+#include "mpsc_ring.h"
+#include "nvs.h"
+#include "probes.h"
+
+struct Item {
+  uint32_t producer, sequence;
+};
+
+static const int RING_SIZE = 1024;
+
+// Returns the number of errors: items lost, duplicated or out of order.
+static long ringStress(int producers, int perProducer) {
+  static MpscRing<Item, RING_SIZE> ring;
+  std::atomic<int> ready{0};
+  std::vector<double> pushNs(producers);
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; p++) {
+    threads.emplace_back([&, p]() {
+      ready++;
+      while (ready < producers) std::this_thread::yield();
+      auto t0 = std::chrono::steady_clock::now();
+      for (int n = 0; n < perProducer; n++) {
+        while (!ring.push({ (uint32_t)p, (uint32_t)n })) std::this_thread::yield();
+      }
+      pushNs[p] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / perProducer;
+    });
+  }
+
+  std::vector<uint32_t> next(producers, 0);
+  long errors = 0, received = 0, total = (long)producers * perProducer;
+  uint32_t maxDepth = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  while (received < total) {
+    Item item;
+    if (!ring.pop(&item)) { std::this_thread::yield(); continue; }
+    maxDepth = std::max(maxDepth, ring.depth() + 1);
+    if (item.producer >= (uint32_t)producers || item.sequence != next[item.producer]) errors++;
+    else next[item.producer]++;
+    received++;
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  for (auto& t : threads) t.join();
+  Item extra;
+  while (ring.pop(&extra)) errors++;
+
+  double meanPushNs = 0;
+  for (double ns : pushNs) meanPushNs += ns / producers;
+  printf("Ring: %d producers x %d items through %d slots\n", producers, perProducer, RING_SIZE);
+  printf("  %.1f M items/s, %.1f ns per push including waits on a full ring, deepest %u\n", total / seconds / 1e6, meanPushNs, maxDepth);
+  printf("  %ld items lost, duplicated or out of order\n", errors);
+  return errors;
+}
+
+// Returns 1 if the control task's counts do not add up to what was submitted.
+static int firmwareEndToEnd(int producers, int perProducer) {
+  g_isTesting = true;
+  Serial.setMuted(true);
+  host_nvs_reset();
+  g_mockTime = { 1, 13, 2, 9, 0, 0 }; // Tue 09:00 in January
+  g_mockIndoorTempF = 68; g_mockOutdoorTempF = 30; g_mockHumidity = 40;
+  setup();
+  resetCommands();
+  resetProbes();
+
+  std::atomic<int> running{producers};
+  std::atomic<long> accepted{0}, refused{0};
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; p++) {
+    threads.emplace_back([&, p]() {
+      std::mt19937 rng(p + 1);
+      std::uniform_int_distribution<int> pick(0, 9), target(6500, 7800), pause(0, 200);
+      for (int n = 0; n < perProducer; n++) {
+        bool ok;
+        switch (pick(rng)) {
+          case 0:  ok = submitSystemMode(SYS_HEAT); break;
+          case 1:  ok = submitVacation(false); break;
+          case 2:  ok = submitResumeSchedule(); break;
+          case 3:  ok = submitSetpointHold(centiCFromF(200), 0); break; // Out of range: rejected
+          default: ok = submitSetpointHold(centiCFromF(target(rng) / 100.0f), 30); break;
+        }
+        (ok ? accepted : refused)++;
+        std::this_thread::sleep_for(std::chrono::microseconds(pause(rng)));
+      }
+      running--;
+    });
+  }
+
+  unsigned long passes = 0;
+  while (running > 0 || commandQueueDepth() > 0) { loop(); passes++; }
+  for (auto& t : threads) t.join();
+  while (commandQueueDepth() > 0) { loop(); passes++; }
+
+  const CommandStats& s = commandStats;
+  unsigned long applied = 0;
+  for (int t = 0; t < NUM_COMMAND_TYPES; t++) applied += s.applied[t];
+  const ProbeHistogram& h = probeHistograms[PROBE_COMMAND_LATENCY];
+  printf("Firmware: %d producers x %d commands against loop(), %lu passes\n", producers, perProducer, passes);
+  printf("  %lu submitted, %lu applied, %lu rejected, %lu refused full; deepest %u of %d, %lu drains\n", s.submitted, applied, s.rejected,
+         s.full, s.maxDepth, COMMAND_QUEUE_DEPTH, s.drains);
+  if (h.count) {
+    printf("  Submit to relay commit: mean %.1f us, p50 <= %u us, p99 <= %u us, max %.1f us over %u commands\n",
+           (double)h.totalCycles / h.count / PROBE_CYCLES_PER_US, probePercentileUs(h, 50), probePercentileUs(h, 99),
+           (double)h.maxCycles / PROBE_CYCLES_PER_US, h.count);
+  }
+  bool balanced = s.submitted == (unsigned long)accepted && s.full == (unsigned long)refused && s.submitted == applied + s.rejected &&
+                  h.count == applied;
+  if (!balanced) printf("  Counts do not add up: %ld accepted and %ld refused by the producers\n", accepted.load(), refused.load());
+  resetCommands();
+  return balanced ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+  int producers = 4, items = 1000000, commands = 2000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--producers") && i + 1 < argc) producers = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--items") && i + 1 < argc) items = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--commands") && i + 1 < argc) commands = atoi(argv[++i]);
+    else { fprintf(stderr, "Usage: %s [--producers N] [--items N] [--commands N]\n", argv[0]); return 2; }
+  }
+  if (producers < 1 || items < 1 || commands < 1) { fprintf(stderr, "Need at least one producer, item and command\n"); return 2; }
+
+  long ringErrors = ringStress(producers, items);
+  int firmwareErrors = firmwareEndToEnd(producers, commands);
+  return ringErrors || firmwareErrors ? 1 : 0;
+}
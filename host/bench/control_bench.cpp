@@ -0,0 +1,174 @@
+// Control pass benchmark: the float temperature and humidity decisions the
+// controller used to make, kept here verbatim on their own state, against the
+// integer CentiC path. Both replay the same minute-by-minute trace of a house
+// drifting around its setpoint; the report gives time per pass, emulated
+// ESP32-C6 cycles (esp_cpu_get_cycle_count() counts at 160 MHz on the host)
+// and how often the two paths chose the same relays. The host has an FPU, so
+// the float figures here are a lower bound: on the C6 every float operation
+// is a soft-float library call.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <Arduino.h>
+#include "config.h"
+#include "controller.h"
+#include "esp_cpu.h"
+#include "hvac_logic.h"
+#include "utils.h"
+
+// -- The float path, as it was --
+struct LegacyUnit {
+  uint8_t relays;
+  unsigned long lastHeaterOnTime, lastHeaterOffTime, lastCoolerOnTime, lastCoolerOffTime, cycleStartTime;
+  bool cycleInProgress, freshAirForHeating;
+  float cycleStartTempF, cycleStartOutdoorTempF;
+  float heatRate[NUM_PERFORMANCE_BINS], coolRate[NUM_PERFORMANCE_BINS];
+  int heatSamples[NUM_PERFORMANCE_BINS], coolSamples[NUM_PERFORMANCE_BINS];
+};
+
+static bool legacyOn(const LegacyUnit& u, int pin) { return (u.relays & RELAY_BIT(pin)) != 0; }
+static void legacySet(LegacyUnit& u, int pin, bool on) { if (on) u.relays |= RELAY_BIT(pin); else u.relays &= ~RELAY_BIT(pin); }
+
+static int legacyPerformanceBin(float tempF) {
+    if (tempF < 10) return 0;
+    if (tempF < 20) return 1;
+    if (tempF < 30) return 2;
+    if (tempF < 40) return 3;
+    if (tempF < 50) return 4;
+    if (tempF < 60) return 5;
+    if (tempF < 70) return 6;
+    return 7;
+}
+
+static void legacyUpdatePerformance(LegacyUnit& u, unsigned long now, bool isHeating, float currentTempF) {
+    if (!u.cycleInProgress) return;
+    unsigned long durationMs = now - u.cycleStartTime;
+    if (durationMs < (MIN_HEATER_RUN_TIME_MS - 1000)) return;
+    float tempChangeF = fabsf(currentTempF - u.cycleStartTempF);
+    float durationHours = (float)durationMs / (1000.0 * 60.0 * 60.0);
+    float rateF_PerHour = tempChangeF / durationHours;
+    int bin = legacyPerformanceBin(u.cycleStartOutdoorTempF);
+    float* rate = isHeating ? u.heatRate : u.coolRate;
+    int* samples = isHeating ? u.heatSamples : u.coolSamples;
+    rate[bin] = ((rate[bin] * samples[bin]) + rateF_PerHour) / (samples[bin] + 1);
+    samples[bin]++;
+    u.cycleInProgress = false;
+}
+
+static void legacyControlTemperature(LegacyUnit& u, unsigned long now, float tempC, float targetTempC, float outdoorTempC) {
+  bool isHeatingOn = legacyOn(u, HEATER_RELAY_PIN), isCoolingOn = legacyOn(u, COOLER_RELAY_PIN), isFreshAirOn = legacyOn(u, FRESH_AIR_RELAY_PIN);
+  float tempDeadbandC = fahrenheitToCelsius(32.0 + TEMPERATURE_DEADBAND_F) - fahrenheitToCelsius(32.0);
+  float freshAirDiffC = fahrenheitToCelsius(32.0 + FRESH_AIR_TEMP_DIFFERENTIAL_F) - fahrenheitToCelsius(32.0);
+
+  if (!isCoolingOn && !(isFreshAirOn && !u.freshAirForHeating)) {
+    if (isHeatingOn && (now - u.lastHeaterOnTime > MAX_HEATER_RUN_TIME_MS)) {
+      legacySet(u, HEATER_RELAY_PIN, LOW); u.lastHeaterOffTime = now; legacyUpdatePerformance(u, now, true, celsiusToFahrenheit(tempC));
+    } else if (tempC >= targetTempC && (isHeatingOn || isFreshAirOn)) {
+      if (isHeatingOn && (now - u.lastHeaterOnTime > MIN_HEATER_RUN_TIME_MS)) { legacySet(u, HEATER_RELAY_PIN, LOW); u.lastHeaterOffTime = now; legacyUpdatePerformance(u, now, true, celsiusToFahrenheit(tempC)); }
+      else if (isFreshAirOn) { legacySet(u, FRESH_AIR_RELAY_PIN, LOW); }
+    } else if (tempC < (targetTempC - tempDeadbandC) && !isHeatingOn) {
+      if (outdoorTempC > (tempC + freshAirDiffC)) { legacySet(u, FRESH_AIR_RELAY_PIN, HIGH); legacySet(u, HEATER_RELAY_PIN, LOW); u.freshAirForHeating = true; }
+      else if (now - u.lastHeaterOffTime > MIN_HEATER_OFF_TIME_MS && !legacyOn(u, COOLER_RELAY_PIN)) { legacySet(u, HEATER_RELAY_PIN, HIGH); u.lastHeaterOnTime = now; u.cycleStartTime = now; u.cycleInProgress = true; u.cycleStartTempF = celsiusToFahrenheit(tempC); u.cycleStartOutdoorTempF = celsiusToFahrenheit(outdoorTempC); }
+    }
+  }
+
+  if (!isHeatingOn && !(isFreshAirOn && u.freshAirForHeating)) {
+    if (isCoolingOn && (now - u.lastCoolerOnTime > MAX_COOLER_RUN_TIME_MS)) {
+      legacySet(u, COOLER_RELAY_PIN, LOW); u.lastCoolerOffTime = now; legacyUpdatePerformance(u, now, false, celsiusToFahrenheit(tempC));
+    } else if (tempC <= targetTempC && (isCoolingOn || isFreshAirOn)) {
+      if (isCoolingOn && (now - u.lastCoolerOnTime > MIN_COOLER_RUN_TIME_MS)) { legacySet(u, COOLER_RELAY_PIN, LOW); u.lastCoolerOffTime = now; legacyUpdatePerformance(u, now, false, celsiusToFahrenheit(tempC)); }
+      else if (isFreshAirOn) { legacySet(u, FRESH_AIR_RELAY_PIN, LOW); }
+    } else if (tempC > (targetTempC + tempDeadbandC) && !isCoolingOn) {
+      if (outdoorTempC < (tempC - freshAirDiffC)) { legacySet(u, FRESH_AIR_RELAY_PIN, HIGH); legacySet(u, COOLER_RELAY_PIN, LOW); u.freshAirForHeating = false; }
+      else if (now - u.lastCoolerOffTime > MIN_COOLER_OFF_TIME_MS && !legacyOn(u, HEATER_RELAY_PIN)) { legacySet(u, COOLER_RELAY_PIN, HIGH); u.lastCoolerOnTime = now; u.cycleStartTime = now; u.cycleInProgress = true; u.cycleStartTempF = celsiusToFahrenheit(tempC); u.cycleStartOutdoorTempF = celsiusToFahrenheit(outdoorTempC); }
+    }
+  }
+}
+
+static void legacyControlHumidity(LegacyUnit& u, float humidity, float indoorTempC, float outdoorTempC) {
+  float effectiveTarget = std::min(HUMIDITY_TARGET, calculateMaxHumidityForWindow(indoorTempC, outdoorTempC));
+  bool isHumidityControlOn = legacyOn(u, HUMIDITY_RELAY_PIN);
+  if (humidity < (effectiveTarget - HUMIDITY_DEADBAND) && !isHumidityControlOn) legacySet(u, HUMIDITY_RELAY_PIN, HIGH);
+  else if (humidity >= effectiveTarget && isHumidityControlOn) legacySet(u, HUMIDITY_RELAY_PIN, LOW);
+}
+
+// -- The trace: what the sensor task would deliver each minute --
+struct Sample { float indoorF, outdoorF, humidity; CentiC indoor, outdoor; CentiRH humidityCentiRH; };
+
+int main(int argc, char** argv) {
+  int iterations = 2000000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--iterations") && i + 1 < argc) iterations = atoi(argv[++i]);
+    else { fprintf(stderr, "Usage: %s [--iterations N]\n", argv[0]); return 2; }
+  }
+
+  const int TRACE_LENGTH = 4096;
+  const unsigned long STEP_MS = 60000;
+  std::vector<Sample> trace(TRACE_LENGTH);
+  std::mt19937 rng(7);
+  std::normal_distribution<float> drift(0, 0.15f), noise(0, 0.05f);
+  float indoorF = 70, outdoorF = 30, humidity = 38;
+  for (int n = 0; n < TRACE_LENGTH; n++) {
+    indoorF += drift(rng) - (indoorF - 70) * 0.02f;
+    outdoorF = 30 + 15 * sinf(n * 6.2832f / 1440) + noise(rng);
+    humidity += noise(rng) - (humidity - 38) * 0.01f;
+    trace[n] = { indoorF, outdoorF, humidity, centiCFromF(indoorF), centiCFromF(outdoorF), centiRH(humidity) };
+  }
+  const float TARGET_F = 70;
+
+  static ControllerStorage<1> unit;
+  ControllerBatch& b = unit.batch;
+  b.systemMode[0] = SYS_AUTO; b.tempUnit[0] = FAHRENHEIT; b.season = 0;
+  LegacyUnit legacy = {};
+
+  // Decision agreement: each path runs on its own state over one pass of the trace.
+  b.now = 0; initialize_logic_timers(b, 0, b.now);
+  legacy.lastHeaterOffTime = b.lastHeaterOffTime[0]; legacy.lastCoolerOffTime = b.lastCoolerOffTime[0];
+  int agree = 0;
+  for (int n = 0; n < TRACE_LENGTH; n++, b.now += STEP_MS) {
+    const Sample& s = trace[n];
+    float indoorC = fahrenheitToCelsius(s.indoorF), outdoorC = fahrenheitToCelsius(s.outdoorF);
+    legacyControlTemperature(legacy, b.now, indoorC, fahrenheitToCelsius(TARGET_F), outdoorC);
+    legacyControlHumidity(legacy, s.humidity, indoorC, outdoorC);
+    controlTemperature(b, 0, s.indoor, centiCFromF(TARGET_F), s.outdoor);
+    controlHumidity(b, 0, s.humidityCentiRH, s.indoor, s.outdoor);
+    if (legacy.relays == b.relays[0]) agree++;
+  }
+
+  // Timing: the trace on repeat, the clock advancing a minute per pass.
+  const int MASK = TRACE_LENGTH - 1;
+  auto start = std::chrono::steady_clock::now();
+  uint32_t cycles = esp_cpu_get_cycle_count();
+  unsigned long now = 0;
+  for (int n = 0; n < iterations; n++, now += STEP_MS) {
+    const Sample& s = trace[n & MASK];
+    float indoorC = fahrenheitToCelsius(s.indoorF), outdoorC = fahrenheitToCelsius(s.outdoorF);
+    legacyControlTemperature(legacy, now, indoorC, fahrenheitToCelsius(TARGET_F), outdoorC);
+    legacyControlHumidity(legacy, s.humidity, indoorC, outdoorC);
+  }
+  uint32_t floatCycles = esp_cpu_get_cycle_count() - cycles;
+  double floatNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  cycles = esp_cpu_get_cycle_count();
+  CentiC target = centiCFromF(TARGET_F);
+  for (int n = 0; n < iterations; n++, b.now += STEP_MS) {
+    const Sample& s = trace[n & MASK];
+    controlTemperature(b, 0, s.indoor, target, s.outdoor);
+    controlHumidity(b, 0, s.humidityCentiRH, s.indoor, s.outdoor);
+  }
+  uint32_t intCycles = esp_cpu_get_cycle_count() - cycles;
+  double intNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  printf("Control pass (temperature + humidity), %d iterations\n", iterations);
+  printf("  %-22s %8.1f ns/pass %8.1f cycles/pass\n", "float (previous)", floatNs / iterations, (double)floatCycles / iterations);
+  printf("  %-22s %8.1f ns/pass %8.1f cycles/pass  %5.1fx\n", "integer CentiC", intNs / iterations, (double)intCycles / iterations, floatNs / intNs);
+  printf("  Same relays on %d of %d trace passes\n", agree, TRACE_LENGTH);
+  return 0;
+}
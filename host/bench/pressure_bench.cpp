@@ -0,0 +1,165 @@
+// Pressure monitor, end to end on a virtual clock. A duct static pressure
+// that steps with the air handler (on 20 minutes, off 10) is read through a
+// 4-20 mA loop with ADC noise and the odd pulled wire, sampled every
+// PRESSURE_SAMPLE_INTERVAL_MS and uploaded through a mock HTTP endpoint. The
+// endpoint parses each JSON batch, keeps readings by batch sequence number
+// (so a resend after a lost acknowledgement is not counted twice), refuses a
+// share of requests at random, loses some acknowledgements after storing, and
+// goes down for --outage-hours every day.
+//
+// The report gives the measured sample rate, readings, batches and requests
+// per hour against one blocking request per reading, bytes per reading, RAM,
+// delivery latency, decimated accuracy against the true loop current, and the
+// host time per sample and per upload step. The exit code is non-zero if a
+// reading is lost without being counted as dropped, arrives out of order or
+// twice, is off by more than ACCURACY_BOUND_CENTIPA, or if readings are
+// dropped during an outage the queue should have covered.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <Arduino.h>
+#include "config.h"
+#include "hvac_tests.h"
+#include "pressure.h"
+
+const CentiPa ACCURACY_BOUND_CENTIPA = 20;
+
+static std::mt19937 rng(23);
+static double trueMicroAmps;      // The transmitter's output this sample
+static double windowTrueSum;      // Over the in-band samples of the current window
+static int windowSamples;
+static bool wirePulled;
+static std::normal_distribution<double> adcNoise(0, 30); // uA
+
+static int32_t benchSource() {
+  if (wirePulled) return 0; // Left out of the reading, so out of its truth too
+  windowTrueSum += trueMicroAmps;
+  windowSamples++;
+  return (int32_t)lround(trueMicroAmps + adcNoise(rng));
+}
+
+// -- Mock HTTP endpoint --
+struct Delivered { uint32_t timestampMs; CentiPa pressure; uint8_t status; unsigned long receivedAt; };
+static std::vector<Delivered> store;
+static uint32_t lastSequence;
+static unsigned long simNow, requests, duplicates, malformed;
+static double failRate;
+static bool endpointDown;
+
+static bool benchTransport(const char* payload, size_t len) {
+  requests++;
+  std::uniform_real_distribution<double> u(0, 1);
+  if (endpointDown || u(rng) < failRate) return false; // Connection refused or 5xx
+
+  std::string body(payload, len);
+  unsigned long seq, now;
+  const char* p = body.c_str();
+  if (sscanf(p, "{\"seq\":%lu,\"now\":%lu,\"r\":[", &seq, &now) != 2 || !(p = strstr(p, "\"r\":["))) { malformed++; return false; }
+  p += 5;
+  std::vector<Delivered> batch;
+  unsigned long t; long v; unsigned ua, status; int used;
+  while (sscanf(p, "[%lu,%ld,%u,%u]%n", &t, &v, &ua, &status, &used) == 4) {
+    batch.push_back({ (uint32_t)t, (CentiPa)v, (uint8_t)status, simNow });
+    p += used;
+    if (*p == ',') p++;
+  }
+  if (strcmp(p, "]}") != 0) { malformed++; return false; }
+  if (seq == lastSequence) duplicates++; // Stored already, its acknowledgement was lost
+  else store.insert(store.end(), batch.begin(), batch.end());
+  lastSequence = seq;
+  return u(rng) >= failRate; // Stored, but the response can still be lost
+}
+
+int main(int argc, char** argv) {
+  int days = 30;
+  double outageHours = 3;
+  failRate = 0.05;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--days") && i + 1 < argc) days = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--outage-hours") && i + 1 < argc) outageHours = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--fail-rate") && i + 1 < argc) failRate = atof(argv[++i]);
+    else { fprintf(stderr, "Usage: %s [--days N] [--outage-hours H] [--fail-rate P]\n", argv[0]); return 2; }
+  }
+
+  g_isTesting = true; // No tasks: the bench steps the sampler and uploader itself
+  startPressureMonitor();
+  setPressureSource(benchSource);
+  setPressureTransport(benchTransport);
+
+  const unsigned long DAY_MS = 24UL * 3600 * 1000, END = days * DAY_MS;
+  std::vector<double> truth; // True mean pressure of each window, in order
+  std::uniform_real_distribution<double> u(0, 1);
+  double sampleNs = 0, uploadNs = 0;
+  unsigned long uploadSteps = 0, pullUntil = 0;
+
+  for (simNow = 0; simNow < END; simNow += PRESSURE_SAMPLE_INTERVAL_MS) {
+    unsigned long minute = simNow / 60000;
+    double inchesWC = (minute % 30 < 20 ? 0.62 : 0.04) + 0.03 * sin(simNow / 3.6e6);
+    trueMicroAmps = PRESSURE_LOOP_ZERO_UA + PRESSURE_LOOP_SPAN_UA * inchesWC;
+    if (!pullUntil && u(rng) < 1.0 / (3 * DAY_MS / PRESSURE_SAMPLE_INTERVAL_MS)) pullUntil = simNow + 5 * 60000;
+    wirePulled = pullUntil && simNow < pullUntil;
+    if (pullUntil && simNow >= pullUntil) pullUntil = 0;
+    endpointDown = simNow % DAY_MS >= 2 * 3600000UL && simNow % DAY_MS < 2 * 3600000UL + outageHours * 3600000;
+
+    unsigned long readings = pressureStats.readings;
+    auto t0 = std::chrono::steady_clock::now();
+    samplePressure(simNow);
+    sampleNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    if (pressureStats.readings != readings) {
+      truth.push_back(windowSamples ? windowTrueSum / windowSamples : 0);
+      windowTrueSum = 0; windowSamples = 0;
+    }
+    if (simNow % PRESSURE_UPLOAD_POLL_MS == 0) {
+      auto t1 = std::chrono::steady_clock::now();
+      uploadPressure(simNow);
+      uploadNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t1).count();
+      uploadSteps++;
+    }
+  }
+  double refuseRate = failRate;
+  endpointDown = false; failRate = 0;
+  for (unsigned long end = simNow + 2 * PRESSURE_RETRY_MAX_SECS * 1000 + PRESSURE_BATCH_MAX_AGE_SECS * 1000; simNow < end; simNow += 1000) uploadPressure(simNow);
+
+  // Every produced reading is delivered, in order and once, unless it was dropped.
+  const PressureStats& s = pressureStats;
+  unsigned long misordered = 0, faults = 0;
+  CentiPa worstError = 0;
+  std::vector<unsigned long> latency;
+  for (size_t i = 0; i < store.size(); i++) {
+    const Delivered& d = store[i];
+    if (i && d.timestampMs <= store[i - 1].timestampMs) misordered++;
+    latency.push_back(d.receivedAt - d.timestampMs);
+    if (d.status != PRESSURE_OK) { faults++; continue; }
+    size_t window = d.timestampMs / (PRESSURE_DECIMATION * PRESSURE_SAMPLE_INTERVAL_MS);
+    if (window < truth.size()) worstError = std::max(worstError, (CentiPa)std::abs(d.pressure - loopCurrentToCentiPa((uint32_t)lround(truth[window]))));
+  }
+  std::sort(latency.begin(), latency.end());
+  unsigned long lost = s.readings - s.dropped - store.size();
+  double hours = days * 24.0;
+  double queueHours = (PRESSURE_QUEUE_READINGS + PRESSURE_BATCH_READINGS) * PRESSURE_DECIMATION * PRESSURE_SAMPLE_INTERVAL_MS / 3.6e6;
+
+  printf("Pressure monitor: %d days, %.1f h outage daily, %.0f%% of requests refused and %.0f%% of acknowledgements lost\n", days,
+         outageHours, refuseRate * 100, refuseRate * 100);
+  printf("  Sampling     %lu samples at %.2f Hz measured (%lu ms configured), %lu readings, %lu open-loop\n", s.samples,
+         pressureSampleRateHz(), PRESSURE_SAMPLE_INTERVAL_MS, s.readings, s.openLoop);
+  printf("  Uplink       %lu batches, %.1f requests/h against %.1f for one per reading; %lu refused; %lu resends deduplicated\n",
+         s.batches, requests / hours, s.readings / hours, s.failures, duplicates);
+  printf("  Payload      %.1f bytes/reading, %lu bytes in all\n", s.readingsSent ? (double)s.bytesSent / s.readingsSent : 0.0, s.bytesSent);
+  printf("  Delivery     p50 %.1f min  p99 %.1f min  max %.1f min; queue covers %.1f h\n", latency.empty() ? 0 : latency[latency.size() / 2] / 6e4,
+         latency.empty() ? 0 : latency[(size_t)(latency.size() * 0.99)] / 6e4, latency.empty() ? 0 : latency.back() / 6e4, queueHours);
+  printf("  Accuracy     worst %d centiPa (%.4f in WC) against the true window mean; %lu fault readings delivered\n", worstError,
+         worstError / 24884.0, faults);
+  printf("  RAM          %zu bytes\n", pressureMemoryBytes());
+  printf("  Host time    %.1f ns/sample, %.1f ns/upload step\n", sampleNs / s.samples, uploadNs / std::max(1UL, uploadSteps));
+  printf("  Delivered %zu, dropped %lu, lost %lu, out of order %lu, malformed %lu\n", store.size(), s.dropped, lost, misordered, malformed);
+
+  bool failed = lost || misordered || malformed || worstError > ACCURACY_BOUND_CENTIPA || (outageHours < queueHours && s.dropped);
+  if (failed) printf("  FAILED\n");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,96 @@
+// Psychrometric kernel benchmark and accuracy sweep: the table kernel against
+// the double-precision Magnus formula it replaced. The sweep covers every
+// 0.01 C of the table for the single-input helpers and a 0.03 x 0.07 C grid of
+// indoor/outdoor pairs for the window limit; the exit code is non-zero if any
+// error exceeds the bounds documented in psychrometrics.h. On the host both
+// versions run on the FPU, so the timings only show the kernel costs no more;
+// on the FPU-less ESP32-C6 the reference's double exp() is soft-float.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "hvac_logic.h"
+#include "psychrometrics.h"
+
+static volatile float sink;
+
+template <typename Fn>
+static double nsPerOp(int iterations, Fn fn) {
+  auto start = std::chrono::steady_clock::now();
+  for (int n = 0; n < iterations; n++) fn(n);
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+static double magnusSvp(double t) { return 6.1094 * exp(17.625 * t / (243.04 + t)); }
+static double magnusDewPoint(double t, double rh) {
+  double g = log(rh / 100.0) + 17.625 * t / (243.04 + t);
+  return 243.04 * g / (17.625 - g);
+}
+
+static int report(const char* name, double error, double bound, const char* unit) {
+  bool ok = error < bound;
+  printf("  %-30s max error %9.5f %-4s (bound %-4g) %s\n", name, error, unit, bound, ok ? "ok" : "EXCEEDED");
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+  int iterations = 5000000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--iterations") && i + 1 < argc) iterations = atoi(argv[++i]);
+    else { fprintf(stderr, "Usage: %s [--iterations N]\n", argv[0]); return 2; }
+  }
+
+  double svpError = 0, dewError = 0, ahError = 0, windowError = 0, wrapperError = 0;
+  for (int32_t c = PSYCHRO_MIN_CENTI_C; c <= PSYCHRO_MAX_CENTI_C; c++) {
+    double t = c / 100.0, es = magnusSvp(t);
+    svpError = std::max(svpError, fabs(saturationVapourPressure(c) / (double)(1 << PSYCHRO_SVP_FRAC_BITS) / es - 1) * 100);
+    for (int32_t rh = 500; rh <= 10000; rh += 500) {
+      double td = magnusDewPoint(t, rh / 100.0);
+      if (td > PSYCHRO_MIN_CENTI_C / 100.0 + 0.5) dewError = std::max(dewError, fabs(dewPoint(c, rh) / 100.0 - td));
+      double ah = 216685.0 * es * rh / 10000 / (t + 273.15);
+      if (ah > 1000) ahError = std::max(ahError, fabs(absoluteHumidity(c, rh) / ah - 1) * 100); // Whole mg: quantisation dominates below 1 g/m3
+    }
+  }
+  for (int32_t in = 500; in <= 3500; in += 3) {
+    for (int32_t out = -4000; out <= 4000; out += 7) {
+      windowError = std::max(windowError, fabs(maxHumidityForWindow(in, out) / 100.0 - referenceMaxHumidityForWindow(in / 100.0, out / 100.0)));
+    }
+  }
+  // Float inputs off the 0.01 C grid, as the sensors deliver them.
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> indoor(5, 35), outdoor(-40, 40);
+  for (int n = 0; n < 1000000; n++) {
+    float in = indoor(rng), out = outdoor(rng);
+    wrapperError = std::max(wrapperError, fabs(calculateMaxHumidityForWindow(in, out) - referenceMaxHumidityForWindow(in, out)));
+  }
+
+  printf("Psychrometric kernel accuracy against double-precision Magnus (%zu-byte table)\n", sizeof(uint32_t) * PSYCHRO_TABLE_SIZE);
+  int failures = 0;
+  failures += report("saturationVapourPressure", svpError, 0.01, "%");
+  failures += report("maxHumidityForWindow", windowError, 0.02, "%RH");
+  failures += report("calculateMaxHumidityForWindow", wrapperError, 0.05, "%RH");
+  failures += report("dewPoint", dewError, 0.01, "C");
+  failures += report("absoluteHumidity", ahError, 0.1, "%");
+
+  const int SAMPLE_COUNT = 4096;
+  std::vector<float> ins(SAMPLE_COUNT), outs(SAMPLE_COUNT);
+  for (int n = 0; n < SAMPLE_COUNT; n++) { ins[n] = indoor(rng); outs[n] = outdoor(rng); }
+  double reference = nsPerOp(iterations, [&](int n) {
+    sink = (float)referenceMaxHumidityForWindow(ins[n & (SAMPLE_COUNT - 1)], outs[n & (SAMPLE_COUNT - 1)]);
+  });
+  double kernel = nsPerOp(iterations, [&](int n) {
+    sink = calculateMaxHumidityForWindow(ins[n & (SAMPLE_COUNT - 1)], outs[n & (SAMPLE_COUNT - 1)]);
+  });
+  double dew = nsPerOp(iterations, [&](int n) { sink = (float)dewPoint(2000 + (n & 1023), 4500); });
+
+  printf("Window humidity limit, %d iterations\n", iterations);
+  printf("  %-34s %8.1f ns/op\n", "reference (double Magnus)", reference);
+  printf("  %-34s %8.1f ns/op  %5.1fx\n", "table kernel", kernel, reference / kernel);
+  printf("  %-34s %8.1f ns/op\n", "dew point", dew);
+  return failures;
+}
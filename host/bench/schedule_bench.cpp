@@ -0,0 +1,84 @@
+// Schedule lookup benchmark: the reference linear scan (entry lookup plus the
+// next-change scan, as each control pass used to do) against the compiled
+// timeline, cold and through the per-instance cursor that control passes hit
+// between transitions.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "config.h"
+#include "controller.h"
+#include "main.h"
+#include "schedule.h"
+
+static volatile int sink;
+
+template <typename Fn>
+static double nsPerOp(int iterations, Fn fn) {
+  auto start = std::chrono::steady_clock::now();
+  for (int n = 0; n < iterations; n++) fn(n);
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+int main(int argc, char** argv) {
+  int iterations = 2000000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--iterations") && i + 1 < argc) iterations = atoi(argv[++i]);
+    else { fprintf(stderr, "Usage: %s [--iterations N]\n", argv[0]); return 2; }
+  }
+
+  // A full schedule: ten weekday entries, two overrides and a few holidays.
+  static ControllerStorage<1> unit;
+  ControllerBatch& b = unit.batch;
+  Schedule& sched = b.programSchedule[0];
+  sched.weekdayEntryCount = MAX_DAY_ENTRIES;
+  for (int e = 0; e < MAX_DAY_ENTRIES; e++) sched.weekday[e] = { (uint8_t)(5 + e * 2 - (e > 8)), 15, centiCFromF(66.0f + e), FAN_AUTO };
+  sched.dayOverride[3][0] = { 7, 0, centiCFromF(69.0), FAN_AUTO }; sched.dayOverride[3][1] = { 18, 0, centiCFromF(71.0), FAN_AUTO };
+  sched.dayOverrideCount[3] = 2;
+  sched.exceptions[0] = { 1, 1, 0 }; sched.exceptions[1] = { 7, 4, 0 }; sched.exceptions[2] = { 12, 25, 0 };
+  sched.exceptionCount = 3;
+
+  const int SAMPLE_COUNT = 4096;
+  std::mt19937 rng(1);
+  std::vector<TimeInfo> samples(SAMPLE_COUNT);
+  for (TimeInfo& t : samples) t = { 1 + (int)(rng() % 12), 1 + (int)(rng() % 28), (int)(rng() % 7), (int)(rng() % 24), (int)(rng() % 60), (int)(rng() % 60) };
+
+  double scan = nsPerOp(iterations, [&](int n) {
+    const TimeInfo& t = samples[n & (SAMPLE_COUNT - 1)];
+    sink = lookupScheduleEntry(sched, false, t).target + (int)secondsUntilNextScheduleChange(sched, false, t);
+  });
+
+  CompiledSchedule compiled;
+  compileSchedule(sched, compiled);
+  double cold = nsPerOp(iterations, [&](int n) {
+    ScheduleLookup found = lookupCompiledSchedule(compiled, false, samples[n & (SAMPLE_COUNT - 1)]);
+    sink = found.entry->target + (int)found.secondsValid;
+  });
+
+  // A control pass every 5 s of a simulated day: the cursor answers from cache
+  // until each transition, then does one compiled lookup.
+  const TimeInfo day0 = { 3, 2, 1, 0, 0, 0 };
+  double cached = nsPerOp(iterations, [&](int n) {
+    unsigned long secondOfDay = (unsigned long)(n % 17280) * 5;
+    b.now = secondOfDay * 1000;
+    if (!scheduleCursorValid(b, 0)) {
+      TimeInfo t = day0; t.hour = secondOfDay / 3600; t.minute = secondOfDay / 60 % 60; t.second = secondOfDay % 60;
+      if (secondOfDay == 0) invalidateScheduleCursor(b, 0);
+      sink = activeScheduleEntry(b, 0, t).target;
+    } else {
+      sink = b.scheduleCursor[0].entry->target;
+    }
+  });
+
+  double compileNs = nsPerOp(std::max(1, iterations / 100), [&](int) { compileSchedule(sched, compiled); sink = compiled.transitions[0].entry.target; });
+
+  printf("Schedule lookup, %d iterations (%zu-byte compiled timeline)\n", iterations, sizeof(CompiledSchedule));
+  printf("  %-34s %8.1f ns/op\n", "reference scan (entry + next)", scan);
+  printf("  %-34s %8.1f ns/op  %5.1fx\n", "compiled lookup (cold)", cold, scan / cold);
+  printf("  %-34s %8.1f ns/op  %5.1fx\n", "cursor, pass every 5 s", cached, scan / cached);
+  printf("  %-34s %8.1f ns/op\n", "compile (on edit only)", compileNs);
+  return 0;
+}
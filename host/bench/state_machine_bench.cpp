@@ -0,0 +1,167 @@
+// State machine benchmark: stepThermostat() (state_machine.h) for each
+// equipment profile against controlTemperature(), the nested decision code it
+// replaces in loop(). Every path replays the same minute-by-minute trace, a
+// house drifting around its setpoint through a mild year so that heating,
+// cooling and both economizer branches all run, each on its own controller
+// state. The report gives time per pass, emulated ESP32-C6 cycles
+// (esp_cpu_get_cycle_count() counts at 160 MHz on the host), the share of
+// passes spent in each state, and code size read from this executable's
+// symbol table with nm. Sizes are for the host's instruction set and
+// optimisation level, so compare them with each other, not with a firmware
+// image. The exit code is 1 if the furnace-and-air machine with an
+// economizer ever leaves different relays or timers than controlTemperature().
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <limits.h>
+#include <unistd.h>
+#include <Arduino.h>
+#include "config.h"
+#include "controller.h"
+#include "esp_cpu.h"
+#include "hvac_logic.h"
+#include "state_machine.h"
+
+struct Sample { CentiC indoor, outdoor; };
+
+static const char* stateName(ThermostatState s) {
+  switch (s) {
+    case IDLE: return "idle";
+    case HEATING: return "heating";
+    case COOLING: return "cooling";
+    case ECONOMIZER_HEATING: return "economizer heating";
+    case ECONOMIZER_COOLING: return "economizer cooling";
+    default: return "other";
+  }
+}
+
+// Bytes of each function whose demangled name starts with one of the given
+// prefixes, summed; 0 if nm is not on the path.
+static unsigned long symbolBytes(const std::vector<std::string>& prefixes) {
+  char self[PATH_MAX + 1] = {};
+  if (readlink("/proc/self/exe", self, PATH_MAX) <= 0) return 0;
+  FILE* nm = popen(("nm -S -C '" + std::string(self) + "' 2>/dev/null").c_str(), "r");
+  if (!nm) return 0;
+  unsigned long total = 0;
+  char line[512];
+  while (fgets(line, sizeof(line), nm)) {
+    unsigned long long address, size;
+    char type;
+    int used;
+    if (sscanf(line, "%llx %llx %c %n", &address, &size, &type, &used) != 3 || (type != 'T' && type != 't' && type != 'W')) continue;
+    std::string name(line + used);
+    for (const std::string& prefix : prefixes) if (name.compare(0, prefix.size(), prefix) == 0) { total += size; break; }
+  }
+  pclose(nm);
+  return total;
+}
+
+struct Path {
+  const char* label;
+  void (*step)(ControllerBatch& b, int i, CentiC temp, CentiC target, CentiC outdoor);
+  const char* symbol;
+};
+
+template <EquipmentProfile Profile, bool Economizer>
+static void machine(ControllerBatch& b, int i, CentiC temp, CentiC target, CentiC outdoor) {
+  stepThermostat<Profile, Economizer>(b, i, temp, target, outdoor);
+}
+
+static void reference(ControllerBatch& b, int i, CentiC temp, CentiC target, CentiC outdoor) { controlTemperature(b, i, temp, target, outdoor); }
+
+int main(int argc, char** argv) {
+  int iterations = 2000000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--iterations") && i + 1 < argc) iterations = atoi(argv[++i]);
+    else { fprintf(stderr, "Usage: %s [--iterations N]\n", argv[0]); return 2; }
+  }
+
+  const Path PATHS[] = {
+    { "controlTemperature()", reference, "controlTemperature(ControllerBatch&" },
+    { "heat+cool, economizer", machine<EQUIPMENT_HEAT_COOL, true>, "ThermostatState stepThermostat<(EquipmentProfile)2, true>" },
+    { "heat+cool", machine<EQUIPMENT_HEAT_COOL, false>, "ThermostatState stepThermostat<(EquipmentProfile)2, false>" },
+    { "heat pump, economizer", machine<EQUIPMENT_HEAT_PUMP, true>, "ThermostatState stepThermostat<(EquipmentProfile)3, true>" },
+    { "heat only", machine<EQUIPMENT_HEAT_ONLY, false>, "ThermostatState stepThermostat<(EquipmentProfile)0, false>" },
+    { "cool only", machine<EQUIPMENT_COOL_ONLY, false>, "ThermostatState stepThermostat<(EquipmentProfile)1, false>" },
+  };
+  const int NUM_PATHS = sizeof(PATHS) / sizeof(PATHS[0]);
+
+  // A year squeezed into the trace: outdoor 20-95 F, and a house with internal
+  // gains that answers the relays of a controlTemperature() run, so the
+  // equipment and the economizer cycle as they would. The paths then replay
+  // its readings open loop.
+  const int TRACE_LENGTH = 8192;
+  const unsigned long STEP_MS = 60000;
+  const CentiC TARGET = centiCFromF(70);
+  std::vector<Sample> trace(TRACE_LENGTH);
+  std::mt19937 rng(11);
+  std::normal_distribution<float> noise(0, 0.3f);
+  static ControllerStorage<1> house;
+  ControllerBatch& h = house.batch;
+  h.systemMode[0] = SYS_AUTO; h.tempUnit[0] = FAHRENHEIT; h.season = 0; h.now = 0;
+  initialize_logic_timers(h, 0, h.now);
+  float indoorF = 70;
+  for (int n = 0; n < TRACE_LENGTH; n++, h.now += STEP_MS) {
+    float outdoorF = 57.5f - 37.5f * cosf(n * 6.2832f / TRACE_LENGTH) + 8 * sinf(n * 6.2832f / 1440) + noise(rng);
+    trace[n] = { centiCFromF(indoorF), centiCFromF(outdoorF) };
+    controlTemperature(h, 0, trace[n].indoor, TARGET, trace[n].outdoor);
+    float leak = relayOn(h, 0, FRESH_AIR_RELAY_PIN) ? 0.03f : 0.004f;
+    indoorF += (outdoorF - indoorF) * leak + (relayOn(h, 0, HEATER_RELAY_PIN) ? 0.25f : 0) - (relayOn(h, 0, COOLER_RELAY_PIN) ? 0.2f : 0) + 0.06f + noise(rng) * 0.05f;
+  }
+
+  static ControllerStorage<NUM_PATHS> units;
+  ControllerBatch& b = units.batch;
+  b.season = 0;
+  for (int p = 0; p < NUM_PATHS; p++) { b.systemMode[p] = SYS_AUTO; b.tempUnit[p] = FAHRENHEIT; }
+
+  // Agreement and state mix: one pass of the trace, the reference on instance 0.
+  b.now = 0;
+  for (int p = 0; p < NUM_PATHS; p++) initialize_logic_timers(b, p, b.now);
+  int agree = 0;
+  unsigned long stateCount[ECONOMIZER_COOLING + 1] = {};
+  for (int n = 0; n < TRACE_LENGTH; n++, b.now += STEP_MS) {
+    const Sample& s = trace[n];
+    for (int p = 0; p < NUM_PATHS; p++) PATHS[p].step(b, p, s.indoor, TARGET, s.outdoor);
+    stateCount[b.state[1]]++;
+    if (b.relays[0] == b.relays[1] && b.lastHeaterOnTime[0] == b.lastHeaterOnTime[1] && b.lastCoolerOnTime[0] == b.lastCoolerOnTime[1] &&
+        b.lastHeaterOffTime[0] == b.lastHeaterOffTime[1] && b.lastCoolerOffTime[0] == b.lastCoolerOffTime[1])
+      agree++;
+  }
+
+  // Timing: the trace on repeat, each path on its own instance.
+  const int MASK = TRACE_LENGTH - 1;
+  double ns[NUM_PATHS];
+  uint32_t cycles[NUM_PATHS];
+  for (int p = 0; p < NUM_PATHS; p++) {
+    unsigned long start = b.now;
+    auto t0 = std::chrono::steady_clock::now();
+    uint32_t c0 = esp_cpu_get_cycle_count();
+    for (int n = 0; n < iterations; n++, b.now += STEP_MS) {
+      const Sample& s = trace[n & MASK];
+      PATHS[p].step(b, p, s.indoor, TARGET, s.outdoor);
+    }
+    cycles[p] = esp_cpu_get_cycle_count() - c0;
+    ns[p] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    b.now = start;
+  }
+
+  unsigned long actions = symbolBytes({ "void act<" });
+  printf("Temperature control pass, %d iterations\n", iterations);
+  printf("  %-24s %8s %12s %10s\n", "", "ns/pass", "cycles/pass", "code B");
+  for (int p = 0; p < NUM_PATHS; p++) {
+    unsigned long bytes = symbolBytes({ PATHS[p].symbol });
+    printf("  %-24s %8.1f %12.1f %10lu  %5.2fx\n", PATHS[p].label, ns[p] / iterations, (double)cycles[p] / iterations, bytes, ns[0] / ns[p]);
+  }
+  printf("  Machine actions, shared by every profile: %lu B\n", actions);
+  printf("  States (heat+cool, economizer):");
+  for (int s = 0; s <= ECONOMIZER_COOLING; s++)
+    if (stateCount[s]) printf(" %s %.1f%%", stateName((ThermostatState)s), 100.0 * stateCount[s] / TRACE_LENGTH);
+  printf("\n  Same relays and timers as controlTemperature() on %d of %d trace passes\n", agree, TRACE_LENGTH);
+  return agree == TRACE_LENGTH ? 0 : 1;
+}
@@ -0,0 +1,153 @@
+// Time-series store benchmark: recordSeries() (timeseries.h) fed synthetic
+// relay activity for a year and on past the new year, a pass every few
+// seconds, on the RAM-backed SPIFFS. The heater and humidifier follow
+// winter, the cooler summer, and in the shoulder seasons the economizer stands in for either. The report gives the
+// time per pass, emulated ESP32-C6 cycles (esp_cpu_get_cycle_count() counts
+// at 160 MHz on the host), flash written per day, the store's RAM and flash
+// footprint, and for each query window the latency and the buckets and file
+// reads per tier, beside the records a flat minute log would have read.
+// Windows end within the last ten hours and long ones start on a day
+// boundary, so every tier they need is still on flash; the exit code is 1 if
+// any query differs from an exact per-minute tally kept alongside.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <Arduino.h>
+#include "config.h"
+#include "controller.h"
+#include "esp_cpu.h"
+#include "timeseries.h"
+#include "SPIFFS.h"
+
+static const int RELAY_PINS[NUM_SERIES_RELAYS] = { HEATER_RELAY_PIN, COOLER_RELAY_PIN, FAN_RELAY_PIN, FRESH_AIR_RELAY_PIN, HUMIDITY_RELAY_PIN };
+static const int DAYS_IN_MONTH[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+// Exact per-minute tally.
+struct MinuteTally {
+  uint32_t ms;
+  uint32_t onMs[NUM_SERIES_RELAYS];
+  uint16_t starts[NUM_SERIES_RELAYS];
+};
+
+static TimeInfo wallAt(unsigned long long ms) {
+  unsigned long long minute = ms / 60000;
+  int dayOfYear = (int)(minute / 1440 % 365), month = 0;
+  while (dayOfYear >= DAYS_IN_MONTH[month]) dayOfYear -= DAYS_IN_MONTH[month++];
+  return { month + 1, dayOfYear + 1, (int)((minute / 1440 + 4) % 7), (int)(minute / 60 % 24), (int)(minute % 60), (int)(ms / 1000 % 60) };
+}
+
+int main(int argc, char** argv) {
+  int days = 400, queries = 2000, stepSecs = 5;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--days") && i + 1 < argc) days = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--queries") && i + 1 < argc) queries = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--step") && i + 1 < argc) stepSecs = atoi(argv[++i]);
+    else { fprintf(stderr, "Usage: %s [--days N] [--queries N] [--step SECS]\n", argv[0]); return 2; }
+  }
+  if (days < 2 || queries < 1 || stepSecs < 1 || 60 % stepSecs) { fprintf(stderr, "Need two days or more, and a step that divides a minute\n"); return 2; }
+
+  SPIFFS.begin(true);
+  eraseTimeseries();
+  const uint32_t MINUTES = days * 1440;
+  std::vector<MinuteTally> tally(MINUTES + 1);
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> unit(0, 1);
+
+  // Twenty-minute cycles: each draws a duty from the season and runs its equipment for that share.
+  const unsigned long long STEP_MS = stepSecs * 1000ULL, END_MS = MINUTES * 60000ULL;
+  uint16_t relays = 0, lastRelays = 0;
+  bool freshAirForHeating = false, economizer = false, humidify = false;
+  float duty = 0, cold = 0;
+  unsigned long passes = 0;
+  double recordNs = 0;
+  uint64_t recordCycles = 0;
+  for (unsigned long long ms = 0; ms <= END_MS; ms += STEP_MS, passes++) {
+    uint32_t minute = (uint32_t)(ms / 60000);
+    if (ms % (20 * 60000) == 0) {
+      cold = cosf((minute / 1440.0f - 20) * 6.2832f / 365);
+      duty = std::min(1.0f, std::max(0.0f, fabsf(cold) * 0.9f - 0.1f + (unit(rng) - 0.5f) * 0.3f));
+      economizer = fabsf(cold) < 0.4f && unit(rng) < 0.5f;
+      humidify = cold > 0.5f && unit(rng) < 0.3f;
+    }
+    bool running = (ms % (20 * 60000)) < duty * 20 * 60000;
+    relays = 0;
+    if (running && economizer) { relays |= RELAY_BIT(FRESH_AIR_RELAY_PIN) | RELAY_BIT(FAN_RELAY_PIN); freshAirForHeating = cold > 0; }
+    else if (running) relays |= RELAY_BIT(cold > 0 ? HEATER_RELAY_PIN : COOLER_RELAY_PIN) | RELAY_BIT(FAN_RELAY_PIN);
+    if (humidify && running) relays |= RELAY_BIT(HUMIDITY_RELAY_PIN);
+    CentiC indoor = (CentiC)(2100 + (running ? 30 : -30)), outdoor = (CentiC)(1000 - 1500 * cold);
+
+    auto t0 = std::chrono::steady_clock::now();
+    uint32_t c0 = esp_cpu_get_cycle_count();
+    recordSeries((unsigned long)ms, wallAt(ms), relays, freshAirForHeating, indoor, outdoor);
+    recordCycles += esp_cpu_get_cycle_count() - c0;
+    recordNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+
+    // The relays just recorded hold until the next pass.
+    if (ms < END_MS) {
+      MinuteTally& m = tally[minute];
+      m.ms += STEP_MS;
+      for (int r = 0; r < NUM_SERIES_RELAYS; r++) {
+        if (relays & RELAY_BIT(RELAY_PINS[r])) m.onMs[r] += STEP_MS;
+        if (ms && (relays & ~lastRelays & RELAY_BIT(RELAY_PINS[r]))) m.starts[r]++;
+      }
+    }
+    lastRelays = relays;
+  }
+
+  printf("Time series store, %d days at one pass per %d s\n", days, stepSecs);
+  printf("  Record: %.1f ns/pass, %.1f cycles/pass, flushes included\n", recordNs / passes, (double)recordCycles / passes);
+  printf("  Flash: %.1f KB written a day, %lu flushes, %lu segments recycled, %lu write errors\n", seriesStats.bytesWritten / 1024.0 / days,
+         seriesStats.flushes, seriesStats.segmentsRecycled, seriesStats.writeErrors);
+  printf("  Footprint: %zu B RAM, %zu KB flash at most (%zu KB in use)\n", timeseriesRamBytes(), timeseriesFlashBytes() / 1024, SPIFFS.usedBytes() / 1024);
+
+  const struct { const char* label; uint32_t minutes, align; } WINDOWS[] = {
+    { "1 h", 60, 1 }, { "1 d", 1440, 60 }, { "7 d", 7 * 1440, 1440 }, { "30 d", 30 * 1440, 1440 }, { "365 d", 365 * 1440, 1440 },
+  };
+  const uint32_t now = seriesNowMinute();
+  printf("  %-6s %10s %22s %22s %10s\n", "Window", "us/query", "buckets m/h/d", "reads m/h/d", "flat log");
+  int mismatches = 0;
+  std::uniform_int_distribution<uint32_t> back(0, 600);
+  for (const auto& w : WINDOWS) {
+    if (w.minutes + w.align + 600 > MINUTES) continue;
+    double ns = 0;
+    uint64_t buckets[NUM_SERIES_TIERS] = {}, reads[NUM_SERIES_TIERS] = {}, flat = 0;
+    for (int q = 0; q < queries; q++) {
+      uint32_t to = now - back(rng), from = (to - w.minutes) / w.align * w.align;
+      SeriesTotals t;
+      SeriesQueryCost cost;
+      auto t0 = std::chrono::steady_clock::now();
+      querySeries(from, to, t, &cost);
+      ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+      for (int k = 0; k < NUM_SERIES_TIERS; k++) { buckets[k] += cost.buckets[k]; reads[k] += cost.reads[k]; }
+      flat += to - from;
+
+      uint64_t expectMs = 0, expectOn[NUM_SERIES_RELAYS] = {};
+      uint32_t expectStarts[NUM_SERIES_RELAYS] = {};
+      for (uint32_t m = from; m < to; m++) {
+        expectMs += tally[m].ms;
+        for (int r = 0; r < NUM_SERIES_RELAYS; r++) { expectOn[r] += tally[m].onMs[r]; expectStarts[r] += tally[m].starts[r]; }
+      }
+      bool same = t.milliseconds == expectMs;
+      for (int r = 0; r < NUM_SERIES_RELAYS; r++) same = same && t.onMilliseconds[r] == expectOn[r] && t.starts[r] == expectStarts[r];
+      if (!same && mismatches++ < 5) {
+        printf("  Mismatch over [%u, %u): %llu ms against %llu, heater %llu against %llu\n", from, to, (unsigned long long)t.milliseconds,
+               (unsigned long long)expectMs, (unsigned long long)t.onMilliseconds[SERIES_HEATER], (unsigned long long)expectOn[SERIES_HEATER]);
+      }
+    }
+    printf("  %-6s %10.2f %8.1f/%5.1f/%6.1f %8.1f/%5.1f/%6.1f %10.0f\n", w.label, ns / queries / 1000,
+           (double)buckets[SERIES_MINUTES] / queries, (double)buckets[SERIES_HOURS] / queries, (double)buckets[SERIES_DAYS] / queries,
+           (double)reads[SERIES_MINUTES] / queries, (double)reads[SERIES_HOURS] / queries, (double)reads[SERIES_DAYS] / queries, (double)flat / queries);
+  }
+
+  SeriesTotals year;
+  querySeries(0, now + 1, year);
+  printf("  Whole run: %lu kWh, %lu kWh saved by the economizer; %lu bad records, %lu gaps\n", seriesEnergyWh(year) / 1000UL,
+         economizerSavingsWh(year) / 1000UL, seriesStats.badRecords, seriesStats.gaps);
+  printf("  %d query mismatches against the exact tally\n", mismatches);
+  return mismatches || seriesStats.writeErrors || seriesStats.badRecords ? 1 : 0;
+}
@@ -0,0 +1,116 @@
+// Multi-zone control pass against its per-tick budget. Sixteen zones with
+// their own setbacks share a three-stage heat, three-stage cool air handler;
+// a crude plant (each zone leaks towards outdoor and gains from the running
+// stages while its damper is open) closes the loop over a slow swing from
+// winter into summer, a minute per pass. Each controlZones() call is timed on
+// its own: the report gives the p50, p99 and worst pass in emulated ESP32-C6
+// cycles (esp_cpu_get_cycle_count() counts at 160 MHz on the host), stage and
+// damper occupancy, and protection violations seen from outside. The exit
+// code is non-zero if p99 exceeds ZONE_PASS_BUDGET_CYCLES or any stage broke
+// its min-off or max-run time. The host is faster than the C6, so its figures
+// are a lower bound on the device.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <Arduino.h>
+#include "config.h"
+#include "controller.h"
+#include "esp_cpu.h"
+#include "hvac_logic.h"
+#include "utils.h"
+#include "zones.h"
+
+int main(int argc, char** argv) {
+  int passes = 500000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--passes") && i + 1 < argc) passes = atoi(argv[++i]);
+    else { fprintf(stderr, "Usage: %s [--passes N]\n", argv[0]); return 2; }
+  }
+
+  const unsigned long STEP_MS = 60000;
+  static ControllerStorage<1> unit;
+  ControllerBatch& b = unit.batch;
+  b.systemMode[0] = SYS_AUTO; b.tempUnit[0] = FAHRENHEIT; b.season = 0; b.now = 0;
+  initialize_logic_timers(b, 0, b.now);
+  static ZoneGroup g;
+  initZoneGroup(g, MAX_ZONES, MAX_STAGES, MAX_STAGES, b.now);
+
+  std::mt19937 rng(11);
+  std::normal_distribution<float> noise(0, 0.01f);
+  float zoneF[MAX_ZONES], leak[MAX_ZONES], targetF[MAX_ZONES];
+  for (int z = 0; z < MAX_ZONES; z++) { zoneF[z] = 66 + z % 5; leak[z] = 0.001f + 0.0002f * (z % 7); targetF[z] = 68 + z % 4; }
+
+  std::vector<uint32_t> cycles(passes);
+  long stagePasses[NUM_STAGE_MODES][MAX_STAGES + 1] = {};
+  long openDampers = 0;
+  int violations = 0;
+  unsigned long stageOffAt[NUM_STAGE_MODES][MAX_STAGES] = {}, stageOnAt[NUM_STAGE_MODES][MAX_STAGES] = {};
+  int wasRunning[NUM_STAGE_MODES] = {};
+  float lowF = 1e9, highF = -1e9;
+  auto start = std::chrono::steady_clock::now();
+
+  for (int n = 0; n < passes; n++, b.now += STEP_MS) {
+    // Outdoor: a daily swing on a season that runs from 10 F to 95 F and back.
+    float day = n / 1440.0f;
+    float outdoorF = 52 + 42 * sinf(day * 6.2832f / 180 - 1.5708f) + 8 * sinf(day * 6.2832f);
+    bool night = fmodf(day, 1.0f) < 0.25f;
+    for (int z = 0; z < MAX_ZONES; z++) {
+      g.temp[z] = centiCFromF(zoneF[z]);
+      g.target[z] = centiCFromF(targetF[z] + (night && z % 2 ? -4 : 0));
+    }
+
+    uint32_t before = esp_cpu_get_cycle_count();
+    controlZones(g, b, 0, centiCFromF(outdoorF));
+    cycles[n] = esp_cpu_get_cycle_count() - before;
+
+    int running[NUM_STAGE_MODES] = { runningStages(g, b, 0, STAGE_HEAT), runningStages(g, b, 0, STAGE_COOL) };
+    for (int m = 0; m < NUM_STAGE_MODES; m++) {
+      stagePasses[m][running[m]]++;
+      // A stage starting before its min-off, or still on past its max-run, is a violation.
+      for (int s = 0; s < MAX_STAGES; s++) {
+        bool on = running[m] > s, was = wasRunning[m] > s;
+        unsigned long minOff = m == STAGE_HEAT ? MIN_HEATER_OFF_TIME_MS : MIN_COOLER_OFF_TIME_MS;
+        unsigned long maxRun = m == STAGE_HEAT ? MAX_HEATER_RUN_TIME_MS : MAX_COOLER_RUN_TIME_MS;
+        if (on && !was) { if (stageOffAt[m][s] && b.now - stageOffAt[m][s] <= minOff) violations++; stageOnAt[m][s] = b.now; }
+        if (!on && was) stageOffAt[m][s] = b.now;
+        if (on && b.now - stageOnAt[m][s] > maxRun + STEP_MS) violations++;
+      }
+      wasRunning[m] = running[m];
+    }
+    openDampers += __builtin_popcount(g.damperOpen);
+
+    int open = std::max(1, __builtin_popcount(g.damperOpen));
+    float supply = 0.12f * (running[STAGE_HEAT] - running[STAGE_COOL]) * std::min(3.0f, (float)MAX_ZONES / open);
+    float freshAir = relayOn(b, 0, FRESH_AIR_RELAY_PIN) ? 0.02f : 0;
+    for (int z = 0; z < MAX_ZONES; z++) {
+      zoneF[z] += leak[z] * (outdoorF - zoneF[z]) + noise(rng);
+      if (g.damperOpen & (1u << z)) zoneF[z] += supply + freshAir * (outdoorF - zoneF[z]);
+      lowF = std::min(lowF, zoneF[z]); highF = std::max(highF, zoneF[z]);
+    }
+  }
+  double hostNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  std::vector<uint32_t> sorted = cycles;
+  std::sort(sorted.begin(), sorted.end());
+  uint32_t p50 = sorted[passes / 2], p99 = sorted[(size_t)(passes * 0.99)], worst = sorted.back();
+  printf("Multi-zone pass: %d zones, %d heat + %d cool stages, %d passes\n", MAX_ZONES, MAX_STAGES, MAX_STAGES, passes);
+  printf("  cycles/pass  p50 %6u  p99 %6u  max %6u  budget %u\n", p50, p99, worst, ZONE_PASS_BUDGET_CYCLES);
+  printf("  host time    %.1f ns/pass including the plant\n", hostNs / passes);
+  for (int m = 0; m < NUM_STAGE_MODES; m++) {
+    printf("  %-4s stages  ", m == STAGE_HEAT ? "heat" : "cool");
+    for (int s = 0; s <= MAX_STAGES; s++) printf(" %d: %5.1f%%", s, 100.0 * stagePasses[m][s] / passes);
+    printf("\n");
+  }
+  printf("  Mean open dampers %.1f of %d\n", (double)openDampers / passes, MAX_ZONES);
+  printf("  Zone temperatures %.1f F to %.1f F\n", lowF, highF);
+  printf("  Protection violations: %d\n", violations);
+  bool overBudget = p99 > ZONE_PASS_BUDGET_CYCLES;
+  if (overBudget) printf("  p99 over budget\n");
+  return (overBudget || violations) ? 1 : 0;
+}
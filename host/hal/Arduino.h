@@ -0,0 +1,78 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+// Host (Linux) stand-in for the Arduino-ESP32 core. Only the subset used by
+// the firmware is provided. GPIO is backed by an in-memory pin array, and
+// delay() advances the mock clock instead of sleeping while g_isTesting is set,
+// so the firmware's loop() can be driven at full speed by the simulator.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+
+using std::abs; // Arduino-ESP32 also exposes the floating-point overloads globally
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT  0x01
+#define OUTPUT 0x03
+
+void setup();
+void loop();
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+int digitalRead(int pin);
+uint32_t analogReadMilliVolts(uint8_t pin);
+void host_set_analog_millivolts(uint8_t pin, uint32_t milliVolts); // Host only
+
+class HardwareSerial {
+public:
+  void begin(unsigned long baud) { (void)baud; }
+  explicit operator bool() const { return true; }
+
+  size_t print(const char* s);
+  size_t print(char c);
+  size_t print(int n);
+  size_t print(unsigned int n);
+  size_t print(long n);
+  size_t print(unsigned long n);
+  size_t print(double n, int digits = 2);
+
+  size_t println();
+  template <typename T> size_t println(T v) { size_t n = print(v); return n + println(); }
+  size_t println(double v, int digits) { size_t n = print(v, digits); return n + println(); }
+
+  size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+  size_t write(const uint8_t* buf, size_t len) { return emit((const char*)buf, len); }
+
+  // Receive side: bytes come from injectInput() rather than a UART.
+  int available() const { return (int)_input.size(); }
+  int read() { if (_input.empty()) return -1; int c = (unsigned char)_input.front(); _input.erase(0, 1); return c; }
+  void onReceive(std::function<void()> callback) { _onReceive = callback; }
+
+  // Host only: the simulator silences the per-tick status lines.
+  void setMuted(bool muted) { _muted = muted; }
+  bool isMuted() const { return _muted; }
+  void injectInput(const char* text) { _input += text; if (_onReceive) _onReceive(); }
+
+private:
+  size_t emit(const char* buf, size_t len);
+  bool _muted = false;
+  std::string _input;
+  std::function<void()> _onReceive;
+};
+
+extern HardwareSerial Serial;
+
+#endif // ARDUINO_H
@@ -0,0 +1,62 @@
+#ifndef SPIFFS_H
+#define SPIFFS_H
+
+// Host stand-in for the Arduino-ESP32 SPIFFS filesystem, backed by RAM. Files
+// live in a process-wide map so logs written by the firmware can be inspected
+// by host tests and tools.
+
+#include <Arduino.h>
+#include <vector>
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class File {
+public:
+  File() = default;
+  File(std::vector<uint8_t>* data, size_t pos) : _data(data), _pos(pos) {}
+
+  explicit operator bool() const { return _data != nullptr; }
+
+  size_t write(const uint8_t* buf, size_t size);
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t print(const char* s);
+  size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+  size_t read(uint8_t* buf, size_t size);
+  int read();
+  int available() const { return _data ? (int)(_data->size() - _pos) : 0; }
+  bool seek(uint32_t pos, SeekMode mode = SeekSet);
+  size_t position() const { return _pos; }
+  size_t size() const { return _data ? _data->size() : 0; }
+  void flush() {}
+  void close() { _data = nullptr; _pos = 0; }
+
+private:
+  std::vector<uint8_t>* _data = nullptr;
+  size_t _pos = 0;
+};
+
+class SPIFFSFS {
+public:
+  bool begin(bool formatOnFail = false);
+  File open(const char* path, const char* mode = FILE_READ);
+  bool exists(const char* path) const;
+  bool remove(const char* path);
+  bool rename(const char* pathFrom, const char* pathTo);
+  size_t totalBytes() const { return _totalBytes; }
+  size_t usedBytes() const;
+
+  // Host only: drop every file.
+  void format();
+
+private:
+  size_t _totalBytes = 1408 * 1024;
+};
+
+extern SPIFFSFS SPIFFS;
+
+#endif // SPIFFS_H
@@ -0,0 +1,9 @@
+#ifndef ESP_ATTR_H
+#define ESP_ATTR_H
+
+// Host stand-in for esp_attr.h. There is no RTC memory on Linux; retained
+// variables are ordinary statics and last as long as the process.
+
+#define RTC_NOINIT_ATTR
+
+#endif // ESP_ATTR_H
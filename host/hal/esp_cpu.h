@@ -0,0 +1,16 @@
+#ifndef ESP_CPU_H
+#define ESP_CPU_H
+
+// Host stand-in for the CPU cycle counter. Counts at the ESP32-C6's default
+// 160 MHz from the monotonic clock, so probe figures read the same as on the
+// device (and wrap at 32 bits the same way).
+
+#include <chrono>
+#include <stdint.h>
+
+inline uint32_t esp_cpu_get_cycle_count() {
+  uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  return (uint32_t)(ns * 160 / 1000);
+}
+
+#endif // ESP_CPU_H
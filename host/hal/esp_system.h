@@ -0,0 +1,24 @@
+#ifndef ESP_SYSTEM_H
+#define ESP_SYSTEM_H
+
+// Host stand-in for esp_system.h. Shutdown handlers are recorded and run by
+// esp_restart(), which then exits the process. The reset reason is whatever
+// the host program last set, power-on by default.
+
+#include "esp_err.h"
+
+typedef void (*shutdown_handler_t)(void);
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handle);
+esp_err_t esp_unregister_shutdown_handler(shutdown_handler_t handle);
+void esp_restart();
+
+typedef enum {
+  ESP_RST_UNKNOWN, ESP_RST_POWERON, ESP_RST_EXT, ESP_RST_SW, ESP_RST_PANIC, ESP_RST_INT_WDT,
+  ESP_RST_TASK_WDT, ESP_RST_WDT, ESP_RST_DEEPSLEEP, ESP_RST_BROWNOUT, ESP_RST_SDIO
+} esp_reset_reason_t;
+
+esp_reset_reason_t esp_reset_reason();
+void host_set_reset_reason(esp_reset_reason_t reason); // Host only
+
+#endif // ESP_SYSTEM_H
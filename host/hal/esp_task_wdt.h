@@ -0,0 +1,12 @@
+#ifndef ESP_TASK_WDT_H
+#define ESP_TASK_WDT_H
+
+// Host stand-in for the task watchdog. There is nothing to reset on Linux.
+
+#include "esp_err.h"
+
+inline esp_err_t esp_task_wdt_init(unsigned int timeout_s, bool panic) { (void)timeout_s; (void)panic; return ESP_OK; }
+inline esp_err_t esp_task_wdt_add(void* task) { (void)task; return ESP_OK; }
+inline esp_err_t esp_task_wdt_reset() { return ESP_OK; }
+
+#endif // ESP_TASK_WDT_H
@@ -0,0 +1,26 @@
+#ifndef FREERTOS_TASK_H
+#define FREERTOS_TASK_H
+
+// Host stand-in for FreeRTOS tasks and direct-to-task notifications. Each
+// std::thread gets its own notification slot; xTaskCreate starts a detached
+// std::thread.
+
+#include "FreeRTOS.h"
+
+struct HostTask;
+typedef HostTask* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+TaskHandle_t xTaskGetCurrentTaskHandle();
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount();
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char* name, uint32_t stackDepth, void* params,
+                       UBaseType_t priority, TaskHandle_t* createdTask);
+
+#define portYIELD_FROM_ISR(x) ((void)(x))
+
+#endif // FREERTOS_TASK_H
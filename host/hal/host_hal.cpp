@@ -0,0 +1,376 @@
+#include <Arduino.h>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "hvac_tests.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "esp_system.h"
+#include "SPIFFS.h"
+#include "soc/gpio_reg.h"
+#include "soc/soc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// =================================================================
+// ==                     ARDUINO CORE                            ==
+// =================================================================
+HardwareSerial Serial;
+
+static const int HOST_PIN_COUNT = 64;
+static int hostPins[HOST_PIN_COUNT];
+
+unsigned long millis() {
+  static const auto start = std::chrono::steady_clock::now();
+  return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+unsigned long micros() {
+  static const auto start = std::chrono::steady_clock::now();
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void delay(unsigned long ms) {
+  // Under the mocks time is virtual, so waiting is just a clock advance.
+  if (g_isTesting) { g_mockMillis += ms; return; }
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void pinMode(int pin, int mode) { (void)pin; (void)mode; }
+void digitalWrite(int pin, int value) { if (pin >= 0 && pin < HOST_PIN_COUNT) hostPins[pin] = value; }
+int digitalRead(int pin) { return (pin >= 0 && pin < HOST_PIN_COUNT) ? hostPins[pin] : LOW; }
+
+uint32_t host_reg_read(uint32_t reg) {
+  uint32_t value = 0;
+  if (reg == GPIO_OUT_REG) for (int pin = 0; pin < 32; pin++) if (hostPins[pin]) value |= 1u << pin;
+  return value;
+}
+
+void host_reg_write(uint32_t reg, uint32_t value) {
+  if (reg == GPIO_OUT_REG) for (int pin = 0; pin < 32; pin++) hostPins[pin] = (value >> pin) & 1;
+}
+
+static uint32_t hostAnalogMilliVolts[HOST_PIN_COUNT];
+uint32_t analogReadMilliVolts(uint8_t pin) { return pin < HOST_PIN_COUNT ? hostAnalogMilliVolts[pin] : 0; }
+void host_set_analog_millivolts(uint8_t pin, uint32_t milliVolts) { if (pin < HOST_PIN_COUNT) hostAnalogMilliVolts[pin] = milliVolts; }
+
+size_t HardwareSerial::emit(const char* buf, size_t len) {
+  if (_muted || len == 0) return len;
+  return fwrite(buf, 1, len, stdout);
+}
+
+size_t HardwareSerial::print(const char* s) { return _muted ? 0 : emit(s, strlen(s)); }
+size_t HardwareSerial::print(char c) { return emit(&c, 1); }
+size_t HardwareSerial::print(int n) { return print((long)n); }
+size_t HardwareSerial::print(unsigned int n) { return print((unsigned long)n); }
+
+size_t HardwareSerial::print(long n) {
+  if (_muted) return 0;
+  char buf[24]; int len = snprintf(buf, sizeof(buf), "%ld", n);
+  return emit(buf, (size_t)len);
+}
+
+size_t HardwareSerial::print(unsigned long n) {
+  if (_muted) return 0;
+  char buf[24]; int len = snprintf(buf, sizeof(buf), "%lu", n);
+  return emit(buf, (size_t)len);
+}
+
+size_t HardwareSerial::print(double n, int digits) {
+  if (_muted) return 0;
+  char buf[48]; int len = snprintf(buf, sizeof(buf), "%.*f", digits, n);
+  return emit(buf, (size_t)len);
+}
+
+size_t HardwareSerial::println() { return emit("\r\n", 2); }
+
+size_t HardwareSerial::printf(const char* fmt, ...) {
+  if (_muted) return 0;
+  char buf[256];
+  va_list args; va_start(args, fmt);
+  int len = vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  if (len < 0) return 0;
+  return emit(buf, std::min((size_t)len, sizeof(buf) - 1));
+}
+
+// =================================================================
+// ==                       ESP-IDF NVS                           ==
+// =================================================================
+typedef std::map<std::string, std::vector<uint8_t>> NvsNamespace;
+
+struct NvsHandleState {
+  std::string ns;
+  bool writable;
+  NvsNamespace pending;
+};
+
+static std::map<std::string, NvsNamespace> nvsStore;
+static std::map<nvs_handle_t, NvsHandleState> nvsHandles;
+static nvs_handle_t nvsNextHandle = 1;
+
+const char* esp_err_to_name(esp_err_t code) {
+  switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+    case ESP_ERR_NVS_INVALID_HANDLE: return "ESP_ERR_NVS_INVALID_HANDLE";
+    case ESP_ERR_NVS_READ_ONLY: return "ESP_ERR_NVS_READ_ONLY";
+    case ESP_ERR_NVS_NO_FREE_PAGES: return "ESP_ERR_NVS_NO_FREE_PAGES";
+    case ESP_ERR_NVS_INVALID_LENGTH: return "ESP_ERR_NVS_INVALID_LENGTH";
+    case ESP_ERR_NVS_NEW_VERSION_FOUND: return "ESP_ERR_NVS_NEW_VERSION_FOUND";
+    default: return "UNKNOWN ERROR";
+  }
+}
+
+esp_err_t nvs_flash_init() { return ESP_OK; }
+esp_err_t nvs_flash_erase() { host_nvs_reset(); return ESP_OK; }
+
+void host_nvs_reset() {
+  nvsStore.clear();
+  nvsHandles.clear();
+}
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle) {
+  // Like the device, a read-only open of a namespace that was never written fails.
+  if (open_mode == NVS_READONLY && nvsStore.find(name) == nvsStore.end()) return ESP_ERR_NVS_NOT_FOUND;
+  nvs_handle_t handle = nvsNextHandle++;
+  nvsHandles[handle] = NvsHandleState{ name, open_mode == NVS_READWRITE, NvsNamespace() };
+  *out_handle = handle;
+  return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) { nvsHandles.erase(handle); }
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+  auto it = nvsHandles.find(handle);
+  if (it == nvsHandles.end()) return ESP_ERR_NVS_INVALID_HANDLE;
+  NvsNamespace& ns = nvsStore[it->second.ns];
+  for (auto& kv : it->second.pending) ns[kv.first] = std::move(kv.second);
+  it->second.pending.clear();
+  return ESP_OK;
+}
+
+static esp_err_t nvsSet(nvs_handle_t handle, const char* key, const void* value, size_t length) {
+  auto it = nvsHandles.find(handle);
+  if (it == nvsHandles.end()) return ESP_ERR_NVS_INVALID_HANDLE;
+  if (!it->second.writable) return ESP_ERR_NVS_READ_ONLY;
+  const uint8_t* bytes = (const uint8_t*)value;
+  it->second.pending[key] = std::vector<uint8_t>(bytes, bytes + length);
+  return ESP_OK;
+}
+
+static const std::vector<uint8_t>* nvsFind(nvs_handle_t handle, const char* key) {
+  auto it = nvsHandles.find(handle);
+  if (it == nvsHandles.end()) return nullptr;
+  auto pending = it->second.pending.find(key);
+  if (pending != it->second.pending.end()) return &pending->second;
+  auto ns = nvsStore.find(it->second.ns);
+  if (ns == nvsStore.end()) return nullptr;
+  auto entry = ns->second.find(key);
+  return entry == ns->second.end() ? nullptr : &entry->second;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length) {
+  return nvsSet(handle, key, value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out_value, size_t* length) {
+  const std::vector<uint8_t>* entry = nvsFind(handle, key);
+  if (!entry) return ESP_ERR_NVS_NOT_FOUND;
+  if (out_value == nullptr) { *length = entry->size(); return ESP_OK; }
+  if (*length < entry->size()) { *length = entry->size(); return ESP_ERR_NVS_INVALID_LENGTH; }
+  memcpy(out_value, entry->data(), entry->size());
+  *length = entry->size();
+  return ESP_OK;
+}
+
+esp_err_t nvs_set_i8(nvs_handle_t handle, const char* key, int8_t value) {
+  return nvsSet(handle, key, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_i8(nvs_handle_t handle, const char* key, int8_t* out_value) {
+  const std::vector<uint8_t>* entry = nvsFind(handle, key);
+  if (!entry || entry->size() != sizeof(int8_t)) return ESP_ERR_NVS_NOT_FOUND;
+  *out_value = (int8_t)(*entry)[0];
+  return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+  auto it = nvsHandles.find(handle);
+  if (it == nvsHandles.end()) return ESP_ERR_NVS_INVALID_HANDLE;
+  it->second.pending.erase(key);
+  auto ns = nvsStore.find(it->second.ns);
+  if (ns == nvsStore.end() || ns->second.erase(key) == 0) return ESP_ERR_NVS_NOT_FOUND;
+  return ESP_OK;
+}
+
+// =================================================================
+// ==                   ESP-IDF SYSTEM                            ==
+// =================================================================
+static std::vector<shutdown_handler_t> shutdownHandlers;
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handle) {
+  if (std::find(shutdownHandlers.begin(), shutdownHandlers.end(), handle) != shutdownHandlers.end()) return ESP_ERR_INVALID_STATE;
+  shutdownHandlers.push_back(handle);
+  return ESP_OK;
+}
+
+esp_err_t esp_unregister_shutdown_handler(shutdown_handler_t handle) {
+  auto it = std::find(shutdownHandlers.begin(), shutdownHandlers.end(), handle);
+  if (it == shutdownHandlers.end()) return ESP_ERR_INVALID_STATE;
+  shutdownHandlers.erase(it);
+  return ESP_OK;
+}
+
+void esp_restart() {
+  for (auto it = shutdownHandlers.rbegin(); it != shutdownHandlers.rend(); ++it) (*it)();
+  exit(0);
+}
+
+static esp_reset_reason_t resetReason = ESP_RST_POWERON;
+esp_reset_reason_t esp_reset_reason() { return resetReason; }
+void host_set_reset_reason(esp_reset_reason_t reason) { resetReason = reason; }
+
+// =================================================================
+// ==                   SPIFFS (RAM-BACKED)                       ==
+// =================================================================
+SPIFFSFS SPIFFS;
+static std::map<std::string, std::vector<uint8_t>> ramFiles;
+
+bool SPIFFSFS::begin(bool formatOnFail) { (void)formatOnFail; return true; }
+void SPIFFSFS::format() { ramFiles.clear(); }
+bool SPIFFSFS::exists(const char* path) const { return ramFiles.count(path) != 0; }
+bool SPIFFSFS::remove(const char* path) { return ramFiles.erase(path) != 0; }
+
+bool SPIFFSFS::rename(const char* pathFrom, const char* pathTo) {
+  auto it = ramFiles.find(pathFrom);
+  if (it == ramFiles.end()) return false;
+  std::vector<uint8_t> data = std::move(it->second);
+  ramFiles.erase(it);
+  ramFiles[pathTo] = std::move(data);
+  return true;
+}
+
+size_t SPIFFSFS::usedBytes() const {
+  size_t used = 0;
+  for (const auto& kv : ramFiles) used += kv.second.size();
+  return used;
+}
+
+File SPIFFSFS::open(const char* path, const char* mode) {
+  if (mode[0] == 'r') {
+    auto it = ramFiles.find(path);
+    return it == ramFiles.end() ? File() : File(&it->second, 0);
+  }
+  std::vector<uint8_t>& data = ramFiles[path];
+  if (mode[0] == 'w') data.clear();
+  return File(&data, data.size());
+}
+
+size_t File::write(const uint8_t* buf, size_t size) {
+  if (!_data) return 0;
+  if (_pos + size > _data->size()) _data->resize(_pos + size);
+  memcpy(_data->data() + _pos, buf, size);
+  _pos += size;
+  return size;
+}
+
+size_t File::print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+
+size_t File::printf(const char* fmt, ...) {
+  char buf[256];
+  va_list args; va_start(args, fmt);
+  int len = vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  if (len < 0) return 0;
+  return write((const uint8_t*)buf, std::min((size_t)len, sizeof(buf) - 1));
+}
+
+size_t File::read(uint8_t* buf, size_t size) {
+  if (!_data) return 0;
+  size_t n = std::min(size, _data->size() - _pos);
+  memcpy(buf, _data->data() + _pos, n);
+  _pos += n;
+  return n;
+}
+
+int File::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+  if (!_data) return false;
+  size_t base = (mode == SeekSet) ? 0 : (mode == SeekCur) ? _pos : _data->size();
+  if (base + pos > _data->size()) return false;
+  _pos = base + pos;
+  return true;
+}
+
+// =================================================================
+// ==               FREERTOS TASKS & NOTIFICATIONS                ==
+// =================================================================
+struct HostTask {
+  std::mutex lock;
+  std::condition_variable signal;
+  uint32_t notifyCount = 0;
+};
+
+static HostTask* currentHostTask() {
+  // Tasks are never deleted on the host, so the slot outlives its thread.
+  static thread_local HostTask* task = new HostTask();
+  return task;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() { return currentHostTask(); }
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait) {
+  HostTask* task = currentHostTask();
+  std::unique_lock<std::mutex> guard(task->lock);
+  auto ready = [task]() { return task->notifyCount > 0; };
+  if (ticksToWait == portMAX_DELAY) task->signal.wait(guard, ready);
+  else task->signal.wait_for(guard, std::chrono::milliseconds(ticksToWait), ready);
+  uint32_t count = task->notifyCount;
+  if (count > 0) task->notifyCount = clearCountOnExit ? 0 : count - 1;
+  return count;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  { std::lock_guard<std::mutex> guard(task->lock); task->notifyCount++; }
+  task->signal.notify_one();
+  return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken) {
+  xTaskNotifyGive(task);
+  if (higherPriorityTaskWoken) *higherPriorityTaskWoken = pdTRUE;
+}
+
+void vTaskDelay(TickType_t ticks) { std::this_thread::sleep_for(std::chrono::milliseconds(ticks)); }
+TickType_t xTaskGetTickCount() { return (TickType_t)millis(); }
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char* name, uint32_t stackDepth, void* params,
+                       UBaseType_t priority, TaskHandle_t* createdTask) {
+  (void)name; (void)stackDepth; (void)priority;
+  std::mutex started;
+  std::condition_variable startedSignal;
+  TaskHandle_t handle = nullptr;
+  std::thread([&, code, params]() {
+    { std::lock_guard<std::mutex> guard(started); handle = currentHostTask(); }
+    startedSignal.notify_one();
+    code(params);
+  }).detach();
+  std::unique_lock<std::mutex> guard(started);
+  startedSignal.wait(guard, [&]() { return handle != nullptr; });
+  if (createdTask) *createdTask = handle;
+  return pdPASS;
+}
@@ -0,0 +1,29 @@
+#ifndef NVS_H
+#define NVS_H
+
+// Host stand-in for the ESP-IDF NVS API, backed by an in-memory key/value
+// store. Writes are staged per handle and only become visible on nvs_commit(),
+// matching the device semantics closely enough for settings round-trips.
+
+#include <cstddef>
+#include <cstdint>
+#include "esp_err.h"
+
+typedef uint32_t nvs_handle_t;
+
+typedef enum { NVS_READONLY, NVS_READWRITE } nvs_open_mode_t;
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle);
+void nvs_close(nvs_handle_t handle);
+esp_err_t nvs_commit(nvs_handle_t handle);
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length);
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* out_value, size_t* length);
+esp_err_t nvs_set_i8(nvs_handle_t handle, const char* key, int8_t value);
+esp_err_t nvs_get_i8(nvs_handle_t handle, const char* key, int8_t* out_value);
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key);
+
+// Host only: wipe the backing store between test runs.
+void host_nvs_reset();
+
+#endif // NVS_H
@@ -0,0 +1,10 @@
+#ifndef SOC_GPIO_REG_H
+#define SOC_GPIO_REG_H
+
+// Host stand-in for the ESP32-C6 GPIO register map: the output register, bit
+// n driving GPIO n, reads and writes the host pin array.
+
+#define DR_REG_GPIO_BASE 0x60091000
+#define GPIO_OUT_REG (DR_REG_GPIO_BASE + 0x4)
+
+#endif // SOC_GPIO_REG_H
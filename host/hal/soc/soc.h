@@ -0,0 +1,15 @@
+#ifndef SOC_SOC_H
+#define SOC_SOC_H
+
+// Host stand-in for the peripheral register accessors. Only the registers
+// the firmware touches are backed, by host_hal.cpp.
+
+#include <stdint.h>
+
+uint32_t host_reg_read(uint32_t reg);
+void host_reg_write(uint32_t reg, uint32_t value);
+
+#define REG_READ(reg) host_reg_read(reg)
+#define REG_WRITE(reg, value) host_reg_write((reg), (value))
+
+#endif // SOC_SOC_H
@@ -0,0 +1,15 @@
+// Runs the on-device self-test suite on the host build. The exit code is the
+// number of failed checks so ctest can gate on it.
+
+#include "hvac_tests.h"
+#include "learning.h"
+#include "nvs.h"
+#include "persistence.h"
+
+int main() {
+  // Same order as setup(): settings, then the learning log, then the tests.
+  host_nvs_reset();
+  loadSettings();
+  initialize_learning();
+  return runTests();
+}
@@ -0,0 +1,31 @@
+#include "building_model.h"
+#include <cmath>
+
+// Sensible heat carried by an airflow: 1.08 BTU/hr per CFM per degree F.
+static const float AIR_HEAT_FACTOR = 1.08;
+
+BuildingModel::BuildingModel(const BuildingParams& params, float initialTempF, float initialHumidity)
+  : _params(params), _indoorTempF(initialTempF), _indoorHumidity(initialHumidity) {}
+
+void BuildingModel::step(float dtSeconds, float outdoorTempF, const RelayInputs& relays) {
+  float dtHours = dtSeconds / 3600.0;
+
+  // Total conductance to outdoors, and the fixed heat input independent of temperature.
+  float conductance = _params.envelopeUA;
+  if (relays.freshAir) conductance += AIR_HEAT_FACTOR * _params.freshAirCfm;
+  float heatInput = _params.internalGains;
+  if (relays.heater) heatInput += _params.heaterOutput;
+  if (relays.cooler) heatInput -= _params.coolerOutput;
+
+  // C dT/dt = G (To - T) + Q  =>  T relaxes exponentially toward To + Q/G.
+  float equilibriumF = outdoorTempF + heatInput / conductance;
+  float decay = expf(-dtHours * conductance / _params.thermalMass);
+  _indoorTempF = equilibriumF + (_indoorTempF - equilibriumF) * decay;
+
+  // Indoor RH drifts toward a baseline that tracks how cold (and so how dry) it is outside.
+  float baselineRH = std::fmin(55.0f, std::fmax(20.0f, 20.0f + 0.5f * (outdoorTempF - 10.0f)));
+  float rhDecay = expf(-dtHours * _params.moistureLossRate);
+  _indoorHumidity = baselineRH + (_indoorHumidity - baselineRH) * rhDecay;
+  if (relays.humidifier) _indoorHumidity += _params.humidifierRate * dtHours;
+  if (_indoorHumidity > 100.0f) _indoorHumidity = 100.0f;
+}
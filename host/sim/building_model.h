@@ -0,0 +1,46 @@
+#ifndef BUILDING_MODEL_H
+#define BUILDING_MODEL_H
+
+// Lumped thermal model of a single-zone house, used as the plant for the host
+// simulator. The indoor air and furnishings are one thermal mass C (BTU/F)
+// coupled to outdoors through the envelope conductance UA (BTU/hr-F). Heat
+// input comes from the heater, cooler, internal gains and, when the fresh-air
+// damper is open, forced ventilation. Each step is integrated exactly, so the
+// model is stable for any tick length.
+
+struct BuildingParams {
+  float envelopeUA      = 450.0;   // BTU/hr-F through walls, roof, infiltration
+  float thermalMass     = 9000.0;  // BTU/F of air, structure and contents
+  float heaterOutput    = 60000.0; // BTU/hr delivered by the furnace
+  float coolerOutput    = 30000.0; // BTU/hr removed by the A/C
+  float freshAirCfm     = 400.0;   // economizer airflow with the damper open
+  float internalGains   = 1500.0;  // BTU/hr from occupants and appliances
+  float humidifierRate  = 4.0;     // %RH/hr added by the humidifier
+  float moistureLossRate = 0.5;    // 1/hr relaxation of indoor RH toward its baseline
+};
+
+struct RelayInputs {
+  bool heater;
+  bool cooler;
+  bool fan;
+  bool freshAir;
+  bool humidifier;
+};
+
+class BuildingModel {
+public:
+  explicit BuildingModel(const BuildingParams& params = BuildingParams(), float initialTempF = 68.0, float initialHumidity = 40.0);
+
+  void step(float dtSeconds, float outdoorTempF, const RelayInputs& relays);
+
+  float indoorTempF() const { return _indoorTempF; }
+  float indoorHumidity() const { return _indoorHumidity; }
+  const BuildingParams& params() const { return _params; }
+
+private:
+  BuildingParams _params;
+  float _indoorTempF;
+  float _indoorHumidity;
+};
+
+#endif // BUILDING_MODEL_H
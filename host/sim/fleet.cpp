@@ -0,0 +1,139 @@
+#include "fleet.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include "controller.h"
+#include "hvac_logic.h"
+#include "main.h"
+#include "relays.h"
+#include "thermal_model.h"
+#include "utils.h"
+
+struct FleetEngine::Batch {
+  ControllerStorage<FLEET_BATCH_SIZE> ctrl;
+  int first = 0;
+  std::vector<BuildingModel> plant;
+  std::vector<WeatherModel> weather;
+};
+
+FleetEngine::FleetEngine(const std::vector<FleetUnitConfig>& units) : _units(units), _results(units.size()) {
+  for (size_t first = 0; first < _units.size(); first += FLEET_BATCH_SIZE) {
+    std::unique_ptr<Batch> batch(new Batch());
+    batch->first = (int)first;
+    batch->ctrl.batch.count = (int)std::min(_units.size() - first, (size_t)FLEET_BATCH_SIZE);
+    _batches.push_back(std::move(batch));
+  }
+}
+
+FleetEngine::~FleetEngine() {}
+
+void FleetEngine::resetBatch(Batch& batch) {
+  ControllerBatch& b = batch.ctrl.batch;
+  batch.plant.clear();
+  batch.weather.clear();
+  b.now = 0;
+  for (int i = 0; i < b.count; i++) {
+    const FleetUnitConfig& unit = _units[batch.first + i];
+    b.systemMode[i] = unit.systemMode;
+    b.tempUnit[i] = FAHRENHEIT;
+    b.vacationModeActive[i] = false;
+    b.programSchedule[i] = unit.schedule;
+    markScheduleEdited(b, i);
+    b.performance[i] = HvacPerformance();
+    b.thermalModel[i] = ThermalModel{}; // Else the last run's fit seeds the emptied bins
+    b.recovery[i] = RecoveryState{};
+    b.scheduleCursor[i] = ScheduleCursor{};
+    b.relays[i] = 0; b.state[i] = IDLE;
+    b.isFanCirculating[i] = false; b.freshAirForHeating[i] = false;
+    b.cycleInProgress[i] = false; b.performanceDirty[i] = 0;
+    b.heaterMaxRunTriggers[i] = 0; b.coolerMaxRunTriggers[i] = 0;
+    b.firstHeaterMaxRunTriggerTime[i] = 0; b.firstCoolerMaxRunTriggerTime[i] = 0;
+    b.systemLockedOut[i] = false;
+    b.lastHeaterOnTime[i] = b.lastCoolerOnTime[i] = b.now;
+    initialize_logic_timers(b, i, b.now);
+    batch.plant.push_back(BuildingModel(unit.building, 68.0, 40.0));
+    batch.weather.push_back(WeatherModel(unit.climate));
+    _results[batch.first + i] = FleetUnitResult();
+  }
+}
+
+void FleetEngine::stepBatch(Batch& batch, unsigned long endMillis, int startDayOfWeek) {
+  ControllerBatch& b = batch.ctrl.batch;
+  FleetUnitResult* results = &_results[batch.first];
+  const float dt = FLEET_TICK_MS / 1000.0f;
+  uint16_t previousRelays[FLEET_BATCH_SIZE] = {};
+
+  for (unsigned long nowMs = 0; nowMs < endMillis; nowMs += FLEET_TICK_MS) {
+    uint64_t simSeconds = nowMs / 1000;
+    TimeInfo time = calendarAt(simSeconds, startDayOfWeek);
+    b.now = nowMs;
+    b.season = seasonForMonth(time.month);
+
+    for (int i = 0; i < b.count; i++) {
+      float outdoorF = batch.weather[i].outdoorTempF(simSeconds);
+      const ScheduleEntry& entry = activeScheduleEntry(b, i, time);
+      float indoorF = batch.plant[i].indoorTempF();
+      CentiC indoor = centiCFromF(indoorF);
+      CentiC outdoor = centiCFromF(outdoorF);
+
+      updateThermalModel(b, i, indoor, outdoor);
+      controlTemperature(b, i, indoor, entry.target, outdoor);
+      controlHumidity(b, i, centiRH(batch.plant[i].indoorHumidity()), indoor, outdoor);
+      controlFan(b, i, entry.fanMode);
+      commitRelays(b, i);
+      if (b.performanceDirty[i]) { b.performanceDirty[i] = 0; results[i].performanceSaves++; }
+
+      uint16_t relays = b.relays[i];
+      uint16_t started = relays & ~previousRelays[i];
+      previousRelays[i] = relays;
+      RelayInputs inputs;
+      inputs.heater = relays & RELAY_BIT(HEATER_RELAY_PIN);
+      inputs.cooler = relays & RELAY_BIT(COOLER_RELAY_PIN);
+      inputs.fan = relays & RELAY_BIT(FAN_RELAY_PIN);
+      inputs.freshAir = relays & RELAY_BIT(FRESH_AIR_RELAY_PIN);
+      inputs.humidifier = relays & RELAY_BIT(HUMIDITY_RELAY_PIN);
+
+      FleetUnitResult& r = results[i];
+      if (inputs.heater) r.heaterHours += dt;
+      if (inputs.cooler) r.coolerHours += dt;
+      if (inputs.freshAir) r.freshAirHours += dt;
+      if (started & RELAY_BIT(HEATER_RELAY_PIN)) r.heaterCycles++;
+      if (started & RELAY_BIT(COOLER_RELAY_PIN)) r.coolerCycles++;
+      r.meanAbsErrorF += fabs(indoorF - centiCToUnit(entry.target, FAHRENHEIT)) * dt;
+
+      batch.plant[i].step(dt, outdoorF, inputs);
+    }
+  }
+
+  double totalSeconds = (double)endMillis / 1000.0;
+  for (int i = 0; i < b.count; i++) {
+    FleetUnitResult& r = results[i];
+    r.heaterHours /= 3600.0; r.coolerHours /= 3600.0; r.freshAirHours /= 3600.0;
+    if (totalSeconds > 0) r.meanAbsErrorF /= totalSeconds;
+    r.lockedOut = b.systemLockedOut[i];
+  }
+}
+
+FleetRunStats FleetEngine::run(int days, int threads, int startDayOfWeek) {
+  if (threads < 1) threads = 1;
+  for (auto& batch : _batches) resetBatch(*batch);
+
+  const unsigned long endMillis = (unsigned long)days * 24UL * 60UL * 60UL * 1000UL;
+  std::atomic<size_t> nextBatch(0);
+  auto worker = [&]() {
+    for (size_t n = nextBatch++; n < _batches.size(); n = nextBatch++) stepBatch(*_batches[n], endMillis, startDayOfWeek);
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> pool;
+  for (int t = 1; t < threads; t++) pool.emplace_back(worker);
+  worker();
+  for (auto& thread : pool) thread.join();
+
+  FleetRunStats stats;
+  stats.threads = threads;
+  stats.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  stats.instanceTicks = (uint64_t)_units.size() * ((endMillis + FLEET_TICK_MS - 1) / FLEET_TICK_MS);
+  return stats;
+}
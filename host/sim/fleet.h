@@ -0,0 +1,61 @@
+#ifndef FLEET_H
+#define FLEET_H
+
+// Fleet simulator: steps thousands of independent thermostats, each with its
+// own configuration, house and weather. Instances are grouped into
+// struct-of-arrays controller batches; worker threads pull whole batches off a
+// shared counter and step each one through the full run a tick at a time, so
+// threads never share mutable state and throughput scales with core count.
+
+#include <memory>
+#include <stdint.h>
+#include <vector>
+#include "building_model.h"
+#include "config.h"
+#include "weather.h"
+
+#define FLEET_BATCH_SIZE 64
+const unsigned long FLEET_TICK_MS = 5000; // Matches the delay() at the end of loop()
+
+struct FleetUnitConfig {
+  BuildingParams building;
+  ClimateParams climate;
+  SystemMode systemMode = DEFAULT_SYSTEM_MODE;
+  Schedule schedule;
+};
+
+struct FleetUnitResult {
+  double heaterHours = 0, coolerHours = 0, freshAirHours = 0;
+  long heaterCycles = 0, coolerCycles = 0;
+  long performanceSaves = 0;
+  double meanAbsErrorF = 0;
+  bool lockedOut = false;
+};
+
+struct FleetRunStats {
+  int threads;
+  double wallSeconds;
+  uint64_t instanceTicks;
+};
+
+class FleetEngine {
+public:
+  explicit FleetEngine(const std::vector<FleetUnitConfig>& units);
+  ~FleetEngine();
+
+  // Simulate every unit for the given number of days from midnight Jan 1. Safe
+  // to call repeatedly; each run starts from a fresh controller and house.
+  FleetRunStats run(int days, int threads, int startDayOfWeek = 1);
+  const std::vector<FleetUnitResult>& results() const { return _results; }
+
+private:
+  struct Batch;
+  void resetBatch(Batch& batch);
+  void stepBatch(Batch& batch, unsigned long endMillis, int startDayOfWeek);
+
+  std::vector<FleetUnitConfig> _units;
+  std::vector<std::unique_ptr<Batch>> _batches;
+  std::vector<FleetUnitResult> _results;
+};
+
+#endif // FLEET_H
@@ -0,0 +1,116 @@
+// Fleet simulator driver: builds a randomised fleet of houses, climates and
+// schedules, steps it across worker threads and reports throughput. With
+// --scaling it repeats the run at 1, 2, 4, ... threads to show how close to
+// linear the speed-up is on this machine, and checks that every run gives
+// the same per-unit results: each starts from a fresh controller and house,
+// whatever ran before or however many threads step it. The exit code is 1
+// if any differs.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include "fleet.h"
+#include "utils.h"
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "Usage: %s [--units N] [--days N] [--threads N] [--seed N] [--scaling]\n", argv0);
+}
+
+static std::vector<FleetUnitConfig> makeFleet(int units, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> scale(0.7f, 1.3f);
+  std::uniform_real_distribution<float> climateMean(38.0f, 68.0f);
+  std::uniform_real_distribution<float> setpointShift(-2.0f, 2.0f);
+  std::uniform_int_distribution<int> modePick(0, 9);
+
+  std::vector<FleetUnitConfig> fleet(units);
+  for (int u = 0; u < units; u++) {
+    FleetUnitConfig& unit = fleet[u];
+    unit.building.envelopeUA *= scale(rng);
+    unit.building.thermalMass *= scale(rng);
+    unit.building.heaterOutput *= scale(rng);
+    unit.building.coolerOutput *= scale(rng);
+    unit.climate.annualMeanF = climateMean(rng);
+    unit.climate.annualAmplitudeF *= scale(rng);
+    unit.climate.seed = rng();
+    int mode = modePick(rng);
+    unit.systemMode = mode == 0 ? SYS_HEAT : mode == 1 ? SYS_COOL : SYS_AUTO;
+    CentiC shift = centiCDeltaFromF(setpointShift(rng));
+    for (int e = 0; e < unit.schedule.weekdayEntryCount; e++) unit.schedule.weekday[e].target += shift;
+    for (int e = 0; e < unit.schedule.weekendEntryCount; e++) unit.schedule.weekend[e].target += shift;
+  }
+  return fleet;
+}
+
+static bool sameResult(const FleetUnitResult& a, const FleetUnitResult& b) {
+  return a.heaterHours == b.heaterHours && a.coolerHours == b.coolerHours && a.freshAirHours == b.freshAirHours &&
+         a.heaterCycles == b.heaterCycles && a.coolerCycles == b.coolerCycles && a.performanceSaves == b.performanceSaves &&
+         a.meanAbsErrorF == b.meanAbsErrorF && a.lockedOut == b.lockedOut;
+}
+
+// Units whose results differ from the first run's.
+static int countDiffering(const std::vector<FleetUnitResult>& first, const std::vector<FleetUnitResult>& results) {
+  int differing = 0;
+  for (size_t u = 0; u < results.size(); u++) differing += !sameResult(first[u], results[u]);
+  return differing;
+}
+
+static void printRun(const FleetRunStats& stats, double baselineRate) {
+  double rate = stats.instanceTicks / stats.wallSeconds;
+  double speedup = baselineRate > 0 ? rate / baselineRate : 1.0;
+  printf("  %7d %10.2f %14.0f %9.2fx %10.0f%%\n", stats.threads, stats.wallSeconds, rate, speedup, 100.0 * speedup / stats.threads);
+}
+
+int main(int argc, char** argv) {
+  int units = 1024;
+  int days = 7;
+  int threads = (int)std::thread::hardware_concurrency();
+  uint32_t seed = 1;
+  bool scaling = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--units") && i + 1 < argc) units = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--days") && i + 1 < argc) days = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--threads") && i + 1 < argc) threads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "--scaling")) scaling = true;
+    else { usage(argv[0]); return 2; }
+  }
+  if (units < 1 || days < 1) { usage(argv[0]); return 2; }
+  if (threads < 1) threads = 1;
+
+  FleetEngine engine(makeFleet(units, seed));
+  printf("Fleet: %d units x %d days (%d per batch)\n\n", units, days, FLEET_BATCH_SIZE);
+  printf("  %7s %10s %14s %10s %11s\n", "Threads", "Wall s", "Inst-ticks/s", "Speed-up", "Efficiency");
+
+  double baselineRate = 0;
+  std::vector<FleetUnitResult> first;
+  int differing = 0;
+  if (scaling) {
+    for (int t = 1; t < threads; t *= 2) {
+      FleetRunStats stats = engine.run(days, t);
+      if (t == 1) baselineRate = stats.instanceTicks / stats.wallSeconds;
+      printRun(stats, baselineRate);
+      if (first.empty()) first = engine.results();
+      else differing = std::max(differing, countDiffering(first, engine.results()));
+    }
+  }
+  FleetRunStats stats = engine.run(days, threads);
+  printRun(stats, baselineRate);
+  if (!first.empty()) differing = std::max(differing, countDiffering(first, engine.results()));
+
+  double heater = 0, cooler = 0, error = 0;
+  long cycles = 0, lockouts = 0;
+  for (const FleetUnitResult& r : engine.results()) {
+    heater += r.heaterHours; cooler += r.coolerHours; error += r.meanAbsErrorF;
+    cycles += r.heaterCycles + r.coolerCycles;
+    if (r.lockedOut) lockouts++;
+  }
+  printf("\n  Per unit: %.1f h heat, %.1f h cool, %.1f cycles, mean |error| %.2f F; %ld units locked out\n",
+         heater / units, cooler / units, (double)cycles / units, error / units, lockouts);
+  if (differing) printf("  %d units differ from the first run: a run inherited state from the one before\n", differing);
+  return differing ? 1 : 0;
+}
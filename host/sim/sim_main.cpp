@@ -0,0 +1,294 @@
+// Accelerated-time building simulator. Runs the unmodified firmware loop()
+// against the host HAL: the mocks supply time, sensors and relays, the
+// scheduler's virtual clock advances time, and a thermal model of the house
+// closes the loop. The plant is stepped from the scheduler's virtual-time hook,
+// so it evolves (and the scheduler's threshold polls see it evolve) while the
+// controller sleeps.
+
+#include <Arduino.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "building_model.h"
+#include "config.h"
+#include "controller.h"
+#include "hvac_logic.h"
+#include "hvac_tests.h"
+#include "learning.h"
+#include "main.h"
+#include "nvs.h"
+#include "persistence.h"
+#include "probes.h"
+#include "recovery.h"
+#include "schedule.h"
+#include "scheduler.h"
+#include "telemetry.h"
+#include "thermal_model.h"
+#include "timeseries.h"
+#include "trace.h"
+#include "utils.h"
+#include "weather.h"
+
+extern CentiC currentTargetTemperature;
+
+struct RelayStats {
+  const char* name;
+  int pin;
+  double onSeconds;
+  long cycles;
+  bool wasOn;
+};
+
+static RelayStats relays[] = {
+  { "heater",     HEATER_RELAY_PIN,    0, 0, false },
+  { "cooler",     COOLER_RELAY_PIN,    0, 0, false },
+  { "fan",        FAN_RELAY_PIN,       0, 0, false },
+  { "fresh air",  FRESH_AIR_RELAY_PIN, 0, 0, false },
+  { "humidifier", HUMIDITY_RELAY_PIN,  0, 0, false },
+};
+static const int RELAY_COUNT = sizeof(relays) / sizeof(relays[0]);
+
+struct SimState {
+  WeatherModel* weather;
+  BuildingModel* house;
+  int startDayOfWeek;
+  double absErrorSeconds, sqErrorSeconds, outsideBandSeconds, totalSeconds, lockoutSeconds;
+};
+static SimState sim;
+
+// Arrival at each schedule transition that needs the plant to heat or cool to
+// a new target: the first instant the indoor temperature reaches it, relative
+// to the transition time (negative = early). Tracking starts when the
+// transition comes within the recovery horizon.
+static const unsigned long RECOVERY_TRACK_HORIZON_SECS = MAX_RECOVERY_TIME_MINS * 60UL;
+static const unsigned long RECOVERY_MISS_MS = 4 * 3600UL * 1000UL;
+
+struct RecoveryTrack {
+  bool pending, arrived, heating;
+  unsigned long changeAtMs, arrivedAtMs;
+  float targetF;
+  long transitions, withinTenMinutes, missed;
+  double sumArrivalMinutes;
+
+  // Thermal model time-to-target, predicted when the plant runs for an early start
+  bool predicted;
+  unsigned long plantStartMs;
+  uint32_t predictedSecs;
+  long predictions;
+  double sumPredictionErrorPct;
+};
+static RecoveryTrack track;
+
+static bool reachedTarget(float indoorF) {
+  return track.heating ? indoorF >= track.targetF - 0.1f : indoorF <= track.targetF + 0.1f;
+}
+
+static void trackRecovery(unsigned long nowMs, float indoorF, float outdoorF) {
+  if (!track.pending) {
+    if (deviceController.scheduleEdited[0]) return; // Not compiled before the first pass
+    TimeInfo t = calendarAt(nowMs / 1000, sim.startDayOfWeek);
+    ScheduleChange change;
+    if (!findNextTargetChange(deviceController.compiledSchedule[0], t, RECOVERY_TRACK_HORIZON_SECS, &change)) return;
+    float targetF = centiCToUnit(change.entry->target, FAHRENHEIT);
+    bool heating = change.entry->target > currentTargetTemperature;
+    bool modeAllows = systemMode == SYS_AUTO || systemMode == (heating ? SYS_HEAT : SYS_COOL);
+    bool needsPlant = heating ? (indoorF < targetF - 0.5f && outdoorF < targetF) : (indoorF > targetF + 0.5f && outdoorF > targetF);
+    if (!modeAllows || !needsPlant) return;
+    track.pending = true; track.arrived = false; track.heating = heating; track.targetF = targetF; track.predicted = false;
+    track.changeAtMs = nowMs + change.secondsUntil * 1000;
+    return;
+  }
+  bool plantOn = g_mockRelayStates[track.heating ? HEATER_RELAY_PIN : COOLER_RELAY_PIN];
+  if (!track.arrived && !track.predicted && plantOn && deviceController.recovery[0].active) {
+    ThermalPrediction p = predictTimeToTarget(centiCFromF(indoorF), centiCFromF(track.targetF), centiCFromF(outdoorF));
+    if (p.reachable && p.confidence >= THERMAL_MODEL_SEED_CONFIDENCE) { track.predicted = true; track.plantStartMs = nowMs; track.predictedSecs = p.seconds; }
+  }
+  if (!track.arrived && reachedTarget(indoorF)) {
+    track.arrived = true; track.arrivedAtMs = nowMs;
+    double actualSecs = (nowMs - track.plantStartMs) / 1000.0;
+    if (track.predicted && actualSecs > 0) { track.predictions++; track.sumPredictionErrorPct += 100.0 * fabs(track.predictedSecs - actualSecs) / actualSecs; }
+  }
+  if ((long)(nowMs - track.changeAtMs) < 0) return;
+  if (track.arrived) {
+    double minutes = ((double)track.arrivedAtMs - (double)track.changeAtMs) / 60000.0;
+    track.transitions++;
+    track.sumArrivalMinutes += minutes;
+    if (fabs(minutes) <= 10.0) track.withinTenMinutes++;
+    track.pending = false;
+  } else if (nowMs - track.changeAtMs > RECOVERY_MISS_MS) {
+    track.transitions++;
+    track.missed++;
+    track.pending = false;
+  }
+}
+
+static void publishSensors(unsigned long nowMs) {
+  uint64_t simSeconds = nowMs / 1000;
+  g_mockTime = calendarAt(simSeconds, sim.startDayOfWeek);
+  g_mockIndoorTempF = sim.house->indoorTempF();
+  g_mockOutdoorTempF = sim.weather->outdoorTempF(simSeconds);
+  g_mockHumidity = sim.house->indoorHumidity();
+}
+
+// Scheduler hook: integrate the house over [fromMs, toMs) with the relays as
+// the controller left them, account for the interval, then publish new readings.
+static void advancePlant(unsigned long fromMs, unsigned long toMs) {
+  float dt = (float)(toMs - fromMs) / 1000.0f;
+  RelayInputs inputs;
+  inputs.heater = g_mockRelayStates[HEATER_RELAY_PIN];
+  inputs.cooler = g_mockRelayStates[COOLER_RELAY_PIN];
+  inputs.fan = g_mockRelayStates[FAN_RELAY_PIN];
+  inputs.freshAir = g_mockRelayStates[FRESH_AIR_RELAY_PIN];
+  inputs.humidifier = g_mockRelayStates[HUMIDITY_RELAY_PIN];
+
+  for (int r = 0; r < RELAY_COUNT; r++) {
+    bool on = g_mockRelayStates[relays[r].pin];
+    if (on) relays[r].onSeconds += dt;
+    if (on && !relays[r].wasOn) relays[r].cycles++;
+    relays[r].wasOn = on;
+  }
+
+  float error = sim.house->indoorTempF() - centiCToUnit(currentTargetTemperature, FAHRENHEIT);
+  sim.absErrorSeconds += fabs(error) * dt;
+  sim.sqErrorSeconds += error * error * dt;
+  if (fabs(error) > 2.0 * TEMPERATURE_DEADBAND_F) sim.outsideBandSeconds += dt;
+  sim.totalSeconds += dt;
+  if (systemLockedOut) sim.lockoutSeconds += dt;
+
+  sim.house->step(dt, sim.weather->outdoorTempF(fromMs / 1000), inputs);
+  publishSensors(toMs);
+  trackRecovery(toMs, g_mockIndoorTempF, g_mockOutdoorTempF);
+}
+
+static FILE* telemetryFile = nullptr;
+static void writeTelemetry(const uint8_t* data, size_t len) { fwrite(data, 1, len, telemetryFile); }
+static FILE* traceFile = nullptr;
+static void writeTrace(const uint8_t* data, size_t len) { fwrite(data, 1, len, traceFile); }
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "Usage: %s [--days N] [--seed N] [--start-dow 0-6] [--no-recovery] [--telemetry FILE] [--trace FILE] [--probes] [--verbose]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+  int days = 365;
+  bool verbose = false, probes = false;
+  const char* telemetryPath = nullptr;
+  const char* tracePath = nullptr;
+  ClimateParams climate;
+  sim.startDayOfWeek = 1;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--days") && i + 1 < argc) days = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--seed") && i + 1 < argc) climate.seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "--start-dow") && i + 1 < argc) sim.startDayOfWeek = atoi(argv[++i]) % 7;
+    else if (!strcmp(argv[i], "--no-recovery")) smartRecoveryEnabled = false;
+    else if (!strcmp(argv[i], "--telemetry") && i + 1 < argc) telemetryPath = argv[++i];
+    else if (!strcmp(argv[i], "--trace") && i + 1 < argc) tracePath = argv[++i];
+    else if (!strcmp(argv[i], "--probes")) probes = true;
+    else if (!strcmp(argv[i], "--verbose")) verbose = true;
+    else { usage(argv[0]); return 2; }
+  }
+
+  WeatherModel weather(climate);
+  BuildingModel house(BuildingParams(), 68.0, 40.0);
+  sim.weather = &weather;
+  sim.house = &house;
+
+  g_isTesting = true;
+  g_mockMillis = 0;
+  Serial.setMuted(!verbose);
+  setTelemetryTextMode(verbose); // The status lines; --telemetry captures binary frames instead
+  if (telemetryPath) {
+    telemetryFile = fopen(telemetryPath, "wb");
+    if (!telemetryFile) { perror(telemetryPath); return 2; }
+    setTelemetryTextMode(false);
+    setTelemetrySink(writeTelemetry);
+  }
+  host_nvs_reset();
+  loadSettings();
+  initialize_learning();
+  initialize_trace();
+  if (tracePath) {
+    traceFile = fopen(tracePath, "wb");
+    if (!traceFile) { perror(tracePath); return 2; }
+    setTraceSink(writeTrace); // The whole run, rather than the on-flash ring
+  }
+  initialize_logic_timers();
+  setVirtualTimeHook(advancePlant);
+  publishSensors(g_mockMillis);
+
+  const unsigned long endMillis = (unsigned long)days * 24UL * 60UL * 60UL * 1000UL;
+  unsigned long passes = 0;
+  auto wallStart = std::chrono::steady_clock::now();
+
+  while (g_mockMillis < endMillis && !systemInFaultState) {
+    loop();
+    passes++;
+  }
+
+  flushSettings();
+  if (telemetryFile) fclose(telemetryFile);
+  if (traceFile) { flushTrace(); fclose(traceFile); }
+  double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+  double totalSeconds = sim.totalSeconds;
+  Serial.setMuted(false);
+
+  printf("Simulated %.1f days in %lu control passes (%.2f s wall, %.0fx real time)\n",
+         totalSeconds / 86400.0, passes, wallSeconds, totalSeconds / wallSeconds);
+  if (systemInFaultState) printf("  Stopped early: controller entered the sensor FAULT state\n");
+  printf("\n  %-11s %10s %8s %10s\n", "Relay", "Runtime h", "Cycles", "Duty %");
+  for (int r = 0; r < RELAY_COUNT; r++) {
+    printf("  %-11s %10.1f %8ld %10.1f\n", relays[r].name, relays[r].onSeconds / 3600.0, relays[r].cycles,
+           totalSeconds > 0 ? 100.0 * relays[r].onSeconds / totalSeconds : 0.0);
+  }
+  if (totalSeconds > 0) {
+    printf("\n  Comfort: mean |error| %.2f F, RMS %.2f F, %.1f%% of time outside +/-%.1f F\n",
+           sim.absErrorSeconds / totalSeconds, sqrt(sim.sqErrorSeconds / totalSeconds),
+           100.0 * sim.outsideBandSeconds / totalSeconds, 2.0 * TEMPERATURE_DEADBAND_F);
+  }
+  long arrived = track.transitions - track.missed;
+  printf("  Recovery (%s): %ld transitions, arrival %+.1f min mean (early < 0), %.0f%% within +/-10 min, %ld missed\n",
+         smartRecoveryEnabled ? "smart" : "off", track.transitions, arrived ? track.sumArrivalMinutes / arrived : 0.0,
+         track.transitions ? 100.0 * track.withinTenMinutes / track.transitions : 0.0, track.missed);
+  const ThermalModel& model = deviceController.thermalModel[0];
+  const BuildingParams& plant = house.params();
+  printf("  Thermal model: loss %.3f/h (plant %.3f), heat %.2f C/h (%.2f), cool %.2f C/h (%.2f), internal %.2f C/h (%.2f), %lu updates\n",
+         model.theta[THERMAL_LOSS], plant.envelopeUA / plant.thermalMass, model.theta[THERMAL_HEAT_GAIN], plant.heaterOutput / plant.thermalMass * 5 / 9,
+         model.theta[THERMAL_COOL_GAIN], plant.coolerOutput / plant.thermalMass * 5 / 9, model.theta[THERMAL_INTERNAL_GAIN],
+         plant.internalGains / plant.thermalMass * 5 / 9, (unsigned long)model.updates);
+  printf("    time to target: %ld confident predictions, mean error %.0f%%\n", track.predictions,
+         track.predictions ? track.sumPredictionErrorPct / track.predictions : 0.0);
+  printf("  Lockout: %s (%.1f h locked out)\n", systemLockedOut ? "ACTIVE" : "clear", sim.lockoutSeconds / 3600.0);
+
+  double perDay = totalSeconds > 0 ? 86400.0 / totalSeconds : 0;
+  printf("\n  Scheduler: %.0f control passes/day (fixed 5 s tick: 17280), %.0f sensor polls/day\n",
+         passes * perDay, schedulerStats.sensorPolls * perDay);
+  for (int r = 0; r < NUM_WAKE_REASONS; r++) {
+    if (schedulerStats.wakes[r]) printf("    %-14s %8.1f wakes/day\n", wakeReasonName((WakeReason)r), schedulerStats.wakes[r] * perDay);
+  }
+
+  printf("\n  Telemetry: %lu frames, %.1f bytes/frame, %lu dropped\n", telemetryStats.published,
+         telemetryStats.shipped ? (double)telemetryStats.bytesOut / telemetryStats.shipped : 0.0, telemetryStats.dropped);
+
+  // The stored history over the run's last 30 days, read back as the console would.
+  SeriesTotals recent;
+  uint32_t seriesTo = seriesNowMinute() + 1, seriesFrom = seriesTo - std::min(seriesTo, 30U * 1440);
+  querySeries(seriesFrom, seriesTo, recent);
+  printf("\n  Time series: %.1f KB/day to flash, %lu segments recycled; last %.1f days: %.1f h heating, %lu kWh used, %lu kWh saved by the economizer\n",
+         seriesStats.bytesWritten / 1024.0 * perDay, seriesStats.segmentsRecycled, recent.milliseconds / 8.64e7,
+         recent.onMilliseconds[SERIES_HEATER] / 3.6e6, (unsigned long)seriesEnergyWh(recent) / 1000, (unsigned long)economizerSavingsWh(recent) / 1000);
+
+  // Before write-back every learned cycle rewrote the whole settings set.
+  const PersistenceStats& ps = persistenceStats;
+  unsigned long fullBlob = sizeof(Schedule) + sizeof(HvacPerformance) + 3;
+  printf("\n  NVS: %.0f bytes/day in %.1f commits/day (%lu changes coalesced); full-blob saves: ~%.0f bytes/day\n",
+         ps.bytesWritten * perDay, ps.flushes * perDay, ps.coalesced, (ps.marks - ps.coalesced) * fullBlob * perDay);
+  printf("       commit latency mean %.0f us, max %lu us\n", ps.flushes ? (double)ps.totalCommitUs / ps.flushes : 0.0, ps.maxCommitUs);
+  if (probes) {
+    printf("\n  Control pass latency (host, in %lu MHz device cycles):\n", CPU_FREQ_MHZ);
+    char line[128];
+    for (int stage = 0; stage < NUM_PROBES; stage++) { formatProbeLine((ProbeStage)stage, line, sizeof(line)); printf("    %s\n", line); }
+  }
+  return 0;
+}
@@ -0,0 +1,44 @@
+#include "weather.h"
+#include <cmath>
+
+static const float TWO_PI_F = 6.28318530718f;
+static const int DAYS_IN_MONTH[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+WeatherModel::WeatherModel(const ClimateParams& params) : _params(params) {}
+
+// Hash the day index into [-1, 1) so a given seed always yields the same fronts.
+float WeatherModel::frontOffset(long day) const {
+  uint32_t x = (uint32_t)day * 2654435761u ^ _params.seed * 2246822519u;
+  x ^= x >> 15; x *= 2246822519u; x ^= x >> 13; x *= 3266489917u; x ^= x >> 16;
+  return (float)(x & 0xFFFF) / 32768.0f - 1.0f;
+}
+
+float WeatherModel::outdoorTempF(uint64_t simSeconds) const {
+  double days = simSeconds / 86400.0;
+  long day = (long)days;
+  float dayFraction = (float)(days - day);
+
+  float annual = -cosf(TWO_PI_F * (float)((days - 20.0) / 365.0));
+  float diurnal = -cosf(TWO_PI_F * (dayFraction - 0.125f)); // Peak at 15:00
+  // Blend today's and tomorrow's fronts so the temperature never jumps at midnight.
+  float front = frontOffset(day) * (1.0f - dayFraction) + frontOffset(day + 1) * dayFraction;
+
+  return _params.annualMeanF + _params.annualAmplitudeF * annual
+       + _params.diurnalAmplitudeF * diurnal + _params.frontAmplitudeF * front;
+}
+
+TimeInfo calendarAt(uint64_t simSeconds, int startDayOfWeek) {
+  uint64_t totalDays = simSeconds / 86400;
+  uint32_t secondOfDay = (uint32_t)(simSeconds % 86400);
+  int dayOfYear = (int)(totalDays % 365);
+
+  TimeInfo t;
+  t.month = 1;
+  while (dayOfYear >= DAYS_IN_MONTH[t.month - 1]) { dayOfYear -= DAYS_IN_MONTH[t.month - 1]; t.month++; }
+  t.day = dayOfYear + 1;
+  t.dayOfWeek = (int)((startDayOfWeek + totalDays) % 7);
+  t.hour = (int)(secondOfDay / 3600);
+  t.minute = (int)((secondOfDay % 3600) / 60);
+  t.second = (int)(secondOfDay % 60);
+  return t;
+}
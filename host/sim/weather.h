@@ -0,0 +1,32 @@
+#ifndef WEATHER_H
+#define WEATHER_H
+
+#include <cstdint>
+#include "config.h" // For TimeInfo
+
+// Synthetic outdoor weather: an annual sinusoid (coldest in late January), a
+// diurnal swing peaking mid-afternoon, and a deterministic day-to-day weather
+// front term so runs are reproducible for a given seed.
+struct ClimateParams {
+  float annualMeanF      = 52.0;
+  float annualAmplitudeF = 22.0;
+  float diurnalAmplitudeF = 9.0;
+  float frontAmplitudeF  = 6.0;
+  uint32_t seed          = 1;
+};
+
+class WeatherModel {
+public:
+  explicit WeatherModel(const ClimateParams& params = ClimateParams());
+  float outdoorTempF(uint64_t simSeconds) const;
+
+private:
+  float frontOffset(long day) const;
+  ClimateParams _params;
+};
+
+// Calendar for a non-leap simulated year that starts at midnight on Jan 1.
+// startDayOfWeek is the weekday of Jan 1 (0=Sun).
+TimeInfo calendarAt(uint64_t simSeconds, int startDayOfWeek);
+
+#endif // WEATHER_H
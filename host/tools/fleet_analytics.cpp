@@ -0,0 +1,624 @@
+// Fleet analytics over the learning logs and performance tables pulled from
+// many units. Each unit is a directory holding any of:
+//   learning_log.bin, learning_log.1.bin  adjustment records (learning.h)
+//   learning_log.csv                       dayOfWeek,hour,tempF rows from firmware before the binary log
+//   perf.bin                               the eight PerfRecord rows in key order (perfH0..perfC3),
+//                                          or the legacy 512-byte "perf" blob (persistence.h)
+// Log files are memory-mapped and cut into fixed-size chunks that worker
+// threads take from a shared counter. A chunk folds into a (day, hour)
+// histogram on the worker's stack, which is then added to its unit's totals;
+// the chunk's pages are released once read. Binary records are fixed 8-byte
+// strides folded without branches (a bad record lands in a discard slot);
+// CSV lines are found with memchr and parsed in place. Nothing is allocated
+// per row, so memory holds the per-unit results and little else.
+//
+// Writes histogram.csv, performance.csv and suggestions.csv to --out (default
+// the current directory) and prints a summary. Suggested schedule edits come
+// from (day, hour) slots that drew at least --min-adjustments adjustments and
+// --lift times the unit's mean per slot; an edit shared by every weekday (or
+// both weekend days) is proposed for that list, the rest as day overrides.
+// Performance rates are flagged as outliers against the fleet's median and
+// MAD for the same mode, season and bin.
+//
+// --generate DIR writes a synthetic fleet in the same layout, for the smoke
+// test and for timing.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "config.h"
+#include "learning.h"
+#include "persistence.h"
+
+static const int SLOTS = 7 * 24;
+static const size_t CHUNK_BYTES = 4 << 20;          // Multiple of the page and record size
+static const float OUTLIER_Z = 3.5f;                // Robust z-score beyond which a rate is flagged
+static const float MIN_MAD_CENTIC = 10.0f;          // Floor on the MAD, so a tight fleet does not flag noise
+static const char* const SEASON_NAMES[NUM_SEASONS] = { "winter", "spring", "summer", "fall" };
+static const char* const DAY_NAMES[7] = { "sun", "mon", "tue", "wed", "thu", "fri", "sat" };
+static_assert(CHUNK_BYTES % sizeof(LearningRecord) == 0 && sizeof(LearningLogHeader) == sizeof(LearningRecord),
+              "Binary chunks must start on a record");
+
+struct Unit {
+  std::string name, dir;
+  std::atomic<uint64_t> count[SLOTS];
+  std::atomic<int64_t> sumDeciF[SLOTS];
+  std::atomic<uint64_t> bad;
+  bool havePerf = false, legacyPerf = false;
+  HvacPerformance perf;
+  Unit() : bad(0) { for (int s = 0; s < SLOTS; s++) { count[s] = 0; sumDeciF[s] = 0; } }
+};
+
+struct LogFile {
+  Unit* unit;
+  const uint8_t* base;
+  size_t size;
+  bool csv;
+};
+
+struct Chunk { int file; size_t begin, end; };
+
+// One chunk's histogram; slot SLOTS takes the records that fail validation.
+struct Fold {
+  uint64_t count[SLOTS + 1];
+  int64_t sumDeciF[SLOTS + 1];
+  uint64_t bytes;
+};
+
+static void foldRecords(const uint8_t* p, size_t records, Fold& f) {
+  for (size_t r = 0; r < records; r++, p += sizeof(LearningRecord)) {
+    LearningRecord rec;
+    memcpy(&rec, p, sizeof(rec));
+    bool valid = (rec.dayOfWeek < 7) & (rec.hour < 24) & (rec.minuteOfYear < MINUTES_PER_YEAR);
+    unsigned slot = valid ? rec.dayOfWeek * 24u + rec.hour : SLOTS;
+    f.count[slot]++;
+    f.sumDeciF[slot] += rec.targetDeciF;
+  }
+}
+
+// Unsigned decimal up to the next non-digit; false if there were no digits.
+static bool parseUint(const char*& p, const char* end, unsigned& out) {
+  const char* start = p;
+  unsigned v = 0;
+  while (p < end && (unsigned)(*p - '0') < 10) v = v * 10 + (*p++ - '0');
+  out = v;
+  return p != start && p - start < 10;
+}
+
+// "d,h,tt.t" with the firmware's one decimal place; further decimals are dropped.
+static bool parseCsvLine(const char* p, const char* end, unsigned& slot, int& deciF) {
+  unsigned day, hour, whole, tenths = 0;
+  if (!parseUint(p, end, day) || p == end || *p++ != ',') return false;
+  if (!parseUint(p, end, hour) || p == end || *p++ != ',') return false;
+  bool negative = p < end && *p == '-';
+  if (negative) p++;
+  if (!parseUint(p, end, whole)) return false;
+  if (p < end && *p == '.') {
+    p++;
+    if (p < end && (unsigned)(*p - '0') < 10) tenths = *p++ - '0';
+    while (p < end && (unsigned)(*p - '0') < 10) p++;
+  }
+  if (p < end && *p == '\r') p++;
+  if (p != end || day > 6 || hour > 23 || whole > 3000) return false;
+  slot = day * 24 + hour;
+  deciF = (int)(whole * 10 + tenths) * (negative ? -1 : 1);
+  return true;
+}
+
+// Lines starting in [begin, end); the line that straddles end belongs to this chunk.
+static void foldCsv(const LogFile& file, size_t begin, size_t end, Fold& f) {
+  const char* base = (const char*)file.base;
+  const char* fileEnd = base + file.size;
+  const char* p = base + begin;
+  if (begin > 0) {
+    const char* nl = (const char*)memchr(p - 1, '\n', fileEnd - (p - 1));
+    if (!nl) return;
+    p = nl + 1;
+  }
+  while (p < base + end) {
+    const char* nl = (const char*)memchr(p, '\n', fileEnd - p);
+    const char* eol = nl ? nl : fileEnd;
+    unsigned slot; int deciF;
+    if (eol != p) {
+      if (!parseCsvLine(p, eol, slot, deciF)) { slot = SLOTS; deciF = 0; }
+      f.count[slot]++;
+      f.sumDeciF[slot] += deciF;
+    }
+    p = eol + 1;
+  }
+}
+
+static void foldChunk(const LogFile& file, const Chunk& c, Fold& f) {
+  memset(&f, 0, sizeof(f));
+  if (file.csv) {
+    foldCsv(file, c.begin, c.end, f);
+  } else {
+    size_t begin = std::max(c.begin, sizeof(LearningLogHeader));
+    if (c.end > begin) foldRecords(file.base + begin, (c.end - begin) / sizeof(LearningRecord), f);
+  }
+  f.bytes = c.end - c.begin;
+}
+
+static void worker(const std::vector<LogFile>* files, const std::vector<Chunk>* chunks, std::atomic<size_t>* next,
+                   std::atomic<uint64_t>* bytes) {
+  Fold f;
+  for (size_t n; (n = next->fetch_add(1)) < chunks->size();) {
+    const Chunk& c = (*chunks)[n];
+    const LogFile& file = (*files)[c.file];
+    foldChunk(file, c, f);
+    Unit& u = *file.unit;
+    for (int s = 0; s < SLOTS; s++) {
+      if (!f.count[s]) continue;
+      u.count[s].fetch_add(f.count[s], std::memory_order_relaxed);
+      u.sumDeciF[s].fetch_add(f.sumDeciF[s], std::memory_order_relaxed);
+    }
+    u.bad.fetch_add(f.count[SLOTS], std::memory_order_relaxed);
+    bytes->fetch_add(f.bytes, std::memory_order_relaxed);
+    // Page-aligned: chunk boundaries are multiples of CHUNK_BYTES.
+    madvise((void*)(file.base + c.begin), c.end - c.begin, MADV_DONTNEED);
+  }
+}
+
+// Maps a whole file read-only; false if it is missing or empty.
+static bool mapFile(const std::string& path, const uint8_t*& base, size_t& size) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  bool ok = fstat(fd, &st) == 0 && st.st_size > 0;
+  if (ok) {
+    void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ok = m != MAP_FAILED;
+    if (ok) { base = (const uint8_t*)m; size = st.st_size; madvise(m, size, MADV_SEQUENTIAL); }
+  }
+  close(fd);
+  return ok;
+}
+
+static bool readFile(const std::string& path, void* out, size_t capacity, size_t& size) {
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f) return false;
+  size = fread(out, 1, capacity, f);
+  bool whole = fgetc(f) == EOF;
+  fclose(f);
+  return whole;
+}
+
+static uint16_t saturate16(float v) { return (uint16_t)std::max(0.0f, std::min(v + 0.5f, 65535.0f)); }
+
+// perf.bin in either layout, into the in-RAM table.
+static bool loadPerformance(Unit& u) {
+  union { PerfRecord rows[2 * NUM_SEASONS]; LegacyPerformance legacy; } blob;
+  size_t size;
+  if (!readFile(u.dir + "/perf.bin", &blob, sizeof(blob), size)) return false;
+  HvacPerformance& p = u.perf;
+  if (size == sizeof(blob.rows)) {
+    for (int season = 0; season < NUM_SEASONS; season++) {
+      const PerfRecord& heat = blob.rows[season];
+      const PerfRecord& cool = blob.rows[NUM_SEASONS + season];
+      memcpy(p.heatRate[season], heat.rate, sizeof(heat.rate)); memcpy(p.heatSamples[season], heat.samples, sizeof(heat.samples));
+      memcpy(p.coolRate[season], cool.rate, sizeof(cool.rate)); memcpy(p.coolSamples[season], cool.samples, sizeof(cool.samples));
+    }
+  } else if (size == sizeof(blob.legacy)) {
+    // F per hour to CentiC per hour, as loadSettings() migrates it.
+    for (int season = 0; season < NUM_SEASONS; season++) {
+      for (int bin = 0; bin < NUM_PERFORMANCE_BINS; bin++) {
+        p.heatRate[season][bin] = saturate16(blob.legacy.heatRate[season][bin] * 500.0f / 9.0f);
+        p.heatSamples[season][bin] = saturate16((float)blob.legacy.heatSamples[season][bin]);
+        p.coolRate[season][bin] = saturate16(blob.legacy.coolRate[season][bin] * 500.0f / 9.0f);
+        p.coolSamples[season][bin] = saturate16((float)blob.legacy.coolSamples[season][bin]);
+      }
+    }
+    u.legacyPerf = true;
+  } else {
+    fprintf(stderr, "%s/perf.bin: %zu bytes is neither layout\n", u.dir.c_str(), size);
+    return false;
+  }
+  u.havePerf = true;
+  return true;
+}
+
+static float median(std::vector<float>& v) {
+  size_t mid = v.size() / 2;
+  std::nth_element(v.begin(), v.begin() + mid, v.end());
+  return v[mid];
+}
+
+static float rateF(uint16_t centiCPerHour) { return centiCPerHour * 9.0f / 500.0f; }
+
+struct PerfCell { float median = 0, mad = 0; int units = 0; };
+
+// Fleet median and MAD per (mode, season, bin), over the units with samples there.
+static void perfStatistics(const std::vector<Unit*>& units, PerfCell cells[2][NUM_SEASONS][NUM_PERFORMANCE_BINS]) {
+  std::vector<float> values, deviations;
+  for (int heat = 0; heat < 2; heat++) {
+    for (int season = 0; season < NUM_SEASONS; season++) {
+      for (int bin = 0; bin < NUM_PERFORMANCE_BINS; bin++) {
+        values.clear();
+        for (const Unit* u : units) {
+          if (!u->havePerf) continue;
+          const HvacPerformance& p = u->perf;
+          if ((heat ? p.heatSamples : p.coolSamples)[season][bin]) values.push_back((heat ? p.heatRate : p.coolRate)[season][bin]);
+        }
+        PerfCell& cell = cells[heat][season][bin];
+        cell.units = (int)values.size();
+        if (values.empty()) continue;
+        cell.median = median(values);
+        deviations.clear();
+        for (float v : values) deviations.push_back(fabsf(v - cell.median));
+        cell.mad = median(deviations);
+      }
+    }
+  }
+}
+
+static bool isOutlier(const PerfCell& cell, uint16_t rate) {
+  if (cell.units < 5) return false;
+  float sigma = 1.4826f * std::max(cell.mad, MIN_MAD_CENTIC);
+  return fabsf(rate - cell.median) > OUTLIER_Z * sigma;
+}
+
+struct Edit { int hour; int deciF; uint64_t adjustments; };
+
+// Habitual slots for one day, merged while consecutive hours want the same target.
+static std::vector<Edit> dayEdits(const Unit& u, int day, uint64_t minAdjustments, double floorCount) {
+  std::vector<Edit> edits;
+  int lastHour = -2;
+  for (int hour = 0; hour < 24; hour++) {
+    int s = day * 24 + hour;
+    uint64_t n = u.count[s].load();
+    if (n < minAdjustments || n < floorCount) continue;
+    int deciF = (int)lround((double)u.sumDeciF[s].load() / n / 5.0) * 5; // Nearest 0.5 F
+    if (!edits.empty() && lastHour == hour - 1 && edits.back().deciF == deciF) edits.back().adjustments += n;
+    else edits.push_back({ hour, deciF, n });
+    lastHour = hour;
+  }
+  return edits;
+}
+
+// Same hour, and targets within one 0.5 F step of each other.
+static bool sameEdit(const Edit& a, const Edit& b) { return a.hour == b.hour && abs(a.deciF - b.deciF) <= 5; }
+
+// Edits every day in days[] shares move to the list; the rest stay per day.
+// Returns how many edits were written.
+static int emitSuggestions(FILE* out, const Unit& u, uint64_t minAdjustments, double lift) {
+  uint64_t total = 0;
+  for (int s = 0; s < SLOTS; s++) total += u.count[s].load();
+  if (!total) return 0;
+  double floorCount = lift * total / SLOTS;
+  std::vector<Edit> perDay[7];
+  for (int d = 0; d < 7; d++) perDay[d] = dayEdits(u, d, minAdjustments, floorCount);
+
+  int written = 0;
+  static const int WEEKDAYS[] = { 1, 2, 3, 4, 5 }, WEEKEND[] = { 0, 6 };
+  struct { const char* list; const int* days; int count; int cap; } groups[] = {
+    { "weekday", WEEKDAYS, 5, MAX_DAY_ENTRIES }, { "weekend", WEEKEND, 2, MAX_DAY_ENTRIES }
+  };
+  for (auto& g : groups) {
+    std::vector<Edit> shared;
+    for (const Edit& e : perDay[g.days[0]]) {
+      bool everyDay = true;
+      uint64_t adjustments = 0;
+      double weighted = 0;
+      for (int k = 0; k < g.count && everyDay; k++) {
+        auto& list = perDay[g.days[k]];
+        auto it = std::find_if(list.begin(), list.end(), [&](const Edit& o) { return sameEdit(e, o); });
+        everyDay = it != list.end();
+        if (everyDay) { adjustments += it->adjustments; weighted += (double)it->deciF * it->adjustments; }
+      }
+      if (everyDay) shared.push_back({ e.hour, (int)lround(weighted / adjustments / 5.0) * 5, adjustments });
+    }
+    for (const Edit& e : shared) {
+      for (int k = 0; k < g.count; k++) {
+        auto& list = perDay[g.days[k]];
+        list.erase(std::remove_if(list.begin(), list.end(), [&](const Edit& o) { return o.hour == e.hour; }), list.end());
+      }
+    }
+    if ((int)shared.size() > g.cap) shared.resize(g.cap);
+    for (const Edit& e : shared) {
+      fprintf(out, "%s,%s,,%02d:00,%.1f,%llu\n", u.name.c_str(), g.list, e.hour, e.deciF / 10.0, (unsigned long long)e.adjustments);
+      written++;
+    }
+  }
+  for (int d = 0; d < 7; d++) {
+    auto& list = perDay[d];
+    // The most-adjusted edits, if there are more than an override holds, in hour order.
+    if ((int)list.size() > MAX_DAY_OVERRIDE_ENTRIES) {
+      std::sort(list.begin(), list.end(), [](const Edit& a, const Edit& b) { return a.adjustments > b.adjustments; });
+      list.resize(MAX_DAY_OVERRIDE_ENTRIES);
+      std::sort(list.begin(), list.end(), [](const Edit& a, const Edit& b) { return a.hour < b.hour; });
+    }
+    for (const Edit& e : list) {
+      fprintf(out, "%s,override,%s,%02d:00,%.1f,%llu\n", u.name.c_str(), DAY_NAMES[d], e.hour, e.deciF / 10.0, (unsigned long long)e.adjustments);
+      written++;
+    }
+  }
+  return written;
+}
+
+static FILE* openOutput(const std::string& dir, const char* name) {
+  std::string path = dir + "/" + name;
+  FILE* f = fopen(path.c_str(), "w");
+  if (!f) perror(path.c_str());
+  return f;
+}
+
+static void addFleetDir(const char* dir, std::vector<std::string>& unitDirs) {
+  DIR* d = opendir(dir);
+  if (!d) { perror(dir); return; }
+  std::vector<std::string> found;
+  while (dirent* e = readdir(d)) {
+    if (e->d_name[0] == '.') continue;
+    std::string path = std::string(dir) + "/" + e->d_name;
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) found.push_back(path);
+  }
+  closedir(d);
+  std::sort(found.begin(), found.end());
+  unitDirs.insert(unitDirs.end(), found.begin(), found.end());
+}
+
+// ---------------------------------------------------------------------------
+// Synthetic fleet. Each unit has a habit (a weekday morning and evening
+// target, a weekend morning one) buried in random adjustments. One unit in
+// ten writes the legacy CSV log and one in seven the legacy perf blob; one in
+// twenty has a heating rate far off the fleet's.
+static int generateFleet(const char* dir, int units, long rows, unsigned seed) {
+  mkdir(dir, 0755);
+  std::mt19937 rng(seed);
+  std::vector<LearningRecord> buffer(1 << 16);
+  for (int n = 0; n < units; n++) {
+    char unitDir[512];
+    snprintf(unitDir, sizeof(unitDir), "%s/unit%05d", dir, n);
+    if (mkdir(unitDir, 0755) != 0 && errno != EEXIST) { perror(unitDir); return 2; }
+    std::string base(unitDir);
+    int morning = 5 + rng() % 3, evening = 17 + rng() % 3, weekend = 8 + rng() % 2;
+    int warmDeciF = 700 + 5 * (int)(rng() % 8), coolDeciF = 660 + 5 * (int)(rng() % 6);
+    bool csv = n % 10 == 3;
+    FILE* f = fopen((base + (csv ? "/learning_log.csv" : "/learning_log.bin")).c_str(), "wb");
+    if (!f) { perror(unitDir); return 2; }
+    if (!csv) { LearningLogHeader h = { LEARNING_LOG_MAGIC, 1 }; fwrite(&h, sizeof(h), 1, f); }
+    uint32_t minute = rng() % MINUTES_PER_YEAR;
+    for (long r = 0; r < rows;) {
+      size_t batch = (size_t)std::min<long>(rows - r, (long)buffer.size());
+      for (size_t k = 0; k < batch; k++) {
+        minute = (minute + 1 + rng() % 400) % MINUTES_PER_YEAR;
+        LearningRecord& rec = buffer[k];
+        uint32_t day = minute / 1440;
+        rec.minuteOfYear = minute;
+        rec.dayOfWeek = (uint8_t)(day % 7);
+        int kind = rng() % 4;
+        bool weekday = rec.dayOfWeek >= 1 && rec.dayOfWeek <= 5;
+        if (kind == 0 && weekday) { rec.hour = (uint8_t)morning; rec.targetDeciF = (int16_t)warmDeciF; }
+        else if (kind == 1 && weekday) { rec.hour = (uint8_t)evening; rec.targetDeciF = (int16_t)coolDeciF; }
+        else if (kind == 2 && !weekday) { rec.hour = (uint8_t)weekend; rec.targetDeciF = (int16_t)warmDeciF; }
+        else { rec.hour = (uint8_t)(minute / 60 % 24); rec.targetDeciF = (int16_t)(620 + rng() % 160); }
+      }
+      if (csv) {
+        for (size_t k = 0; k < batch; k++) fprintf(f, "%d,%d,%.1f\n", buffer[k].dayOfWeek, buffer[k].hour, buffer[k].targetDeciF / 10.0);
+      } else {
+        fwrite(buffer.data(), sizeof(LearningRecord), batch, f);
+      }
+      r += batch;
+    }
+    fclose(f);
+
+    HvacPerformance p;
+    float gain = 5.0f + (rng() % 100) / 50.0f, leak = 0.05f + (rng() % 20) / 1000.0f;
+    if (n % 20 == 7) gain *= 3; // A misreporting sensor
+    for (int season = 0; season < NUM_SEASONS; season++) {
+      for (int bin = 0; bin < NUM_PERFORMANCE_BINS; bin++) {
+        float outdoorF = 5 + 10 * bin;
+        p.heatRate[season][bin] = saturate16((gain - leak * (68 - outdoorF)) * 500.0f / 9.0f);
+        p.heatSamples[season][bin] = (uint16_t)(bin < 6 ? 3 + rng() % 40 : 0);
+        p.coolRate[season][bin] = saturate16((4.0f - leak * (outdoorF - 74)) * 500.0f / 9.0f);
+        p.coolSamples[season][bin] = (uint16_t)(bin > 4 ? 3 + rng() % 40 : 0);
+      }
+    }
+    f = fopen((base + "/perf.bin").c_str(), "wb");
+    if (!f) { perror(unitDir); return 2; }
+    if (n % 7 == 2) {
+      LegacyPerformance legacy;
+      for (int season = 0; season < NUM_SEASONS; season++) {
+        for (int bin = 0; bin < NUM_PERFORMANCE_BINS; bin++) {
+          legacy.heatRate[season][bin] = rateF(p.heatRate[season][bin]); legacy.heatSamples[season][bin] = p.heatSamples[season][bin];
+          legacy.coolRate[season][bin] = rateF(p.coolRate[season][bin]); legacy.coolSamples[season][bin] = p.coolSamples[season][bin];
+        }
+      }
+      fwrite(&legacy, sizeof(legacy), 1, f);
+    } else {
+      for (int heat = 1; heat >= 0; heat--) {
+        for (int season = 0; season < NUM_SEASONS; season++) {
+          PerfRecord row;
+          memcpy(row.rate, (heat ? p.heatRate : p.coolRate)[season], sizeof(row.rate));
+          memcpy(row.samples, (heat ? p.heatSamples : p.coolSamples)[season], sizeof(row.samples));
+          fwrite(&row, sizeof(row), 1, f);
+        }
+      }
+    }
+    fclose(f);
+  }
+  printf("Generated %d units of %ld adjustments in %s\n", units, rows, dir);
+  return 0;
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr,
+          "Usage: %s [--threads N] [--out DIR] [--min-adjustments N] [--lift X] [--fleet DIR]... [UNIT_DIR]...\n"
+          "       %s --generate DIR [--units N] [--rows N] [--seed N]\n",
+          argv0, argv0);
+}
+
+int main(int argc, char** argv) {
+  int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+  std::string outDir = ".";
+  uint64_t minAdjustments = MIN_ADJUSTMENTS_TO_LEARN;
+  double lift = 2.0;
+  const char* generateDir = nullptr;
+  int genUnits = 100;
+  long genRows = 100000;
+  unsigned seed = 1;
+  std::vector<std::string> unitDirs;
+  for (int i = 1; i < argc; i++) {
+    bool more = i + 1 < argc;
+    if (!strcmp(argv[i], "--threads") && more) threads = std::max(1, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "--out") && more) outDir = argv[++i];
+    else if (!strcmp(argv[i], "--min-adjustments") && more) minAdjustments = strtoull(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "--lift") && more) lift = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--fleet") && more) addFleetDir(argv[++i], unitDirs);
+    else if (!strcmp(argv[i], "--generate") && more) generateDir = argv[++i];
+    else if (!strcmp(argv[i], "--units") && more) genUnits = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--rows") && more) genRows = atol(argv[++i]);
+    else if (!strcmp(argv[i], "--seed") && more) seed = (unsigned)atoi(argv[++i]);
+    else if (argv[i][0] != '-') unitDirs.push_back(argv[i]);
+    else { usage(argv[0]); return 2; }
+  }
+  if (generateDir) return generateFleet(generateDir, genUnits, genRows, seed);
+  if (unitDirs.empty()) { usage(argv[0]); return 2; }
+
+  auto start = std::chrono::steady_clock::now();
+  std::unique_ptr<Unit[]> unitStore(new Unit[unitDirs.size()]);
+  std::vector<Unit*> units;
+  std::vector<LogFile> files;
+  std::vector<Chunk> chunks;
+  int badHeaders = 0, perfTables = 0, legacyPerfTables = 0, csvLogs = 0;
+  for (size_t n = 0; n < unitDirs.size(); n++) {
+    Unit& u = unitStore[n];
+    u.dir = unitDirs[n];
+    while (u.dir.size() > 1 && u.dir.back() == '/') u.dir.pop_back();
+    size_t slash = u.dir.find_last_of('/');
+    u.name = slash == std::string::npos ? u.dir : u.dir.substr(slash + 1);
+    units.push_back(&u);
+    if (loadPerformance(u)) { perfTables++; legacyPerfTables += u.legacyPerf; }
+
+    static const char* const LOGS[] = { "learning_log.1.bin", "learning_log.bin", "learning_log.csv" };
+    for (const char* name : LOGS) {
+      LogFile file = { &u, nullptr, 0, strstr(name, ".csv") != nullptr };
+      std::string path = u.dir + "/" + name;
+      if (!mapFile(path, file.base, file.size)) continue;
+      if (!file.csv) {
+        LearningLogHeader h;
+        if (file.size < sizeof(h) || (memcpy(&h, file.base, sizeof(h)), h.magic != LEARNING_LOG_MAGIC)) {
+          fprintf(stderr, "%s: not a learning log\n", path.c_str());
+          munmap((void*)file.base, file.size);
+          badHeaders++;
+          continue;
+        }
+      }
+      csvLogs += file.csv;
+      int index = (int)files.size();
+      files.push_back(file);
+      for (size_t begin = 0; begin < file.size; begin += CHUNK_BYTES) chunks.push_back({ index, begin, std::min(file.size, begin + CHUNK_BYTES) });
+    }
+  }
+
+  std::atomic<size_t> next(0);
+  std::atomic<uint64_t> bytes(0);
+  std::vector<std::thread> pool;
+  int workers = std::min<int>(threads, (int)std::max<size_t>(1, chunks.size()));
+  for (int t = 0; t < workers; t++) pool.emplace_back(worker, &files, &chunks, &next, &bytes);
+  for (auto& t : pool) t.join();
+  for (const LogFile& f : files) munmap((void*)f.base, f.size);
+  double scanSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  // Fleet histogram and per-unit rows.
+  uint64_t fleetCount[SLOTS] = {}, rows = 0, bad = 0;
+  int64_t fleetSum[SLOTS] = {};
+  FILE* hist = openOutput(outDir, "histogram.csv");
+  if (!hist) return 2;
+  fprintf(hist, "unit,day,hour,adjustments,mean_target_f\n");
+  for (const Unit* u : units) {
+    bad += u->bad.load();
+    for (int s = 0; s < SLOTS; s++) {
+      uint64_t n = u->count[s].load();
+      if (!n) continue;
+      int64_t sum = u->sumDeciF[s].load();
+      fleetCount[s] += n; fleetSum[s] += sum; rows += n;
+      fprintf(hist, "%s,%s,%d,%llu,%.2f\n", u->name.c_str(), DAY_NAMES[s / 24], s % 24, (unsigned long long)n, sum / 10.0 / n);
+    }
+  }
+  for (int s = 0; s < SLOTS; s++) {
+    if (fleetCount[s]) fprintf(hist, "fleet,%s,%d,%llu,%.2f\n", DAY_NAMES[s / 24], s % 24, (unsigned long long)fleetCount[s], fleetSum[s] / 10.0 / fleetCount[s]);
+  }
+  fclose(hist);
+
+  // Performance tables with outlier flags.
+  static PerfCell cells[2][NUM_SEASONS][NUM_PERFORMANCE_BINS];
+  perfStatistics(units, cells);
+  FILE* perf = openOutput(outDir, "performance.csv");
+  if (!perf) return 2;
+  fprintf(perf, "unit,mode,season,bin,rate_f_per_h,samples,fleet_median_f_per_h,flag\n");
+  int outliers = 0, outlierUnits = 0;
+  for (const Unit* u : units) {
+    if (!u->havePerf) continue;
+    bool flagged = false;
+    for (int heat = 1; heat >= 0; heat--) {
+      for (int season = 0; season < NUM_SEASONS; season++) {
+        for (int bin = 0; bin < NUM_PERFORMANCE_BINS; bin++) {
+          uint16_t samples = (heat ? u->perf.heatSamples : u->perf.coolSamples)[season][bin];
+          if (!samples) continue;
+          uint16_t rate = (heat ? u->perf.heatRate : u->perf.coolRate)[season][bin];
+          const PerfCell& cell = cells[heat][season][bin];
+          bool outlier = isOutlier(cell, rate);
+          outliers += outlier; flagged |= outlier;
+          fprintf(perf, "%s,%s,%s,%d,%.2f,%u,%.2f,%s\n", u->name.c_str(), heat ? "heat" : "cool", SEASON_NAMES[season], bin,
+                  rateF(rate), samples, rateF((uint16_t)cell.median), outlier ? "outlier" : "");
+        }
+      }
+    }
+    outlierUnits += flagged;
+  }
+  fclose(perf);
+
+  FILE* sugg = openOutput(outDir, "suggestions.csv");
+  if (!sugg) return 2;
+  fprintf(sugg, "unit,list,day,start,target_f,adjustments\n");
+  int suggestions = 0, suggestedUnits = 0;
+  for (const Unit* u : units) {
+    int n = emitSuggestions(sugg, *u, minAdjustments, lift);
+    suggestions += n; suggestedUnits += n > 0;
+  }
+  fclose(sugg);
+  double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  printf("Fleet analytics: %zu units, %zu log files (%d CSV) in %zu chunks on %d threads\n", units.size(), files.size(), csvLogs,
+         chunks.size(), workers);
+  printf("  Adjustments  %llu (%llu malformed), %.1f MB in %.3f s: %.1f M rows/s, %.0f MB/s\n", (unsigned long long)rows,
+         (unsigned long long)bad, bytes.load() / 1e6, scanSeconds, (rows + bad) / 1e6 / std::max(scanSeconds, 1e-9),
+         bytes.load() / 1e6 / std::max(scanSeconds, 1e-9));
+  if (badHeaders) printf("  Skipped %d files without a learning log header\n", badHeaders);
+  int busiest = (int)(std::max_element(fleetCount, fleetCount + SLOTS) - fleetCount);
+  if (rows) printf("  Busiest slot %s %02d:00, %llu adjustments, mean %.1f F\n", DAY_NAMES[busiest / 24], busiest % 24,
+                   (unsigned long long)fleetCount[busiest], fleetSum[busiest] / 10.0 / fleetCount[busiest]);
+
+  printf("  Performance tables %d (%d legacy); fleet median rates, F/h by outdoor bin:\n", perfTables, legacyPerfTables);
+  for (int heat = 1; heat >= 0; heat--) {
+    for (int season = 0; season < NUM_SEASONS; season++) {
+      printf("    %s %-6s", heat ? "heat" : "cool", SEASON_NAMES[season]);
+      for (int bin = 0; bin < NUM_PERFORMANCE_BINS; bin++) {
+        const PerfCell& cell = cells[heat][season][bin];
+        if (cell.units) printf(" %6.2f", rateF((uint16_t)cell.median));
+        else printf("      -");
+      }
+      printf("\n");
+    }
+  }
+  printf("  Outlier rates %d in %d units\n", outliers, outlierUnits);
+  printf("  Suggested schedule edits %d for %d units\n", suggestions, suggestedUnits);
+  printf("  Total %.3f s; wrote histogram.csv, performance.csv, suggestions.csv to %s\n", totalSeconds, outDir.c_str());
+  return badHeaders ? 1 : 0;
+}
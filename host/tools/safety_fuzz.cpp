@@ -0,0 +1,440 @@
+// Safety fuzzer for the control core. Each sequence is a random run of
+// control passes: sensor readings that wander and spike, mode changes,
+// schedule edits, vacation toggles, wall-clock sets and gaps from seconds to
+// days, with the controller clock started just short of its wrap about
+// half the time. Every pass drives controlTemperature(), controlHumidity()
+// and controlFan() on one instance and stepThermostat() (state_machine.h) on
+// another, as loop() does, and checks the shadow relays before the commit
+// against the safety rules:
+//   heat+cool      heater and cooler never on together
+//   fan            the fan runs whenever the heater, cooler or damper does
+//   min-off        a stage only starts after its minimum off time
+//   min-run        a stage only stops after its minimum run, unless locked out
+//   max-run        no stage is left running past its maximum run
+//   lockout        the lockout follows MAX_RUN_TRIGGER_COUNT max-run stops within
+//                  MAX_RUN_LOCKOUT_HOURS, and holds heat, cool and damper off
+//   schedule       the cached schedule entry matches a fresh lookup
+// The rules are checked against what the relays did, not against the
+// controller's own timers, so a timer the logic forgot to set is caught too.
+//
+// Sequences are numbered; sequence k is generated from --seed and k alone,
+// and threads take numbers from a shared counter, so a run finds the same
+// failures on any core count. The lowest failing sequence is shrunk by
+// dropping runs of passes and events while the same rule still fails, then
+// printed with the command that replays it. The exit code is 1 on any
+// failure. The controller clock is a 32-bit ControlMillis (config.h) on the
+// host too, so sequences started near UINT32_MAX cross the same wrap the
+// device's millis() does every 49.7 days.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Arduino.h>
+#include "config.h"
+#include "controller.h"
+#include "hvac_logic.h"
+#include "main.h"
+#include "relays.h"
+#include "schedule.h"
+#include "state_machine.h"
+#include "../sim/weather.h"
+
+enum Invariant { HEAT_AND_COOL, FAN_WITH_STAGE, MIN_OFF, MIN_RUN, MAX_RUN, LOCKOUT, SCHEDULE_CURSOR, NUM_INVARIANTS, NO_FAILURE = NUM_INVARIANTS };
+static const char* const INVARIANT_NAMES[NUM_INVARIANTS] = { "heat+cool", "fan", "min-off", "min-run", "max-run", "lockout", "schedule" };
+static const char* const PATH_NAMES[] = { "controlTemperature()", "stepThermostat()" };
+static const int NUM_PATHS = 2;
+
+enum EventKind : uint8_t { EVENT_NONE, EVENT_MODE, EVENT_SCHEDULE, EVENT_VACATION, EVENT_CLOCK_SET };
+
+struct Step {
+  uint32_t dtSeconds;
+  CentiC indoor, outdoor;
+  CentiRH humidity;
+  EventKind event;
+  uint8_t mode;                  // EVENT_MODE
+  uint8_t list, day, slot, count; // EVENT_SCHEDULE: 0 weekday, 1 weekend, 2 override of `day`; entry `slot`; new entry count
+  ScheduleEntry entry;
+  uint32_t clockSeconds;         // EVENT_CLOCK_SET: new calendar time
+};
+
+struct Sequence {
+  ControlMillis startNow;
+  uint32_t startSeconds;
+  int startDayOfWeek;
+  SystemMode mode;
+  Schedule schedule;
+  std::vector<Step> steps;
+};
+
+struct Failure {
+  int invariant = NO_FAILURE;
+  int step = -1, path = -1;
+  std::string detail;
+};
+
+// What the relays have done, per instance and stage (0 heater, 1 cooler).
+struct Oracle {
+  ControlMillis onSince[2], offSince[2];
+  int trips[2];
+  ControlMillis firstTrip[2];
+  bool lockedOut;
+};
+
+static const int STAGE_PINS[2] = { HEATER_RELAY_PIN, COOLER_RELAY_PIN };
+static const char* const STAGE_NAMES[2] = { "heater", "cooler" };
+static const unsigned long MIN_RUN_MS[2] = { MIN_HEATER_RUN_TIME_MS, MIN_COOLER_RUN_TIME_MS };
+static const unsigned long MIN_OFF_MS[2] = { MIN_HEATER_OFF_TIME_MS, MIN_COOLER_OFF_TIME_MS };
+static const unsigned long MAX_RUN_MS[2] = { MAX_HEATER_RUN_TIME_MS, MAX_COOLER_RUN_TIME_MS };
+static const uint32_t YEAR_SECONDS = 365u * 86400u;
+
+static uint64_t splitmix64(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+// =================================================================
+// ==                          GENERATION                         ==
+// =================================================================
+struct Rng {
+  std::mt19937_64 engine;
+  explicit Rng(uint64_t seed) : engine(seed) {}
+  uint32_t below(uint32_t n) { return (uint32_t)(engine() % n); }
+  int between(int lo, int hi) { return lo + (int)below((uint32_t)(hi - lo + 1)); }
+  bool chance(uint32_t oneIn) { return below(oneIn) == 0; }
+};
+
+static ScheduleEntry randomEntry(Rng& rng) {
+  return { (uint8_t)rng.below(24), (uint8_t)rng.below(60), centiCFromF((float)rng.between(55, 85)), (FanMode)rng.below(3) };
+}
+
+static void randomSchedule(Rng& rng, Schedule& s) {
+  s = Schedule();
+  s.weekdayEntryCount = (uint8_t)rng.between(1, MAX_DAY_ENTRIES);
+  s.weekendEntryCount = (uint8_t)rng.between(1, MAX_DAY_ENTRIES);
+  for (int n = 0; n < MAX_DAY_ENTRIES; n++) { s.weekday[n] = randomEntry(rng); s.weekend[n] = randomEntry(rng); }
+  for (int d = 0; d < 7; d++) {
+    s.dayOverrideCount[d] = rng.chance(4) ? (uint8_t)rng.between(1, MAX_DAY_OVERRIDE_ENTRIES) : 0;
+    for (int n = 0; n < MAX_DAY_OVERRIDE_ENTRIES; n++) s.dayOverride[d][n] = randomEntry(rng);
+  }
+  s.vacation = randomEntry(rng);
+  s.exceptionCount = (uint8_t)rng.below(MAX_SCHEDULE_EXCEPTIONS + 1);
+  for (int n = 0; n < s.exceptionCount; n++) s.exceptions[n] = { (uint8_t)rng.between(1, 12), (uint8_t)rng.between(1, 28), (uint8_t)rng.below(7) };
+}
+
+// Mostly loop()'s cadence, with the gaps a stalled task, a long sleep or a
+// debugger leaves now and then.
+static uint32_t randomGap(Rng& rng) {
+  uint32_t r = rng.below(100);
+  if (r < 70) return (uint32_t)rng.between(5, 60);
+  if (r < 90) return (uint32_t)rng.between(60, 600);
+  if (r < 98) return (uint32_t)rng.between(600, 7200);
+  return (uint32_t)rng.between(7200, 3 * 86400);
+}
+
+static Sequence generateSequence(uint64_t seed, uint64_t k, int maxSteps) {
+  Rng rng(splitmix64(seed ^ splitmix64(k)));
+  Sequence seq;
+  seq.startNow = rng.chance(2) ? UINT32_MAX - rng.below(3 * 86400000u) : rng.below(86400000u);
+  seq.startSeconds = rng.below(YEAR_SECONDS);
+  seq.startDayOfWeek = (int)rng.below(7);
+  seq.mode = (SystemMode)rng.below(4);
+  randomSchedule(rng, seq.schedule);
+
+  int n = rng.between(16, std::max(16, maxSteps));
+  float indoorF = (float)rng.between(55, 85), outdoorF = (float)rng.between(-10, 105), rh = (float)rng.between(15, 70);
+  std::normal_distribution<float> walk(0, 0.4f);
+  for (int s = 0; s < n; s++) {
+    Step st = {};
+    st.dtSeconds = randomGap(rng);
+    indoorF = std::min(100.0f, std::max(35.0f, indoorF + walk(rng.engine)));
+    outdoorF = std::min(115.0f, std::max(-25.0f, outdoorF + walk(rng.engine) * 2));
+    rh = std::min(95.0f, std::max(5.0f, rh + walk(rng.engine) * 3));
+    if (rng.chance(50)) indoorF = (float)rng.between(40, 95);   // Door open, sun on the sensor
+    if (rng.chance(200)) outdoorF = (float)rng.between(-20, 110);
+    st.indoor = centiCFromF(indoorF); st.outdoor = centiCFromF(outdoorF); st.humidity = centiRH(rh);
+
+    uint32_t e = rng.below(1000);
+    if (e < 25) { st.event = EVENT_MODE; st.mode = (uint8_t)rng.below(4); }
+    else if (e < 40) {
+      st.event = EVENT_SCHEDULE;
+      st.list = (uint8_t)rng.below(3); st.day = (uint8_t)rng.below(7);
+      int limit = st.list == 2 ? MAX_DAY_OVERRIDE_ENTRIES : MAX_DAY_ENTRIES;
+      st.slot = (uint8_t)rng.below(limit);
+      st.count = (uint8_t)rng.below(limit + 1);
+      st.entry = randomEntry(rng);
+    }
+    else if (e < 45) st.event = EVENT_VACATION;
+    else if (e < 50) { st.event = EVENT_CLOCK_SET; st.clockSeconds = rng.below(YEAR_SECONDS); }
+    seq.steps.push_back(st);
+  }
+  return seq;
+}
+
+// =================================================================
+// ==                           RUNNING                           ==
+// =================================================================
+static void applySchedule(Schedule& s, const Step& st) {
+  if (st.list == 0) { s.weekday[st.slot] = st.entry; s.weekdayEntryCount = st.count; }
+  else if (st.list == 1) { s.weekend[st.slot] = st.entry; s.weekendEntryCount = st.count; }
+  else { s.dayOverride[st.day][st.slot] = st.entry; s.dayOverrideCount[st.day] = st.count; }
+}
+
+static void resetInstance(ControllerBatch& b, int i, const Sequence& seq) {
+  b.systemMode[i] = seq.mode;
+  b.tempUnit[i] = FAHRENHEIT;
+  b.vacationModeActive[i] = false;
+  b.programSchedule[i] = seq.schedule;
+  markScheduleEdited(b, i);
+  b.performance[i] = HvacPerformance();
+  b.relays[i] = 0; b.state[i] = IDLE;
+  b.isFanCirculating[i] = false; b.freshAirForHeating[i] = false;
+  b.cycleInProgress[i] = false; b.performanceDirty[i] = 0;
+  b.heaterMaxRunTriggers[i] = 0; b.coolerMaxRunTriggers[i] = 0;
+  b.firstHeaterMaxRunTriggerTime[i] = 0; b.firstCoolerMaxRunTriggerTime[i] = 0;
+  b.systemLockedOut[i] = false;
+  b.lastHeaterOnTime[i] = b.lastCoolerOnTime[i] = b.now;
+  initialize_logic_timers(b, i, b.now);
+}
+
+static void failAt(Failure& f, Invariant inv, int step, int path, const char* fmt, ...) __attribute__((format(printf, 5, 6)));
+static void failAt(Failure& f, Invariant inv, int step, int path, const char* fmt, ...) {
+  if (f.invariant != NO_FAILURE) return;
+  char text[256];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(text, sizeof(text), fmt, args);
+  va_end(args);
+  f.invariant = inv; f.step = step; f.path = path; f.detail = text;
+}
+
+// Checks one pass of instance i: `before` is the mask committed last pass,
+// `shadow` the mask the pass left, lockout state from before and after.
+static void checkPass(Failure& f, Oracle& o, const ControllerBatch& b, int i, int step, uint16_t before, uint16_t shadow, bool lockedBefore) {
+  const ControlMillis now = b.now;
+  const uint16_t HEAT = RELAY_BIT(HEATER_RELAY_PIN), COOL = RELAY_BIT(COOLER_RELAY_PIN), FRESH = RELAY_BIT(FRESH_AIR_RELAY_PIN);
+  if ((shadow & HEAT) && (shadow & COOL)) failAt(f, HEAT_AND_COOL, step, i, "heater and cooler both on");
+  if ((shadow & (HEAT | COOL | FRESH)) && !(shadow & RELAY_BIT(FAN_RELAY_PIN))) failAt(f, FAN_WITH_STAGE, step, i, "stage or damper on without the fan");
+
+  for (int s = 0; s < 2; s++) {
+    uint16_t bit = RELAY_BIT(STAGE_PINS[s]);
+    bool was = before & bit, is = shadow & bit;
+    if (!was && is) {
+      if (now - o.offSince[s] <= MIN_OFF_MS[s])
+        failAt(f, MIN_OFF, step, i, "%s started %u s after stopping", STAGE_NAMES[s], (now - o.offSince[s]) / 1000);
+      o.onSince[s] = now;
+    } else if (was && !is) {
+      ControlMillis ran = now - o.onSince[s];
+      if (!lockedBefore && ran <= MIN_RUN_MS[s])
+        failAt(f, MIN_RUN, step, i, "%s stopped after %u s", STAGE_NAMES[s], ran / 1000);
+      if (!lockedBefore && ran > MAX_RUN_MS[s]) {
+        if (o.trips[s] > 0 && now - o.firstTrip[s] > MAX_RUN_LOCKOUT_MS) { o.trips[s] = 1; o.firstTrip[s] = now; }
+        else { if (o.trips[s] == 0) o.firstTrip[s] = now; if (++o.trips[s] >= MAX_RUN_TRIGGER_COUNT) o.lockedOut = true; }
+      }
+      o.offSince[s] = now;
+    } else if (is && now - o.onSince[s] > MAX_RUN_MS[s]) {
+      failAt(f, MAX_RUN, step, i, "%s left on after %u min", STAGE_NAMES[s], (now - o.onSince[s]) / 60000);
+    }
+  }
+
+  if (b.systemLockedOut[i] != o.lockedOut)
+    failAt(f, LOCKOUT, step, i, "locked out %d, expected %d after %d heater and %d cooler max-run stops", b.systemLockedOut[i], o.lockedOut, o.trips[0], o.trips[1]);
+  else if (lockedBefore && (shadow & (HEAT | COOL | FRESH)))
+    failAt(f, LOCKOUT, step, i, "heat, cool or damper on while locked out");
+}
+
+// Runs the sequence from a clean controller; stops at the first failure.
+static Failure runSequence(const Sequence& seq, ControllerBatch& b) {
+  Failure f;
+  b.now = seq.startNow;
+  uint64_t seconds = seq.startSeconds;
+  Oracle oracle[NUM_PATHS];
+  for (int i = 0; i < NUM_PATHS; i++) {
+    resetInstance(b, i, seq);
+    Oracle& o = oracle[i];
+    o = Oracle();
+    for (int s = 0; s < 2; s++) o.offSince[s] = b.now - (MIN_OFF_MS[s] + 1000); // As initialize_logic_timers()
+  }
+
+  for (int n = 0; n < (int)seq.steps.size() && f.invariant == NO_FAILURE; n++) {
+    const Step& st = seq.steps[n];
+    b.now += st.dtSeconds * 1000u;
+    seconds += st.dtSeconds;
+    if (st.event == EVENT_CLOCK_SET) seconds = st.clockSeconds;
+    TimeInfo time = calendarAt(seconds, seq.startDayOfWeek);
+    b.season = seasonForMonth(time.month);
+
+    for (int i = 0; i < NUM_PATHS; i++) {
+      switch (st.event) {
+        case EVENT_MODE: b.systemMode[i] = (SystemMode)st.mode; break;
+        case EVENT_SCHEDULE: applySchedule(b.programSchedule[i], st); markScheduleEdited(b, i); break;
+        case EVENT_VACATION: b.vacationModeActive[i] = !b.vacationModeActive[i]; break;
+        case EVENT_CLOCK_SET: invalidateScheduleCursor(b, i); break;
+        default: break;
+      }
+
+      const ScheduleEntry& entry = activeScheduleEntry(b, i, time);
+      const ScheduleEntry& fresh = *lookupCompiledSchedule(b.compiledSchedule[i], b.vacationModeActive[i], time).entry;
+      if (entry.target != fresh.target || entry.fanMode != fresh.fanMode)
+        failAt(f, SCHEDULE_CURSOR, n, i, "cached target %.1f F fan %d, lookup gives %.1f F fan %d",
+               centiCToUnit(entry.target, FAHRENHEIT), entry.fanMode, centiCToUnit(fresh.target, FAHRENHEIT), fresh.fanMode);
+
+      uint16_t before = b.relays[i];
+      bool lockedBefore = b.systemLockedOut[i];
+      if (i == 0) controlTemperature(b, i, st.indoor, entry.target, st.outdoor);
+      else stepThermostat(b, i, st.indoor, entry.target, st.outdoor);
+      controlHumidity(b, i, st.humidity, st.indoor, st.outdoor);
+      controlFan(b, i, entry.fanMode);
+      checkPass(f, oracle[i], b, i, n, before, b.relays[i], lockedBefore);
+      commitRelays(b, i);
+      b.performanceDirty[i] = 0;
+    }
+  }
+  return f;
+}
+
+// =================================================================
+// ==                         MINIMISING                          ==
+// =================================================================
+// Delta debugging over the passes: drop ever smaller runs of them, then
+// strip the events left, keeping each change under which the same rule
+// still fails. Dropping a pass drops its gap too, so what remains is a
+// shorter history that still breaks the rule.
+static Sequence minimise(Sequence seq, int invariant, ControllerBatch& b, int* runs) {
+  auto stillFails = [&](const Sequence& s) { (*runs)++; return runSequence(s, b).invariant == invariant; };
+  Failure f = runSequence(seq, b);
+  seq.steps.resize(f.step + 1);
+
+  for (size_t chunk = std::max<size_t>(1, seq.steps.size() / 2); ; chunk = std::max<size_t>(1, chunk / 2)) {
+    bool removed = false;
+    for (size_t at = 0; at < seq.steps.size(); ) {
+      Sequence trial = seq;
+      trial.steps.erase(trial.steps.begin() + at, trial.steps.begin() + std::min(seq.steps.size(), at + chunk));
+      if (!trial.steps.empty() && stillFails(trial)) { seq = trial; removed = true; }
+      else at += chunk;
+    }
+    if (chunk == 1 && !removed) break;
+  }
+  for (Step& st : seq.steps) {
+    if (st.event == EVENT_NONE) continue;
+    Step saved = st;
+    st.event = EVENT_NONE;
+    if (!stillFails(seq)) st = saved;
+  }
+  f = runSequence(seq, b);
+  seq.steps.resize(f.step + 1);
+  return seq;
+}
+
+static void printSequence(const Sequence& seq, const Failure& f) {
+  const char* const MODES[] = { "off", "heat", "cool", "auto" };
+  const char* const LISTS[] = { "weekday", "weekend", "override" };
+  TimeInfo t = calendarAt(seq.startSeconds, seq.startDayOfWeek);
+  printf("  start: millis %u, %02d/%02d %02d:%02d:%02d (day %d), mode %s\n", seq.startNow, t.month, t.day, t.hour, t.minute, t.second,
+         t.dayOfWeek, MODES[seq.mode]);
+  ControlMillis now = seq.startNow;
+  for (size_t n = 0; n < seq.steps.size(); n++) {
+    const Step& st = seq.steps[n];
+    now += st.dtSeconds * 1000u;
+    printf("  %4zu  +%6us  millis %10u  in %5.1f F  out %5.1f F  rh %4.1f%%", n, st.dtSeconds, now,
+           centiCToUnit(st.indoor, FAHRENHEIT), centiCToUnit(st.outdoor, FAHRENHEIT), st.humidity / 100.0f);
+    switch (st.event) {
+      case EVENT_MODE: printf("  mode %s", MODES[st.mode]); break;
+      case EVENT_SCHEDULE: printf("  edit %s[%d] (day %d) = %02d:%02d %.0f F, %d entries", LISTS[st.list], st.slot, st.day,
+                                  st.entry.startHour, st.entry.startMinute, centiCToUnit(st.entry.target, FAHRENHEIT), st.count); break;
+      case EVENT_VACATION: printf("  vacation toggled"); break;
+      case EVENT_CLOCK_SET: { TimeInfo c = calendarAt(st.clockSeconds, seq.startDayOfWeek); printf("  clock set %02d/%02d %02d:%02d", c.month, c.day, c.hour, c.minute); break; }
+      default: break;
+    }
+    printf("\n");
+  }
+  printf("  -> %s on %s at pass %d: %s\n", INVARIANT_NAMES[f.invariant], PATH_NAMES[f.path], f.step, f.detail.c_str());
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "Usage: %s [--sequences N] [--steps MAX] [--seed S] [--threads N] [--replay K]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+  uint64_t sequences = 200000, seed = 1;
+  int maxSteps = 400;
+  int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+  long long replay = -1;
+  for (int i = 1; i < argc; i++) {
+    bool more = i + 1 < argc;
+    if (!strcmp(argv[i], "--sequences") && more) sequences = strtoull(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "--steps") && more) maxSteps = std::max(16, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "--seed") && more) seed = strtoull(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "--threads") && more) threads = std::max(1, atoi(argv[++i]));
+    else if (!strcmp(argv[i], "--replay") && more) replay = atoll(argv[++i]);
+    else { usage(argv[0]); return 2; }
+  }
+
+  std::unique_ptr<ControllerStorage<NUM_PATHS>> scratch(new ControllerStorage<NUM_PATHS>());
+  if (replay >= 0) {
+    Sequence seq = generateSequence(seed, (uint64_t)replay, maxSteps);
+    Failure f = runSequence(seq, scratch->batch);
+    if (f.invariant == NO_FAILURE) { printf("Sequence %lld (seed %llu): %zu passes, no failure\n", replay, (unsigned long long)seed, seq.steps.size()); return 0; }
+    printf("Sequence %lld (seed %llu), as generated:\n", replay, (unsigned long long)seed);
+    seq.steps.resize(f.step + 1);
+    printSequence(seq, f);
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::atomic<uint64_t> nextSequence(0), passes(0);
+  std::atomic<uint64_t> failures[NUM_INVARIANTS];
+  for (auto& n : failures) n = 0;
+  std::mutex firstLock;
+  uint64_t firstFailing = UINT64_MAX;
+  auto worker = [&]() {
+    std::unique_ptr<ControllerStorage<NUM_PATHS>> storage(new ControllerStorage<NUM_PATHS>());
+    uint64_t steps = 0;
+    for (uint64_t k = nextSequence++; k < sequences; k = nextSequence++) {
+      Sequence seq = generateSequence(seed, k, maxSteps);
+      Failure f = runSequence(seq, storage->batch);
+      steps += f.invariant == NO_FAILURE ? seq.steps.size() : f.step + 1;
+      if (f.invariant == NO_FAILURE) continue;
+      failures[f.invariant]++;
+      std::lock_guard<std::mutex> hold(firstLock);
+      firstFailing = std::min(firstFailing, k);
+    }
+    passes += steps;
+  };
+  std::vector<std::thread> pool;
+  for (int t = 1; t < threads; t++) pool.emplace_back(worker);
+  worker();
+  for (auto& t : pool) t.join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  uint64_t failed = 0;
+  for (auto& n : failures) failed += n;
+  printf("Safety fuzz: %llu sequences, %llu passes on %d threads in %.1f s (%.2f M passes/s), seed %llu\n", (unsigned long long)sequences,
+         (unsigned long long)passes.load(), threads, seconds, passes / seconds / 1e6, (unsigned long long)seed);
+  if (!failed) { printf("  No rule broken\n"); return 0; }
+  printf("  %llu failing sequences:", (unsigned long long)failed);
+  for (int v = 0; v < NUM_INVARIANTS; v++) if (failures[v]) printf(" %s %llu", INVARIANT_NAMES[v], (unsigned long long)failures[v].load());
+  printf("\n");
+
+  Sequence seq = generateSequence(seed, firstFailing, maxSteps);
+  Failure f = runSequence(seq, scratch->batch);
+  size_t generated = f.step + 1;
+  int runs = 0;
+  seq = minimise(seq, f.invariant, scratch->batch, &runs);
+  f = runSequence(seq, scratch->batch);
+  printf("First failing sequence %llu, shrunk from %zu to %zu passes in %d runs (replay: --seed %llu --replay %llu --steps %d):\n",
+         (unsigned long long)firstFailing, generated, seq.steps.size(), runs, (unsigned long long)seed, (unsigned long long)firstFailing, maxSteps);
+  printSequence(seq, f);
+  return 1;
+}
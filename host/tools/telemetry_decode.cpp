@@ -0,0 +1,87 @@
+// Telemetry decoder: splits a captured serial stream at the 0x00 frame
+// delimiters, checks and decodes each frame, and prints CSV (default), the
+// human-readable status lines (--text), or only totals and the latest probe
+// summaries (--summary). Sequence gaps are frames the controller dropped on a
+// full ring.
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "config.h"
+#include "probes.h"
+#include "telemetry.h"
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "Usage: %s [--text | --summary] [FILE]  (reads stdin without FILE)\n", argv0);
+}
+
+int main(int argc, char** argv) {
+  enum { CSV, TEXT, SUMMARY } mode = CSV;
+  const char* path = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--text")) mode = TEXT;
+    else if (!strcmp(argv[i], "--summary")) mode = SUMMARY;
+    else if (argv[i][0] != '-' && !path) path = argv[i];
+    else { usage(argv[0]); return 2; }
+  }
+  FILE* in = path ? fopen(path, "rb") : stdin;
+  if (!in) { perror(path); return 2; }
+
+  if (mode == CSV) printf("seq,timestamp_ms,minute_of_day,state,indoor_raw,indoor,outdoor,target,humidity,relays,flags\n");
+  std::vector<uint8_t> frame;
+  unsigned long statusFrames = 0, probeFrames = 0, bad = 0, lost = 0, heaterOn = 0;
+  TelemetryProbeFrame lastProbe[NUM_PROBES];
+  bool haveProbe[NUM_PROBES] = {};
+  bool haveSequence = false;
+  uint16_t expected = 0;
+  int c;
+  while ((c = fgetc(in)) != EOF) {
+    if (c != 0) { if (frame.size() < TELEMETRY_MAX_ENCODED) frame.push_back((uint8_t)c); else bad++, frame.clear(); continue; }
+    if (frame.empty()) continue;
+    uint8_t raw[TELEMETRY_MAX_FRAME];
+    size_t size = decodeTelemetryBytes(frame.data(), frame.size(), raw);
+    frame.clear();
+    uint16_t sequence;
+    if (size == sizeof(TelemetryFrame) && raw[0] == TELEMETRY_VERSION) {
+      TelemetryFrame f; memcpy(&f, raw, sizeof(f));
+      sequence = f.sequence;
+      if (f.relays & TELEMETRY_RELAY_HEATER) heaterOn++;
+      if (mode == CSV) {
+        printf("%u,%lu,%u,%u,%.2f,%.2f,%.2f,%.2f,%.2f,0x%02x,0x%02x\n", f.sequence, (unsigned long)f.timestampMs, f.minuteOfDay, f.state,
+               f.indoorRaw / 100.0, f.indoorFiltered / 100.0, f.outdoor / 100.0, f.target / 100.0, f.humidity / 100.0, f.relays, f.flags);
+      } else if (mode == TEXT) {
+        char line[128];
+        formatTelemetryText(f, line, sizeof(line));
+        fputs(line, stdout);
+      }
+      statusFrames++;
+    } else if (size == sizeof(TelemetryProbeFrame) && raw[0] == TELEMETRY_PROBE_FRAME) {
+      TelemetryProbeFrame f; memcpy(&f, raw, sizeof(f));
+      sequence = f.sequence;
+      if (f.stage < NUM_PROBES) lastProbe[f.stage] = f, haveProbe[f.stage] = true;
+      if (mode == TEXT) {
+        char line[128];
+        formatTelemetryText(f, line, sizeof(line));
+        fputs(line, stdout);
+      }
+      probeFrames++;
+    } else {
+      bad++;
+      continue;
+    }
+    if (haveSequence) lost += (uint16_t)(sequence - expected);
+    expected = sequence + 1; haveSequence = true;
+  }
+  if (path) fclose(in);
+
+  FILE* out = mode == SUMMARY ? stdout : stderr;
+  fprintf(out, "%lu status frames, %lu probe frames, %lu corrupt, %lu dropped by the controller, heater on in %.1f%%\n",
+          statusFrames, probeFrames, bad, lost, statusFrames ? 100.0 * heaterOn / statusFrames : 0.0);
+  for (int stage = 0; stage < NUM_PROBES; stage++) {
+    if (!haveProbe[stage] || mode != SUMMARY) continue;
+    char line[128];
+    formatTelemetryText(lastProbe[stage], line, sizeof(line));
+    fputs(line, out);
+  }
+  return statusFrames > 0 && bad == 0 ? 0 : 1;
+}
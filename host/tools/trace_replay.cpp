@@ -0,0 +1,117 @@
+// Trace replayer: feeds recorded control passes (trace.h) through the current
+// stepThermostat(), controlHumidity() and controlFan() as fast as they
+// run, and compares the relays they leave with the recorded ones. Give the
+// files oldest first (trace.1.bin, then trace.bin); replay restarts from the
+// controller state in each keyframe. Reports the first divergence with its
+// inputs, how many passes diverged, and the replay speed. The exit code is 1
+// on any divergence and 2 on a file that is not a trace, so a field trace can
+// gate a control change.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "config.h"
+#include "controller.h"
+#include "hvac_logic.h"
+#include "trace.h"
+
+static const char* const RELAY_NAMES[] = { "", "", "heat", "cool", "fan", "fresh", "humid" };
+
+static void formatRelays(uint8_t mask, char* out) {
+  out[0] = 0;
+  for (int pin = 0; pin < 8; pin++) {
+    if (!(mask & (1u << pin))) continue;
+    if (out[0]) strcat(out, "+");
+    strcat(out, pin < 7 ? RELAY_NAMES[pin] : "?");
+  }
+  if (!out[0]) strcpy(out, "off");
+}
+
+static bool readWhole(const char* path, std::vector<uint8_t>& data) {
+  FILE* f = fopen(path, "rb");
+  if (!f) { perror(path); return false; }
+  uint8_t chunk[65536];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) data.insert(data.end(), chunk, chunk + n);
+  fclose(f);
+  return true;
+}
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "Usage: %s [--quiet] TRACE_FILE...  (oldest first)\n", argv0);
+}
+
+int main(int argc, char** argv) {
+  bool quiet = false;
+  std::vector<const char*> paths;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--quiet")) quiet = true;
+    else if (argv[i][0] != '-') paths.push_back(argv[i]);
+    else { usage(argv[0]); return 2; }
+  }
+  if (paths.empty()) { usage(argv[0]); return 2; }
+
+  static ControllerStorage<1> storage;
+  ControllerBatch& b = storage.batch;
+  unsigned long passes = 0, keyframes = 0, diverged = 0, skipped = 0, corrupt = 0;
+  bool haveState = false, reported = false;
+  double replaySeconds = 0;
+  size_t bytes = 0;
+
+  for (const char* path : paths) {
+    std::vector<uint8_t> data;
+    if (!readWhole(path, data)) return 2;
+    TraceHeader header;
+    if (data.size() < sizeof(header) || (memcpy(&header, data.data(), sizeof(header)), header.magic != TRACE_MAGIC || header.version != TRACE_VERSION)) {
+      fprintf(stderr, "%s: not a version %u trace\n", path, TRACE_VERSION);
+      return 2;
+    }
+    bytes += data.size();
+    TraceCodec codec = {};
+    size_t at = sizeof(header);
+    auto start = std::chrono::steady_clock::now();
+    while (at < data.size()) {
+      TracePass pass;
+      WarmState state;
+      bool keyframe;
+      size_t n = decodeTracePass(codec, data.data() + at, data.size() - at, pass, &state, &keyframe);
+      if (!n) {
+        // A torn tail (power lost mid-write) or damage: resume at the next file.
+        corrupt++;
+        break;
+      }
+      at += n;
+      if (keyframe) {
+        loadTraceKeyframe(b, 0, pass, state);
+        haveState = true;
+        keyframes++;
+        continue;
+      }
+      if (!haveState) { skipped++; continue; }
+      uint8_t relays = replayTracePass(b, 0, pass);
+      passes++;
+      if (relays == pass.relays) continue;
+      diverged++;
+      if (reported || quiet) continue;
+      reported = true;
+      char want[48], got[48];
+      formatRelays(pass.relays, want); formatRelays(relays, got);
+      printf("First divergence: %s pass %lu at %lu ms (month %d day %d dow %d %02d:%02d:%02d)\n", path, passes,
+             (unsigned long)pass.timestampMs, pass.time.month, pass.time.day, pass.time.dayOfWeek, pass.time.hour, pass.time.minute, pass.time.second);
+      printf("  indoor %.2f C  outdoor %.2f C  humidity %.2f%%  target %.2f C  mode %d  fan %d  unit %s\n", pass.indoor / 100.0,
+             pass.outdoor / 100.0, pass.humidity / 100.0, pass.target / 100.0, pass.systemMode, pass.fanMode, pass.tempUnit == FAHRENHEIT ? "F" : "C");
+      printf("  recorded %s, replayed %s\n", want, got);
+    }
+    replaySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  printf("Replayed %lu passes from %zu bytes (%.1f bytes/pass), %lu keyframes", passes, bytes,
+         passes + keyframes ? (double)bytes / (passes + keyframes) : 0.0, keyframes);
+  if (skipped) printf(", %lu before the first keyframe skipped", skipped);
+  if (corrupt) printf(", %lu files with a damaged tail", corrupt);
+  printf("\n  %.2f M passes/s (decode and control)\n", passes / 1e6 / std::max(replaySeconds, 1e-9));
+  printf("  Diverged: %lu of %lu passes\n", diverged, passes);
+  return diverged ? 1 : 0;
+}
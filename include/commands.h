@@ -0,0 +1,84 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <stdint.h>
+#include "config.h"
+
+// User commands from any task: the console, a UI or a network handler. A
+// producer fills in a typed Command and submits it to a bounded lock-free
+// queue (mpsc_ring.h), which wakes the control task; nothing outside the
+// control task ever writes the settings, so no setting needs a lock. At the
+// start of the next pass the control task drains the queue and applies each
+// command, and the pass then decides on the new settings at once: the
+// latency from submit to committed relays is one wake and one pass.
+//
+// A setpoint hold replaces the scheduled target until holdMinutes have
+// passed, or with holdMinutes 0 until the schedule next changes the target
+// (indefinitely if it does not within a week), and suspends Smart Recovery
+// meanwhile; CMD_RESUME_SCHEDULE or a vacation toggle ends it. Each hold is
+// also logged as a manual adjustment for the schedule learner. A full queue
+// refuses the command and counts it; the producer decides whether to retry.
+//
+// Latency from submit to the relay commit of the pass that applied the
+// command is recorded as the PROBE_COMMAND_LATENCY probe stage, so it shows
+// in the console's probe report and the telemetry probe frames.
+
+enum CommandType : uint8_t {
+  CMD_SETPOINT_HOLD, CMD_RESUME_SCHEDULE, CMD_SYSTEM_MODE, CMD_VACATION, CMD_SCHEDULE_ENTRY, CMD_LOCKOUT_RESET, NUM_COMMAND_TYPES
+};
+
+// The day program a CMD_SCHEDULE_ENTRY edits; PROGRAM_DAY_OVERRIDE + dayOfWeek
+// for a day override.
+enum ScheduleProgram : uint8_t { PROGRAM_WEEKDAY, PROGRAM_WEEKEND, PROGRAM_VACATION, PROGRAM_DAY_OVERRIDE, NUM_SCHEDULE_PROGRAMS = PROGRAM_DAY_OVERRIDE + 7 };
+
+struct Command {
+  CommandType type;
+  bool on;                 // CMD_VACATION
+  uint8_t program, index;  // CMD_SCHEDULE_ENTRY: index up to the program's entry count, which appends
+  SystemMode mode;         // CMD_SYSTEM_MODE
+  CentiC target;           // CMD_SETPOINT_HOLD
+  uint16_t holdMinutes;    // ...0: until the schedule's next target change
+  ScheduleEntry entry;     // CMD_SCHEDULE_ENTRY
+  uint32_t submittedCycles; // Set by submitCommand()
+};
+
+struct CommandStats {
+  unsigned long submitted;  // Producers count this and full atomically
+  unsigned long applied[NUM_COMMAND_TYPES];
+  unsigned long rejected;  // Out of range; dropped at apply
+  unsigned long full;      // Refused at submit
+  unsigned long drains;    // Passes that applied at least one command
+  uint32_t maxDepth;       // Most commands waiting at one drain
+};
+
+struct SetpointHold {
+  bool active;
+  CentiC target;
+  bool expires;
+  ControlMillis until; // Controller time at which the hold ends
+};
+
+extern CommandStats commandStats;
+extern SetpointHold setpointHold;
+
+struct WakePlan;
+
+// Function Declarations
+// Producers: any task, never blocking. False if the queue is full.
+bool submitCommand(const Command& command);
+bool submitSetpointHold(CentiC target, uint16_t holdMinutes);
+bool submitResumeSchedule();
+bool submitSystemMode(SystemMode mode);
+bool submitVacation(bool on);
+bool submitScheduleEntry(uint8_t program, uint8_t index, const ScheduleEntry& entry);
+bool submitLockoutReset();
+uint32_t commandQueueDepth();
+
+// Control task.
+int drainCommands();                          // Applies everything queued; returns the count applied
+void noteCommandsDecided();                   // After the relay commit of the pass that drained them
+bool setpointHeld();                          // Ends a hold whose time is up
+void planHoldExpiry(WakePlan& plan, ControlMillis now); // Wake when the hold ends
+void resetCommands();                         // Empty the queue, end any hold, clear the stats
+
+#endif // COMMANDS_H
@@ -1,12 +1,31 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include <stdint.h>
+
 // -- Temperature Unit Selection --
 enum TempUnit { CELSIUS, FAHRENHEIT };
 
 // -- System & Fan Mode Enums --
 enum SystemMode { SYS_OFF, SYS_HEAT, SYS_COOL, SYS_AUTO };
-enum FanMode { FAN_AUTO, FAN_ON, FAN_CIRCULATE };
+enum FanMode : uint8_t { FAN_AUTO, FAN_ON, FAN_CIRCULATE };
+enum ThermostatState : uint8_t { IDLE, RECOVERING, HEATING, COOLING, FAN_ONLY, ECONOMIZER_HEATING, ECONOMIZER_COOLING };
+enum EquipmentProfile { EQUIPMENT_HEAT_ONLY, EQUIPMENT_COOL_ONLY, EQUIPMENT_HEAT_COOL, EQUIPMENT_HEAT_PUMP };
+
+// -- Integer Temperatures --
+// The control core works in hundredths of a degree Celsius and hundredths of a
+// percent RH. Readings are converted once when sampled, settings when entered
+// and thresholds at compile time; only display and telemetry convert back.
+typedef int16_t CentiC;
+typedef int16_t CentiRH;
+
+// -- Controller Clock --
+// millis() is 32 bits on the device and wraps every 49.7 days. The control
+// core keeps its clock and timers in this type, so a host build, where
+// unsigned long is 64 bits, wraps them exactly where the device does.
+typedef uint32_t ControlMillis;
+
+constexpr CentiC centiCFromF(float f) { return (CentiC)((f - 32.0f) * 500.0f / 9.0f + (f >= 32.0f ? 0.5f : -0.5f)); }
 
 // -- Data Structures --
 struct TimeInfo {
@@ -15,43 +34,62 @@ struct TimeInfo {
   int dayOfWeek; // 0=Sun, 1=Mon, ..., 6=Sat
   int hour;
   int minute;
+  int second;
 };
 
 struct ScheduleEntry {
-  int startHour; 
-  int startMinute; 
-  float targetTemperature; 
+  uint8_t startHour;
+  uint8_t startMinute;
+  CentiC target;
   FanMode fanMode;
 };
 
+#define MAX_DAY_ENTRIES 10
+#define MAX_DAY_OVERRIDE_ENTRIES 6
+#define MAX_SCHEDULE_EXCEPTIONS 8
+
+// A date that runs another day's program, e.g. a holiday on the Sunday program.
+struct ScheduleException {
+  uint8_t month;
+  uint8_t day;
+  uint8_t programDay; // 0=Sun ... 6=Sat
+};
+
 struct Schedule {
-  ScheduleEntry weekday[10] = {
-    { 6, 30, 70.0, FAN_AUTO },      
-    { 8, 30, 75.0, FAN_CIRCULATE }, 
-    { 17, 30, 72.0, FAN_AUTO },     
-    { 22, 00, 68.0, FAN_AUTO },     
+  ScheduleEntry weekday[MAX_DAY_ENTRIES] = {
+    { 6, 30, centiCFromF(70.0), FAN_AUTO },
+    { 8, 30, centiCFromF(75.0), FAN_CIRCULATE },
+    { 17, 30, centiCFromF(72.0), FAN_AUTO },
+    { 22, 00, centiCFromF(68.0), FAN_AUTO },
   };
-  int weekdayEntryCount = 4;
+  uint8_t weekdayEntryCount = 4;
 
-  ScheduleEntry weekend[10] = { 
-    { 8, 00, 71.0, FAN_AUTO }, 
-    { 23, 00, 69.0, FAN_AUTO } 
+  ScheduleEntry weekend[MAX_DAY_ENTRIES] = {
+    { 8, 00, centiCFromF(71.0), FAN_AUTO },
+    { 23, 00, centiCFromF(69.0), FAN_AUTO }
   };
-  int weekendEntryCount = 2;
-  
-  ScheduleEntry vacation = { 0, 0, 80.0, FAN_CIRCULATE };
+  uint8_t weekendEntryCount = 2;
+
+  ScheduleEntry vacation = { 0, 0, centiCFromF(80.0), FAN_CIRCULATE };
+
+  // Per-day overrides: a day with entries here runs them instead of weekday/weekend.
+  ScheduleEntry dayOverride[7][MAX_DAY_OVERRIDE_ENTRIES] = {};
+  uint8_t dayOverrideCount[7] = {};
+
+  ScheduleException exceptions[MAX_SCHEDULE_EXCEPTIONS] = {};
+  uint8_t exceptionCount = 0;
 };
 
 #define NUM_PERFORMANCE_BINS 8
 #define NUM_SEASONS 4 // 0:Winter, 1:Spring, 2:Summer, 3:Fall
 
 struct HvacPerformance {
-  // heatRate[season][temperature_bin]
-  float heatRate[NUM_SEASONS][NUM_PERFORMANCE_BINS] = {{0}};
-  int   heatSamples[NUM_SEASONS][NUM_PERFORMANCE_BINS] = {{0}};
-  
-  float coolRate[NUM_SEASONS][NUM_PERFORMANCE_BINS] = {{0}};
-  int   coolSamples[NUM_SEASONS][NUM_PERFORMANCE_BINS] = {{0}};
+  // heatRate[season][temperature_bin], in CentiC per hour
+  uint16_t heatRate[NUM_SEASONS][NUM_PERFORMANCE_BINS] = {{0}};
+  uint16_t heatSamples[NUM_SEASONS][NUM_PERFORMANCE_BINS] = {{0}};
+
+  uint16_t coolRate[NUM_SEASONS][NUM_PERFORMANCE_BINS] = {{0}};
+  uint16_t coolSamples[NUM_SEASONS][NUM_PERFORMANCE_BINS] = {{0}};
 };
 
 // =================================================================
@@ -59,7 +97,7 @@ struct HvacPerformance {
 // =================================================================
 const TempUnit      DEFAULT_TEMP_UNIT       = FAHRENHEIT;
 const SystemMode    DEFAULT_SYSTEM_MODE     = SYS_AUTO;
-const float         HUMIDITY_TARGET         = 45.0;
+constexpr float     HUMIDITY_TARGET         = 45.0;
 
 // -- Relay Pin Assignments --
 const int HEATER_RELAY_PIN          = 2;
@@ -68,17 +106,21 @@ const int FAN_RELAY_PIN             = 4;
 const int FRESH_AIR_RELAY_PIN       = 5;
 const int HUMIDITY_RELAY_PIN        = 6;
 
+// -- Equipment Settings (state_machine.h) --
+const EquipmentProfile EQUIPMENT_PROFILE     = EQUIPMENT_HEAT_COOL; // Furnace and air conditioner on separate relays
+const bool          EQUIPMENT_ECONOMIZER            = true; // A fresh-air damper is fitted
+
 // -- Hysteresis, Cycle, and Protection Settings --
-const float         TEMPERATURE_DEADBAND_F          = 1.0;
-const float         HUMIDITY_DEADBAND               = 2.0;
+constexpr float     TEMPERATURE_DEADBAND_F          = 1.0;
+constexpr float     HUMIDITY_DEADBAND               = 2.0;
 const unsigned long MIN_HEATER_RUN_TIME_MINS        = 3;
 const unsigned long MIN_HEATER_OFF_TIME_MINS        = 5;
 const unsigned long MAX_HEATER_RUN_TIME_MINS        = 90;
 const unsigned long MIN_COOLER_RUN_TIME_MINS        = 4;
 const unsigned long MIN_COOLER_OFF_TIME_MINS        = 5;
 const unsigned long MAX_COOLER_RUN_TIME_MINS        = 90;
-const float         WINDOW_EFFICIENCY_FACTOR        = 0.6; 
-const float         FRESH_AIR_TEMP_DIFFERENTIAL_F   = 4.0;
+constexpr float     WINDOW_EFFICIENCY_FACTOR        = 0.6; 
+constexpr float     FRESH_AIR_TEMP_DIFFERENTIAL_F   = 4.0;
 const unsigned long FAN_CIRCULATE_ON_TIME_MINS      = 15;
 const unsigned long FAN_CIRCULATE_OFF_TIME_MINS     = 45;
 
@@ -89,12 +131,104 @@ const float         MIN_PLAUSIBLE_TEMP_F            = 0.0;
 const float         MAX_PLAUSIBLE_TEMP_F            = 120.0;
 
 // -- Learning Algorithm Settings --
-const char* LEARNING_LOG_FILE               = "/learning_log.csv";
+const char* const   LEARNING_LOG_FILE               = "/learning_log.bin";
+const char* const   LEARNING_LOG_ROTATED_FILE       = "/learning_log.1.bin";
 const int           MIN_ADJUSTMENTS_TO_LEARN        = 3;
 const unsigned long ADJUSTMENT_ANALYSIS_HOURS       = 24;
+const unsigned long LEARNING_LOG_MAX_BYTES          = 16 * 1024; // Rotate at this size; one older file is kept
+const int           LEARNING_LOG_BUFFER_RECORDS     = 32;  // RAM ring ahead of SPIFFS
+const int           LEARNING_LOG_FLUSH_RECORDS      = 8;   // Flush once this many are buffered...
+const unsigned long LEARNING_LOG_FLUSH_SECS         = 300; // ...or the oldest has waited this long
+const unsigned long LEARNING_ANALYSIS_BUDGET_US     = 2000; // Analyzer time per control pass
+
+// -- Control Trace Settings --
+const bool          TRACE_CAPTURE_ENABLED           = true;
+const char* const   TRACE_FILE                      = "/trace.bin";
+const char* const   TRACE_ROTATED_FILE              = "/trace.1.bin";
+const unsigned long TRACE_MAX_BYTES                 = 32 * 1024; // Rotate at this size; one older file is kept
+const int           TRACE_BUFFER_BYTES              = 512; // RAM buffer ahead of SPIFFS, flushed when full...
+const unsigned long TRACE_FLUSH_SECS                = 600; // ...or once the oldest record has waited this long
+
+// -- Event-Driven Scheduler Settings --
+const unsigned long SENSOR_POLL_INTERVAL_SECS       = 5;   // Threshold check while asleep; keep under the watchdog timeout
+const unsigned long MAX_CONTROL_SLEEP_SECS          = 300; // Run a full control pass at least this often
+
+// -- Sensor Acquisition Settings --
+const unsigned long SENSOR_SAMPLE_INTERVAL_SECS     = 2;   // Sensor task period
+const int           SENSOR_MEDIAN_WINDOW            = 3;   // Odd; a spike shorter than half the window never reaches control
+const float         SENSOR_EMA_TAU_SECS             = 30.0; // Smoothing for the rate of change
+const float         SENSOR_MAX_RATE_F_PER_MIN       = 2.0; // Faster indoor change is a sensor fault
+const unsigned long SENSOR_STUCK_MINS               = 120; // Identical raw indoor readings this long hold the outputs off until the reading moves
+const unsigned long SENSOR_STALE_SECS               = 30;  // No sample this long: the sensor task or bus has hung
+
+// -- Telemetry Settings --
+const int           TELEMETRY_RING_FRAMES           = 32;  // Power of two; frames beyond this are dropped and counted
+const unsigned long TELEMETRY_DRAIN_INTERVAL_MS     = 200;
+const bool          TELEMETRY_TEXT_OUTPUT           = false; // Human-readable status lines instead of binary frames
+const unsigned long TELEMETRY_PROBE_INTERVAL_SECS   = 900; // Latency histogram summaries, one frame per probe stage
+
+// -- Instrumentation --
+const unsigned long CPU_FREQ_MHZ                    = 160; // Cycle counter rate, for probe timings
+
+// -- Settings Persistence --
+const unsigned long SETTINGS_WRITE_BACK_MINS        = 15;  // Coalesce NVS writes; a changed setting is stored within this window
+const unsigned long WATCHDOG_TIMEOUT_SECS           = 10;
 
 // -- Time to Temperature (Smart Recovery) Settings --
 const bool          ENABLE_SMART_RECOVERY           = true;
 const int           MAX_RECOVERY_TIME_MINS          = 180;
+const int           MIN_RECOVERY_SAMPLES            = 3;   // Cycles in a bin before its rate is used without interpolation
+constexpr float     RECOVERY_LEAD_MARGIN            = 1.15; // Start this much earlier than the learned rate suggests
+
+// -- Multi-Zone Settings (zones.h) --
+const int           MAX_ZONES                       = 16;  // Per air handler
+const int           MAX_STAGES                      = 3;   // Heating or cooling stages per air handler
+const unsigned long STAGE_UP_DELAY_MINS             = 10;  // A stage that has run this long without satisfying calls the next
+constexpr float     STAGE_UP_ERROR_F                = 2.0; // Lead zone this far beyond the deadband per stage calls the next at once
+const int           MIN_OPEN_DAMPERS                = 1;   // Minimum airflow path while the air handler runs
+const unsigned long DAMPER_MIN_DWELL_SECS           = 120; // A damper stays open at least this long before closing
+
+// -- Thermal Model Settings (thermal_model.h) --
+const unsigned long THERMAL_MODEL_SAMPLE_SECS       = 300; // Integration interval per least-squares update
+constexpr float     THERMAL_MODEL_FORGETTING        = 0.998; // Per update: a memory of about 500 updates, under two days
+const int           THERMAL_MODEL_MIN_SAMPLES       = 12;  // Updates with the equipment running before its predictions count
+const int           THERMAL_MODEL_SEED_CONFIDENCE   = 70;  // Fill empty HvacPerformance bins from the model above this
+
+// -- Pressure Monitor Settings (pressure.h) --
+const bool          PRESSURE_MONITOR_ENABLED        = false; // A 4-20 mA duct pressure transmitter is fitted
+const int           PRESSURE_ADC_PIN                = 1;
+const uint32_t      PRESSURE_SHUNT_OHMS             = 150; // Loop sense resistor: 4-20 mA reads 0.6-3.0 V
+const int32_t       PRESSURE_RANGE_LOW_CENTIPA      = 0;     // Pressure at 4 mA, as set on the transmitter
+const int32_t       PRESSURE_RANGE_HIGH_CENTIPA     = 24884; // ...and at 20 mA: 1 inch WC
+const uint32_t      PRESSURE_OPEN_LOOP_UA           = 3600;  // NAMUR NE43: below this the loop is open or unpowered
+const uint32_t      PRESSURE_SHORTED_LOOP_UA        = 21000; // ...above this it is shorted
+const unsigned long PRESSURE_SAMPLE_INTERVAL_MS     = 250;
+const int           PRESSURE_DECIMATION             = 240; // Samples averaged per reading: one a minute
+const int           PRESSURE_QUEUE_READINGS         = 256; // Power of two; over four hours of readings through an outage
+const int           PRESSURE_BATCH_READINGS         = 15;  // Readings per upload...
+const unsigned long PRESSURE_BATCH_MAX_AGE_SECS     = 900; // ...or fewer once the oldest has waited this long
+const unsigned long PRESSURE_UPLOAD_POLL_MS         = 1000;
+const unsigned long PRESSURE_RETRY_MIN_SECS         = 5;   // Backoff after a failed upload, doubling...
+const unsigned long PRESSURE_RETRY_MAX_SECS         = 600; // ...up to this
+
+// -- Time Series Settings (timeseries.h) --
+const int           SERIES_MINUTE_SEGMENTS          = 7;   // Segment files per tier; the oldest is recycled, so one fewer is always kept whole
+const int           SERIES_MINUTE_SEGMENT_RECORDS   = 240; // Four hours a segment: a day of minutes
+const int           SERIES_HOUR_SEGMENTS            = 6;
+const int           SERIES_HOUR_SEGMENT_RECORDS     = 168; // A week a segment: five weeks of hours
+const int           SERIES_DAY_SEGMENTS             = 5;
+const int           SERIES_DAY_SEGMENT_RECORDS      = 92;  // A quarter a segment: a year of days
+const int           SERIES_FLUSH_RECORDS            = 16;  // Closed minutes held in RAM per append
+const unsigned long SERIES_MAX_GAP_SECS             = 900; // A longer pause between passes is a gap, not runtime
+const uint32_t      HEATER_INPUT_WATTS              = 18000; // Nameplate input, for energy estimates
+const uint32_t      COOLER_INPUT_WATTS              = 3500;
+const uint32_t      FAN_INPUT_WATTS                 = 400;
+const uint32_t      FRESH_AIR_INPUT_WATTS           = 10;  // Damper actuator
+const uint32_t      HUMIDIFIER_INPUT_WATTS          = 50;
+
+// -- Command Queue Settings (commands.h) --
+const int           COMMAND_QUEUE_DEPTH             = 16;  // Power of two; a full queue refuses commands
+constexpr float     HOLD_MIN_TARGET_F               = 45.0; // Setpoint holds and schedule entries outside this are rejected
+constexpr float     HOLD_MAX_TARGET_F               = 90.0;
 
 #endif // CONFIG_H
\ No newline at end of file
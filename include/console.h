@@ -0,0 +1,31 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+// Line-based serial console for queries from a connected terminal.
+// pollConsole() runs at the start of each control pass and consumes only the
+// bytes already received, so it never blocks; received bytes also wake the
+// control task so a command is answered without waiting out a long sleep.
+//
+//   probes          Latency histogram summary for each probe stage
+//   probes reset    Clear the histograms
+//   boot            Warm or cold start and boot-to-first-decision latency
+//   model           Thermal model parameters and the time to reach the target
+//   relays          Committed relay outputs, transitions per relay and interlock trips
+//   runtime [h]     Runtime, duty, starts and energy per relay over the last h hours (24)
+//   hold t [m]      Hold the target at t in the display unit for m minutes (0: to the next schedule change)
+//   resume          End a hold
+//   mode m          off, heat, cool or auto
+//   vacation on|off
+//   unlock          Clear a max-run lockout
+//   commands        Command queue counts, depth and submit-to-decision latency
+//   selftest        Run the self-test suite, then restart cold (host build only)
+//   help
+
+const int CONSOLE_LINE_MAX = 64;
+
+// Function Declarations
+void startConsole();
+void pollConsole();
+bool handleConsoleCommand(const char* line); // False if the command is unknown
+
+#endif // CONSOLE_H
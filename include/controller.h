@@ -0,0 +1,146 @@
+#ifndef CONTROLLER_H
+#define CONTROLLER_H
+
+#include <stdint.h>
+#include "config.h"
+#include "main.h"
+#include "recovery.h"
+#include "schedule.h"
+#include "thermal_model.h"
+
+// Bit n of a relay mask is GPIO n, so a mask maps directly onto the output register.
+#define RELAY_BIT(pin) ((uint16_t)(1u << (pin)))
+
+// Bit per (heat/cool, season) performance row, matching the persisted records.
+#define PERF_DIRTY_BIT(isHeating, season) ((uint8_t)(1u << ((isHeating) ? (season) : NUM_SEASONS + (season))))
+
+// Controller state for a batch of thermostats, stored struct-of-arrays: each
+// member points at `count` consecutive elements, one per instance, so a batch
+// is stepped field-by-field with the hot timers packed together in cache. The
+// device runs a batch of one; the host fleet simulator runs thousands.
+struct ControllerBatch {
+  int count = 0;
+
+  // -- Per-instance configuration --
+  SystemMode* systemMode;
+  TempUnit* tempUnit;
+  bool* vacationModeActive;
+  Schedule* programSchedule;
+  HvacPerformance* performance;
+
+  // -- Compiled schedule and its lookup cache --
+  CompiledSchedule* compiledSchedule;
+  ScheduleCursor* scheduleCursor;
+  bool* scheduleEdited; // programSchedule changed since it was compiled
+  RecoveryState* recovery; // Smart Recovery lookahead and learned-rate cache
+  ThermalModel* thermalModel; // Online RC model, fitted every pass
+
+  // -- Cycle protection timers --
+  ControlMillis* lastHeaterOnTime;
+  ControlMillis* lastHeaterOffTime;
+  ControlMillis* lastCoolerOnTime;
+  ControlMillis* lastCoolerOffTime;
+  ControlMillis* lastFanCycleTime;
+  bool* isFanCirculating;
+  bool* freshAirForHeating; // Which AUTO branch opened the economizer damper
+
+  // -- Performance learning for the cycle in progress --
+  CentiC* cycleStartTemp;
+  CentiC* cycleStartOutdoorTemp;
+  ControlMillis* cycleStartTime;
+  bool* cycleInProgress; // millis() may legitimately be 0 when a cycle starts
+
+  // -- Max-run safety lockout --
+  int* heaterMaxRunTriggers;
+  ControlMillis* firstHeaterMaxRunTriggerTime;
+  int* coolerMaxRunTriggers;
+  ControlMillis* firstCoolerMaxRunTriggerTime;
+  bool* systemLockedOut;
+
+  // -- Outputs --
+  uint16_t* relays;       // Shadow relay mask per instance; see relays.h
+  ThermostatState* state; // After the last stepThermostat() pass; see state_machine.h
+  uint8_t* performanceDirty; // PERF_DIRTY_BIT mask of learned rows awaiting persistence
+
+  // -- Shared per-tick inputs, set by the caller before each step --
+  ControlMillis now = 0;
+  int season = 0;
+  bool hardwareRelays = false; // commitRelays() drives the real pins from instance 0's mask
+};
+
+// Backing arrays for a batch of N controllers. Construct once; the batch
+// member holds pointers into this object, so it must not be copied or moved.
+template <int N>
+struct ControllerStorage {
+  SystemMode systemMode[N];
+  TempUnit tempUnit[N];
+  bool vacationModeActive[N] = {};
+  Schedule programSchedule[N];
+  HvacPerformance performance[N];
+  CompiledSchedule compiledSchedule[N];
+  ScheduleCursor scheduleCursor[N] = {};
+  bool scheduleEdited[N];
+  RecoveryState recovery[N] = {};
+  ThermalModel thermalModel[N] = {};
+
+  ControlMillis lastHeaterOnTime[N] = {};
+  ControlMillis lastHeaterOffTime[N] = {};
+  ControlMillis lastCoolerOnTime[N] = {};
+  ControlMillis lastCoolerOffTime[N] = {};
+  ControlMillis lastFanCycleTime[N] = {};
+  bool isFanCirculating[N] = {};
+  bool freshAirForHeating[N] = {};
+
+  CentiC cycleStartTemp[N] = {};
+  CentiC cycleStartOutdoorTemp[N] = {};
+  ControlMillis cycleStartTime[N] = {};
+  bool cycleInProgress[N] = {};
+
+  int heaterMaxRunTriggers[N] = {};
+  ControlMillis firstHeaterMaxRunTriggerTime[N] = {};
+  int coolerMaxRunTriggers[N] = {};
+  ControlMillis firstCoolerMaxRunTriggerTime[N] = {};
+  bool systemLockedOut[N] = {};
+
+  uint16_t relays[N] = {};
+  ThermostatState state[N] = {};
+  uint8_t performanceDirty[N] = {};
+
+  ControllerBatch batch;
+
+  explicit ControllerStorage(bool hardwareRelays = false) {
+    for (int i = 0; i < N; i++) { systemMode[i] = DEFAULT_SYSTEM_MODE; tempUnit[i] = DEFAULT_TEMP_UNIT; scheduleEdited[i] = true; }
+    batch.count = N;
+    batch.systemMode = systemMode; batch.tempUnit = tempUnit;
+    batch.vacationModeActive = vacationModeActive;
+    batch.programSchedule = programSchedule; batch.performance = performance;
+    batch.compiledSchedule = compiledSchedule; batch.scheduleCursor = scheduleCursor; batch.scheduleEdited = scheduleEdited;
+    batch.recovery = recovery; batch.thermalModel = thermalModel;
+    batch.lastHeaterOnTime = lastHeaterOnTime; batch.lastHeaterOffTime = lastHeaterOffTime;
+    batch.lastCoolerOnTime = lastCoolerOnTime; batch.lastCoolerOffTime = lastCoolerOffTime;
+    batch.lastFanCycleTime = lastFanCycleTime; batch.isFanCirculating = isFanCirculating;
+    batch.freshAirForHeating = freshAirForHeating;
+    batch.cycleStartTemp = cycleStartTemp; batch.cycleStartOutdoorTemp = cycleStartOutdoorTemp;
+    batch.cycleStartTime = cycleStartTime; batch.cycleInProgress = cycleInProgress;
+    batch.heaterMaxRunTriggers = heaterMaxRunTriggers; batch.firstHeaterMaxRunTriggerTime = firstHeaterMaxRunTriggerTime;
+    batch.coolerMaxRunTriggers = coolerMaxRunTriggers; batch.firstCoolerMaxRunTriggerTime = firstCoolerMaxRunTriggerTime;
+    batch.systemLockedOut = systemLockedOut;
+    batch.relays = relays; batch.state = state; batch.performanceDirty = performanceDirty;
+    batch.hardwareRelays = hardwareRelays;
+  }
+  ControllerStorage(const ControllerStorage&) = delete;
+  ControllerStorage& operator=(const ControllerStorage&) = delete;
+};
+
+// Relay access for instance i. Both work on the shadow mask only, the device
+// batch included; commitRelays() (relays.h) puts it on the pins once per pass.
+inline bool relayOn(const ControllerBatch& b, int i, int pin) { return (b.relays[i] & RELAY_BIT(pin)) != 0; }
+
+inline void setRelay(ControllerBatch& b, int i, int pin, bool on) {
+  if (on) b.relays[i] |= RELAY_BIT(pin); else b.relays[i] &= ~RELAY_BIT(pin);
+}
+
+// The controller run by setup()/loop(): a batch of one bound to the real relays.
+extern ControllerBatch& deviceController;
+
+#endif // CONTROLLER_H
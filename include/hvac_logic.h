@@ -2,13 +2,55 @@
 #define HVAC_LOGIC_H
 
 #include "config.h"
+#include "controller.h"
+#include "utils.h"
+
+// Convert minutes to milliseconds for internal use
+const unsigned long MIN_HEATER_RUN_TIME_MS = MIN_HEATER_RUN_TIME_MINS * 60 * 1000;
+const unsigned long MIN_HEATER_OFF_TIME_MS = MIN_HEATER_OFF_TIME_MINS * 60 * 1000;
+const unsigned long MAX_HEATER_RUN_TIME_MS = MAX_HEATER_RUN_TIME_MINS * 60 * 1000;
+const unsigned long MIN_COOLER_RUN_TIME_MS = MIN_COOLER_RUN_TIME_MINS * 60 * 1000;
+const unsigned long MIN_COOLER_OFF_TIME_MS = MIN_COOLER_OFF_TIME_MINS * 60 * 1000;
+const unsigned long MAX_COOLER_RUN_TIME_MS = MAX_COOLER_RUN_TIME_MINS * 60 * 1000;
+const unsigned long FAN_CIRCULATE_ON_TIME_MS = FAN_CIRCULATE_ON_TIME_MINS * 60 * 1000;
+const unsigned long FAN_CIRCULATE_OFF_TIME_MS = FAN_CIRCULATE_OFF_TIME_MINS * 60 * 1000;
+const unsigned long MAX_RUN_LOCKOUT_MS = MAX_RUN_LOCKOUT_HOURS * 60 * 60 * 1000;
+
+// Thresholds in CentiC, fixed at compile time. The deadband and fresh-air
+// differential are configured in degrees of the display unit.
+constexpr CentiC temperatureDeadband(TempUnit unit) { return centiCDeltaFrom(TEMPERATURE_DEADBAND_F, unit); }
+constexpr CentiC freshAirDifferential(TempUnit unit) { return centiCDeltaFrom(FRESH_AIR_TEMP_DIFFERENTIAL_F, unit); }
+constexpr CentiRH HUMIDITY_TARGET_CENTI = centiRH(HUMIDITY_TARGET);
+constexpr CentiRH HUMIDITY_DEADBAND_CENTI = centiRH(HUMIDITY_DEADBAND);
 
 // Function Declarations
+// Single-thermostat API: operates on deviceController using the HAL clock and relays.
 void initialize_logic_timers();
-void controlTemperature(float tempC, float targetTempC, float outdoorTempC);
+void controlTemperature(CentiC temp, CentiC target, CentiC outdoor);
 void controlFan(FanMode fanMode);
-void controlHumidity(float humidity, float indoorTempC, float outdoorTempC);
+void controlHumidity(CentiRH humidity, CentiC indoor, CentiC outdoor);
 void updatePerformanceData(bool isHeating);
-int getPerformanceBin(float tempF);
+int getPerformanceBin(CentiC outdoor);
+float calculateMaxHumidityForWindow(float indoorTempC, float outdoorTempC);
+
+// Batch API: steps instance i of a batch. The caller sets b.now and b.season
+// for the tick and persists the rows flagged in each instance's performanceDirty mask.
+void initialize_logic_timers(ControllerBatch& b, int i, ControlMillis now);
+void controlTemperature(ControllerBatch& b, int i, CentiC temp, CentiC target, CentiC outdoor);
+void controlFan(ControllerBatch& b, int i, FanMode fanMode);
+void controlHumidity(ControllerBatch& b, int i, CentiRH humidity, CentiC indoor, CentiC outdoor);
+void updatePerformanceData(ControllerBatch& b, int i, bool isHeating, CentiC current);
+
+// controlTemperature() in parts, for the multi-zone engine (zones.h), which
+// decides heating and cooling on different lead zones, and for the state
+// machine (state_machine.h). Both halves decide against the relay states from
+// the start of the pass.
+struct RelaySnapshot { bool heating, cooling, freshAir; };
+bool enforceLockout(ControllerBatch& b, int i); // True if locked out; heat, cool and fresh air are then off
+void countMaxRunTrip(ControllerBatch& b, int i, bool isHeating); // MAX_RUN_TRIGGER_COUNT within MAX_RUN_LOCKOUT_HOURS locks out
+RelaySnapshot relaySnapshot(const ControllerBatch& b, int i);
+bool releaseStage(ControllerBatch& b, int i, const RelaySnapshot& pass, CentiC temp); // True if it stopped a stage the mode no longer calls for; the pass then ends
+void controlHeating(ControllerBatch& b, int i, const RelaySnapshot& pass, CentiC temp, CentiC target, CentiC outdoor);
+void controlCooling(ControllerBatch& b, int i, const RelaySnapshot& pass, CentiC temp, CentiC target, CentiC outdoor);
 
-#endif // HVAC_LOGIC_H
\ No newline at end of file
+#endif // HVAC_LOGIC_H
@@ -9,8 +9,9 @@ extern unsigned long g_mockMillis;
 extern TimeInfo g_mockTime;
 extern float g_mockIndoorTempF;
 extern float g_mockOutdoorTempF;
+extern float g_mockHumidity;
 extern bool g_mockRelayStates[10];
 
-void runTests();
+int runTests(); // Returns the number of failed checks
 
 #endif // HVAC_TESTS_H
\ No newline at end of file
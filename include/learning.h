@@ -1,8 +1,69 @@
 #ifndef LEARNING_H
 #define LEARNING_H
 
+#include <stdint.h>
+#include "config.h"
+
+// Manual adjustments are logged as fixed-size binary records. They collect in
+// a RAM ring and are appended to SPIFFS in batches; the log rotates into one
+// older file at LEARNING_LOG_MAX_BYTES. The analyzer reads forward from a
+// persisted checkpoint, a bounded slice per call, folding each record into a
+// per-(dayOfWeek, hour) aggregate, so no record is ever read twice.
+
+struct LearningRecord {
+  uint32_t minuteOfYear; // ((dayOfYear * 24) + hour) * 60 + minute
+  int16_t targetDeciF;   // New target in 0.1 F
+  uint8_t dayOfWeek;
+  uint8_t hour;
+};
+
+const uint32_t LEARNING_LOG_MAGIC = 0x474C5648; // "HVLG"
+const uint32_t MINUTES_PER_YEAR = 365 * 24 * 60;  // minuteOfYear wraps here
+
+struct LearningLogHeader {
+  uint32_t magic;
+  uint32_t generation; // Bumped on every rotation
+};
+
+// Adjustments seen for one (dayOfWeek, hour) in the current analysis window.
+struct AdjustmentBucket {
+  uint32_t windowStartMinute;
+  int32_t sumDeciF;
+  uint16_t count;
+  uint16_t reserved;
+};
+
+// Where the analyzer resumes, plus its aggregates; persisted as one record.
+struct LearningCheckpoint {
+  uint32_t generation; // Log file the offset refers to
+  uint32_t offset;
+  AdjustmentBucket buckets[7][24];
+};
+
+struct ScheduleProposal {
+  uint8_t dayOfWeek;
+  uint8_t hour;
+  uint16_t adjustments;
+  float targetTempF;
+};
+
+struct LearningStats {
+  unsigned long recordsLogged, recordsDropped, flushes, bytesFlushed, rotations;
+  unsigned long recordsAnalyzed, recordsSkipped, analyzerPasses, budgetExhausted, proposals;
+};
+
+const int MAX_SCHEDULE_PROPOSALS = 8;
+
+extern LearningCheckpoint learningCheckpoint;
+extern LearningStats learningStats;
+extern ScheduleProposal scheduleProposals[MAX_SCHEDULE_PROPOSALS]; // Newest last
+extern int scheduleProposalCount;
+
+// Function Declarations
 void initialize_learning();
 void log_manual_adjustment(float newTempF);
+bool flushLearningLog();
 void analyze_and_learn_if_needed();
+uint32_t minuteOfYear(const TimeInfo& t); // 0 to MINUTES_PER_YEAR - 1, ignoring leap days
 
-#endif // LEARNING_H
\ No newline at end of file
+#endif // LEARNING_H
@@ -2,20 +2,37 @@
 #define MAIN_H
 
 #include "config.h" // For TimeInfo struct
+#include "schedule.h"
+#include "sensors.h"
 
 // Global Variables needed by other files
-extern HvacPerformance performance;
-extern bool systemLockedOut;
+// (references into deviceController's instance 0, see controller.h)
+extern Schedule& programSchedule;
+extern HvacPerformance& performance;
+extern bool& systemLockedOut;
+extern TempUnit& tempUnit;
+extern SystemMode& systemMode;
+extern bool& vacationModeActive;
+extern bool systemInFaultState; // Latched by a sensor fault until a manual reset
 
 // Function Declarations needed by other files
 TimeInfo getCurrentTime();
-float readTemperature();
-float readOutdoorTemperature();
+float readTemperature();         // Blocking drivers, for the sensor task;
+float readOutdoorTemperature();  // the control path uses sensorSnapshot()
 float readHumidity();
+bool validateSensorReadings(const SensorSnapshot& sensors, bool report = true); // False on a hard fault
+bool latchSensorFault(const SensorSnapshot& sensors);       // True if it latched one and dropped the outputs
+bool holdForStuckSensor(const SensorSnapshot& sensors);     // True while a stuck reading holds the outputs off
 unsigned long currentTime();
-void writeRelay(int pin, bool value);
-bool readRelay(int pin);
-void saveSettings();
+void writeRelays(uint16_t mask, uint16_t changed); // The changed bits of mask, in one GPIO register write
+void feedWatchdog();
+unsigned long watchdogFeedAge();
+void getCurrentScheduleSettings();
 int getCurrentSeason();
+int seasonForMonth(int month);
+// Reference linear scan of the raw Schedule, kept for the tests and benchmark;
+// the control loop uses the compiled timeline in schedule.h.
+const ScheduleEntry& lookupScheduleEntry(const Schedule& schedule, bool vacation, const TimeInfo& now);
+unsigned long secondsUntilNextScheduleChange(const Schedule& schedule, bool vacation, const TimeInfo& now);
 
 #endif // MAIN_H
\ No newline at end of file
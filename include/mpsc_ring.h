@@ -0,0 +1,56 @@
+#ifndef MPSC_RING_H
+#define MPSC_RING_H
+
+#include <atomic>
+#include <stdint.h>
+
+// Bounded lock-free ring for any number of producers and one consumer. Each
+// slot carries a sequence number: a producer claims the next index with a
+// compare-and-swap on the head, fills the slot, then publishes it by storing
+// index + 1 in its sequence; the consumer frees it by storing index + N. A
+// producer preempted between claim and publish holds back the slots behind it
+// until it resumes, but never blocks another producer's claim.
+template <typename T, int N>
+class MpscRing {
+  static_assert((N & (N - 1)) == 0, "MpscRing size must be a power of two");
+public:
+  MpscRing() { for (uint32_t i = 0; i < (uint32_t)N; i++) slots_[i].sequence.store(i, std::memory_order_relaxed); }
+
+  bool push(const T& item) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot& slot = slots_[head & (N - 1)];
+      int32_t lag = (int32_t)(slot.sequence.load(std::memory_order_acquire) - head);
+      if (lag < 0) return false; // Still holds the item from N pushes ago: full
+      if (lag > 0) { head = head_.load(std::memory_order_relaxed); continue; } // Another producer claimed it
+      if (head_.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) {
+        slot.item = item;
+        slot.sequence.store(head + 1, std::memory_order_release);
+        return true;
+      }
+    }
+  }
+
+  bool pop(T* item) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    Slot& slot = slots_[tail & (N - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != tail + 1) return false; // Empty, or not yet published
+    *item = slot.item;
+    slot.sequence.store(tail + N, std::memory_order_release);
+    tail_.store(tail + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Claimed and not yet popped; a snapshot, exact only on the consumer.
+  uint32_t depth() const { return head_.load(std::memory_order_relaxed) - tail_.load(std::memory_order_relaxed); }
+
+private:
+  struct Slot {
+    std::atomic<uint32_t> sequence;
+    T item;
+  };
+  Slot slots_[N];
+  std::atomic<uint32_t> head_{0}, tail_{0};
+};
+
+#endif // MPSC_RING_H
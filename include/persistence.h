@@ -0,0 +1,63 @@
+#ifndef PERSISTENCE_H
+#define PERSISTENCE_H
+
+#include <stdint.h>
+#include "config.h"
+
+// Dirty-tracked, write-back settings persistence. Settings live in RAM; changing
+// one marks only its NVS record dirty. Dirty records are written together, with
+// a single nvs_commit, once the oldest pending change reaches the write-back
+// deadline, or at once through flushSettings(). Performance data is split into
+// one record per (heat/cool, season), so a learned cycle rewrites 32 bytes
+// instead of the whole table.
+
+enum PersistRecord {
+  REC_SCHEDULE, REC_TEMP_UNIT, REC_SYSTEM_MODE, REC_VACATION,
+  REC_LEARNING,                                 // Analyzer checkpoint and aggregates, see learning.h
+  REC_PERF_HEAT_0,                              // One per season, REC_PERF_HEAT_0 + season
+  REC_PERF_COOL_0 = REC_PERF_HEAT_0 + NUM_SEASONS,
+  NUM_PERSIST_RECORDS = REC_PERF_COOL_0 + NUM_SEASONS
+};
+
+// One (heat/cool, season) row of the performance table, as stored in NVS under
+// "perfH0".."perfH3" and "perfC0".."perfC3". host/tools/fleet_analytics reads
+// pulled rows with this layout too.
+struct PerfRecord {
+  uint16_t rate[NUM_PERFORMANCE_BINS]; // CentiC per hour
+  uint16_t samples[NUM_PERFORMANCE_BINS];
+};
+
+// The whole-table "perf" blob written before per-row records, rates in F per
+// hour; loadSettings() migrates it.
+struct LegacyPerformance {
+  float heatRate[NUM_SEASONS][NUM_PERFORMANCE_BINS]; int heatSamples[NUM_SEASONS][NUM_PERFORMANCE_BINS];
+  float coolRate[NUM_SEASONS][NUM_PERFORMANCE_BINS]; int coolSamples[NUM_SEASONS][NUM_PERFORMANCE_BINS];
+};
+
+const unsigned long SETTINGS_WRITE_BACK_MS = SETTINGS_WRITE_BACK_MINS * 60 * 1000;
+const unsigned long WATCHDOG_FLUSH_MARGIN_MS = 3000; // Emergency flush this long before the watchdog fires
+
+struct PersistenceStats {
+  unsigned long marks;          // markSettingsDirty() calls
+  unsigned long coalesced;      // ...that hit a record already pending
+  unsigned long flushes;        // Flushes that committed at least one record
+  unsigned long emergencyFlushes; // Of those, forced by shutdown or a stalled watchdog
+  unsigned long recordsWritten;
+  unsigned long bytesWritten;
+  unsigned long lastCommitUs, maxCommitUs, totalCommitUs; // nvs_commit latency
+  unsigned long errors;
+};
+
+extern PersistenceStats persistenceStats;
+
+// Function Declarations
+void loadSettings();
+void saveSettings();                        // Mark every record dirty and flush now
+void markSettingsDirty(PersistRecord record);
+void markPerformanceDirty(uint8_t perfDirtyMask); // PERF_DIRTY_BIT() mask, see controller.h
+bool flushSettings();                       // Write pending records now; false on NVS error
+void persistenceTick();                     // Flush if the write-back deadline has passed
+bool settingsDirty();
+void installPersistenceResetHooks();        // Device: flush on esp_restart() and before a watchdog reset
+
+#endif // PERSISTENCE_H
@@ -0,0 +1,79 @@
+#ifndef PRESSURE_H
+#define PRESSURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+
+// Duct pressure monitor for a 4-20 mA transmitter (VERIS PX3PXX01 or any
+// two-wire loop device). A sampler task reads the loop current through a
+// pluggable source every PRESSURE_SAMPLE_INTERVAL_MS and folds it into a
+// boxcar decimator: every PRESSURE_DECIMATION samples become one reading, the
+// integer mean of the in-range samples scaled onto the configured range.
+// Samples outside the NAMUR NE43 band (under 3.6 mA: open loop or no supply;
+// over 21 mA: shorted loop) are left out of the mean, and a window that is
+// mostly out of band becomes a fault reading instead of a pressure.
+//
+// Readings go through a lock-free ring (store) to an uploader task (forward),
+// which sends them in batches of PRESSURE_BATCH_READINGS, or sooner once the
+// oldest has waited PRESSURE_BATCH_MAX_AGE_SECS, through a pluggable
+// transport. A batch that is not acknowledged is resent unchanged, with the
+// same sequence number, after a backoff that doubles from
+// PRESSURE_RETRY_MIN_SECS to PRESSURE_RETRY_MAX_SECS; sampling never waits on
+// the network. The ring holds PRESSURE_QUEUE_READINGS through an outage; past
+// that, new readings are dropped and counted. Under g_isTesting there are no
+// tasks: samplePressure() and uploadPressure() are called directly.
+
+typedef int32_t CentiPa; // Hundredths of a pascal
+
+const uint32_t PRESSURE_LOOP_ZERO_UA = 4000, PRESSURE_LOOP_SPAN_UA = 16000;
+
+enum PressureStatus : uint8_t { PRESSURE_OK, PRESSURE_OPEN_LOOP, PRESSURE_SHORTED_LOOP };
+
+struct PressureReading {
+  uint32_t timestampMs;   // currentTime() at the end of the window
+  CentiPa pressure;       // 0 unless status is PRESSURE_OK
+  uint16_t loopMicroAmps; // Mean over the window's in-band samples, or all of them on a fault
+  uint16_t samples;       // In-band samples averaged
+  PressureStatus status;
+};
+
+struct PressureDecimator {
+  uint32_t sum, sumAll;   // Microamps: in-band samples, all samples
+  uint16_t count, good, open, shorted;
+};
+
+// Loop current in microamps, or a negative value if the source failed.
+typedef int32_t (*PressureSource)();
+// Sends one batch; true once the far end has acknowledged it. May block.
+typedef bool (*PressureTransport)(const char* payload, size_t len);
+
+// A batch is JSON: {"seq":N,"now":MS,"r":[[MS,CENTIPA,UA,STATUS],...]}. "now"
+// is the sender's clock when the batch was sealed, so the far end can turn
+// reading timestamps into wall time; seq repeats on a resend.
+const size_t PRESSURE_MAX_PAYLOAD = 40 + PRESSURE_BATCH_READINGS * 44;
+
+struct PressureStats {
+  unsigned long samples, sourceErrors, readings, openLoop, shortedLoop, dropped;
+  unsigned long batches, readingsSent, failures, bytesSent;
+  unsigned long firstSampleAt, lastSampleAt;
+};
+
+extern PressureStats pressureStats;
+
+// Function Declarations
+PressureStatus classifyLoopCurrent(uint32_t microAmps);
+CentiPa loopCurrentToCentiPa(uint32_t microAmps); // Linear over PRESSURE_RANGE_*, not clamped
+// Adds one sample; true when it completes a window, which is then in out.
+bool decimatePressureSample(PressureDecimator& d, uint32_t microAmps, uint32_t at, PressureReading& out);
+size_t encodePressureBatch(const PressureReading* readings, int count, uint32_t sequence, uint32_t now, char* out, size_t size);
+
+void startPressureMonitor();  // Starts the sampler and uploader tasks (or resets the virtual ones)
+void samplePressure(unsigned long now);         // Sampler step: one source read
+size_t uploadPressure(unsigned long now);       // Uploader step; returns readings acknowledged
+void setPressureSource(PressureSource source);  // Default: analogReadMilliVolts() over PRESSURE_SHUNT_OHMS
+void setPressureTransport(PressureTransport transport); // Default: none, readings wait in the queue
+float pressureSampleRateHz();                   // Measured over the samples taken so far
+size_t pressureMemoryBytes();                   // Static RAM held by the monitor
+
+#endif // PRESSURE_H
@@ -0,0 +1,86 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+#include <algorithm>
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "esp_cpu.h"
+
+// Hot-path latency probes. A probe reads the CPU cycle counter around a stage
+// of the control pass and adds the elapsed cycles to that stage's histogram:
+// count, min, max, total and 32 log2 buckets (bucket b holds 2^(b-1) to
+// 2^b - 1 cycles). Recording is a few adds, from the control task only.
+// Build with -DHVAC_PROBES=0 to compile every probe out.
+
+#ifndef HVAC_PROBES
+#define HVAC_PROBES 1
+#endif
+
+enum ProbeStage {
+  PROBE_LOOP,              // Whole control pass, sleep excluded
+  PROBE_SENSORS, PROBE_SCHEDULE, PROBE_RECOVERY,
+  PROBE_CONTROL_TEMP, PROBE_CONTROL_HUMIDITY, PROBE_CONTROL_FAN,
+  PROBE_TELEMETRY, PROBE_LEARNING, PROBE_PERSISTENCE,
+  PROBE_NVS_COMMIT,        // Inside PROBE_PERSISTENCE when a flush is due
+  PROBE_PLAN_WAKE,
+  PROBE_THERMAL_MODEL,
+  PROBE_TRACE,
+  PROBE_RELAY_COMMIT,
+  PROBE_SERIES,
+  PROBE_COMMANDS,          // Draining and applying queued commands
+  PROBE_COMMAND_LATENCY,   // Not a stage: submit to the relay commit that acted on it, per command
+  NUM_PROBES
+};
+
+const int PROBE_BUCKETS = 32;
+const uint32_t PROBE_CYCLES_PER_US = CPU_FREQ_MHZ;
+
+struct ProbeHistogram {
+  uint32_t count;
+  uint32_t minCycles, maxCycles;
+  uint64_t totalCycles;
+  uint32_t buckets[PROBE_BUCKETS];
+};
+
+extern ProbeHistogram probeHistograms[NUM_PROBES];
+
+// Function Declarations
+const char* probeName(ProbeStage stage);
+void resetProbes();
+uint32_t probePercentileUs(const ProbeHistogram& h, int percent); // Upper bound of the bucket holding it
+int formatProbeLine(ProbeStage stage, char* out, size_t size);    // One report line, no newline
+
+inline int probeBucket(uint32_t cycles) { return cycles ? 32 - __builtin_clz(cycles) : 0; }
+
+#if HVAC_PROBES
+
+inline void recordProbe(ProbeStage stage, uint32_t cycles) {
+  ProbeHistogram& h = probeHistograms[stage];
+  if (h.count == 0 || cycles < h.minCycles) h.minCycles = cycles;
+  if (cycles > h.maxCycles) h.maxCycles = cycles;
+  h.count++;
+  h.totalCycles += cycles;
+  h.buckets[std::min(probeBucket(cycles), PROBE_BUCKETS - 1)]++;
+}
+
+inline uint32_t probeStart() { return esp_cpu_get_cycle_count(); }
+inline void probeStop(ProbeStage stage, uint32_t start) { recordProbe(stage, esp_cpu_get_cycle_count() - start); }
+
+struct ScopedProbe {
+  ProbeStage stage;
+  uint32_t start;
+  explicit ScopedProbe(ProbeStage s) : stage(s), start(esp_cpu_get_cycle_count()) {}
+  ~ScopedProbe() { probeStop(stage, start); }
+};
+#define PROBE_CONCAT_(a, b) a##b
+#define PROBE_CONCAT(a, b) PROBE_CONCAT_(a, b)
+#define PROBE_SCOPE(stage) ScopedProbe PROBE_CONCAT(probe_, __LINE__)(stage)
+#else
+inline void recordProbe(ProbeStage, uint32_t) {}
+inline uint32_t probeStart() { return 0; }
+inline void probeStop(ProbeStage, uint32_t) {}
+#define PROBE_SCOPE(stage) do {} while (0)
+#endif
+
+#endif // PROBES_H
@@ -0,0 +1,38 @@
+#ifndef PSYCHROMETRICS_H
+#define PSYCHROMETRICS_H
+
+#include <stdint.h>
+
+// Integer psychrometric kernel. Saturation vapour pressure (Magnus, a = 17.625,
+// b = 243.04 C, 6.1094 hPa) is tabulated at compile time every 0.2 C from
+// -50 C to +60 C and read back by linear interpolation, so a control pass does
+// no soft-float exp(). Temperatures are hundredths of a degree Celsius,
+// relative humidity hundredths of a percent; inputs outside the table are
+// clamped to its ends.
+//
+// Error against the double-precision Magnus formula, over the table range
+// (checked by the self-tests and the sweep in hvac_psychro_bench):
+//   saturationVapourPressure        < 0.01 % relative
+//   maxHumidityForWindow            < 0.02 %RH
+//   dewPoint                        < 0.01 C
+//   absoluteHumidity                < 0.1 % relative above 1 g/m3 (whole mg below)
+//   calculateMaxHumidityForWindow() < 0.05 %RH, mostly from rounding float inputs to 0.01 C
+
+const int32_t PSYCHRO_MIN_CENTI_C = -5000;
+const int32_t PSYCHRO_MAX_CENTI_C = 6000;
+const int32_t PSYCHRO_STEP_CENTI_C = 20;
+const int PSYCHRO_TABLE_SIZE = (PSYCHRO_MAX_CENTI_C - PSYCHRO_MIN_CENTI_C) / PSYCHRO_STEP_CENTI_C + 1;
+const int PSYCHRO_SVP_FRAC_BITS = 20; // Table entries are hPa in Q20
+
+int32_t toCentiC(float tempC);
+uint32_t saturationVapourPressure(int32_t centiC); // hPa, Q20
+int32_t dewPoint(int32_t centiC, int32_t rhCenti); // Centi-C
+uint32_t absoluteHumidity(int32_t centiC, int32_t rhCenti); // mg/m3
+// Highest indoor RH that keeps the window glass, estimated from the outdoor
+// temperature and WINDOW_EFFICIENCY_FACTOR, 2 C above its dew point, limited to 10..95 %RH.
+int32_t maxHumidityForWindow(int32_t indoorCentiC, int32_t outdoorCentiC); // Centi-%RH
+
+// The original double-precision formula, kept as the reference for the tests and the benchmark.
+double referenceMaxHumidityForWindow(double indoorTempC, double outdoorTempC);
+
+#endif // PSYCHROMETRICS_H
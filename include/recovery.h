@@ -0,0 +1,56 @@
+#ifndef RECOVERY_H
+#define RECOVERY_H
+
+#include <stdint.h>
+#include "config.h"
+
+// Time-to-temperature (Smart Recovery). Before a schedule transition that
+// raises the heating target or lowers the cooling target, the controller
+// switches to the upcoming target early enough to reach it at the scheduled
+// minute. Lead time is the remaining temperature change divided by the rate
+// learned in HvacPerformance for this season and outdoor bin. The next target
+// change is cached per schedule cursor, and the learned rate per (season, bin,
+// direction), so a pass normally costs a division and a compare.
+
+struct ControllerBatch;
+
+struct RecoveryState {
+  // -- Next target change, cached until the schedule cursor moves --
+  bool nextValid;
+  bool hasNext;
+  ControlMillis nextKey;      // Cursor validUntil the lookahead was computed for
+  ControlMillis nextChangeAt; // Controller time of the transition
+  CentiC nextTarget;
+
+  // -- Learned rate, cached per (season, outdoor bin, direction) --
+  bool rateValid;
+  int rateSeason, rateBin;
+  bool rateHeating;
+  int32_t ratePerHour;  // CentiC per hour
+
+  // -- Outputs of the last pass --
+  bool active;          // Latched until the transition arrives
+  bool startPlanned;    // startAt is meaningful
+  ControlMillis startAt;
+  unsigned long leadSecs;
+};
+
+struct RecoveryStats {
+  unsigned long lookaheads, rateEstimates, recoveries;
+};
+
+extern bool smartRecoveryEnabled; // Starts as ENABLE_SMART_RECOVERY
+extern RecoveryStats recoveryStats;
+
+// Function Declarations
+int32_t estimateRecoveryRate(const HvacPerformance& perf, int season, int bin, bool heating); // CentiC/hour, 0 without data
+void invalidateRecovery(ControllerBatch& b, int i);
+
+// Batch API: returns the target to control to this pass. b.now and b.season
+// must be set, and the schedule cursor current.
+CentiC planRecovery(ControllerBatch& b, int i, const TimeInfo& now, CentiC current, CentiC outdoor, CentiC scheduledTarget);
+
+// Single-thermostat API on deviceController; a no-op while smartRecoveryEnabled is false.
+CentiC planRecovery(const TimeInfo& now, CentiC current, CentiC outdoor, CentiC scheduledTarget);
+
+#endif // RECOVERY_H
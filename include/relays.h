@@ -0,0 +1,51 @@
+#ifndef RELAYS_H
+#define RELAYS_H
+
+#include <stdint.h>
+#include "config.h"
+
+// Relay output commit. The control routines read and change only the shadow
+// mask in ControllerBatch::relays (relayOn()/setRelay() in controller.h),
+// never the pins, so a pass can turn the economizer on and the heater off in
+// either order without the outputs ever showing the step in between. Once the
+// pass has decided, commitRelays() checks the shadow against the interlocks
+// and, for the device, writes every changed relay in one store to the GPIO
+// output register and counts each relay's transitions for wear tracking.
+//
+// The interlocks back up the control logic rather than replace it; a trip
+// means a decision went wrong and is counted. Heater and cooler together
+// turns both off, and the heater, cooler or economizer without the fan turns
+// the fan on. The corrected mask is written back to the shadow, so the next
+// pass and the warm-start state see what was driven.
+
+struct ControllerBatch;
+
+const int RELAY_PIN_LIMIT = 16; // Relay masks are 16 bits: pins 0..15
+const uint16_t RELAY_OUTPUTS = (1u << HEATER_RELAY_PIN) | (1u << COOLER_RELAY_PIN) | (1u << FAN_RELAY_PIN) |
+                               (1u << FRESH_AIR_RELAY_PIN) | (1u << HUMIDITY_RELAY_PIN);
+
+enum RelayInterlock : uint8_t {
+  INTERLOCK_HEAT_AND_COOL = 1 << 0, // Both dropped
+  INTERLOCK_FAN_FORCED    = 1 << 1  // Heat, cool or fresh air without the fan
+};
+
+struct RelayStats {
+  unsigned long commits, writes;            // Passes committed, register writes issued
+  unsigned long heatCoolTrips, fanTrips;    // Interlock corrections
+  unsigned long transitions[RELAY_PIN_LIMIT]; // Per relay pin, since boot
+};
+
+extern RelayStats relayStats;
+
+// Function Declarations
+uint16_t applyRelayInterlocks(uint16_t mask, uint8_t* tripped); // tripped: RelayInterlock bits, may be null
+
+// Batch API: validates instance i's shadow in place; the device batch also drives the pins.
+uint8_t commitRelays(ControllerBatch& b, int i); // Returns the interlocks that tripped
+
+// Device API on deviceController.
+void initialize_relays(); // At boot: the pins' levels are unknown, so the first commit writes every relay
+uint8_t commitRelays();
+uint16_t committedRelays(); // The mask last written to the pins
+
+#endif // RELAYS_H
@@ -0,0 +1,70 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <stdint.h>
+#include "config.h"
+
+// Compiled form of a Schedule: for each of the seven day programs (override,
+// else weekday/weekend) a sorted run of transitions starting at midnight,
+// where the previous date's last entry carries over until the first entry,
+// stored back to back as one week-long list. An hour index makes a lookup a
+// table read plus a step over the few transitions inside that hour, and every
+// lookup also reports how long its answer stays valid, so callers can cache it.
+
+const int MAX_DAY_TRANSITIONS = MAX_DAY_ENTRIES + 1; // Entries plus the midnight start
+const int MAX_WEEK_TRANSITIONS = 7 * MAX_DAY_TRANSITIONS;
+const unsigned long NO_SCHEDULE_CHANGE = 0xFFFFFFFFUL;
+
+struct ControllerBatch;
+
+struct ScheduleTransition {
+  uint16_t startMinute; // Minutes after midnight
+  bool carried;         // Midnight segment before the day's first entry: the previous date's last entry applies
+  ScheduleEntry entry;
+};
+
+struct CompiledSchedule {
+  ScheduleTransition transitions[MAX_WEEK_TRANSITIONS];
+  uint8_t dayStart[8];     // Program day d is transitions[dayStart[d] .. dayStart[d + 1])
+  uint8_t hourIndex[7][24]; // Transition active at hh:00 on each program day
+  uint32_t exceptionDays[12]; // Bit d-1 set if month/day has an exception
+  ScheduleException exceptions[MAX_SCHEDULE_EXCEPTIONS];
+  int exceptionCount;
+  ScheduleEntry vacation;
+};
+
+struct ScheduleLookup {
+  const ScheduleEntry* entry;
+  unsigned long secondsValid; // Until the next transition, or NO_SCHEDULE_CHANGE
+};
+
+struct ScheduleChange {
+  const ScheduleEntry* entry;
+  unsigned long secondsUntil;
+};
+
+// Per-instance cache of the last lookup, see activeScheduleEntry().
+struct ScheduleCursor {
+  const ScheduleEntry* entry; // Null when the cursor must be recomputed
+  ControlMillis validUntil;   // Controller time at which the entry may change
+  bool expires;
+  bool vacation;              // vacationModeActive the entry was looked up for
+};
+
+// Function Declarations
+void compileSchedule(const Schedule& schedule, CompiledSchedule& out);
+int programDayFor(const CompiledSchedule& cs, const TimeInfo& now);
+ScheduleLookup lookupCompiledSchedule(const CompiledSchedule& cs, bool vacation, const TimeInfo& now);
+// The first transition within horizonSecs that changes the target temperature.
+bool findNextTargetChange(const CompiledSchedule& cs, const TimeInfo& now, unsigned long horizonSecs, ScheduleChange* out);
+TimeInfo timeAfterDays(const TimeInfo& t, int days);
+
+// Batch API. activeScheduleEntry() recompiles after markScheduleEdited() and
+// otherwise only looks the schedule up again once b.now reaches the cursor's
+// validUntil; until then it returns the cached entry without reading `now`.
+bool scheduleCursorValid(const ControllerBatch& b, int i);
+const ScheduleEntry& activeScheduleEntry(ControllerBatch& b, int i, const TimeInfo& now);
+void markScheduleEdited(ControllerBatch& b, int i);
+void invalidateScheduleCursor(ControllerBatch& b, int i); // After the wall clock is set
+
+#endif // SCHEDULE_H
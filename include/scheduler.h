@@ -0,0 +1,52 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "config.h"
+#include "controller.h"
+
+// Event-driven control scheduling. After each control pass, planNextWake()
+// works out the earliest instant any decision could change: a schedule
+// transition, a Smart Recovery start, a min-run/min-off/max-run timer expiry,
+// the fan circulate edge, or the next mandatory sensor sample. It also returns the indoor temperature
+// and humidity band inside which no relay rule can fire. schedulerSleep() then
+// blocks until that instant, polling the sensors cheaply against the band and
+// returning early if a reading leaves it or another task calls wakeScheduler().
+
+const unsigned long SENSOR_POLL_INTERVAL_MS = SENSOR_POLL_INTERVAL_SECS * 1000;
+const unsigned long MAX_CONTROL_SLEEP_MS = MAX_CONTROL_SLEEP_SECS * 1000;
+
+enum WakeReason {
+  WAKE_SENSOR_SAMPLE, WAKE_SCHEDULE, WAKE_RECOVERY, WAKE_HEATER_TIMER, WAKE_COOLER_TIMER,
+  WAKE_FAN_CYCLE, WAKE_THRESHOLD, WAKE_EXTERNAL, NUM_WAKE_REASONS
+};
+
+struct WakePlan {
+  ControlMillis wakeAt; // Controller time at which to run the next control pass
+  WakeReason reason;
+  CentiC lowTemp, highTemp;          // Wake early if indoor temperature reaches either bound
+  CentiRH lowHumidity, highHumidity; // Likewise for indoor relative humidity
+};
+
+struct SchedulerStats {
+  unsigned long wakes[NUM_WAKE_REASONS];
+  unsigned long sensorPolls;
+};
+
+extern SchedulerStats schedulerStats;
+
+// Virtual-clock backend (g_isTesting): called before each simulated sleep
+// interval so a plant model can advance and update the sensor mocks.
+typedef void (*VirtualTimeHook)(unsigned long fromMs, unsigned long toMs);
+
+// Function Declarations
+// b.now must be the time of the pass just completed.
+WakePlan planNextWake(ControllerBatch& b, int i, const TimeInfo& time, FanMode fanMode,
+                      CentiC temp, CentiC target, CentiC outdoor, CentiRH humidity);
+bool outsideWakeBand(const WakePlan& plan, CentiC temp, CentiRH humidity);
+WakeReason schedulerSleep(const WakePlan& plan);
+void wakeScheduler();
+void wakeSchedulerFromISR();
+void setVirtualTimeHook(VirtualTimeHook hook);
+const char* wakeReasonName(WakeReason reason);
+
+#endif // SCHEDULER_H
@@ -0,0 +1,44 @@
+#ifndef SENSORS_H
+#define SENSORS_H
+
+#include <stdint.h>
+#include "config.h"
+#include "spsc_ring.h"
+
+// Sensor acquisition. A dedicated task calls the blocking drivers
+// (readTemperature() etc.) every SENSOR_SAMPLE_INTERVAL_SECS, filters each
+// channel (median-of-N to drop spikes, then an EMA for the rate of change),
+// and pushes the filtered, timestamped sample into a single-producer,
+// single-consumer ring. The control task drains the ring and keeps the latest
+// sample, so it never waits on a sensor. Under g_isTesting there is no task:
+// sensorSnapshot() takes the samples the virtual clock has passed over.
+
+const unsigned long SENSOR_SAMPLE_INTERVAL_MS = SENSOR_SAMPLE_INTERVAL_SECS * 1000;
+const int SENSOR_RING_SIZE = 16; // Power of two
+
+// Temperatures are in the unit readTemperature() returns (tempUnit). The
+// control path uses the CentiC copies, converted once here at sampling.
+struct SensorSnapshot {
+  bool valid;                 // False until the first sample
+  unsigned long timestamp;    // currentTime() when sampled
+  uint32_t sequence;
+  float indoor, outdoor, humidity; // Median-filtered, for control decisions
+  CentiC indoorCentiC, outdoorCentiC;
+  CentiRH humidityCentiRH;
+  float indoorRaw;            // This sample's unfiltered reading
+  float indoorSmoothed;       // EMA of the median
+  float indoorRatePerMin;     // Of the EMA, per minute
+  bool indoorStuck;           // Raw reading unchanged for SENSOR_STUCK_MINS; see holdForStuckSensor()
+};
+
+struct SensorStats {
+  unsigned long samples, overruns, drains;
+};
+
+extern SensorStats sensorStats;
+
+// Function Declarations
+void startSensorAcquisition(); // Primes one sample, then starts the task (or resets the virtual sampler)
+SensorSnapshot sensorSnapshot(); // Latest filtered sample; never blocks
+
+#endif // SENSORS_H
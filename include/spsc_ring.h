@@ -0,0 +1,33 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <stdint.h>
+
+// Lock-free ring for one producer and one consumer. Indices only grow; each
+// side writes only its own index, and the release/acquire pair on it
+// publishes the slot contents.
+template <typename T, int N>
+class SpscRing {
+  static_assert((N & (N - 1)) == 0, "SpscRing size must be a power of two");
+public:
+  bool push(const T& item) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == (uint32_t)N) return false;
+    slots_[head & (N - 1)] = item;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+  bool pop(T* item) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) return false;
+    *item = slots_[tail & (N - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+private:
+  T slots_[N];
+  std::atomic<uint32_t> head_{0}, tail_{0};
+};
+
+#endif // SPSC_RING_H
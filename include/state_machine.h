@@ -0,0 +1,67 @@
+#ifndef STATE_MACHINE_H
+#define STATE_MACHINE_H
+
+#include <stdint.h>
+#include "config.h"
+
+// Temperature control as an explicit state machine. Each pass the instance's
+// ThermostatState is read off its shadow relays (the relays stay the ground
+// truth, so a warm start, a trace keyframe or the fault path needs no second
+// copy to resync) and only that state's transitions are tried, in table
+// order; the first whose guard holds fires and ends the pass. The rules are
+// one constexpr table, filtered per state and per equipment at compile time,
+// so a heat-only build carries no cooling or economizer code at all and the
+// per-pass work is the handful of guards that can apply.
+//
+// With EQUIPMENT_HEAT_COOL and an economizer the decisions are exactly those
+// of controlTemperature() (hvac_logic.h), which stays as the reference and as
+// the building blocks of the zone engine. EQUIPMENT_HEAT_PUMP drives the same
+// two relays but treats them as one compressor: neither direction starts
+// until both have been off for their minimum off time.
+
+struct ControllerBatch;
+
+template <EquipmentProfile Profile> struct EquipmentTraits;
+template <> struct EquipmentTraits<EQUIPMENT_HEAT_ONLY> { static constexpr bool heat = true, cool = false, sharedCompressor = false; };
+template <> struct EquipmentTraits<EQUIPMENT_COOL_ONLY> { static constexpr bool heat = false, cool = true, sharedCompressor = false; };
+template <> struct EquipmentTraits<EQUIPMENT_HEAT_COOL> { static constexpr bool heat = true, cool = true, sharedCompressor = false; };
+template <> struct EquipmentTraits<EQUIPMENT_HEAT_PUMP> { static constexpr bool heat = true, cool = true, sharedCompressor = true; };
+
+enum StateTransition : uint8_t {
+  TRANSITION_LOCKOUT,           // Locked out: heat, cool and damper off, nothing else runs
+  TRANSITION_HEAT_RELEASED,     // The mode no longer calls for heat: the heater stops after its minimum run
+  TRANSITION_HEAT_MAX_RUN,      // Heater past MAX_HEATER_RUN_TIME_MINS; counts toward the lockout
+  TRANSITION_HEAT_SATISFIED,    // At target after the minimum run
+  TRANSITION_HEAT_DAMPER_CLOSE, // At target: the damper closes
+  TRANSITION_HEAT_DAMPER_OPEN,  // Cold inside, warmer outside: free heating
+  TRANSITION_HEAT_START,
+  TRANSITION_COOL_RELEASED,
+  TRANSITION_COOL_MAX_RUN,
+  TRANSITION_COOL_SATISFIED,
+  TRANSITION_COOL_DAMPER_CLOSE,
+  TRANSITION_COOL_DAMPER_OPEN,  // Warm inside, cooler outside: free cooling
+  TRANSITION_COOL_START,
+  NUM_STATE_TRANSITIONS         // Also "none fired"
+};
+
+// Called when a transition changes the state or a relay; never on a pass
+// that holds. A null hook (the default) costs one test per change.
+typedef void (*StateTraceHook)(int instance, ThermostatState from, ThermostatState to, StateTransition transition, ControlMillis now);
+
+// Function Declarations
+const char* stateTransitionName(StateTransition transition);
+ThermostatState thermostatStateOf(const ControllerBatch& b, int i); // From instance i's shadow relays
+void setStateTraceHook(StateTraceHook hook);
+
+// Batch API: one pass for instance i, in place of controlTemperature(). Returns
+// the state after the pass, also left in b.state[i]. Instantiated for every
+// profile, with and without an economizer.
+template <EquipmentProfile Profile, bool Economizer>
+ThermostatState stepThermostat(ControllerBatch& b, int i, CentiC temp, CentiC target, CentiC outdoor);
+// ...for the equipment configured in config.h.
+ThermostatState stepThermostat(ControllerBatch& b, int i, CentiC temp, CentiC target, CentiC outdoor);
+
+// Device API on deviceController, with the HAL clock; learned rows go to persistence.
+ThermostatState stepThermostat(CentiC temp, CentiC target, CentiC outdoor);
+
+#endif // STATE_MACHINE_H
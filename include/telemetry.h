@@ -0,0 +1,81 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "sensors.h"
+
+// Status telemetry. Each control pass packs one fixed-layout frame into a
+// lock-free ring and moves on; a low-priority task drains the ring and ships
+// each frame as CRC-16 checked, COBS-encoded bytes ending in 0x00, or as the
+// old human-readable status line when text output is selected. A full ring
+// drops the frame and counts it. host/tools/telemetry_decode reads the stream.
+// The first byte of a frame says what it is: TELEMETRY_VERSION for the status
+// frame, TELEMETRY_PROBE_FRAME for a latency summary (see probes.h), sent every
+// TELEMETRY_PROBE_INTERVAL_SECS for each probe stage.
+
+const uint8_t TELEMETRY_VERSION = 1;
+const uint8_t TELEMETRY_PROBE_FRAME = 0x81;
+
+// Relay and flag bits of a frame.
+const uint8_t TELEMETRY_RELAY_HEATER = 1 << 0, TELEMETRY_RELAY_COOLER = 1 << 1, TELEMETRY_RELAY_FAN = 1 << 2,
+              TELEMETRY_RELAY_FRESH_AIR = 1 << 3, TELEMETRY_RELAY_HUMIDIFIER = 1 << 4;
+const uint8_t TELEMETRY_FLAG_LOCKED_OUT = 1 << 0, TELEMETRY_FLAG_FAHRENHEIT = 1 << 1, TELEMETRY_FLAG_VACATION = 1 << 2,
+              TELEMETRY_FLAG_SENSOR_STUCK = 1 << 3;
+
+// Wire layout: packed, little-endian. Temperatures are hundredths of a degree
+// in the unit given by TELEMETRY_FLAG_FAHRENHEIT.
+struct __attribute__((packed)) TelemetryFrame {
+  uint8_t version;
+  uint8_t state;         // ThermostatState
+  uint16_t sequence;     // Counts dropped frames too, so gaps show loss
+  uint32_t timestampMs;  // currentTime()
+  uint16_t minuteOfDay;  // Wall clock
+  int16_t indoorRaw, indoorFiltered, outdoor, target;
+  uint16_t humidity;     // Hundredths of %RH
+  uint8_t relays;        // TELEMETRY_RELAY_*
+  uint8_t flags;         // TELEMETRY_FLAG_*
+};
+
+struct __attribute__((packed)) TelemetryProbeFrame {
+  uint8_t kind;          // TELEMETRY_PROBE_FRAME
+  uint8_t stage;         // ProbeStage
+  uint16_t sequence;
+  uint32_t count;
+  uint32_t minUs, p50Us, p99Us, maxUs; // Percentiles are bucket upper bounds
+};
+
+const size_t TELEMETRY_MAX_FRAME = sizeof(TelemetryProbeFrame);
+// Largest frame plus CRC, COBS overhead byte and delimiter.
+const size_t TELEMETRY_MAX_ENCODED = TELEMETRY_MAX_FRAME + 2 + 1 + 1;
+
+struct TelemetryStats {
+  unsigned long published, dropped, shipped, bytesOut;
+};
+
+typedef void (*TelemetrySink)(const uint8_t* data, size_t len);
+
+extern TelemetryStats telemetryStats;
+
+// Function Declarations
+void startTelemetry(); // Starts the drain task (none under g_isTesting)
+void publishTelemetry(const SensorSnapshot& sensors, const TimeInfo& now, CentiC target, ThermostatState state);
+void publishProbeTelemetry();                // Queues the probe summaries when they are due
+bool enqueueTelemetry(TelemetryFrame frame); // Never blocks; false if dropped
+bool enqueueTelemetry(TelemetryProbeFrame frame);
+size_t drainTelemetry();                     // Ships queued frames, returns how many
+void setTelemetryTextMode(bool text);
+void setTelemetrySink(TelemetrySink sink);   // Default: Serial.write
+
+size_t encodeTelemetryFrame(const TelemetryFrame& frame, uint8_t* out); // Includes the 0x00 delimiter
+size_t encodeTelemetryFrame(const TelemetryProbeFrame& frame, uint8_t* out);
+// Checks and unpacks one received frame (len excludes the delimiter) into
+// raw, returning its size, or 0 if it is corrupt. raw[0] is the frame kind.
+size_t decodeTelemetryBytes(const uint8_t* in, size_t len, uint8_t raw[TELEMETRY_MAX_FRAME]);
+bool decodeTelemetryFrame(const uint8_t* in, size_t len, TelemetryFrame* frame);
+bool decodeTelemetryFrame(const uint8_t* in, size_t len, TelemetryProbeFrame* frame);
+int formatTelemetryText(const TelemetryFrame& frame, char* out, size_t size);
+int formatTelemetryText(const TelemetryProbeFrame& frame, char* out, size_t size);
+
+#endif // TELEMETRY_H
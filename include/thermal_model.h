@@ -0,0 +1,65 @@
+#ifndef THERMAL_MODEL_H
+#define THERMAL_MODEL_H
+
+#include <stdint.h>
+#include "config.h"
+
+// Online thermal model. The house is one first-order RC node:
+//   dT/dt = -loss * (T - Tout) + heatGain * heating - coolGain * cooling + internalGain
+// with T in C and t in hours. Every control pass integrates the regressors
+// over the time since the last pass, with the relays that held through it;
+// every THERMAL_MODEL_SAMPLE_SECS the interval's mean slope is one recursive
+// least squares update with forgetting factor THERMAL_MODEL_FORGETTING, so
+// the model follows the season in fixed memory. Intervals with the economizer
+// open, or a gap in the passes, are dropped rather than fitted.
+//
+// The model starts from the learned HvacPerformance rates, so persisted data
+// carries over on boot, and once confident it fills the table's empty outdoor
+// bins with its own rates (as one sample each, so real cycles soon outweigh
+// them). Cycle learning in updatePerformanceData() is unchanged.
+//
+// The RLS step is about a hundred float operations, soft-float on the C6,
+// once per sample; it is off the decision path and measured by PROBE_THERMAL_MODEL.
+
+struct ControllerBatch;
+struct HvacPerformance;
+
+enum ThermalParam { THERMAL_LOSS, THERMAL_HEAT_GAIN, THERMAL_COOL_GAIN, THERMAL_INTERNAL_GAIN, NUM_THERMAL_PARAMS };
+
+struct ThermalModel {
+  bool seeded;
+  float theta[NUM_THERMAL_PARAMS];                       // 1/h, then C/h
+  float P[NUM_THERMAL_PARAMS][NUM_THERMAL_PARAMS];       // Parameter covariance over the residual variance
+  float residualVar;                                      // (C/h)^2, forgetting-weighted
+  uint32_t updates;
+  uint16_t heatSamples, coolSamples;                      // Updates with the heater, cooler mostly on
+
+  // -- Interval being integrated --
+  bool intervalOpen;
+  bool disturbed;                                         // Economizer open during the interval
+  ControlMillis intervalStart, lastAt;
+  CentiC startTemp, lastTemp, lastOutdoor;
+  float sumPhi[NUM_THERMAL_PARAMS];                       // Regressors integrated over hours
+};
+
+struct ThermalPrediction {
+  bool reachable;       // The equipment can hold the target at this outdoor temperature
+  uint32_t seconds;     // Running from current to target; 0 if already there
+  uint8_t confidence;   // 0..100, from the model's uncertainty in the starting rate
+};
+
+// Function Declarations
+void seedThermalModel(ThermalModel& m, const HvacPerformance& perf, int season);
+// heating, cooling and freshAir are the relays that held since the previous call.
+void updateThermalModel(ThermalModel& m, ControlMillis now, CentiC indoor, CentiC outdoor, bool heating, bool cooling, bool freshAir);
+ThermalPrediction predictTimeToTarget(const ThermalModel& m, CentiC current, CentiC target, CentiC outdoor);
+uint8_t seedPerformanceFromModel(const ThermalModel& m, HvacPerformance& perf, int season, CentiC indoor); // PERF_DIRTY_BIT mask of rows filled
+
+// Batch API: instance i, with the relays that held since the last pass. b.now and b.season must be set.
+void updateThermalModel(ControllerBatch& b, int i, CentiC indoor, CentiC outdoor);
+
+// Single-thermostat API on deviceController.
+void updateThermalModel(CentiC indoor, CentiC outdoor);
+ThermalPrediction predictTimeToTarget(CentiC current, CentiC target, CentiC outdoor);
+
+#endif // THERMAL_MODEL_H
@@ -0,0 +1,110 @@
+#ifndef TIMESERIES_H
+#define TIMESERIES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+
+// Runtime, duty cycle and energy history. Each control pass adds the time
+// since the previous one to every relay that held on through it, counts the
+// relays it started and samples the temperatures, all into the open 1-minute
+// bucket: constant work per pass, splitting an interval only where it crosses
+// a minute boundary. A closed minute is appended to the minute tier and
+// folded into the open hour, a closed hour likewise into the open day, so
+// the three tiers are downsampled as they are written rather than by reading
+// back.
+//
+// Each tier is a ring of fixed-size segment files on SPIFFS of fixed 64-byte
+// records. Appends only ever extend the newest segment, SERIES_FLUSH_RECORDS
+// minutes at a time, one open and close per tier;
+// when it is full the oldest segment is truncated and reused, so the tiers'
+// footprint is fixed and erases move round the ring. At boot the newest
+// segment of each tier is found from the sequence numbers in the segment
+// headers, and the open hour and day are rebuilt from the tier below, so a
+// reset costs at most the minutes still in RAM.
+//
+// A query over [from, to) is split on hour and day boundaries: whole days are
+// read from the day tier, the hours either side from the hour tier and the
+// minutes at the ends from the minute tier, so a year is a few hundred reads.
+// Segments are located from a RAM index of their first minutes and records
+// within one by binary search.
+//
+// Times are series minutes: the wall clock's minute of the year plus a year
+// count kept by the store. The series clock never runs backwards; after the
+// wall clock is set back it runs on the controller clock until the wall
+// clock catches up, and a forward set leaves a gap.
+
+enum SeriesRelay { SERIES_HEATER, SERIES_COOLER, SERIES_FAN, SERIES_FRESH_AIR, SERIES_HUMIDIFIER, NUM_SERIES_RELAYS };
+enum SeriesTier { SERIES_MINUTES, SERIES_HOURS, SERIES_DAYS, NUM_SERIES_TIERS };
+
+const uint32_t SERIES_MAGIC = 0x53545648; // "HVTS"
+const uint32_t SERIES_TIER_MINUTES[NUM_SERIES_TIERS] = { 1, 60, 24 * 60 };
+
+// One bucket as stored.
+struct SeriesBucket {
+  uint32_t startMinute;
+  uint32_t seconds;                       // Time accounted for: the duty cycle's denominator
+  uint32_t onSeconds[NUM_SERIES_RELAYS];
+  uint32_t economizerHeatSeconds;         // Damper open in place of the heater...
+  uint32_t economizerCoolSeconds;         // ...or the cooler
+  uint32_t samples;                       // Control passes
+  uint16_t starts[NUM_SERIES_RELAYS];
+  CentiC indoorMean, indoorMin, indoorMax;
+  CentiC outdoorMean, outdoorMin, outdoorMax;
+  uint16_t crc;                           // Over everything before it
+};
+static_assert(sizeof(SeriesBucket) == 64, "Series records are 64 bytes");
+
+struct SeriesSegmentHeader {
+  uint32_t magic;
+  uint8_t tier;
+  uint8_t reserved[3];
+  uint32_t sequence; // Bumped each time a segment of the tier is started
+};
+
+// An open bucket, or the sum of a query's buckets.
+struct SeriesTotals {
+  uint32_t startMinute;
+  uint64_t milliseconds;
+  uint64_t onMilliseconds[NUM_SERIES_RELAYS];
+  uint64_t economizerHeatMilliseconds, economizerCoolMilliseconds;
+  uint32_t starts[NUM_SERIES_RELAYS];
+  uint32_t samples;
+  int64_t indoorSum, outdoorSum;
+  CentiC indoorMin, indoorMax, outdoorMin, outdoorMax;
+};
+
+// What a query read, per tier.
+struct SeriesQueryCost {
+  uint32_t buckets[NUM_SERIES_TIERS];   // Stored buckets added in
+  uint32_t reads[NUM_SERIES_TIERS];     // File reads, the binary search included
+};
+
+struct SeriesStats {
+  unsigned long passes, minutesClosed, hoursClosed, daysClosed;
+  unsigned long flushes, bytesWritten, segmentsRecycled;
+  unsigned long gaps;       // Passes after a stall, reboot or clock set: interval not counted
+  unsigned long badRecords; // Failed their CRC on read
+  unsigned long writeErrors;
+};
+
+extern SeriesStats seriesStats;
+
+// Function Declarations
+void initialize_timeseries(); // Finds each tier's newest segment; the open buckets are rebuilt on the first pass
+void eraseTimeseries();       // Drops every segment and the open buckets
+void recordSeries(unsigned long nowMs, const TimeInfo& wall, uint16_t relays, bool freshAirForHeating, CentiC indoor, CentiC outdoor);
+bool flushTimeseries();
+uint32_t seriesNowMinute();   // The open minute; 0 before the first pass
+// Sums [fromMinute, toMinute), the open buckets included. False if nothing was recorded in it.
+bool querySeries(uint32_t fromMinute, uint32_t toMinute, SeriesTotals& out, SeriesQueryCost* cost = nullptr);
+void clearSeriesTotals(SeriesTotals& t);
+uint32_t seriesEnergyWh(const SeriesTotals& t);
+uint32_t economizerSavingsWh(const SeriesTotals& t); // Heater or cooler input the damper stood in for
+size_t timeseriesRamBytes();
+size_t timeseriesFlashBytes(); // Every segment full
+
+// Device API: the relays deviceController committed this pass, on the HAL clock.
+void recordSeries(const TimeInfo& now, CentiC indoor, CentiC outdoor);
+
+#endif // TIMESERIES_H
@@ -0,0 +1,98 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "warmstart.h"
+
+// Control trace. Every control pass appends one record of its inputs (clock,
+// wall time, readings, settings and the control target) and the relays it
+// left, so the exact sequence a unit saw can be replayed on the host through
+// changed control code (host/tools/trace_replay). A record is a varint mask
+// of the fields that changed since the previous pass, the milliseconds since
+// it, and each changed field as a zigzag varint delta: a quiet pass is under
+// ten bytes. A keyframe codes every field against zero and carries the
+// controller state (the WarmState layout), so decoding can start there; one
+// opens every file and follows every boot, and every pass that applied
+// commands, whose effects (a lockout reset) no field carries. Records collect
+// in a RAM buffer and are appended to SPIFFS in batches, rotating at
+// TRACE_MAX_BYTES with one older file kept, as the learning log does. On the host, setTraceSink()
+// sends the stream elsewhere, unbounded.
+
+struct ControllerBatch;
+
+const uint32_t TRACE_MAGIC = 0x52545648; // "HVTR"
+const uint16_t TRACE_VERSION = 1;
+
+// Field mask, most frequent first so a typical record's mask is one byte.
+enum TraceField : uint16_t {
+  TRACE_CLOCK    = 1 << 0,  // Second of day
+  TRACE_INDOOR   = 1 << 1,
+  TRACE_OUTDOOR  = 1 << 2,
+  TRACE_HUMIDITY = 1 << 3,
+  TRACE_TARGET   = 1 << 4,
+  TRACE_RELAYS   = 1 << 5,  // One byte
+  TRACE_DATE     = 1 << 6,  // Month, day and dayOfWeek, a byte each
+  TRACE_SETTINGS = 1 << 7,  // One byte: systemMode | fanMode << 2 | tempUnit << 4
+  TRACE_KEYFRAME = 1 << 8,  // Coded against zero; a WarmState follows the fields
+  TRACE_FIELDS   = (1 << 9) - 1
+};
+
+struct TraceHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t generation; // Bumped on every rotation
+};
+
+// One control pass.
+struct TracePass {
+  uint32_t timestampMs;   // The controller clock, currentTime()
+  TimeInfo time;
+  CentiC indoor, outdoor;
+  CentiRH humidity;
+  CentiC target;          // After Smart Recovery: what stepThermostat() was given
+  SystemMode systemMode;
+  FanMode fanMode;
+  TempUnit tempUnit;
+  uint8_t relays;         // RELAY_BIT() mask after the pass; the relay pins all fit a byte
+};
+
+// Encoder or decoder state: the previous pass, which fields are coded against.
+struct TraceCodec {
+  bool primed; // False until a keyframe; a delta record is then undecodable
+  TracePass last;
+};
+
+const size_t TRACE_MAX_RECORD = 32 + sizeof(WarmState);
+
+struct TraceStats {
+  unsigned long records, keyframes, bytes, flushes, rotations, dropped;
+};
+
+typedef void (*TraceSink)(const uint8_t* data, size_t len);
+
+extern TraceStats traceStats;
+
+// Function Declarations
+// Codes one pass into out (TRACE_MAX_RECORD bytes), as a keyframe if state is
+// given or the codec is not primed (state is then required). Returns the size.
+size_t encodeTracePass(TraceCodec& codec, const TracePass& pass, const WarmState* state, uint8_t* out);
+// Decodes the record at in; returns its size, or 0 if it is truncated or
+// corrupt. *keyframe says whether it was one, in which case *state is filled.
+size_t decodeTracePass(TraceCodec& codec, const uint8_t* in, size_t len, TracePass& pass, WarmState* state, bool* keyframe);
+
+// Batch API: instance i's inputs for a pass, and replay of recorded passes.
+uint8_t traceRelayMask(const ControllerBatch& b, int i);
+void loadTraceKeyframe(ControllerBatch& b, int i, const TracePass& pass, const WarmState& state);
+uint8_t replayTracePass(ControllerBatch& b, int i, const TracePass& pass); // Runs the control routines, returns the relays
+
+// Device API on deviceController.
+void initialize_trace();
+void recordTrace(const TimeInfo& now, CentiC indoor, CentiC outdoor, CentiRH humidity, CentiC target, FanMode fanMode); // After the relay decisions
+bool flushTrace();
+void requestTraceKeyframe(); // Controller state changed outside the recorded inputs (a command): code the next record as a keyframe
+void setTraceSink(TraceSink sink); // Host: write the stream (header first) here instead of SPIFFS
+
+#endif // TRACE_H
@@ -1,6 +1,10 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+
 inline float fahrenheitToCelsius(float f) {
     return (f - 32.0) * 5.0 / 9.0;
 }
@@ -9,4 +13,33 @@ inline float celsiusToFahrenheit(float c) {
     return (c * 9.0 / 5.0) + 32.0;
 }
 
+// -- CentiC conversions (see config.h) --
+constexpr CentiC centiCFromC(float c) { return (CentiC)(c * 100.0f + (c >= 0 ? 0.5f : -0.5f)); }
+constexpr CentiC centiCDeltaFromF(float df) { return (CentiC)(df * 500.0f / 9.0f + (df >= 0 ? 0.5f : -0.5f)); }
+constexpr CentiRH centiRH(float rh) { return (CentiRH)(rh * 100.0f + (rh >= 0 ? 0.5f : -0.5f)); }
+
+// A temperature, or a difference, given in the display unit.
+constexpr CentiC centiCFrom(float value, TempUnit unit) { return unit == FAHRENHEIT ? centiCFromF(value) : centiCFromC(value); }
+constexpr CentiC centiCDeltaFrom(float delta, TempUnit unit) { return unit == FAHRENHEIT ? centiCDeltaFromF(delta) : centiCFromC(delta); }
+
+// Back to hundredths of the display unit, in integers, for telemetry.
+inline int32_t centiCToCentiUnit(CentiC c, TempUnit unit) {
+    return unit == FAHRENHEIT ? (c * 9 + (c >= 0 ? 2 : -2)) / 5 + 3200 : c;
+}
+
+inline float centiCToUnit(CentiC c, TempUnit unit) { return centiCToCentiUnit(c, unit) / 100.0f; }
+
+// CRC-16/CCITT-FALSE, for telemetry frames, retained state and series
+// records; a nibble at a time from a 32-byte table, no branches.
+inline uint16_t crc16(const uint8_t* data, size_t len) {
+  static const uint16_t NIBBLE[16] = { 0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+                                       0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF };
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc = (uint16_t)(crc << 4) ^ NIBBLE[(crc >> 12) ^ (data[i] >> 4)];
+    crc = (uint16_t)(crc << 4) ^ NIBBLE[(crc >> 12) ^ (data[i] & 0x0F)];
+  }
+  return crc;
+}
+
 #endif // UTILS_H
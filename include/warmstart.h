@@ -0,0 +1,65 @@
+#ifndef WARMSTART_H
+#define WARMSTART_H
+
+#include <stdint.h>
+#include "config.h"
+
+// Warm start. Each control pass mirrors the hot controller state (cycle
+// protection timers, max-run trigger counters, lockout, circulate phase,
+// relay outputs and the cycle-start sample) into RTC memory that survives a
+// software, panic, watchdog or brownout reset, with a CRC-16. Timers are kept
+// as ages against a clock that keeps running through the reset, so a warm
+// boot re-bases them onto the new millis() and the real min-off and min-run
+// times still apply. The relays are latched through the reset by GPIO hold,
+// so a cycle in progress carries on. Power-on, a failed check or a state
+// older than WARM_START_MAX_AGE_SECS boots cold, and setup() drops the relays
+// before it does anything else. The state is claimed (cleared from RTC
+// memory) at that point, so only one boot can resume it: a crash before the
+// first pass saves again boots cold next time, and a crash loop cannot keep
+// a relay latched.
+
+struct ControllerBatch;
+
+const unsigned long WARM_START_MAX_AGE_SECS = 600; // Beyond this the plant has moved on; boot cold
+
+// The retained state. Ages are milliseconds before savedAtUs on the retained
+// clock. A control trace (trace.h) stores the same layout in its keyframes.
+struct WarmState {
+  uint32_t magic;
+  uint16_t size;
+  uint16_t relays;
+  uint64_t savedAtUs;
+  uint32_t heaterOnAge, heaterOffAge, coolerOnAge, coolerOffAge, fanCycleAge;
+  uint32_t cycleStartAge, firstHeaterMaxRunAge, firstCoolerMaxRunAge;
+  CentiC cycleStartTemp, cycleStartOutdoorTemp;
+  uint8_t heaterMaxRunTriggers, coolerMaxRunTriggers;
+  uint8_t flags;
+  uint8_t reserved;
+  uint16_t crc; // Over everything before it
+};
+
+// Boot-to-first-decision latency: currentTime() includes deliberate waits,
+// micros() is execution time (on the host, where delay() is virtual).
+struct BootStats {
+  bool warm;
+  bool decided;                      // First control decision made since boot
+  unsigned long setupMs, setupUs;    // Entry to setup()
+  unsigned long decisionMs, decisionUs;
+};
+
+extern BootStats bootStats;
+
+// Batch API: instance i against a caller-supplied retained clock (microseconds).
+void captureWarmState(const ControllerBatch& b, int i, uint64_t clockUs, WarmState& s);
+void applyWarmState(ControllerBatch& b, int i, const WarmState& s, unsigned long elapsedMs); // Relays included
+void saveWarmState(const ControllerBatch& b, int i, uint64_t clockUs);
+bool restoreWarmState(ControllerBatch& b, int i, uint64_t clockUs); // False, and b untouched, if absent or invalid
+
+// Device API on deviceController and the reset reason.
+bool claimWarmState();     // First thing at boot: reset reason allows it and the retained state checks out
+bool warmStart();          // Restore the claimed state, re-latch the relays and release the hold; false to boot cold
+void saveWarmState();
+void invalidateWarmState(); // Next boot is cold: faults, self-tests
+void noteFirstDecision();
+
+#endif // WARMSTART_H
@@ -0,0 +1,64 @@
+#ifndef ZONES_H
+#define ZONES_H
+
+#include <stdint.h>
+#include "config.h"
+
+// Multi-zone engine: several zones with dampers sharing one air handler. The
+// air handler is instance i of a ControllerBatch; its heater and cooler are
+// stage 1, with their existing protections, economizer and learning. Stages
+// 2..MAX_STAGES keep their own min-run, min-off and max-run state here, so
+// every protection applies per equipment stage rather than per zone. A pass:
+//   1. Demand per zone (target - temp) and a lead zone per mode: the largest
+//      deficit for heating, the largest excess for cooling.
+//   2. Stage 1 heats on the heating lead and cools on the cooling lead, so it
+//      starts when any zone leaves the deadband and runs until all are satisfied.
+//      If zones call for both in AUTO, the larger error is served first and
+//      the other mode waits for the air handler to go idle.
+//   3. Stage s calls in once the lead is STAGE_UP_ERROR_F per stage beyond the
+//      deadband, or stage s - 1 has run STAGE_UP_DELAY_MINS without bringing
+//      it back; it drops out once the lead is back within the deadband.
+//   4. Dampers open for the zones calling in the running mode (at least
+//      MIN_OPEN_DAMPERS of them, by demand) and all open while idle.
+// With one zone and one stage a pass is exactly controlTemperature(). The work
+// is a fixed loop over at most MAX_ZONES zones and MAX_STAGES stages, with no
+// allocation or division; hvac_zone_bench measures it against the budget below.
+
+struct ControllerBatch;
+
+enum StageMode { STAGE_HEAT, STAGE_COOL, NUM_STAGE_MODES };
+
+const uint32_t ZONE_PASS_BUDGET_CYCLES = 16000; // 100 us at CPU_FREQ_MHZ, for MAX_ZONES zones and MAX_STAGES stages
+const unsigned long STAGE_UP_DELAY_MS = STAGE_UP_DELAY_MINS * 60 * 1000;
+const unsigned long DAMPER_MIN_DWELL_MS = DAMPER_MIN_DWELL_SECS * 1000;
+
+struct ZoneGroup {
+  int zoneCount;
+  int stageCount[NUM_STAGE_MODES]; // 1..MAX_STAGES, stage 1 being the batch's heater or cooler
+
+  // -- Per zone; the caller sets temp and target before each pass --
+  CentiC temp[MAX_ZONES];
+  CentiC target[MAX_ZONES];
+  int16_t demand[MAX_ZONES];         // target - temp: above zero wants heat, below wants cooling
+  ControlMillis damperChangedAt[MAX_ZONES];
+  uint16_t damperOpen;               // Bit per zone
+
+  // -- Stages 2..MAX_STAGES, stage s at index s - 2 --
+  ControlMillis stageOnTime[NUM_STAGE_MODES][MAX_STAGES - 1];
+  ControlMillis stageOffTime[NUM_STAGE_MODES][MAX_STAGES - 1];
+  ControlMillis firstStageMaxRunTime[NUM_STAGE_MODES][MAX_STAGES - 1];
+  uint8_t stageMaxRunTriggers[NUM_STAGE_MODES][MAX_STAGES - 1];
+  uint8_t stagesOn[NUM_STAGE_MODES];        // Bit s - 2 per running stage
+  uint8_t stagesLockedOut[NUM_STAGE_MODES]; // Until initZoneGroup(), as the system lockout is until reset
+
+  // -- Last pass --
+  int8_t lead[NUM_STAGE_MODES];
+};
+
+// Function Declarations
+void initZoneGroup(ZoneGroup& g, int zones, int heatStages, int coolStages, ControlMillis now);
+// One pass for the air handler at instance i; b.now and b.season must be set.
+void controlZones(ZoneGroup& g, ControllerBatch& b, int i, CentiC outdoor);
+int runningStages(const ZoneGroup& g, const ControllerBatch& b, int i, StageMode mode); // Including stage 1
+
+#endif // ZONES_H
@@ -0,0 +1,200 @@
+#include "commands.h"
+#include <Arduino.h>
+#include "config.h"
+#include "controller.h"
+#include "esp_cpu.h"
+#include "learning.h"
+#include "main.h"
+#include "mpsc_ring.h"
+#include "persistence.h"
+#include "probes.h"
+#include "schedule.h"
+#include "scheduler.h"
+#include "trace.h"
+#include "utils.h"
+
+static const unsigned long HOLD_HORIZON_SECS = 7 * 24 * 3600UL;
+static const CentiC HOLD_MIN_TARGET = centiCFromF(HOLD_MIN_TARGET_F);
+static const CentiC HOLD_MAX_TARGET = centiCFromF(HOLD_MAX_TARGET_F);
+
+CommandStats commandStats;
+SetpointHold setpointHold;
+
+static MpscRing<Command, COMMAND_QUEUE_DEPTH> queue;
+
+// Submit stamps of the commands the current pass applied, until its relay commit.
+static uint32_t appliedCycles[COMMAND_QUEUE_DEPTH];
+static int appliedCount = 0;
+
+// =================================================================
+// ==                         PRODUCERS                           ==
+// =================================================================
+bool submitCommand(const Command& command) {
+  Command c = command;
+  c.submittedCycles = esp_cpu_get_cycle_count();
+  // Producers race on these two counters, so they count atomically.
+  if (!queue.push(c)) { __atomic_fetch_add(&commandStats.full, 1, __ATOMIC_RELAXED); return false; }
+  __atomic_fetch_add(&commandStats.submitted, 1, __ATOMIC_RELAXED);
+  wakeScheduler();
+  return true;
+}
+
+bool submitSetpointHold(CentiC target, uint16_t holdMinutes) {
+  Command c = {};
+  c.type = CMD_SETPOINT_HOLD; c.target = target; c.holdMinutes = holdMinutes;
+  return submitCommand(c);
+}
+
+bool submitResumeSchedule() {
+  Command c = {};
+  c.type = CMD_RESUME_SCHEDULE;
+  return submitCommand(c);
+}
+
+bool submitSystemMode(SystemMode mode) {
+  Command c = {};
+  c.type = CMD_SYSTEM_MODE; c.mode = mode;
+  return submitCommand(c);
+}
+
+bool submitVacation(bool on) {
+  Command c = {};
+  c.type = CMD_VACATION; c.on = on;
+  return submitCommand(c);
+}
+
+bool submitScheduleEntry(uint8_t program, uint8_t index, const ScheduleEntry& entry) {
+  Command c = {};
+  c.type = CMD_SCHEDULE_ENTRY; c.program = program; c.index = index; c.entry = entry;
+  return submitCommand(c);
+}
+
+bool submitLockoutReset() {
+  Command c = {};
+  c.type = CMD_LOCKOUT_RESET;
+  return submitCommand(c);
+}
+
+uint32_t commandQueueDepth() { return queue.depth(); }
+
+// =================================================================
+// ==                       CONTROL TASK                          ==
+// =================================================================
+static bool targetInRange(CentiC target) { return target >= HOLD_MIN_TARGET && target <= HOLD_MAX_TARGET; }
+
+// Without a hold time, the hold lasts until the schedule's target next changes.
+static bool applySetpointHold(const Command& c) {
+  if (!targetInRange(c.target)) return false;
+  ControlMillis now = currentTime();
+  setpointHold.active = true;
+  setpointHold.target = c.target;
+  setpointHold.expires = true;
+  setpointHold.until = now + c.holdMinutes * 60000UL;
+  if (!c.holdMinutes) {
+    TimeInfo wall = getCurrentTime();
+    deviceController.now = now;
+    activeScheduleEntry(deviceController, 0, wall); // Compiles a pending edit
+    ScheduleChange change;
+    setpointHold.expires = !vacationModeActive && findNextTargetChange(deviceController.compiledSchedule[0], wall, HOLD_HORIZON_SECS, &change);
+    if (setpointHold.expires) setpointHold.until = now + (ControlMillis)(change.secondsUntil * 1000);
+  }
+  log_manual_adjustment(centiCToUnit(c.target, FAHRENHEIT));
+  return true;
+}
+
+static bool applyScheduleEntry(const Command& c) {
+  const ScheduleEntry& e = c.entry;
+  if (c.program >= NUM_SCHEDULE_PROGRAMS || e.startHour > 23 || e.startMinute > 59 || e.fanMode > FAN_CIRCULATE || !targetInRange(e.target)) return false;
+  ScheduleEntry* entries;
+  uint8_t* count;
+  uint8_t vacationCount = 1;
+  int capacity;
+  switch (c.program) {
+    case PROGRAM_WEEKDAY:  entries = programSchedule.weekday; count = &programSchedule.weekdayEntryCount; capacity = MAX_DAY_ENTRIES; break;
+    case PROGRAM_WEEKEND:  entries = programSchedule.weekend; count = &programSchedule.weekendEntryCount; capacity = MAX_DAY_ENTRIES; break;
+    case PROGRAM_VACATION: entries = &programSchedule.vacation; count = &vacationCount; capacity = 1; break;
+    default: {
+      int day = c.program - PROGRAM_DAY_OVERRIDE;
+      entries = programSchedule.dayOverride[day]; count = &programSchedule.dayOverrideCount[day]; capacity = MAX_DAY_OVERRIDE_ENTRIES;
+    }
+  }
+  if (c.index > *count || c.index >= capacity) return false;
+  entries[c.index] = e;
+  if (c.index == *count) (*count)++;
+  markScheduleEdited(deviceController, 0);
+  markSettingsDirty(REC_SCHEDULE);
+  return true;
+}
+
+static bool applyCommand(const Command& c) {
+  switch (c.type) {
+    case CMD_SETPOINT_HOLD:
+      return applySetpointHold(c);
+    case CMD_RESUME_SCHEDULE:
+      setpointHold.active = false;
+      return true;
+    case CMD_SYSTEM_MODE:
+      if (c.mode < SYS_OFF || c.mode > SYS_AUTO) return false;
+      if (systemMode != c.mode) { systemMode = c.mode; markSettingsDirty(REC_SYSTEM_MODE); }
+      return true;
+    case CMD_VACATION:
+      setpointHold.active = false;
+      if (vacationModeActive != c.on) { vacationModeActive = c.on; markSettingsDirty(REC_VACATION); }
+      return true;
+    case CMD_SCHEDULE_ENTRY:
+      return applyScheduleEntry(c);
+    case CMD_LOCKOUT_RESET: {
+      ControllerBatch& b = deviceController;
+      b.systemLockedOut[0] = false;
+      b.heaterMaxRunTriggers[0] = b.coolerMaxRunTriggers[0] = 0;
+      b.firstHeaterMaxRunTriggerTime[0] = b.firstCoolerMaxRunTriggerTime[0] = 0;
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+// At most a queue's worth per pass, so a flood of commands cannot stretch
+// one pass; whatever is left wakes the next pass at once.
+int drainCommands() {
+  uint32_t depth = queue.depth();
+  if (depth > commandStats.maxDepth) commandStats.maxDepth = depth;
+  int applied = 0;
+  Command c;
+  for (int n = 0; n < COMMAND_QUEUE_DEPTH && queue.pop(&c); n++) {
+    if (!applyCommand(c)) { commandStats.rejected++; continue; }
+    commandStats.applied[c.type]++;
+    if (appliedCount < COMMAND_QUEUE_DEPTH) appliedCycles[appliedCount++] = c.submittedCycles;
+    applied++;
+  }
+  // A lockout reset or any other command changes state the trace records do
+  // not carry, so this pass's record restates it all for replay.
+  if (applied) { commandStats.drains++; requestTraceKeyframe(); }
+  if (queue.depth()) wakeScheduler();
+  return applied;
+}
+
+void noteCommandsDecided() {
+  uint32_t now = esp_cpu_get_cycle_count();
+  for (int n = 0; n < appliedCount; n++) recordProbe(PROBE_COMMAND_LATENCY, now - appliedCycles[n]);
+  appliedCount = 0;
+}
+
+bool setpointHeld() {
+  if (setpointHold.active && setpointHold.expires && (int32_t)((ControlMillis)currentTime() - setpointHold.until) >= 0) setpointHold.active = false;
+  return setpointHold.active;
+}
+
+void planHoldExpiry(WakePlan& plan, ControlMillis now) {
+  if (!setpointHold.active || !setpointHold.expires || (int32_t)(setpointHold.until - now) <= 0) return;
+  if ((int32_t)(setpointHold.until - plan.wakeAt) < 0) { plan.wakeAt = setpointHold.until; plan.reason = WAKE_SCHEDULE; }
+}
+
+void resetCommands() {
+  Command c;
+  while (queue.pop(&c)) {}
+  appliedCount = 0;
+  setpointHold = SetpointHold();
+  commandStats = CommandStats();
+}
@@ -0,0 +1,148 @@
+#include "console.h"
+#include <Arduino.h>
+#include "config.h"
+#include "commands.h"
+#include "controller.h"
+#include "main.h"
+#include "hvac_tests.h"
+#include "probes.h"
+#include "relays.h"
+#include "scheduler.h"
+#include "sensors.h"
+#include "thermal_model.h"
+#include "timeseries.h"
+#include "utils.h"
+#include "warmstart.h"
+#include "esp_system.h"
+
+// The self-tests overwrite NVS settings, learned rates and flash logs with
+// synthetic data, so only a host build (mock NVS and a RAM SPIFFS) runs them
+// from the console.
+#ifndef HVAC_SELFTEST_COMMAND
+#define HVAC_SELFTEST_COMMAND 0
+#endif
+
+extern CentiC currentTargetTemperature;
+
+static char lineBuffer[CONSOLE_LINE_MAX];
+static int lineLength = 0;
+
+void startConsole() {
+  Serial.onReceive([]() { wakeScheduler(); });
+}
+
+void pollConsole() {
+  while (Serial.available() > 0) {
+    int c = Serial.read();
+    if (c == '\r' || c == '\n') {
+      if (lineLength == 0) continue;
+      lineBuffer[lineLength] = '\0';
+      lineLength = 0;
+      if (!handleConsoleCommand(lineBuffer)) Serial.printf("Unknown command '%s'; try 'help'\n", lineBuffer);
+    } else if (lineLength < CONSOLE_LINE_MAX - 1) {
+      lineBuffer[lineLength++] = (char)c;
+    }
+  }
+}
+
+bool handleConsoleCommand(const char* line) {
+  if (!strcmp(line, "probes")) {
+    char out[128];
+    for (int stage = 0; stage < NUM_PROBES; stage++) {
+      formatProbeLine((ProbeStage)stage, out, sizeof(out));
+      Serial.println(out);
+    }
+    return true;
+  }
+  if (!strcmp(line, "probes reset")) { resetProbes(); Serial.println("Probes reset"); return true; }
+  if (!strcmp(line, "boot")) {
+    Serial.printf("%s start, first decision %lu ms (%lu us executing) after setup()\n", bootStats.warm ? "Warm" : "Cold",
+                  bootStats.decisionMs - bootStats.setupMs, bootStats.decisionUs - bootStats.setupUs);
+    return true;
+  }
+  if (!strcmp(line, "model")) {
+    const ThermalModel& m = deviceController.thermalModel[0];
+    Serial.printf("Loss %.3f/h, heat %.2f C/h, cool %.2f C/h, internal %.2f C/h; %lu updates (%u heating, %u cooling)\n",
+                  m.theta[THERMAL_LOSS], m.theta[THERMAL_HEAT_GAIN], m.theta[THERMAL_COOL_GAIN], m.theta[THERMAL_INTERNAL_GAIN],
+                  (unsigned long)m.updates, m.heatSamples, m.coolSamples);
+    SensorSnapshot sensors = sensorSnapshot();
+    ThermalPrediction p = predictTimeToTarget(sensors.indoorCentiC, currentTargetTemperature, sensors.outdoorCentiC);
+    if (p.reachable) Serial.printf("To target: %lu min, %u%% confidence\n", (unsigned long)(p.seconds / 60), p.confidence);
+    else Serial.println("To target: out of reach at this outdoor temperature");
+    return true;
+  }
+  if (!strcmp(line, "relays")) {
+    static const struct { int pin; const char* name; } RELAYS[] = {
+      { HEATER_RELAY_PIN, "heater" }, { COOLER_RELAY_PIN, "cooler" }, { FAN_RELAY_PIN, "fan" },
+      { FRESH_AIR_RELAY_PIN, "fresh air" }, { HUMIDITY_RELAY_PIN, "humidifier" } };
+    for (const auto& r : RELAYS) {
+      Serial.printf("%-10s %s, %lu transitions since boot\n", r.name, (committedRelays() & RELAY_BIT(r.pin)) ? "on " : "off",
+                    relayStats.transitions[r.pin]);
+    }
+    Serial.printf("%lu commits, %lu register writes, interlock trips: %lu heat+cool, %lu fan\n", relayStats.commits, relayStats.writes,
+                  relayStats.heatCoolTrips, relayStats.fanTrips);
+    return true;
+  }
+  if (!strncmp(line, "runtime", 7) && (line[7] == '\0' || line[7] == ' ')) {
+    static const char* const NAMES[NUM_SERIES_RELAYS] = { "heater", "cooler", "fan", "fresh air", "humidifier" };
+    long hours = line[7] ? atol(line + 8) : 24;
+    if (hours <= 0) hours = 24;
+    uint32_t to = seriesNowMinute() + 1;
+    uint32_t span = (uint32_t)std::min(hours * 60L, (long)to);
+    SeriesTotals t;
+    if (!querySeries(to - span, to, t)) { Serial.println("No runtime recorded in that window"); return true; }
+    for (int r = 0; r < NUM_SERIES_RELAYS; r++) {
+      Serial.printf("%-10s %6.1f h, %5.1f%% duty, %lu starts\n", NAMES[r], t.onMilliseconds[r] / 3.6e6,
+                    t.milliseconds ? 100.0 * t.onMilliseconds[r] / t.milliseconds : 0.0, (unsigned long)t.starts[r]);
+    }
+    Serial.printf("%.1f h recorded of %ld: %lu Wh used, %lu Wh saved by the economizer\n", t.milliseconds / 3.6e6, hours,
+                  (unsigned long)seriesEnergyWh(t), (unsigned long)economizerSavingsWh(t));
+    return true;
+  }
+  // Settings go through the command queue like any other producer's, and are
+  // applied at the start of this same pass.
+  float holdTemp;
+  unsigned holdMinutes = 0;
+  if (sscanf(line, "hold %f %u", &holdTemp, &holdMinutes) >= 1) {
+    CentiC target = tempUnit == FAHRENHEIT ? centiCFromF(holdTemp) : (CentiC)lroundf(holdTemp * 100);
+    bool queued = submitSetpointHold(target, (uint16_t)std::min(holdMinutes, 65535u));
+    Serial.println(queued ? "Hold queued" : "Command queue full");
+    return true;
+  }
+  static const char* const MODES[] = { "off", "heat", "cool", "auto" };
+  for (int m = SYS_OFF; m <= SYS_AUTO; m++) {
+    if (!strncmp(line, "mode ", 5) && !strcmp(line + 5, MODES[m])) { Serial.println(submitSystemMode((SystemMode)m) ? "Mode queued" : "Command queue full"); return true; }
+  }
+  if (!strcmp(line, "vacation on") || !strcmp(line, "vacation off")) { Serial.println(submitVacation(line[10] == 'n') ? "Vacation queued" : "Command queue full"); return true; }
+  if (!strcmp(line, "resume")) { Serial.println(submitResumeSchedule() ? "Resume queued" : "Command queue full"); return true; }
+  if (!strcmp(line, "unlock")) { Serial.println(submitLockoutReset() ? "Lockout reset queued" : "Command queue full"); return true; }
+  if (!strcmp(line, "commands")) {
+    const CommandStats& s = commandStats;
+    unsigned long applied = 0;
+    for (int t = 0; t < NUM_COMMAND_TYPES; t++) applied += s.applied[t];
+    Serial.printf("%lu submitted, %lu applied in %lu passes, %lu rejected, %lu refused full; depth %lu now, %lu at most\n", s.submitted, applied,
+                  s.drains, s.rejected, s.full, (unsigned long)commandQueueDepth(), (unsigned long)s.maxDepth);
+    if (setpointHold.active) {
+      Serial.printf("Holding %.1f %s", centiCToUnit(setpointHold.target, tempUnit), tempUnit == FAHRENHEIT ? "F" : "C");
+      if (setpointHold.expires) Serial.printf(" for %lu more min\n", (unsigned long)((ControlMillis)(setpointHold.until - currentTime()) / 60000));
+      else Serial.println(" until resumed");
+    }
+    char out[128];
+    formatProbeLine(PROBE_COMMAND_LATENCY, out, sizeof(out));
+    Serial.println(out);
+    return true;
+  }
+  if (!strcmp(line, "selftest")) {
+#if HVAC_SELFTEST_COMMAND
+    // The suite drives the live controller through the mocks, so restart cold afterwards.
+    Serial.printf("Self-tests: %d failed; restarting\n", runTests());
+    invalidateWarmState();
+    esp_restart();
+#else
+    Serial.println("Self-tests overwrite stored settings and history; run them on the host build (ctest)");
+#endif
+    return true;
+  }
+  if (!strcmp(line, "help")) { Serial.println("Commands: probes, probes reset, boot, model, relays, runtime [hours], hold <temp> [minutes], resume, mode off|heat|cool|auto, vacation on|off, unlock, commands, selftest, help"); return true; }
+  return false;
+}
@@ -1,151 +1,213 @@
 #include "hvac_logic.h"
 #include <Arduino.h>
-#include <cmath>
 #include "config.h"
+#include "controller.h"
 #include "main.h"
+#include "persistence.h"
+#include "psychrometrics.h"
+#include "sensors.h"
 #include "utils.h"
 
-// -- Global State Variables for this module --
-unsigned long lastHeaterOnTime = 0, lastHeaterOffTime = 0;
-unsigned long lastCoolerOnTime = 0, lastCoolerOffTime = 0;
-unsigned long lastFanCycleTime = 0;
-bool isFanCirculating = false;
-float cycleStartTempF = 0;
-float cycleStartOutdoorTempF = 0;
-unsigned long cycleStartTime = 0;
-int heaterMaxRunTriggers = 0;
-unsigned long firstHeaterMaxRunTriggerTime = 0;
-int coolerMaxRunTriggers = 0;
-unsigned long firstCoolerMaxRunTriggerTime = 0;
-
-// Convert minutes to milliseconds for internal use
-const unsigned long MIN_HEATER_RUN_TIME_MS = MIN_HEATER_RUN_TIME_MINS * 60 * 1000;
-const unsigned long MIN_HEATER_OFF_TIME_MS = MIN_HEATER_OFF_TIME_MINS * 60 * 1000;
-const unsigned long MAX_HEATER_RUN_TIME_MS = MAX_HEATER_RUN_TIME_MINS * 60 * 1000;
-const unsigned long MIN_COOLER_RUN_TIME_MS = MIN_COOLER_RUN_TIME_MINS * 60 * 1000;
-const unsigned long MIN_COOLER_OFF_TIME_MS = MIN_COOLER_OFF_TIME_MINS * 60 * 1000;
-const unsigned long MAX_COOLER_RUN_TIME_MS = MAX_COOLER_RUN_TIME_MINS * 60 * 1000;
-const unsigned long FAN_CIRCULATE_ON_TIME_MS = FAN_CIRCULATE_ON_TIME_MINS * 60 * 1000;
-const unsigned long FAN_CIRCULATE_OFF_TIME_MS = FAN_CIRCULATE_OFF_TIME_MINS * 60 * 1000;
-const unsigned long MAX_RUN_LOCKOUT_MS = MAX_RUN_LOCKOUT_HOURS * 60 * 60 * 1000;
+void initialize_logic_timers(ControllerBatch& b, int i, ControlMillis now) {
+  b.lastHeaterOffTime[i] = now - (MIN_HEATER_OFF_TIME_MS + 1000);
+  b.lastCoolerOffTime[i] = now - (MIN_COOLER_OFF_TIME_MS + 1000);
+  b.lastFanCycleTime[i] = now;
+}
 
-void initialize_logic_timers() {
-  unsigned long now = currentTime();
-  lastHeaterOffTime = now - (MIN_HEATER_OFF_TIME_MS + 1000);
-  lastCoolerOffTime = now - (MIN_COOLER_OFF_TIME_MS + 1000);
-  lastFanCycleTime = now;
+// Upper edge of each outdoor bin but the last: 10 F, 20 F, ... 70 F.
+static constexpr CentiC PERFORMANCE_BIN_EDGES[NUM_PERFORMANCE_BINS - 1] = {
+  centiCFromF(10), centiCFromF(20), centiCFromF(30), centiCFromF(40), centiCFromF(50), centiCFromF(60), centiCFromF(70)
+};
+
+int getPerformanceBin(CentiC outdoor) {
+    int bin = 0;
+    while (bin < NUM_PERFORMANCE_BINS - 1 && outdoor >= PERFORMANCE_BIN_EDGES[bin]) bin++;
+    return bin;
 }
 
-int getPerformanceBin(float tempF) {
-    if (tempF < 10) return 0; if (tempF < 20) return 1;
-    if (tempF < 30) return 2; if (tempF < 40) return 3;
-    if (tempF < 50) return 4; if (tempF < 60) return 5;
-    if (tempF < 70) return 6; return 7;
+// Learned rates are a running mean in CentiC per hour, rounded at each step.
+static void addRateSample(uint16_t& rate, uint16_t& samples, int32_t sample) {
+    if (samples < UINT16_MAX) samples++;
+    int32_t delta = sample - rate;
+    rate = (uint16_t)(rate + (delta + (delta >= 0 ? samples / 2 : -(samples / 2))) / samples);
 }
 
-void updatePerformanceData(bool isHeating) {
-    if (cycleStartTime == 0) return;
-    unsigned long durationMs = currentTime() - cycleStartTime;
+void updatePerformanceData(ControllerBatch& b, int i, bool isHeating, CentiC current) {
+    if (!b.cycleInProgress[i]) return;
+    ControlMillis durationMs = b.now - b.cycleStartTime[i];
     if (durationMs < (MIN_HEATER_RUN_TIME_MS - 1000)) return;
 
-    float currentTempF = readTemperature(); // readTemperature already returns the correct unit (Fahrenheit by default)
-    float tempChangeF = abs(currentTempF - cycleStartTempF);
-    float durationHours = (float)durationMs / (1000.0 * 60.0 * 60.0);
-    float rateF_PerHour = tempChangeF / durationHours;
-
-    int bin = getPerformanceBin(cycleStartOutdoorTempF);
-    int season = getCurrentSeason();
-
-    if (isHeating) {
-        int oldCount = performance.heatSamples[season][bin];
-        performance.heatRate[season][bin] = ((performance.heatRate[season][bin] * oldCount) + rateF_PerHour) / (oldCount + 1);
-        performance.heatSamples[season][bin]++;
-    } else {
-        int oldCount = performance.coolSamples[season][bin];
-        performance.coolRate[season][bin] = ((performance.coolRate[season][bin] * oldCount) + rateF_PerHour) / (oldCount + 1);
-        performance.coolSamples[season][bin]++;
-    }
-    saveSettings();
-    cycleStartTime = 0;
+    // Whole seconds keep the product in 32 bits: |change| < 2^16, duration over MIN_HEATER_RUN_TIME_MS.
+    uint32_t change = (uint32_t)abs(current - b.cycleStartTemp[i]);
+    uint32_t ratePerHour = std::min(change * 3600UL / (durationMs / 1000), (unsigned long)UINT16_MAX);
+
+    int bin = getPerformanceBin(b.cycleStartOutdoorTemp[i]);
+    int season = b.season;
+    HvacPerformance& perf = b.performance[i];
+
+    if (isHeating) addRateSample(perf.heatRate[season][bin], perf.heatSamples[season][bin], (int32_t)ratePerHour);
+    else addRateSample(perf.coolRate[season][bin], perf.coolSamples[season][bin], (int32_t)ratePerHour);
+    b.performanceDirty[i] |= PERF_DIRTY_BIT(isHeating, season);
+    b.recovery[i].rateValid = false;
+    b.cycleInProgress[i] = false;
+}
+
+bool enforceLockout(ControllerBatch& b, int i) {
+  if (!b.systemLockedOut[i]) return false;
+  if(relayOn(b, i, HEATER_RELAY_PIN)) setRelay(b, i, HEATER_RELAY_PIN, LOW);
+  if(relayOn(b, i, COOLER_RELAY_PIN)) setRelay(b, i, COOLER_RELAY_PIN, LOW);
+  if(relayOn(b, i, FRESH_AIR_RELAY_PIN)) setRelay(b, i, FRESH_AIR_RELAY_PIN, LOW);
+  return true;
+}
+
+void countMaxRunTrip(ControllerBatch& b, int i, bool isHeating) {
+  ControlMillis now = b.now;
+  int& triggers = isHeating ? b.heaterMaxRunTriggers[i] : b.coolerMaxRunTriggers[i];
+  ControlMillis& firstTrigger = isHeating ? b.firstHeaterMaxRunTriggerTime[i] : b.firstCoolerMaxRunTriggerTime[i];
+  if (triggers > 0 && (now - firstTrigger > MAX_RUN_LOCKOUT_MS)) { triggers = 1; firstTrigger = now; }
+  else { if (triggers == 0) firstTrigger = now; triggers++; if (triggers >= MAX_RUN_TRIGGER_COUNT) { b.systemLockedOut[i] = true; } }
 }
 
-void controlTemperature(float tempC, float targetTempC, float outdoorTempC) {
-  if (systemLockedOut) {
-    if(readRelay(HEATER_RELAY_PIN)) writeRelay(HEATER_RELAY_PIN, LOW);
-    if(readRelay(COOLER_RELAY_PIN)) writeRelay(COOLER_RELAY_PIN, LOW);
-    if(readRelay(FRESH_AIR_RELAY_PIN)) writeRelay(FRESH_AIR_RELAY_PIN, LOW);
-    return;
+// A mode change can take the call away from a running stage: SYS_OFF or the
+// other direction, or AUTO with the damper open the other way. Neither half
+// below decides for it then, so it is stopped here once it has had its
+// minimum run, and past its maximum run it counts toward the lockout as usual.
+bool releaseStage(ControllerBatch& b, int i, const RelaySnapshot& pass, CentiC tempC) {
+  ControlMillis now = b.now;
+  SystemMode mode = b.systemMode[i];
+  bool heatCalled = mode == SYS_HEAT || (mode == SYS_AUTO && !pass.cooling && !(pass.freshAir && !b.freshAirForHeating[i]));
+  bool coolCalled = mode == SYS_COOL || (mode == SYS_AUTO && !pass.heating && !(pass.freshAir && b.freshAirForHeating[i]));
+  if (pass.heating && !heatCalled && now - b.lastHeaterOnTime[i] > MIN_HEATER_RUN_TIME_MS) {
+    setRelay(b, i, HEATER_RELAY_PIN, LOW); b.lastHeaterOffTime[i] = now; updatePerformanceData(b, i, true, tempC);
+    if (now - b.lastHeaterOnTime[i] > MAX_HEATER_RUN_TIME_MS) countMaxRunTrip(b, i, true);
+    return true;
   }
+  if (pass.cooling && !coolCalled && now - b.lastCoolerOnTime[i] > MIN_COOLER_RUN_TIME_MS) {
+    setRelay(b, i, COOLER_RELAY_PIN, LOW); b.lastCoolerOffTime[i] = now; updatePerformanceData(b, i, false, tempC);
+    if (now - b.lastCoolerOnTime[i] > MAX_COOLER_RUN_TIME_MS) countMaxRunTrip(b, i, false);
+    return true;
+  }
+  return false;
+}
 
-  unsigned long now = currentTime();
-  bool isHeatingOn = readRelay(HEATER_RELAY_PIN);
-  bool isCoolingOn = readRelay(COOLER_RELAY_PIN);
-  bool isFreshAirOn = readRelay(FRESH_AIR_RELAY_PIN);
-  
-  float tempDeadbandC = (tempUnit == FAHRENHEIT) ? fahrenheitToCelsius(32.0 + TEMPERATURE_DEADBAND_F) - fahrenheitToCelsius(32.0) : TEMPERATURE_DEADBAND_F;
-  float freshAirDiffC = (tempUnit == FAHRENHEIT) ? fahrenheitToCelsius(32.0 + FRESH_AIR_TEMP_DIFFERENTIAL_F) - fahrenheitToCelsius(32.0) : FRESH_AIR_TEMP_DIFFERENTIAL_F;
-
-  if (systemMode == SYS_HEAT || (systemMode == SYS_AUTO && !isCoolingOn && !isFreshAirOn)) {
-    if (isHeatingOn && (now - lastHeaterOnTime > MAX_HEATER_RUN_TIME_MS)) {
-        writeRelay(HEATER_RELAY_PIN, LOW); lastHeaterOffTime = now; updatePerformanceData(true);
-        if (heaterMaxRunTriggers > 0 && (now - firstHeaterMaxRunTriggerTime > MAX_RUN_LOCKOUT_MS)) { heaterMaxRunTriggers = 1; firstHeaterMaxRunTriggerTime = now; } 
-        else { if (heaterMaxRunTriggers == 0) firstHeaterMaxRunTriggerTime = now; heaterMaxRunTriggers++; if (heaterMaxRunTriggers >= MAX_RUN_TRIGGER_COUNT) { systemLockedOut = true; } }
+RelaySnapshot relaySnapshot(const ControllerBatch& b, int i) {
+  return { relayOn(b, i, HEATER_RELAY_PIN), relayOn(b, i, COOLER_RELAY_PIN), relayOn(b, i, FRESH_AIR_RELAY_PIN) };
+}
+
+void controlHeating(ControllerBatch& b, int i, const RelaySnapshot& pass, CentiC tempC, CentiC targetTempC, CentiC outdoorTempC) {
+  ControlMillis now = b.now;
+  bool isHeatingOn = pass.heating, isCoolingOn = pass.cooling, isFreshAirOn = pass.freshAir;
+  CentiC tempDeadbandC = temperatureDeadband(b.tempUnit[i]);
+  CentiC freshAirDiffC = freshAirDifferential(b.tempUnit[i]);
+
+  if (b.systemMode[i] == SYS_HEAT || (b.systemMode[i] == SYS_AUTO && !isCoolingOn && !(isFreshAirOn && !b.freshAirForHeating[i]))) {
+    if (isHeatingOn && (now - b.lastHeaterOnTime[i] > MAX_HEATER_RUN_TIME_MS)) {
+        setRelay(b, i, HEATER_RELAY_PIN, LOW); b.lastHeaterOffTime[i] = now; updatePerformanceData(b, i, true, tempC);
+        countMaxRunTrip(b, i, true);
     } else if (tempC >= targetTempC && (isHeatingOn || isFreshAirOn)) {
-      if (isHeatingOn && (now - lastHeaterOnTime > MIN_HEATER_RUN_TIME_MS)) { writeRelay(HEATER_RELAY_PIN, LOW); lastHeaterOffTime = now; updatePerformanceData(true); } 
-      else if(isFreshAirOn) { writeRelay(FRESH_AIR_RELAY_PIN, LOW); }
+      if (isHeatingOn && (now - b.lastHeaterOnTime[i] > MIN_HEATER_RUN_TIME_MS)) { setRelay(b, i, HEATER_RELAY_PIN, LOW); b.lastHeaterOffTime[i] = now; updatePerformanceData(b, i, true, tempC); } 
+      else if(isFreshAirOn) { setRelay(b, i, FRESH_AIR_RELAY_PIN, LOW); }
     } else if (tempC < (targetTempC - tempDeadbandC) && !isHeatingOn) {
-      if (outdoorTempC > (tempC + freshAirDiffC)) { writeRelay(FRESH_AIR_RELAY_PIN, HIGH); writeRelay(HEATER_RELAY_PIN, LOW); } 
-      else { if (now - lastHeaterOffTime > MIN_HEATER_OFF_TIME_MS) { if (!readRelay(COOLER_RELAY_PIN)) { writeRelay(HEATER_RELAY_PIN, HIGH); lastHeaterOnTime = now; cycleStartTime = now; cycleStartTempF = celsiusToFahrenheit(tempC); cycleStartOutdoorTempF = celsiusToFahrenheit(outdoorTempC); } } }
+      if (outdoorTempC > (tempC + freshAirDiffC)) { setRelay(b, i, FRESH_AIR_RELAY_PIN, HIGH); setRelay(b, i, HEATER_RELAY_PIN, LOW); b.freshAirForHeating[i] = true; } 
+      else { if (now - b.lastHeaterOffTime[i] > MIN_HEATER_OFF_TIME_MS) { if (!relayOn(b, i, COOLER_RELAY_PIN)) { setRelay(b, i, HEATER_RELAY_PIN, HIGH); b.lastHeaterOnTime[i] = now; b.cycleStartTime[i] = now; b.cycleInProgress[i] = true; b.cycleStartTemp[i] = tempC; b.cycleStartOutdoorTemp[i] = outdoorTempC; } } }
     } 
   }
+}
+
+void controlCooling(ControllerBatch& b, int i, const RelaySnapshot& pass, CentiC tempC, CentiC targetTempC, CentiC outdoorTempC) {
+  ControlMillis now = b.now;
+  bool isHeatingOn = pass.heating, isCoolingOn = pass.cooling, isFreshAirOn = pass.freshAir;
+  CentiC tempDeadbandC = temperatureDeadband(b.tempUnit[i]);
+  CentiC freshAirDiffC = freshAirDifferential(b.tempUnit[i]);
 
-  if (systemMode == SYS_COOL || (systemMode == SYS_AUTO && !isHeatingOn && !isFreshAirOn)) {
-    if (isCoolingOn && (now - lastCoolerOnTime > MAX_COOLER_RUN_TIME_MS)) {
-        writeRelay(COOLER_RELAY_PIN, LOW); lastCoolerOffTime = now; updatePerformanceData(false);
-        if (coolerMaxRunTriggers > 0 && (now - firstCoolerMaxRunTriggerTime > MAX_RUN_LOCKOUT_MS)) { coolerMaxRunTriggers = 1; firstCoolerMaxRunTriggerTime = now; } 
-        else { if (coolerMaxRunTriggers == 0) firstCoolerMaxRunTriggerTime = now; coolerMaxRunTriggers++; if (coolerMaxRunTriggers >= MAX_RUN_TRIGGER_COUNT) { systemLockedOut = true; } }
+  if (b.systemMode[i] == SYS_COOL || (b.systemMode[i] == SYS_AUTO && !isHeatingOn && !(isFreshAirOn && b.freshAirForHeating[i]))) {
+    if (isCoolingOn && (now - b.lastCoolerOnTime[i] > MAX_COOLER_RUN_TIME_MS)) {
+        setRelay(b, i, COOLER_RELAY_PIN, LOW); b.lastCoolerOffTime[i] = now; updatePerformanceData(b, i, false, tempC);
+        countMaxRunTrip(b, i, false);
     } else if (tempC <= targetTempC && (isCoolingOn || isFreshAirOn)) {
-      if (isCoolingOn && (now - lastCoolerOnTime > MIN_COOLER_RUN_TIME_MS)) { writeRelay(COOLER_RELAY_PIN, LOW); lastCoolerOffTime = now; updatePerformanceData(false); } 
-      else if (isFreshAirOn) { writeRelay(FRESH_AIR_RELAY_PIN, LOW); }
+      if (isCoolingOn && (now - b.lastCoolerOnTime[i] > MIN_COOLER_RUN_TIME_MS)) { setRelay(b, i, COOLER_RELAY_PIN, LOW); b.lastCoolerOffTime[i] = now; updatePerformanceData(b, i, false, tempC); } 
+      else if (isFreshAirOn) { setRelay(b, i, FRESH_AIR_RELAY_PIN, LOW); }
     } else if (tempC > (targetTempC + tempDeadbandC) && !isCoolingOn) {
-      if (outdoorTempC < (tempC - freshAirDiffC)) { writeRelay(FRESH_AIR_RELAY_PIN, HIGH); writeRelay(COOLER_RELAY_PIN, LOW); } 
-      else { if (now - lastCoolerOffTime > MIN_COOLER_OFF_TIME_MS) { if (!readRelay(HEATER_RELAY_PIN)) { writeRelay(COOLER_RELAY_PIN, HIGH); lastCoolerOnTime = now; cycleStartTime = now; cycleStartTempF = celsiusToFahrenheit(tempC); cycleStartOutdoorTempF = celsiusToFahrenheit(outdoorTempC); } } }
+      if (outdoorTempC < (tempC - freshAirDiffC)) { setRelay(b, i, FRESH_AIR_RELAY_PIN, HIGH); setRelay(b, i, COOLER_RELAY_PIN, LOW); b.freshAirForHeating[i] = false; } 
+      else { if (now - b.lastCoolerOffTime[i] > MIN_COOLER_OFF_TIME_MS) { if (!relayOn(b, i, HEATER_RELAY_PIN)) { setRelay(b, i, COOLER_RELAY_PIN, HIGH); b.lastCoolerOnTime[i] = now; b.cycleStartTime[i] = now; b.cycleInProgress[i] = true; b.cycleStartTemp[i] = tempC; b.cycleStartOutdoorTemp[i] = outdoorTempC; } } }
     }
   }
 }
 
-void controlFan(FanMode fanMode) {
-  unsigned long now = currentTime();
-  bool isHeatCoolOrFreshAirActive = (readRelay(HEATER_RELAY_PIN) || readRelay(COOLER_RELAY_PIN) || readRelay(FRESH_AIR_RELAY_PIN));
+void controlTemperature(ControllerBatch& b, int i, CentiC temp, CentiC target, CentiC outdoor) {
+  if (enforceLockout(b, i)) return;
+  RelaySnapshot pass = relaySnapshot(b, i);
+  if (releaseStage(b, i, pass, temp)) return;
+  controlHeating(b, i, pass, temp, target, outdoor);
+  controlCooling(b, i, pass, temp, target, outdoor);
+}
+
+void controlFan(ControllerBatch& b, int i, FanMode fanMode) {
+  ControlMillis now = b.now;
+  bool isHeatCoolOrFreshAirActive = (relayOn(b, i, HEATER_RELAY_PIN) || relayOn(b, i, COOLER_RELAY_PIN) || relayOn(b, i, FRESH_AIR_RELAY_PIN));
 
-  if (isHeatCoolOrFreshAirActive) { if (!readRelay(FAN_RELAY_PIN)) { writeRelay(FAN_RELAY_PIN, HIGH); } return; }
+  if (isHeatCoolOrFreshAirActive) { if (!relayOn(b, i, FAN_RELAY_PIN)) { setRelay(b, i, FAN_RELAY_PIN, HIGH); } return; }
   
   switch(fanMode) {
-    case FAN_ON: if (!readRelay(FAN_RELAY_PIN)) { writeRelay(FAN_RELAY_PIN, HIGH); } break;
+    case FAN_ON: if (!relayOn(b, i, FAN_RELAY_PIN)) { setRelay(b, i, FAN_RELAY_PIN, HIGH); } break;
     case FAN_CIRCULATE:
-      if (isFanCirculating) { if (now - lastFanCycleTime >= FAN_CIRCULATE_ON_TIME_MS) { writeRelay(FAN_RELAY_PIN, LOW); isFanCirculating = false; lastFanCycleTime = now; } } 
-      else { if (now - lastFanCycleTime >= FAN_CIRCULATE_OFF_TIME_MS) { writeRelay(FAN_RELAY_PIN, HIGH); isFanCirculating = true; lastFanCycleTime = now; } }
+      if (b.isFanCirculating[i]) { if (now - b.lastFanCycleTime[i] >= FAN_CIRCULATE_ON_TIME_MS) { setRelay(b, i, FAN_RELAY_PIN, LOW); b.isFanCirculating[i] = false; b.lastFanCycleTime[i] = now; } } 
+      else { if (now - b.lastFanCycleTime[i] >= FAN_CIRCULATE_OFF_TIME_MS) { setRelay(b, i, FAN_RELAY_PIN, HIGH); b.isFanCirculating[i] = true; b.lastFanCycleTime[i] = now; } }
       break;
-    case FAN_AUTO: default: if (readRelay(FAN_RELAY_PIN)) { writeRelay(FAN_RELAY_PIN, LOW); } break;
+    case FAN_AUTO: default: if (relayOn(b, i, FAN_RELAY_PIN)) { setRelay(b, i, FAN_RELAY_PIN, LOW); } break;
   }
 }
 
 float calculateMaxHumidityForWindow(float indoorTempC, float outdoorTempC) {
-  float estimatedWindowTemp = outdoorTempC + WINDOW_EFFICIENCY_FACTOR * (indoorTempC - outdoorTempC);
-  float targetDewPoint = estimatedWindowTemp - 2.0;
-  double a = 17.625, b = 243.04;
-  double alpha_td = (a * targetDewPoint) / (b + targetDewPoint);
-  double alpha_t = (a * indoorTempC) / (b + indoorTempC);
-  double maxRH = 100.0 * exp(alpha_td - alpha_t);
-  if (maxRH > 95.0) return 95.0; if (maxRH < 10.0) return 10.0;
-  return (float)maxRH;
-}
-
-void controlHumidity(float humidity, float indoorTempC, float outdoorTempC) {
-  float maxHumidityLimit = calculateMaxHumidityForWindow(indoorTempC, outdoorTempC);
-  float effectiveTarget = std::min(HUMIDITY_TARGET, maxHumidityLimit);
-  bool isHumidityControlOn = readRelay(HUMIDITY_RELAY_PIN);
-
-  if (humidity < (effectiveTarget - HUMIDITY_DEADBAND) && !isHumidityControlOn) { writeRelay(HUMIDITY_RELAY_PIN, HIGH); } 
-  else if (humidity >= effectiveTarget && isHumidityControlOn) { writeRelay(HUMIDITY_RELAY_PIN, LOW); }
-}
\ No newline at end of file
+  return maxHumidityForWindow(toCentiC(indoorTempC), toCentiC(outdoorTempC)) / 100.0f;
+}
+
+void controlHumidity(ControllerBatch& b, int i, CentiRH humidity, CentiC indoor, CentiC outdoor) {
+  CentiRH effectiveTarget = (CentiRH)std::min((int32_t)HUMIDITY_TARGET_CENTI, maxHumidityForWindow(indoor, outdoor));
+  bool isHumidityControlOn = relayOn(b, i, HUMIDITY_RELAY_PIN);
+
+  if (humidity < (effectiveTarget - HUMIDITY_DEADBAND_CENTI) && !isHumidityControlOn) { setRelay(b, i, HUMIDITY_RELAY_PIN, HIGH); } 
+  else if (humidity >= effectiveTarget && isHumidityControlOn) { setRelay(b, i, HUMIDITY_RELAY_PIN, LOW); }
+}
+
+// =================================================================
+// ==             DEVICE CONTROLLER (SINGLE INSTANCE)             ==
+// =================================================================
+// The original single-thermostat API, used by loop() and the self-tests. Each
+// call latches the shared tick inputs from the HAL and hands any newly learned
+// performance rows to the write-back persistence layer.
+static void beginDeviceTick() {
+  deviceController.now = currentTime();
+  deviceController.season = getCurrentSeason();
+}
+
+static void persistDevicePerformance() {
+  if (!deviceController.performanceDirty[0]) return;
+  markPerformanceDirty(deviceController.performanceDirty[0]);
+  deviceController.performanceDirty[0] = 0;
+}
+
+void initialize_logic_timers() {
+  initialize_logic_timers(deviceController, 0, currentTime());
+}
+
+void updatePerformanceData(bool isHeating) {
+  beginDeviceTick();
+  updatePerformanceData(deviceController, 0, isHeating, sensorSnapshot().indoorCentiC);
+  persistDevicePerformance();
+}
+
+void controlTemperature(CentiC temp, CentiC target, CentiC outdoor) {
+  beginDeviceTick();
+  controlTemperature(deviceController, 0, temp, target, outdoor);
+  persistDevicePerformance();
+}
+
+void controlFan(FanMode fanMode) {
+  beginDeviceTick();
+  controlFan(deviceController, 0, fanMode);
+}
+
+void controlHumidity(CentiRH humidity, CentiC indoor, CentiC outdoor) {
+  controlHumidity(deviceController, 0, humidity, indoor, outdoor);
+}
@@ -1,29 +1,52 @@
 #include "hvac_tests.h"
 #include <Arduino.h>
 #include "config.h"
+#include "commands.h"
+#include "console.h"
 #include "main.h"
 #include "hvac_logic.h"
+#include "learning.h"
+#include "persistence.h"
+#include "pressure.h"
+#include "probes.h"
+#include "psychrometrics.h"
+#include "recovery.h"
+#include "relays.h"
+#include "scheduler.h"
+#include "sensors.h"
+#include "state_machine.h"
+#include "telemetry.h"
+#include "thermal_model.h"
+#include "timeseries.h"
+#include "trace.h"
+#include "utils.h"
+#include "warmstart.h"
+#include "zones.h"
+#include "SPIFFS.h"
+#include "nvs.h"
 
 // -- Mocking infrastructure for tests --
 bool g_isTesting = false;
 unsigned long g_mockMillis = 0;
 TimeInfo g_mockTime;
 float g_mockIndoorTempF, g_mockOutdoorTempF;
+float g_mockHumidity = 45.0;
+int g_testFailures = 0;
 bool g_mockRelayStates[10] = {LOW,LOW,LOW,LOW,LOW,LOW,LOW,LOW,LOW,LOW};
 
-extern Schedule programSchedule;
-extern bool vacationModeActive;
-extern float currentTargetTemperature;
+extern CentiC currentTargetTemperature;
 extern FanMode currentFanMode;
 
-void setMockTime(int month, int day, int dayOfWeek, int hour, int min) { 
+void setMockTime(int month, int day, int dayOfWeek, int hour, int min, int sec = 0) { 
     g_mockTime.month = month; g_mockTime.day = day; 
-    g_mockTime.dayOfWeek = dayOfWeek; g_mockTime.hour = hour; g_mockTime.minute = min; 
+    g_mockTime.dayOfWeek = dayOfWeek; g_mockTime.hour = hour; g_mockTime.minute = min; g_mockTime.second = sec;
+    invalidateScheduleCursor(deviceController, 0); // A jump in mock time is a clock set
 }
 void advanceMockMillis(unsigned long ms) { g_mockMillis += ms; }
 void setMockSensors(float iF, float oF) { g_mockIndoorTempF = iF; g_mockOutdoorTempF = oF; }
 void resetHvacState() {
   for (int i=0; i<10; i++) g_mockRelayStates[i] = LOW;
+  deviceController.relays[0] = 0;
   g_mockMillis = 0;
   systemLockedOut = false;
   initialize_logic_timers();
@@ -32,43 +55,993 @@ void resetHvacState() {
 void test(const char* testName, bool condition) {
   Serial.print("Test: "); Serial.print(testName); Serial.print(" ... ");
   Serial.println(condition ? "[PASS]" : "[FAIL]");
+  if (!condition) g_testFailures++;
 }
 
 void testSchedulingLogic() {
   Serial.println("  --- Testing Scheduling Logic ---");
   setMockTime(1, 1, 1, 7, 0); getCurrentScheduleSettings();
-  test("    1. Weekday Wake Temp", abs(currentTargetTemperature - 70.0) < 0.01);
+  test("    1. Weekday Wake Temp", currentTargetTemperature == centiCFromF(70.0));
   setMockTime(1, 1, 3, 10, 0); getCurrentScheduleSettings();
-  test("    2. Weekday Away Temp", abs(currentTargetTemperature - 75.0) < 0.01);
+  test("    2. Weekday Away Temp", currentTargetTemperature == centiCFromF(75.0));
   vacationModeActive = true; getCurrentScheduleSettings();
-  test("    3. Vacation Mode Temp", abs(currentTargetTemperature - programSchedule.vacation.targetTemperature) < 0.01);
+  test("    3. Vacation Mode Temp", currentTargetTemperature == programSchedule.vacation.target);
   vacationModeActive = false;
 }
 
 void testPerformanceLearning() {
     Serial.println("  --- Testing Seasonal Performance Learning ---");
     resetHvacState();
-    memset(&performance, 0, sizeof(performance)); 
-    float targetC = fahrenheitToCelsius(70);
+    performance = HvacPerformance();
+    CentiC target = centiCFromF(70);
     const unsigned long MIN_HEATER_RUN_TIME_MS = MIN_HEATER_RUN_TIME_MINS * 60 * 1000;
     setMockTime(1, 15, 2, 10, 0); // Jan 15 (Winter, Season 0)
     setMockSensors(68, 35);
-    controlTemperature(fahrenheitToCelsius(68), targetC, fahrenheitToCelsius(35));
+    controlTemperature(centiCFromF(68), target, centiCFromF(35));
     advanceMockMillis(MIN_HEATER_RUN_TIME_MS + 5000); 
     setMockSensors(71, 35);
-    controlTemperature(fahrenheitToCelsius(71), targetC, fahrenheitToCelsius(35));
-    test("    1. Heat rate learned in Winter slot", performance.heatRate[0][3] > 0.1);
-    test("    2. Heat rate NOT learned in Summer slot", abs(performance.heatRate[2][3]) < 0.01);
+    controlTemperature(centiCFromF(71), target, centiCFromF(35));
+    test("    1. Heat rate learned in Winter slot", performance.heatRate[0][3] > 0);
+    test("    2. Heat rate NOT learned in Summer slot", performance.heatRate[2][3] == 0);
+}
+
+void testControllerBatch() {
+    Serial.println("  --- Testing Per-Instance Controller Batch ---");
+    resetHvacState();
+    static ControllerStorage<2> fleet;
+    ControllerBatch& b = fleet.batch;
+    b.now = 0; b.season = 0;
+    for (int i = 0; i < b.count; i++) initialize_logic_timers(b, i, b.now);
+    CentiC target = centiCFromF(70);
+    controlTemperature(b, 0, centiCFromF(65), target, centiCFromF(30));
+    controlTemperature(b, 1, centiCFromF(70.5), target, centiCFromF(30));
+    test("    1. Cold instance calls for heat", (b.relays[0] & RELAY_BIT(HEATER_RELAY_PIN)) != 0);
+    test("    2. Warm instance stays idle", b.relays[1] == 0);
+    test("    3. Device relays untouched", !g_mockRelayStates[HEATER_RELAY_PIN]);
+
+    // Started a minute before the 32-bit clock wraps, the heater still gets its minimum run.
+    b.now = UINT32_MAX - 60000;
+    initialize_logic_timers(b, 0, b.now);
+    b.relays[0] = 0;
+    controlTemperature(b, 0, centiCFromF(65), target, centiCFromF(30));
+    b.now += 2 * 60000;
+    controlTemperature(b, 0, centiCFromF(71), target, centiCFromF(30));
+    bool heldAcrossWrap = relayOn(b, 0, HEATER_RELAY_PIN);
+    b.now += MIN_HEATER_RUN_TIME_MS;
+    controlTemperature(b, 0, centiCFromF(71), target, centiCFromF(30));
+    test("    4. Min-run holds across the millis() wrap", heldAcrossWrap && !relayOn(b, 0, HEATER_RELAY_PIN));
+}
+
+void testEventScheduler() {
+    Serial.println("  --- Testing Event-Driven Scheduler ---");
+    resetHvacState();
+    g_mockMillis = 60000;
+    initialize_logic_timers();
+    CentiC target = centiCFromF(70), outdoor = centiCFromF(35);
+    setMockTime(1, 15, 1, 8, 28, 0); setMockSensors(70.5, 35); g_mockHumidity = 40;
+    controlTemperature(centiCFromF(70.5), target, outdoor);
+    WakePlan plan = planNextWake(deviceController, 0, g_mockTime, FAN_AUTO, centiCFromF(70.5), target, outdoor, centiRH(40));
+    test("    1. Idle wakes at the 08:30 transition", plan.reason == WAKE_SCHEDULE && plan.wakeAt - g_mockMillis == 120000);
+    test("    2. Heat threshold at target - deadband", plan.lowTemp == target - temperatureDeadband(FAHRENHEIT) - 1);
+
+    setMockTime(1, 15, 1, 9, 0, 0); setMockSensors(68, 35);
+    controlTemperature(centiCFromF(68), target, outdoor);
+    plan = planNextWake(deviceController, 0, g_mockTime, FAN_AUTO, centiCFromF(68), target, outdoor, centiRH(40));
+    test("    3. Running heater wakes at min-run expiry", plan.reason == WAKE_HEATER_TIMER && plan.wakeAt - g_mockMillis == MIN_HEATER_RUN_TIME_MS + 1);
+
+    unsigned long before = g_mockMillis;
+    setMockSensors(71, 35);
+    test("    4. Threshold crossing wakes early", schedulerSleep(plan) == WAKE_THRESHOLD && g_mockMillis - before == SENSOR_POLL_INTERVAL_MS);
+
+    // Heating has no lower band, so only the fault check wakes a sleep on a sensor that fails low.
+    setMockSensors(68, 35);
+    advanceMockMillis(SENSOR_POLL_INTERVAL_MS); sensorSnapshot();
+    controlTemperature(centiCFromF(68), target, outdoor);
+    commitRelays();
+    plan = planNextWake(deviceController, 0, g_mockTime, FAN_AUTO, centiCFromF(68), target, outdoor, centiRH(40));
+    bool heating = g_mockRelayStates[HEATER_RELAY_PIN] && plan.lowTemp == INT16_MIN;
+    before = g_mockMillis;
+    setMockSensors(-40, 35);
+    bool woke = schedulerSleep(plan) == WAKE_THRESHOLD && g_mockMillis - before <= SENSOR_POLL_INTERVAL_MS;
+    bool latched = latchSensorFault(sensorSnapshot());
+    test("    5. A failed sensor stops the heater within one poll", heating && woke && latched && !g_mockRelayStates[HEATER_RELAY_PIN] &&
+         deviceController.relays[0] == 0);
+    systemInFaultState = false;
+    setMockSensors(70, 35);
+    resetHvacState();
+}
+
+void testPersistence() {
+    Serial.println("  --- Testing Coalesced Settings Persistence ---");
+    flushSettings();
+    PersistenceStats before = persistenceStats;
+    markSettingsDirty(REC_SYSTEM_MODE); markSettingsDirty(REC_SYSTEM_MODE);
+    persistenceTick();
+    test("    1. Repeated change coalesces, no write before deadline", persistenceStats.coalesced == before.coalesced + 1 && persistenceStats.flushes == before.flushes && settingsDirty());
+    g_mockMillis += SETTINGS_WRITE_BACK_MS;
+    persistenceTick();
+    test("    2. Deadline writes only the changed record", persistenceStats.recordsWritten == before.recordsWritten + 1 && persistenceStats.bytesWritten == before.bytesWritten + 1 && !settingsDirty());
+
+    uint16_t saved = performance.heatRate[2][3];
+    performance.heatRate[2][3] = 306;
+    before = persistenceStats;
+    markPerformanceDirty(PERF_DIRTY_BIT(true, 2));
+    flushSettings();
+    test("    3. Learned cell rewrites one 32-byte row", persistenceStats.bytesWritten - before.bytesWritten == 32 && persistenceStats.flushes == before.flushes + 1);
+    performance.heatRate[2][3] = 0;
+    loadSettings();
+    test("    4. Row round-trips through NVS", performance.heatRate[2][3] == 306);
+    performance.heatRate[2][3] = saved;
+    markPerformanceDirty(PERF_DIRTY_BIT(true, 2));
+    flushSettings();
+
+    // The original firmware's schedule blob: int/int/float/int entries, no overrides.
+    struct OriginalEntry { int hour, minute; float targetF; int fanMode; };
+    struct { OriginalEntry weekday[10]; int weekdayCount; OriginalEntry weekend[10]; int weekendCount; OriginalEntry vacation; } original = {};
+    original.weekday[0] = { 6, 45, 69.5f, FAN_AUTO }; original.weekdayCount = 1;
+    original.weekend[0] = { 9, 0, 70.0f, FAN_AUTO }; original.weekend[1] = { 22, 30, 66.0f, FAN_AUTO }; original.weekendCount = 2;
+    original.vacation = { 0, 0, 82.0f, FAN_CIRCULATE };
+    Schedule savedSchedule = programSchedule;
+    TempUnit savedUnit = tempUnit;
+    tempUnit = FAHRENHEIT; markSettingsDirty(REC_TEMP_UNIT); flushSettings();
+    nvs_handle_t handle;
+    nvs_open("hvac_cfg", NVS_READWRITE, &handle);
+    nvs_set_blob(handle, "schedule", &original, sizeof(original)); nvs_commit(handle);
+    loadSettings();
+    test("    5. The original firmware's schedule migrates", programSchedule.weekdayEntryCount == 1 && programSchedule.weekendEntryCount == 2 &&
+         programSchedule.weekday[0].startMinute == 45 && programSchedule.weekday[0].target == centiCFromF(69.5) &&
+         programSchedule.weekend[1].target == centiCFromF(66) && programSchedule.vacation.target == centiCFromF(82) && !settingsDirty());
+
+    Schedule corrupt = Schedule();
+    corrupt.weekdayEntryCount = 200;
+    nvs_set_blob(handle, "schedule", &corrupt, sizeof(corrupt)); nvs_commit(handle);
+    nvs_close(handle);
+    loadSettings();
+    test("    6. A schedule whose counts overrun falls back to the defaults", programSchedule.weekdayEntryCount == Schedule().weekdayEntryCount);
+
+    programSchedule = savedSchedule; tempUnit = savedUnit;
+    markSettingsDirty(REC_SCHEDULE); markSettingsDirty(REC_TEMP_UNIT); flushSettings();
+    markScheduleEdited(deviceController, 0);
+}
+
+void testLearningLog() {
+    Serial.println("  --- Testing Buffered Learning Log & Analyzer ---");
+    flushLearningLog();
+    for (int n = 0; n < 100; n++) analyze_and_learn_if_needed();
+    LearningStats before = learningStats;
+    int proposalsBefore = learningStats.proposals;
+    File log = SPIFFS.open(LEARNING_LOG_FILE, FILE_READ);
+    size_t sizeBefore = log.size(); log.close();
+
+    setMockTime(3, 10, 2, 7, 5);  log_manual_adjustment(71.0);
+    setMockTime(3, 10, 2, 7, 20); log_manual_adjustment(72.0);
+    log = SPIFFS.open(LEARNING_LOG_FILE, FILE_READ);
+    test("    1. Adjustments are buffered in RAM", log.size() == sizeBefore && learningStats.flushes == before.flushes); log.close();
+    setMockTime(3, 10, 2, 7, 40); log_manual_adjustment(73.0);
+    analyze_and_learn_if_needed();
+    test("    2. Nothing analyzed before the batch is flushed", learningStats.recordsAnalyzed == before.recordsAnalyzed);
+    g_mockMillis += LEARNING_LOG_FLUSH_SECS * 1000;
+    analyze_and_learn_if_needed();
+    log = SPIFFS.open(LEARNING_LOG_FILE, FILE_READ);
+    test("    3. One batched flush of 8-byte records", learningStats.flushes == before.flushes + 1 && log.size() == sizeBefore + 3 * sizeof(LearningRecord)); log.close();
+    const ScheduleProposal& p = scheduleProposals[scheduleProposalCount - 1];
+    test("    4. Third adjustment in the window proposes the mean", (int)learningStats.proposals == proposalsBefore + 1 && p.dayOfWeek == 2 && p.hour == 7 && abs(p.targetTempF - 72.0) < 0.01);
+
+    // Fill past the size cap: the log rotates and the analyzer catches up
+    // across the rotation, touching each record exactly once.
+    before = learningStats;
+    const int burst = LEARNING_LOG_MAX_BYTES / sizeof(LearningRecord) + 100;
+    for (int n = 0; n < burst; n++) { setMockTime(1 + n / 28 % 12, 1 + n % 28, n % 7, n / 7 % 24, 0); log_manual_adjustment(70.0); } // Months apart per bucket
+    flushLearningLog();
+    int passes = 0;
+    while (learningStats.recordsAnalyzed - before.recordsAnalyzed < (unsigned long)burst && passes < 1000) { analyze_and_learn_if_needed(); passes++; }
+    log = SPIFFS.open(LEARNING_LOG_FILE, FILE_READ);
+    test("    5. Log rotates at its size cap", learningStats.rotations > before.rotations && log.size() < LEARNING_LOG_MAX_BYTES); log.close();
+    test("    6. Analyzer resumes across rotation, no re-scan", learningStats.recordsAnalyzed - before.recordsAnalyzed == (unsigned long)burst && learningStats.recordsSkipped == before.recordsSkipped);
+}
+
+void testCompiledSchedule() {
+    Serial.println("  --- Testing Compiled Schedule Timeline ---");
+    static ControllerStorage<1> unit;
+    ControllerBatch& b = unit.batch;
+    Schedule& sched = b.programSchedule[0];
+    sched.dayOverride[3][0] = { 7, 15, centiCFromF(69.0), FAN_AUTO };
+    sched.dayOverride[3][1] = { 12, 0, centiCFromF(73.0), FAN_ON };
+    sched.dayOverrideCount[3] = 2;
+    sched.exceptions[0] = { 12, 25, 0 };
+    sched.exceptionCount = 1;
+    markScheduleEdited(b, 0);
+
+    // Every minute of the week, plus the holiday, against the reference scan.
+    int mismatches = 0;
+    for (int dow = 0; dow <= 7; dow++) {
+        for (int minute = 0; minute < 24 * 60; minute++) {
+            TimeInfo t = { dow < 7 ? 3 : 12, dow < 7 ? 1 + dow : 25, dow % 7, minute / 60, minute % 60, minute % 7 * 8 };
+            b.now = minute; invalidateScheduleCursor(b, 0);
+            const ScheduleEntry& fast = activeScheduleEntry(b, 0, t);
+            const ScheduleEntry& ref = lookupScheduleEntry(sched, false, t);
+            unsigned long validMs = b.scheduleCursor[0].validUntil - b.now;
+            if (fast.target != ref.target || fast.fanMode != ref.fanMode || validMs != secondsUntilNextScheduleChange(sched, false, t) * 1000) mismatches++;
+        }
+    }
+    test("    1. Matches the scan over the whole week and a holiday", mismatches == 0);
+
+    TimeInfo tueNight = { 3, 3, 2, 3, 0, 0 };
+    b.now = 0; invalidateScheduleCursor(b, 0);
+    test("    2. Overnight setback carries past midnight", activeScheduleEntry(b, 0, tueNight).target == centiCFromF(68.0));
+    TimeInfo wed = { 3, 4, 3, 12, 30, 0 };
+    b.now = 0; invalidateScheduleCursor(b, 0);
+    test("    3. Per-day override applies", activeScheduleEntry(b, 0, wed).target == centiCFromF(73.0));
+    TimeInfo bogus = { 1, 1, 6, 23, 59, 0 };
+    b.now = 1000;
+    test("    4. Cached until the next transition", activeScheduleEntry(b, 0, bogus).target == centiCFromF(73.0));
+    b.now = b.scheduleCursor[0].validUntil;
+    test("    5. Re-looked up once valid-until passes", activeScheduleEntry(b, 0, bogus).target == centiCFromF(69.0));
+    sched.weekend[1].target = centiCFromF(66.0);
+    markScheduleEdited(b, 0);
+    test("    6. Edit recompiles", activeScheduleEntry(b, 0, bogus).target == centiCFromF(66.0));
+    b.vacationModeActive[0] = true;
+    test("    7. Vacation never expires", activeScheduleEntry(b, 0, bogus).target == sched.vacation.target && !b.scheduleCursor[0].expires);
+}
+
+void testSmartRecovery() {
+    Serial.println("  --- Testing Smart Recovery ---");
+    static ControllerStorage<1> unit;
+    ControllerBatch& b = unit.batch;
+    b.systemMode[0] = SYS_AUTO; b.tempUnit[0] = FAHRENHEIT;
+    b.season = seasonForMonth(1);
+    HvacPerformance& perf = b.performance[0];
+    perf.heatRate[b.season][2] = centiCDeltaFromF(2.0); perf.heatSamples[b.season][2] = MIN_RECOVERY_SAMPLES;
+    perf.heatRate[b.season][5] = centiCDeltaFromF(5.0); perf.heatSamples[b.season][5] = MIN_RECOVERY_SAMPLES;
+    perf.heatRate[b.season][3] = centiCDeltaFromF(9.0); perf.heatSamples[b.season][3] = 1; // Too few cycles to trust
+    test("    1. Sparse bin interpolates between learned bins", abs(estimateRecoveryRate(perf, b.season, 3, true) - centiCDeltaFromF(3.0)) <= 1);
+
+    // Tue 05:00, 68F night setback until 70F at 06:30; 3F at 3F/h is 69 min with margin.
+    TimeInfo t = { 1, 13, 2, 5, 0, 0 };
+    b.now = 1000;
+    CentiC current = centiCFromF(67.0), outdoor = centiCFromF(35.0);
+    CentiC target = planRecovery(b, 0, t, current, outdoor, activeScheduleEntry(b, 0, t).target);
+    double leadMs = (centiCFromF(70.0) - current) * 3600.0 * RECOVERY_LEAD_MARGIN / estimateRecoveryRate(perf, b.season, 3, true) * 1000.0;
+    unsigned long expectedStart = b.now + 90 * 60000UL - (unsigned long)leadMs;
+    test("    2. Holds the setback and plans the start", target == centiCFromF(68.0) && b.recovery[0].startPlanned && abs((long)(b.recovery[0].startAt - expectedStart)) < 1000);
+    RecoveryStats before = recoveryStats;
+    b.now += 10 * 60000UL; t.minute = 10;
+    planRecovery(b, 0, t, current, outdoor, activeScheduleEntry(b, 0, t).target);
+    test("    3. Lookahead and rate cached between passes", recoveryStats.lookaheads == before.lookaheads && recoveryStats.rateEstimates == before.rateEstimates);
+    b.now = b.recovery[0].startAt; t.minute = 21;
+    target = planRecovery(b, 0, t, current, outdoor, activeScheduleEntry(b, 0, t).target);
+    test("    4. Switches to the next target at the planned start", target == centiCFromF(70.0) && b.recovery[0].active);
+
+    perf = HvacPerformance();
+    invalidateRecovery(b, 0);
+    b.recovery[0].active = false;
+    target = planRecovery(b, 0, t, centiCFromF(60.0), outdoor, activeScheduleEntry(b, 0, t).target);
+    test("    5. Nothing learned: follows the schedule", target == centiCFromF(68.0) && !b.recovery[0].startPlanned);
+}
+
+void testSensorAcquisition() {
+    Serial.println("  --- Testing Sensor Acquisition ---");
+    SpscRing<int, 4> ring;
+    int pushed = 0, value = 0;
+    while (ring.push(pushed)) pushed++;
+    bool ordered = true;
+    for (int n = 0; n < pushed; n++) ordered = ordered && ring.pop(&value) && value == n;
+    test("    1. Ring holds its size and pops in order", pushed == 4 && ordered && !ring.pop(&value));
+
+    g_mockMillis = 1000000;
+    startSensorAcquisition();
+    setMockSensors(70.0, 40.0); g_mockHumidity = 45;
+    for (int n = 0; n < 5; n++) { sensorSnapshot(); advanceMockMillis(SENSOR_SAMPLE_INTERVAL_MS); }
+    setMockSensors(95.0, 40.0);
+    SensorSnapshot spike = sensorSnapshot();
+    advanceMockMillis(SENSOR_SAMPLE_INTERVAL_MS); setMockSensors(70.0, 40.0);
+    SensorSnapshot after = sensorSnapshot();
+    test("    2. Median drops a one-sample spike", spike.indoor == 70.0 && after.indoor == 70.0 && validateSensorReadings(after));
+
+    setMockSensors(72.0, 40.0);
+    advanceMockMillis(SENSOR_POLL_INTERVAL_MS);
+    SensorSnapshot step = sensorSnapshot();
+    test("    3. A real change passes within one poll", step.indoor == 72.0 && step.indoorSmoothed > 70.0 && step.indoorSmoothed < 72.0);
+
+    for (int n = 0; n < 10; n++) { advanceMockMillis(SENSOR_SAMPLE_INTERVAL_MS); setMockSensors(72.0 + n, 40.0); sensorSnapshot(); }
+    test("    4. Implausible rate fails validation", !validateSensorReadings(sensorSnapshot()));
+
+    setMockSensors(71.0, 40.0);
+    unsigned long samplesBefore = sensorStats.samples;
+    for (unsigned long t = 0; t <= SENSOR_STUCK_MINS * 60000UL; t += SENSOR_POLL_INTERVAL_MS) { advanceMockMillis(SENSOR_POLL_INTERVAL_MS); sensorSnapshot(); }
+    test("    5. Unchanging sensor flagged as stuck, not a hard fault", sensorSnapshot().indoorStuck && validateSensorReadings(sensorSnapshot()));
+    test("    6. Sampled at its own rate, no overruns", sensorStats.samples - samplesBefore >= SENSOR_STUCK_MINS * 60 / SENSOR_SAMPLE_INTERVAL_SECS && sensorStats.overruns == 0);
+
+    // Stuck holds the outputs off, stopped as the rules would stop them, until the reading moves.
+    ControllerBatch& b = deviceController;
+    b.relays[0] = RELAY_BIT(HEATER_RELAY_PIN) | RELAY_BIT(FAN_RELAY_PIN);
+    b.cycleInProgress[0] = true;
+    bool held = holdForStuckSensor(sensorSnapshot()) && b.relays[0] == 0 && !g_mockRelayStates[HEATER_RELAY_PIN] &&
+                b.lastHeaterOffTime[0] == currentTime() && !b.cycleInProgress[0];
+    setMockSensors(71.5, 40.0);
+    advanceMockMillis(SENSOR_SAMPLE_INTERVAL_MS);
+    SensorSnapshot moved = sensorSnapshot();
+    test("    7. A stuck reading holds the outputs off and clears when it moves", held && !moved.indoorStuck && !holdForStuckSensor(moved));
+}
+
+static uint8_t telemetryCapture[1024];
+static size_t telemetryCaptured = 0;
+static void captureTelemetry(const uint8_t* data, size_t len) {
+  size_t n = std::min(len, sizeof(telemetryCapture) - telemetryCaptured);
+  memcpy(telemetryCapture + telemetryCaptured, data, n); telemetryCaptured += n;
+}
+
+void testTelemetry() {
+    Serial.println("  --- Testing Telemetry Frames ---");
+    TelemetryFrame f = {};
+    f.version = TELEMETRY_VERSION; f.state = RECOVERING; f.sequence = 0x0100; f.timestampMs = 86400000;
+    f.minuteOfDay = 6 * 60 + 5; f.indoorRaw = 6840; f.indoorFiltered = 6850; f.outdoor = -1250; f.target = 7000;
+    f.humidity = 4500; f.relays = TELEMETRY_RELAY_HEATER | TELEMETRY_RELAY_FAN; f.flags = TELEMETRY_FLAG_FAHRENHEIT;
+    uint8_t wire[TELEMETRY_MAX_ENCODED];
+    size_t len = encodeTelemetryFrame(f, wire);
+    TelemetryFrame back;
+    test("    1. Frame round-trips, zero only as the delimiter", len <= TELEMETRY_MAX_ENCODED && wire[len - 1] == 0 && memchr(wire, 0, len - 1) == nullptr &&
+         decodeTelemetryFrame(wire, len - 1, &back) && memcmp(&back, &f, sizeof(f)) == 0);
+    wire[5] ^= 0x10;
+    test("    2. Corrupted frame rejected", !decodeTelemetryFrame(wire, len - 1, &back));
+
+    setTelemetrySink(captureTelemetry);
+    drainTelemetry();
+    TelemetryStats before = telemetryStats;
+    for (int n = 0; n < TELEMETRY_RING_FRAMES + 5; n++) enqueueTelemetry(f);
+    test("    3. Full ring drops and counts instead of blocking", telemetryStats.dropped - before.dropped == 5);
+    telemetryCaptured = 0;
+    test("    4. Drain ships every queued frame", drainTelemetry() == (size_t)TELEMETRY_RING_FRAMES && telemetryCaptured == TELEMETRY_RING_FRAMES * len);
+
+    setTelemetryTextMode(true);
+    telemetryCaptured = 0;
+    enqueueTelemetry(f); drainTelemetry();
+    telemetryCapture[std::min(telemetryCaptured, sizeof(telemetryCapture) - 1)] = 0;
+    test("    5. Text output on request", strstr((const char*)telemetryCapture, "Time: 6:05 | Temp: 68.5F, Target: 70.0F (recovering)") != nullptr);
+    setTelemetryTextMode(TELEMETRY_TEXT_OUTPUT);
+    setTelemetrySink(nullptr);
+}
+
+void testProbes() {
+    Serial.println("  --- Testing Latency Probes ---");
+    if (!HVAC_PROBES) { test("    1. Probes compiled out", handleConsoleCommand("probes")); return; }
+    resetProbes();
+    for (int n = 0; n < 99; n++) recordProbe(PROBE_CONTROL_TEMP, PROBE_CYCLES_PER_US);
+    recordProbe(PROBE_CONTROL_TEMP, 100 * PROBE_CYCLES_PER_US);
+    const ProbeHistogram& h = probeHistograms[PROBE_CONTROL_TEMP];
+    test("    1. Count, min and max", h.count == 100 && h.minCycles == PROBE_CYCLES_PER_US && h.maxCycles == 100 * PROBE_CYCLES_PER_US);
+    test("    2. Log2 bucket", h.buckets[probeBucket(PROBE_CYCLES_PER_US)] == 99 && probeBucket(PROBE_CYCLES_PER_US) == 8);
+    test("    3. Percentiles from buckets", probePercentileUs(h, 50) == 2 && probePercentileUs(h, 100) == 100);
+    { PROBE_SCOPE(PROBE_LEARNING); }
+    test("    4. Scoped probe records once", probeHistograms[PROBE_LEARNING].count == 1);
+    test("    5. Console answers probe queries", handleConsoleCommand("probes") && handleConsoleCommand("probes reset") && !handleConsoleCommand("bogus"));
+    test("    6. Reset clears", probeHistograms[PROBE_CONTROL_TEMP].count == 0);
+}
+
+void testPsychrometrics() {
+    Serial.println("  --- Testing Psychrometric Kernel ---");
+    float worst = 0;
+    for (int in = 1000; in <= 3000; in += 137)
+      for (int out = -3000; out <= 3500; out += 211)
+        worst = std::max(worst, (float)fabs(maxHumidityForWindow(in, out) / 100.0 - referenceMaxHumidityForWindow(in / 100.0, out / 100.0)));
+    test("    1. Window limit within 0.02 %RH of Magnus", worst < 0.02);
+    test("    2. Limit clamped to 10..95 %RH", maxHumidityForWindow(4000, -5000) == 1000 && maxHumidityForWindow(2100, 3000) == 9500);
+    test("    3. Saturation pressure at 20 C", abs((int)saturationVapourPressure(2000) - (int)(23.3344 * (1 << PSYCHRO_SVP_FRAC_BITS))) < 200);
+    test("    4. Dew point of 20 C / 50 %RH", abs(dewPoint(2000, 5000) - 926) <= 1);
+    test("    5. Absolute humidity of 20 C / 50 %RH", abs((int)absoluteHumidity(2000, 5000) - 8624) <= 5);
+    test("    6. Out-of-range and NaN inputs clamp", toCentiC(NAN) == PSYCHRO_MIN_CENTI_C && toCentiC(99.0f) == PSYCHRO_MAX_CENTI_C && toCentiC(-1.234f) == -123);
 }
 
 // ... other test suites (min/max time, lockout, etc.) ...
 
-void runTests() {
+void testWarmStart() {
+    Serial.println("  --- Testing Warm Start ---");
+    static ControllerStorage<1> before, after;
+    ControllerBatch& b = before.batch;
+    b.now = 50000000;
+    initialize_logic_timers(b, 0, b.now);
+    b.lastHeaterOnTime[0] = b.now - 600000; b.lastHeaterOffTime[0] = b.now - 60000; // Ran 9 min, off a minute ago
+    b.heaterMaxRunTriggers[0] = 1; b.firstHeaterMaxRunTriggerTime[0] = b.now - 1000000;
+    b.isFanCirculating[0] = true; setRelay(b, 0, FAN_RELAY_PIN, HIGH);
+    b.systemLockedOut[0] = true;
+    const uint64_t SAVED_US = 7000000000ULL;
+    saveWarmState(b, 0, SAVED_US);
+
+    // millis() restarts at boot; the retained clock shows a 2 s reset.
+    ControllerBatch& w = after.batch;
+    w.now = 1500; w.systemMode[0] = SYS_AUTO; w.season = 0;
+    bool restored = restoreWarmState(w, 0, SAVED_US + 2000000);
+    test("    1. Timers re-based across the reset", restored && w.now - w.lastHeaterOffTime[0] == 62000 && w.now - w.lastHeaterOnTime[0] == 602000 &&
+         w.heaterMaxRunTriggers[0] == 1 && w.now - w.firstHeaterMaxRunTriggerTime[0] == 1002000);
+    test("    2. Relays, circulate phase and lockout restored", w.relays[0] == RELAY_BIT(FAN_RELAY_PIN) && w.isFanCirculating[0] && w.systemLockedOut[0]);
+
+    w.systemLockedOut[0] = false;
+    CentiC target = centiCFromF(70), outdoor = centiCFromF(35);
+    controlTemperature(w, 0, centiCFromF(65), target, outdoor);
+    bool heldOff = !relayOn(w, 0, HEATER_RELAY_PIN);
+    w.now += MIN_HEATER_OFF_TIME_MS - 62000 + 1000;
+    controlTemperature(w, 0, centiCFromF(65), target, outdoor);
+    test("    3. Min-off time counts from before the reset", heldOff && relayOn(w, 0, HEATER_RELAY_PIN));
+
+    bool stale = restoreWarmState(w, 0, SAVED_US + (WARM_START_MAX_AGE_SECS + 1) * 1000000ULL);
+    bool early = restoreWarmState(w, 0, SAVED_US - 1);
+    invalidateWarmState();
+    test("    4. Stale, clock-reversed or invalidated state boots cold", !stale && !early && !restoreWarmState(w, 0, SAVED_US + 1000));
+}
+
+void testZones() {
+    Serial.println("  --- Testing Multi-Zone Engine ---");
+    static ControllerStorage<2> storage;
+    static ZoneGroup one, g;
+    ControllerBatch& b = storage.batch;
+    b.now = 10000000; b.season = 0;
+    for (int i = 0; i < 2; i++) { b.systemMode[i] = SYS_AUTO; initialize_logic_timers(b, i, b.now); }
+    initZoneGroup(one, 1, 1, 1, b.now);
+    CentiC target = centiCFromF(70), outdoor = centiCFromF(35);
+    bool same = true;
+    for (int step = 0; step < 600; step++) { // A sawtooth through both deadbands, a minute a step
+      CentiC temp = centiCFromF(64) + (CentiC)(abs(step % 200 - 100) * 12);
+      one.temp[0] = temp; one.target[0] = target;
+      controlZones(one, b, 0, outdoor);
+      controlTemperature(b, 1, temp, target, outdoor);
+      same &= b.relays[0] == b.relays[1];
+      b.now += 60000;
+    }
+    test("    1. One zone, one stage is controlTemperature()", same);
+
+    b.systemMode[0] = SYS_HEAT;
+    initialize_logic_timers(b, 0, b.now);
+    b.relays[0] = 0;
+    initZoneGroup(g, 4, 2, 1, b.now);
+    for (int z = 0; z < 4; z++) { g.target[z] = target; g.temp[z] = target; }
+    g.temp[2] = centiCFromF(64); // 6 F cold: beyond deadband + STAGE_UP_ERROR_F
+    controlZones(g, b, 0, outdoor);
+    bool staged = runningStages(g, b, 0, STAGE_HEAT) == 2;
+    test("    2. Lead zone error calls stage 2", staged && g.lead[STAGE_HEAT] == 2);
+
+    b.now += MIN_HEATER_RUN_TIME_MS + 1000;
+    g.temp[2] = target - 10; // Within the deadband, still calling stage 1
+    controlZones(g, b, 0, outdoor);
+    bool dropped = runningStages(g, b, 0, STAGE_HEAT) == 1;
+    b.now += 60000;
+    g.temp[2] = centiCFromF(64);
+    controlZones(g, b, 0, outdoor);
+    test("    3. Stage 2 drops out, then honours its own min-off", dropped && runningStages(g, b, 0, STAGE_HEAT) == 1);
+
+    b.now += DAMPER_MIN_DWELL_MS;
+    controlZones(g, b, 0, outdoor);
+    test("    4. Dampers close on satisfied zones after the dwell", g.damperOpen == (1u << 2));
+    g.temp[2] = target;
+    b.now += 60000;
+    controlZones(g, b, 0, outdoor);
+    test("    5. Idle air handler opens every damper", !relayOn(b, 0, HEATER_RELAY_PIN) && g.damperOpen == 0xF);
+}
+
+// Exact first-order plant, a pass every 30 s, heater on below 19.5 C and off above 20.5 C.
+static void driveRcPlant(ControllerBatch& b, float& tempC, int passes) {
+    const float LOSS = 0.05f, HEAT = 3.7f, INTERNAL = 0.1f;
+    for (int n = 0; n < passes; n++) {
+      float outdoorC = 2.0f + 6.0f * sinf(b.now / 3.6e6f * 6.2832f / 24);
+      updateThermalModel(b, 0, (CentiC)lroundf(tempC * 100), (CentiC)lroundf(outdoorC * 100));
+      bool heating = relayOn(b, 0, HEATER_RELAY_PIN);
+      if (tempC < 19.5f && !heating) setRelay(b, 0, HEATER_RELAY_PIN, HIGH);
+      if (tempC > 20.5f && heating) setRelay(b, 0, HEATER_RELAY_PIN, LOW);
+      float equilibrium = outdoorC + (INTERNAL + (relayOn(b, 0, HEATER_RELAY_PIN) ? HEAT : 0)) / LOSS;
+      tempC = equilibrium + (tempC - equilibrium) * expf(-LOSS * 30 / 3600.0f);
+      b.now += 30000;
+    }
+}
+
+void testThermalModel() {
+    Serial.println("  --- Testing Thermal Model ---");
+    static ControllerStorage<1> storage;
+    ControllerBatch& b = storage.batch;
+    b.now = 1000; b.season = 0;
+    HvacPerformance& perf = b.performance[0];
+    perf.heatRate[0][3] = 300; perf.heatSamples[0][3] = 4; // 3 C/h with 35 F outdoors
+    float tempC = 18.0f;
+    driveRcPlant(b, tempC, 1);
+    const ThermalModel& m = b.thermalModel[0];
+    test("    1. Seeded from the learned rates", m.seeded && fabs(m.theta[THERMAL_HEAT_GAIN] - 3.92f) < 0.05f);
+
+    driveRcPlant(b, tempC, 2 * 24 * 120);
+    test("    2. Converges on the plant's loss and heating gain", fabs(m.theta[THERMAL_LOSS] - 0.05f) < 0.0025f &&
+         fabs(m.theta[THERMAL_HEAT_GAIN] - 3.7f) < 0.1f && m.heatSamples >= THERMAL_MODEL_MIN_SAMPLES);
+
+    // From 17 C to 21 C at 0 C outdoors: equilibrium 76 C, ln(59 / 55) / 0.05 h.
+    ThermalPrediction p = predictTimeToTarget(m, 1700, 2100, 0);
+    test("    3. Time to target within 5% and confident", p.reachable && fabs(p.seconds - 5053.0f) < 250 && p.confidence >= THERMAL_MODEL_SEED_CONFIDENCE);
+    test("    4. Out-of-reach target reported", !predictTimeToTarget(m, 1700, 8000, 0).reachable);
+
+    test("    5. Empty bins filled as one sample, learned bins kept", perf.heatSamples[0][0] == 1 && perf.heatRate[0][0] > 0 &&
+         perf.heatSamples[0][3] == 4 && perf.heatRate[0][3] == 300 && (b.performanceDirty[0] & PERF_DIRTY_BIT(true, 0)));
+
+    uint32_t updates = m.updates;
+    setRelay(b, 0, FRESH_AIR_RELAY_PIN, HIGH);
+    driveRcPlant(b, tempC, 60);
+    setRelay(b, 0, FRESH_AIR_RELAY_PIN, LOW);
+    test("    6. Economizer intervals are not fitted", m.updates == updates);
+}
+
+void testTrace() {
+    Serial.println("  --- Testing Control Trace ---");
+    // A heating morning on a batch, recorded pass by pass.
+    static ControllerStorage<1> field, bench;
+    ControllerBatch& b = field.batch;
+    b.now = 3600000; b.systemMode[0] = SYS_HEAT; b.tempUnit[0] = FAHRENHEIT; b.season = 0;
+    initialize_logic_timers(b, 0, b.now);
+    TraceCodec enc = {};
+    static uint8_t stream[8192];
+    size_t used = 0;
+    TracePass pass = {};
+    pass.time = { 1, 15, 3, 6, 0, 0 };
+    pass.target = centiCFromF(70); pass.outdoor = centiCFromF(30); pass.humidity = 4000;
+    pass.systemMode = SYS_HEAT; pass.fanMode = FAN_AUTO; pass.tempUnit = FAHRENHEIT;
+    const int PASSES = 200;
+    size_t quietSize = 0;
+    TracePass recorded = {};
+    for (int n = 0; n < PASSES; n++) {
+        pass.timestampMs = (uint32_t)b.now;
+        pass.indoor = (CentiC)(centiCFromF(66) + 3 * (n % 60));
+        pass.relays = replayTracePass(b, 0, pass);
+        WarmState state;
+        if (n == 0) captureWarmState(b, 0, 0, state);
+        size_t size = encodeTracePass(enc, pass, n == 0 ? &state : nullptr, stream + used);
+        if (n == 100) quietSize = size;
+        used += size;
+        recorded = pass;
+        b.now += 30000;
+        int second = (pass.time.hour * 60 + pass.time.minute) * 60 + pass.time.second + 30;
+        pass.time.hour = second / 3600; pass.time.minute = second / 60 % 60; pass.time.second = second % 60;
+    }
+    test("    1. A quiet pass codes in a few bytes", quietSize > 0 && quietSize <= 8 && used < PASSES * 10);
+
+    // Decode and replay on a fresh batch from the keyframe.
+    TraceCodec dec = {};
+    ControllerBatch& r = bench.batch;
+    size_t at = 0;
+    int decoded = 0, keyframes = 0, diverged = 0;
+    TracePass last = {};
+    while (at < used) {
+        TracePass p; WarmState state; bool keyframe;
+        size_t n = decodeTracePass(dec, stream + at, used - at, p, &state, &keyframe);
+        if (!n) break;
+        at += n; decoded++; last = p;
+        if (keyframe) { loadTraceKeyframe(r, 0, p, state); keyframes++; continue; }
+        if (replayTracePass(r, 0, p) != p.relays) diverged++;
+    }
+    test("    2. Every pass decodes, fields intact", decoded == PASSES && keyframes == 1 && last.timestampMs == recorded.timestampMs &&
+         last.indoor == recorded.indoor && last.time.hour == recorded.time.hour && last.time.minute == recorded.time.minute &&
+         last.relays == recorded.relays && last.humidity == recorded.humidity);
+    test("    3. Replay through the control code matches", diverged == 0 && r.relays[0] == b.relays[0]);
+
+    // The same trace against a different decision diverges.
+    dec = TraceCodec{}; at = 0; diverged = 0;
+    while (at < used) {
+        TracePass p; WarmState state; bool keyframe;
+        at += decodeTracePass(dec, stream + at, used - at, p, &state, &keyframe);
+        if (keyframe) { loadTraceKeyframe(r, 0, p, state); continue; }
+        p.target = (CentiC)(p.target - 300);
+        if (replayTracePass(r, 0, p) != p.relays) diverged++;
+    }
+    TraceCodec fresh = {};
+    TracePass scratch;
+    test("    4. A changed decision shows as divergence; torn records rejected", diverged > 0 &&
+         decodeTracePass(fresh, stream, 10, scratch, nullptr, nullptr) == 0 && decodeTracePass(dec, stream + 1, 0, scratch, nullptr, nullptr) == 0);
+
+    // Device capture: SPIFFS files with a keyframe after boot and each rotation.
+    initialize_trace();
+    TraceStats before = traceStats;
+    CentiC indoor = centiCFromF(68);
+    for (int n = 0; traceStats.rotations == before.rotations && n < 100000; n++) {
+        deviceController.now = g_mockMillis += 60000;
+        indoor = (CentiC)(indoor + (n % 2 ? 7 : -5));
+        recordTrace(g_mockTime, indoor, centiCFromF(40), 4500, centiCFromF(70), FAN_AUTO);
+    }
+    flushTrace();
+    File file = SPIFFS.open(TRACE_ROTATED_FILE, FILE_READ);
+    TraceHeader header = {};
+    uint8_t first[TRACE_MAX_RECORD];
+    bool ok = file && file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) && file.read(first, sizeof(first)) == sizeof(first);
+    file.close();
+    TraceCodec devCodec = {};
+    bool keyframe = false;
+    ok = ok && header.magic == TRACE_MAGIC && decodeTracePass(devCodec, first, sizeof(first), scratch, nullptr, &keyframe) && keyframe;
+    file = SPIFFS.open(TRACE_FILE, FILE_READ);
+    size_t size = file.size(); file.close();
+    test("    5. Flash ring rotates, each file opens on a keyframe", ok && traceStats.rotations == before.rotations + 1 &&
+         traceStats.keyframes >= before.keyframes + 2 && size < TRACE_MAX_BYTES);
+}
+
+// A loop current the test sets, with a +-40 uA square-wave ripple, and an
+// endpoint that acknowledges or refuses and remembers what it was sent.
+static int32_t mockLoopMicroAmps;
+static int mockLoopTick;
+static int32_t mockPressureSource() { return mockLoopMicroAmps + (mockLoopTick++ % 2 ? 40 : -40); }
+static bool mockEndpointUp;
+static int mockEndpointCalls;
+static char mockEndpointLast[PRESSURE_MAX_PAYLOAD];
+static bool mockPressureTransport(const char* payload, size_t len) {
+    mockEndpointCalls++;
+    if (!mockEndpointUp) return false;
+    memcpy(mockEndpointLast, payload, len); mockEndpointLast[len] = 0;
+    return true;
+}
+
+void testRelayCommit() {
+    Serial.println("  --- Testing Relay Shadow and Commit ---");
+    const uint16_t HEAT = RELAY_BIT(HEATER_RELAY_PIN), COOL = RELAY_BIT(COOLER_RELAY_PIN), FAN = RELAY_BIT(FAN_RELAY_PIN);
+    const uint16_t FRESH = RELAY_BIT(FRESH_AIR_RELAY_PIN), HUMID = RELAY_BIT(HUMIDITY_RELAY_PIN);
+    uint8_t t1, t2, t3;
+    bool interlocks = applyRelayInterlocks(HEAT | COOL | FAN, &t1) == FAN && t1 == INTERLOCK_HEAT_AND_COOL &&
+                      applyRelayInterlocks(FRESH, &t2) == (FRESH | FAN) && t2 == INTERLOCK_FAN_FORCED &&
+                      applyRelayInterlocks(HEAT | FAN | HUMID, &t3) == (HEAT | FAN | HUMID) && t3 == 0;
+    test("    1. Interlocks: never heat with cool, never a stage without the fan", interlocks);
+
+    // Decisions change the shadow only; the commit puts them on the pins in one write.
+    resetHvacState();
+    SystemMode savedMode = systemMode;
+    systemMode = SYS_HEAT;
+    g_mockMillis = 3600000; initialize_logic_timers();
+    initialize_relays();
+    commitRelays();
+    RelayStats before = relayStats;
+    controlTemperature(centiCFromF(65), centiCFromF(70), centiCFromF(30));
+    controlFan(FAN_AUTO);
+    bool pinsUntouched = !g_mockRelayStates[HEATER_RELAY_PIN] && !g_mockRelayStates[FAN_RELAY_PIN] && deviceController.relays[0] == (HEAT | FAN);
+    commitRelays();
+    test("    2. Pins change only at the commit, together", pinsUntouched && g_mockRelayStates[HEATER_RELAY_PIN] && g_mockRelayStates[FAN_RELAY_PIN] &&
+         relayStats.writes == before.writes + 1 && committedRelays() == (HEAT | FAN));
+
+    // An unchanged pass writes nothing; each relay's transitions are counted.
+    commitRelays();
+    bool quiet = relayStats.writes == before.writes + 1;
+    g_mockMillis += MIN_HEATER_RUN_TIME_MS + 1000;
+    deviceController.now = g_mockMillis;
+    controlTemperature(centiCFromF(71), centiCFromF(70), centiCFromF(30));
+    controlFan(FAN_AUTO);
+    commitRelays();
+    test("    3. No write when nothing changed; transitions counted per relay", quiet && relayStats.writes == before.writes + 2 &&
+         relayStats.transitions[HEATER_RELAY_PIN] == before.transitions[HEATER_RELAY_PIN] + 2 &&
+         relayStats.transitions[FAN_RELAY_PIN] == before.transitions[FAN_RELAY_PIN] + 2 && !g_mockRelayStates[HEATER_RELAY_PIN]);
+
+    // A shadow that breaks an interlock is corrected before it reaches the pins.
+    g_mockMillis += MIN_HEATER_OFF_TIME_MS + 1000;
+    deviceController.now = g_mockMillis;
+    deviceController.relays[0] = HEAT | COOL;
+    deviceController.cycleInProgress[0] = true;
+    uint8_t tripped = commitRelays();
+    test("    4. A bad shadow is corrected, not driven", tripped == INTERLOCK_HEAT_AND_COOL && deviceController.relays[0] == 0 &&
+         !g_mockRelayStates[HEATER_RELAY_PIN] && !g_mockRelayStates[COOLER_RELAY_PIN] && relayStats.heatCoolTrips == before.heatCoolTrips + 1);
+
+    // The trip stops both stages like any turn-off: min-off restarts and the cycle ends unlearned.
+    bool stopped = deviceController.lastHeaterOffTime[0] == g_mockMillis && deviceController.lastCoolerOffTime[0] == g_mockMillis &&
+                   !deviceController.cycleInProgress[0];
+    controlTemperature(centiCFromF(65), centiCFromF(70), centiCFromF(30));
+    test("    5. The trip starts both min-off times and ends the cycle", stopped && !relayOn(deviceController, 0, HEATER_RELAY_PIN));
+    deviceController.relays[0] = 0;
+    commitRelays();
+
+    // After boot every relay is written, whatever was held.
+    g_mockRelayStates[FAN_RELAY_PIN] = HIGH;
+    initialize_relays();
+    commitRelays();
+    test("    6. The first commit after boot writes every relay", !g_mockRelayStates[FAN_RELAY_PIN]);
+    systemMode = savedMode;
+    resetHvacState();
+}
+
+void testPressure() {
+    Serial.println("  --- Testing Pressure Monitor ---");
+    const CentiPa span = PRESSURE_RANGE_HIGH_CENTIPA - PRESSURE_RANGE_LOW_CENTIPA;
+    test("    1. 4-20 mA scales onto the range, NE43 faults classified",
+         loopCurrentToCentiPa(4000) == PRESSURE_RANGE_LOW_CENTIPA && loopCurrentToCentiPa(20000) == PRESSURE_RANGE_HIGH_CENTIPA &&
+         loopCurrentToCentiPa(12000) == PRESSURE_RANGE_LOW_CENTIPA + span / 2 && classifyLoopCurrent(3500) == PRESSURE_OPEN_LOOP &&
+         classifyLoopCurrent(21500) == PRESSURE_SHORTED_LOOP && classifyLoopCurrent(3800) == PRESSURE_OK);
+
+    // One reading per window; the ripple averages out.
+    startPressureMonitor();
+    setPressureSource(mockPressureSource);
+    setPressureTransport(mockPressureTransport);
+    mockLoopMicroAmps = 12000; mockLoopTick = 0;
+    unsigned long t = 1000;
+    for (int n = 0; n < PRESSURE_DECIMATION * 3; n++, t += PRESSURE_SAMPLE_INTERVAL_MS) samplePressure(t);
+    float rate = pressureSampleRateHz();
+    test("    2. Decimation gives one reading per window, ripple removed", pressureStats.readings == 3 &&
+         fabsf(rate - 1000.0f / PRESSURE_SAMPLE_INTERVAL_MS) < 0.01f);
+
+    // A few glitches are left out of the mean; a window that is mostly open is a fault.
+    for (int n = 0; n < PRESSURE_DECIMATION; n++, t += PRESSURE_SAMPLE_INTERVAL_MS) {
+        mockLoopMicroAmps = n % 40 == 0 ? 1000 : 12000;
+        samplePressure(t);
+    }
+    mockLoopMicroAmps = 1000;
+    for (int n = 0; n < PRESSURE_DECIMATION; n++, t += PRESSURE_SAMPLE_INTERVAL_MS) samplePressure(t);
+    test("    3. Glitches skipped, an open loop reported as a fault", pressureStats.readings == 5 && pressureStats.openLoop == 1);
+
+    // Endpoint down: the batch is held and retried with a doubling backoff.
+    mockEndpointUp = false; mockEndpointCalls = 0;
+    mockLoopMicroAmps = 20000;
+    for (int n = 0; n < PRESSURE_DECIMATION * (PRESSURE_BATCH_READINGS - 5); n++, t += PRESSURE_SAMPLE_INTERVAL_MS) samplePressure(t);
+    unsigned long attempts[4] = {}, sent = 0;
+    for (unsigned long now = t; mockEndpointCalls < 4; now += 1000) {
+        int before = mockEndpointCalls;
+        uploadPressure(now);
+        if (mockEndpointCalls > before) attempts[mockEndpointCalls - 1] = now;
+    }
+    bool backoff = attempts[1] - attempts[0] == PRESSURE_RETRY_MIN_SECS * 1000 && attempts[2] - attempts[1] == PRESSURE_RETRY_MIN_SECS * 2000 &&
+                   attempts[3] - attempts[2] == PRESSURE_RETRY_MIN_SECS * 4000;
+    mockEndpointUp = true;
+    for (unsigned long now = attempts[3]; now < attempts[3] + 3600000; now += 1000) sent += uploadPressure(now);
+    test("    4. Failed uploads back off and resend the batch once the endpoint is up", backoff && sent == PRESSURE_BATCH_READINGS &&
+         pressureStats.batches == 1 && pressureStats.failures == 4 && strncmp(mockEndpointLast, "{\"seq\":", 7) == 0 &&
+         strstr(mockEndpointLast, ",12442,12000,0]") != nullptr && strstr(mockEndpointLast, ",24884,20000,0]") != nullptr &&
+         strstr(mockEndpointLast, ",0,1000,1]") != nullptr);
+
+    // No uplink for longer than the queue holds: readings beyond it are dropped and counted.
+    setPressureTransport(nullptr);
+    size_t memory = pressureMemoryBytes();
+    for (int n = 0; n < PRESSURE_DECIMATION * (PRESSURE_QUEUE_READINGS + PRESSURE_BATCH_READINGS + 10); n++, t += PRESSURE_SAMPLE_INTERVAL_MS) {
+        samplePressure(t);
+        if (n % PRESSURE_DECIMATION == 0) uploadPressure(t);
+    }
+    test("    5. A long outage fills the bounded queue, then drops and counts", pressureStats.dropped > 0 &&
+         pressureStats.readings - pressureStats.readingsSent - pressureStats.dropped <= PRESSURE_QUEUE_READINGS + PRESSURE_BATCH_READINGS &&
+         pressureMemoryBytes() == memory && memory < 8192);
+    setPressureSource(nullptr);
+    startPressureMonitor();
+}
+
+static unsigned long transitionCounts[NUM_STATE_TRANSITIONS];
+static ThermostatState lastTracedFrom, lastTracedTo;
+static void countTransitions(int instance, ThermostatState from, ThermostatState to, StateTransition transition, ControlMillis now) {
+    (void)instance; (void)now;
+    transitionCounts[transition]++;
+    lastTracedFrom = from; lastTracedTo = to;
+}
+
+static bool sameControllerState(const ControllerBatch& b, int x, int y) {
+    return b.relays[x] == b.relays[y] && b.freshAirForHeating[x] == b.freshAirForHeating[y] &&
+           b.lastHeaterOnTime[x] == b.lastHeaterOnTime[y] && b.lastHeaterOffTime[x] == b.lastHeaterOffTime[y] &&
+           b.lastCoolerOnTime[x] == b.lastCoolerOnTime[y] && b.lastCoolerOffTime[x] == b.lastCoolerOffTime[y] &&
+           b.cycleInProgress[x] == b.cycleInProgress[y] && b.cycleStartTime[x] == b.cycleStartTime[y] &&
+           b.cycleStartTemp[x] == b.cycleStartTemp[y] && b.cycleStartOutdoorTemp[x] == b.cycleStartOutdoorTemp[y] &&
+           b.heaterMaxRunTriggers[x] == b.heaterMaxRunTriggers[y] && b.coolerMaxRunTriggers[x] == b.coolerMaxRunTriggers[y] &&
+           b.firstHeaterMaxRunTriggerTime[x] == b.firstHeaterMaxRunTriggerTime[y] &&
+           b.firstCoolerMaxRunTriggerTime[x] == b.firstCoolerMaxRunTriggerTime[y] && b.systemLockedOut[x] == b.systemLockedOut[y] &&
+           b.performanceDirty[x] == b.performanceDirty[y] && !memcmp(&b.performance[x], &b.performance[y], sizeof(HvacPerformance));
+}
+
+void testStateMachine() {
+    Serial.println("  --- Testing Control State Machine ---");
+    const uint16_t HEAT = RELAY_BIT(HEATER_RELAY_PIN), COOL = RELAY_BIT(COOLER_RELAY_PIN), FRESH = RELAY_BIT(FRESH_AIR_RELAY_PIN);
+    static ControllerStorage<3> storage;
+    ControllerBatch& b = storage.batch;
+    b.now = 10000000; b.season = 0;
+    for (int i = 0; i < 3; i++) { b.systemMode[i] = SYS_AUTO; b.tempUnit[i] = FAHRENHEIT; initialize_logic_timers(b, i, b.now); }
+
+    // A random walk through inputs, modes, clock jumps, resets and stray relay
+    // states: instance 0 on controlTemperature(), 1 on the machine, 2 on a
+    // heat-only machine without an economizer.
+    memset(transitionCounts, 0, sizeof(transitionCounts));
+    setStateTraceHook(countTransitions);
+    const SystemMode MODES[] = { SYS_OFF, SYS_HEAT, SYS_COOL, SYS_AUTO };
+    const uint16_t STRAY[] = { 0, HEAT, COOL, FRESH, HEAT | FRESH, COOL | FRESH };
+    uint32_t seed = 20261017;
+    auto next = [&seed](uint32_t n) { seed = seed * 1664525u + 1013904223u; return (seed >> 8) % n; };
+    bool same = true, heatOnly = true;
+    for (int step = 0; step < 50000 && same; step++) {
+        if (next(40) == 0) b.systemMode[0] = b.systemMode[1] = b.systemMode[2] = MODES[next(4)];
+        if (next(300) == 0) { b.relays[0] = b.relays[1] = STRAY[next(6)]; b.freshAirForHeating[0] = b.freshAirForHeating[1] = next(2); }
+        if (next(400) == 0) b.systemLockedOut[0] = b.systemLockedOut[1] = false; // A manual reset
+        b.now += next(8) == 0 ? next(150) * 60000UL : 60000;
+        CentiC target = centiCFromF(70);
+        CentiC temp = (CentiC)(target - 350 + (int)next(700)), outdoor = (CentiC)(centiCFromF(0) + (int)next(4000));
+        controlTemperature(b, 0, temp, target, outdoor);
+        stepThermostat<EQUIPMENT_HEAT_COOL, true>(b, 1, temp, target, outdoor);
+        stepThermostat<EQUIPMENT_HEAT_ONLY, false>(b, 2, temp, target, outdoor);
+        same = sameControllerState(b, 0, 1) && b.state[1] == thermostatStateOf(b, 1);
+        heatOnly &= !(b.relays[2] & (COOL | FRESH));
+    }
+    bool everyRule = true;
+    for (int t = 0; t < NUM_STATE_TRANSITIONS; t++) everyRule &= transitionCounts[t] > 0;
+    test("    1. Furnace, air and economizer decide exactly as controlTemperature()", same && everyRule);
+    test("    2. A heat-only build never cools or opens the damper", heatOnly);
+
+    // A heat pump rests the compressor after cooling before it heats.
+    for (int i = 0; i < 2; i++) {
+        b.relays[i] = 0; b.systemMode[i] = SYS_HEAT; b.systemLockedOut[i] = false;
+        initialize_logic_timers(b, i, b.now);
+        b.lastCoolerOffTime[i] = b.now - 60000;
+    }
+    CentiC cold = centiCFromF(65), target = centiCFromF(70), colder = centiCFromF(30);
+    ThermostatState pump = stepThermostat<EQUIPMENT_HEAT_PUMP, true>(b, 0, cold, target, colder);
+    ThermostatState furnace = stepThermostat<EQUIPMENT_HEAT_COOL, true>(b, 1, cold, target, colder);
+    b.now += MIN_COOLER_OFF_TIME_MS;
+    test("    3. A heat pump waits out the compressor's off time", pump == IDLE && furnace == HEATING &&
+         stepThermostat<EQUIPMENT_HEAT_PUMP, true>(b, 0, cold, target, colder) == HEATING);
+
+    // The hook sees each change once, with its cause; a pass that holds is silent.
+    resetHvacState();
+    SystemMode savedMode = systemMode;
+    systemMode = SYS_HEAT;
+    g_mockMillis = 3600000; initialize_logic_timers();
+    memset(transitionCounts, 0, sizeof(transitionCounts));
+    ThermostatState started = stepThermostat(cold, target, colder);
+    bool traced = transitionCounts[TRANSITION_HEAT_START] == 1 && lastTracedFrom == IDLE && lastTracedTo == HEATING;
+    advanceMockMillis(60000);
+    stepThermostat(cold, target, colder);
+    test("    4. Transitions are traced once, holding passes are not", started == HEATING && deviceController.state[0] == HEATING &&
+         traced && transitionCounts[TRANSITION_HEAT_START] == 1);
+
+    // Switched off under a running heater: it finishes its minimum run, then stops.
+    for (int i = 0; i < 2; i++) {
+        b.relays[i] = 0; b.systemMode[i] = SYS_HEAT; b.systemLockedOut[i] = false; b.heaterMaxRunTriggers[i] = 0;
+        initialize_logic_timers(b, i, b.now);
+    }
+    auto bothPass = [&]() { controlTemperature(b, 0, cold, target, colder); stepThermostat<EQUIPMENT_HEAT_COOL, true>(b, 1, cold, target, colder); };
+    bothPass();
+    b.systemMode[0] = b.systemMode[1] = SYS_OFF;
+    b.now += 60000; bothPass();
+    bool held = relayOn(b, 0, HEATER_RELAY_PIN) && relayOn(b, 1, HEATER_RELAY_PIN);
+    b.now += MIN_HEATER_RUN_TIME_MS; bothPass();
+    test("    5. A heater the mode no longer calls for stops after its minimum run", held && b.relays[0] == 0 && b.relays[1] == 0 &&
+         b.heaterMaxRunTriggers[0] == 0 && sameControllerState(b, 0, 1));
+    setStateTraceHook(nullptr);
+    systemMode = savedMode;
+    resetHvacState();
+}
+
+void testCommands() {
+    Serial.println("  --- Testing Command Queue ---");
+    resetHvacState();
+    resetCommands();
+    SystemMode savedMode = systemMode;
+    Schedule savedSchedule = programSchedule;
+    systemMode = SYS_HEAT; vacationModeActive = false;
+    g_mockMillis = 3600000; initialize_logic_timers();
+    setMockTime(1, 14, 3, 10, 0); // Wednesday 10:00: the weekday 08:30 entry, 75 F
+    // One control pass as loop() runs it, in a house at 76 F.
+    auto pass = [&]() {
+        drainCommands();
+        getCurrentScheduleSettings();
+        stepThermostat(centiCFromF(76), currentTargetTemperature, centiCFromF(30));
+        commitRelays();
+        noteCommandsDecided();
+    };
+    pass();
+    bool idle = !relayOn(deviceController, 0, HEATER_RELAY_PIN);
+    unsigned long logged = learningStats.recordsLogged, latencies = probeHistograms[PROBE_COMMAND_LATENCY].count;
+    bool queued = submitSetpointHold(centiCFromF(78), 30);
+    pass();
+    test("    1. A hold from any task decides the next pass, logged for learning", idle && queued && relayOn(deviceController, 0, HEATER_RELAY_PIN) &&
+         currentTargetTemperature == centiCFromF(78) && learningStats.recordsLogged == logged + 1 &&
+         probeHistograms[PROBE_COMMAND_LATENCY].count == latencies + 1 && commandQueueDepth() == 0);
+
+    advanceMockMillis(31 * 60000UL);
+    pass();
+    bool timedOut = !setpointHold.active && currentTargetTemperature == centiCFromF(75);
+    submitSetpointHold(centiCFromF(77), 0);
+    pass();
+    test("    2. Holds end on time, or at the schedule's next target change", timedOut && setpointHold.active && setpointHold.expires &&
+         setpointHold.until - currentTime() == 7.5 * 3600000UL);
+
+    systemLockedOut = true;
+    ScheduleEntry evening = { 18, 0, centiCFromF(73), FAN_AUTO };
+    submitSystemMode(SYS_COOL); submitVacation(true); submitScheduleEntry(PROGRAM_WEEKDAY, 1, evening); submitLockoutReset();
+    pass();
+    test("    3. Mode, vacation, schedule and lockout changes apply and persist", systemMode == SYS_COOL && vacationModeActive && !setpointHold.active &&
+         programSchedule.weekday[1].target == centiCFromF(73) && programSchedule.weekdayEntryCount == 4 && !systemLockedOut && settingsDirty() &&
+         commandStats.rejected == 0);
+
+    // The trace restates the controller state after a pass that applied commands.
+    recordTrace(g_mockTime, centiCFromF(76), centiCFromF(30), 4000, currentTargetTemperature, FAN_AUTO);
+    TraceStats traced = traceStats;
+    pass();
+    recordTrace(g_mockTime, centiCFromF(76), centiCFromF(30), 4000, currentTargetTemperature, FAN_AUTO);
+    bool quietDelta = traceStats.keyframes == traced.keyframes;
+    systemLockedOut = true;
+    submitLockoutReset();
+    pass();
+    recordTrace(g_mockTime, centiCFromF(76), centiCFromF(30), 4000, currentTargetTemperature, FAN_AUTO);
+    test("    4. A pass that applied commands is traced as a keyframe", quietDelta && traceStats.keyframes == traced.keyframes + 1 && !systemLockedOut);
+
+    // A full queue refuses; a command out of range is dropped when applied.
+    resetCommands();
+    int accepted = 0;
+    for (int n = 0; n <= COMMAND_QUEUE_DEPTH; n++) accepted += submitResumeSchedule();
+    drainCommands();
+    submitSetpointHold(centiCFromF(200), 0); submitScheduleEntry(NUM_SCHEDULE_PROGRAMS, 0, evening);
+    submitScheduleEntry(PROGRAM_WEEKEND, 5, evening); // Past the end of the program
+    drainCommands();
+    test("    5. A full queue refuses and counts; bad commands are rejected", accepted == COMMAND_QUEUE_DEPTH && commandStats.full == 1 &&
+         commandStats.maxDepth == COMMAND_QUEUE_DEPTH && commandStats.rejected == 3 && !setpointHold.active);
+
+    resetCommands();
+    systemMode = savedMode; vacationModeActive = false;
+    programSchedule = savedSchedule; markScheduleEdited(deviceController, 0);
+    resetHvacState();
+}
+
+void testTimeSeries() {
+    Serial.println("  --- Testing Time Series Store ---");
+    // 40 hours from midnight on 1 January, a pass every 30 s; the heater runs
+    // the second half of every ten minutes, so exactly half the time.
+    eraseTimeseries();
+    size_t usedBefore = SPIFFS.usedBytes();
+    SeriesStats before = seriesStats;
+    const unsigned long STEP_MS = 30000;
+    const uint32_t REBOOT_MINUTE = 20 * 60, END_MINUTE = 40 * 60;
+    auto heaterOn = [](uint32_t minute) { return minute % 10 >= 5; };
+    auto pass = [&](unsigned long ms) {
+        uint32_t minute = ms / 60000;
+        TimeInfo wall = { 1, (int)(minute / 1440) + 1, (int)(minute / 1440 + 4) % 7, (int)(minute / 60 % 24), (int)(minute % 60), (int)(ms / 1000 % 60) };
+        recordSeries(ms, wall, heaterOn(minute) ? RELAY_BIT(HEATER_RELAY_PIN) | RELAY_BIT(FAN_RELAY_PIN) : 0, false, centiCFromF(68), centiCFromF(30));
+    };
+    auto expectedOnMs = [&](uint32_t from, uint32_t to) {
+        uint64_t ms = 0;
+        for (uint32_t m = from; m < to; m++) if (heaterOn(m)) ms += 60000;
+        return ms;
+    };
+    unsigned long ms = 0;
+    for (; ms <= 3 * 3600000UL; ms += STEP_MS) pass(ms);
+    SeriesTotals t;
+    SeriesQueryCost cost;
+    bool found = querySeries(0, 180, t, &cost);
+    test("    1. Runtime, duty and starts roll up into hours", found && t.milliseconds == 3 * 3600000ULL && t.onMilliseconds[SERIES_HEATER] == expectedOnMs(0, 180) &&
+         t.onMilliseconds[SERIES_FAN] == t.onMilliseconds[SERIES_HEATER] && t.onMilliseconds[SERIES_COOLER] == 0 && t.starts[SERIES_HEATER] == 18 &&
+         seriesEnergyWh(t) == 3 * (18000 + 400) / 2 && seriesStats.hoursClosed == before.hoursClosed + 3);
+    test("    2. Whole hours are read from the hour tier", cost.buckets[SERIES_HOURS] == 3 && cost.buckets[SERIES_MINUTES] == 0);
+
+    // A clean reset on a minute boundary: flushed, then the store rebuilt from flash.
+    for (; ms <= (REBOOT_MINUTE + 30) * 60000UL; ms += STEP_MS) pass(ms);
+    flushTimeseries();
+    initialize_timeseries();
+    ms -= STEP_MS; // Back up at once: the first pass after boot counts no time
+    for (; ms <= END_MINUTE * 60000UL; ms += STEP_MS) pass(ms);
+    found = querySeries(0, 1440, t, &cost);
+    bool dayTier = found && cost.buckets[SERIES_DAYS] == 1 && cost.buckets[SERIES_HOURS] == 0 && t.onMilliseconds[SERIES_HEATER] == expectedOnMs(0, 1440);
+    found = querySeries(REBOOT_MINUTE, END_MINUTE, t, &cost);
+    test("    3. Days from the day tier; the open hour survives a reset", dayTier && found && t.milliseconds == (END_MINUTE - REBOOT_MINUTE) * 60000ULL &&
+         t.onMilliseconds[SERIES_HEATER] == expectedOnMs(REBOOT_MINUTE, END_MINUTE) && cost.buckets[SERIES_DAYS] == 0);
+
+    // Forty hours overflow the minute ring: its oldest segments were reused, and the hours remain.
+    SeriesTotals early;
+    bool minutesGone = !querySeries(0, 30, early);
+    found = querySeries(17, END_MINUTE - 3, t, &cost);
+    test("    4. Rings recycle within their footprint", minutesGone && seriesStats.segmentsRecycled > before.segmentsRecycled &&
+         SPIFFS.usedBytes() - usedBefore <= timeseriesFlashBytes() && found && t.onMilliseconds[SERIES_HEATER] == expectedOnMs(60, END_MINUTE - 3) &&
+         seriesStats.writeErrors == before.writeErrors && seriesStats.badRecords == before.badRecords);
+    eraseTimeseries();
+}
+
+int runTests() {
   g_isTesting = true;
+  g_testFailures = 0;
   Serial.println("\n--- Starting Self-Test Suite ---");
   testSchedulingLogic();
+  testCompiledSchedule();
   testPerformanceLearning();
+  testControllerBatch();
+  testEventScheduler();
+  testPersistence();
+  testLearningLog();
+  testSmartRecovery();
+  testSensorAcquisition();
+  testTelemetry();
+  testProbes();
+  testPsychrometrics();
+  testWarmStart();
+  testZones();
+  testThermalModel();
+  testTrace();
+  testPressure();
+  testRelayCommit();
+  testStateMachine();
+  testCommands();
+  testTimeSeries();
   // ... call other test suites ...
   g_isTesting = false;
   Serial.println("--- Self-Test Suite Complete ---\n");
+  return g_testFailures;
 }
\ No newline at end of file
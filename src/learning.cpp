@@ -1,22 +1,207 @@
 #include "learning.h"
+#include <Arduino.h>
 #include "config.h"
 #include "main.h"
+#include "persistence.h"
 #include "SPIFFS.h"
 
+static const uint32_t ANALYSIS_WINDOW_MINUTES = ADJUSTMENT_ANALYSIS_HOURS * 60;
+static const int ANALYZER_CHUNK_RECORDS = 16;
+static const int DAYS_BEFORE_MONTH[12] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+
+LearningCheckpoint learningCheckpoint;
+LearningStats learningStats;
+ScheduleProposal scheduleProposals[MAX_SCHEDULE_PROPOSALS];
+int scheduleProposalCount = 0;
+
+static LearningRecord ring[LEARNING_LOG_BUFFER_RECORDS];
+static int ringHead = 0, ringCount = 0;
+static unsigned long oldestBufferedAt = 0;
+static uint32_t currentGeneration = 0;
+
+// =================================================================
+// ==                     LOG FILES                               ==
+// =================================================================
+static bool readHeader(const char* path, LearningLogHeader& header) {
+    File file = SPIFFS.open(path, FILE_READ);
+    if (!file) return false;
+    bool ok = file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) && header.magic == LEARNING_LOG_MAGIC;
+    file.close();
+    return ok;
+}
+
+static bool createLog(uint32_t generation) {
+    File file = SPIFFS.open(LEARNING_LOG_FILE, FILE_WRITE);
+    if (!file) return false;
+    LearningLogHeader header = { LEARNING_LOG_MAGIC, generation };
+    file.write((const uint8_t*)&header, sizeof(header));
+    file.close();
+    currentGeneration = generation;
+    return true;
+}
+
+// The current file becomes the rotated one, replacing the previous rotated
+// file, so the log never holds more than two files. The checkpoint keeps
+// pointing at the generation it was reading, now under the rotated name.
+static void rotateLog() {
+    SPIFFS.remove(LEARNING_LOG_ROTATED_FILE);
+    SPIFFS.rename(LEARNING_LOG_FILE, LEARNING_LOG_ROTATED_FILE);
+    createLog(currentGeneration + 1);
+    learningStats.rotations++;
+}
+
 void initialize_learning() {
     if (!SPIFFS.begin(true)) {
         Serial.println("An Error has occurred while mounting SPIFFS");
     }
+    // Firmware before the binary log wrote /learning_log.csv. Its rows carry
+    // no date, so they cannot become LearningRecords; the file stays for
+    // hvac_fleet_analytics, which still reads it from pulled units.
+
+    LearningLogHeader header;
+    if (readHeader(LEARNING_LOG_FILE, header)) { currentGeneration = header.generation; return; }
+    uint32_t next = learningCheckpoint.generation + 1;
+    if (readHeader(LEARNING_LOG_ROTATED_FILE, header) && header.generation + 1 > next) next = header.generation + 1;
+    createLog(next);
 }
 
-void log_manual_adjustment(float newTempF) {
-    TimeInfo now = getCurrentTime();
+// =================================================================
+// ==                  BUFFERED LOGGING                           ==
+// =================================================================
+uint32_t minuteOfYear(const TimeInfo& t) {
+    int month = (t.month >= 1 && t.month <= 12) ? t.month : 1;
+    uint32_t dayOfYear = DAYS_BEFORE_MONTH[month - 1] + t.day - 1;
+    return ((dayOfYear * 24 + t.hour) * 60 + t.minute) % MINUTES_PER_YEAR;
+}
+
+// Append the whole ring with at most two writes, one open and one close.
+bool flushLearningLog() {
+    if (!ringCount) return true;
+    if (!SPIFFS.exists(LEARNING_LOG_FILE) && !createLog(currentGeneration + 1)) return false;
     File file = SPIFFS.open(LEARNING_LOG_FILE, FILE_APPEND);
-    if (!file) { return; }
-    file.printf("%d,%d,%.1f\n", now.dayOfWeek, now.hour, newTempF);
+    if (!file) return false;
+    int tail = (ringHead - ringCount + LEARNING_LOG_BUFFER_RECORDS) % LEARNING_LOG_BUFFER_RECORDS;
+    int first = std::min(ringCount, LEARNING_LOG_BUFFER_RECORDS - tail);
+    size_t bytes = file.write((const uint8_t*)&ring[tail], first * sizeof(LearningRecord));
+    if (ringCount > first) bytes += file.write((const uint8_t*)&ring[0], (ringCount - first) * sizeof(LearningRecord));
+    size_t size = file.size();
     file.close();
+
+    learningStats.flushes++;
+    learningStats.bytesFlushed += bytes;
+    ringCount = 0;
+    if (size >= LEARNING_LOG_MAX_BYTES) rotateLog();
+    return true;
+}
+
+void log_manual_adjustment(float newTempF) {
+    TimeInfo now = getCurrentTime();
+    if (ringCount == LEARNING_LOG_BUFFER_RECORDS && !flushLearningLog()) {
+        ringCount--; // Filesystem unavailable: overwrite the oldest
+        learningStats.recordsDropped++;
+    }
+    if (!ringCount) oldestBufferedAt = currentTime();
+
+    LearningRecord& rec = ring[ringHead];
+    rec.minuteOfYear = minuteOfYear(now);
+    rec.targetDeciF = (int16_t)lroundf(newTempF * 10.0f);
+    rec.dayOfWeek = (uint8_t)now.dayOfWeek;
+    rec.hour = (uint8_t)now.hour;
+    ringHead = (ringHead + 1) % LEARNING_LOG_BUFFER_RECORDS;
+    ringCount++;
+    learningStats.recordsLogged++;
+}
+
+static void flushLearningLogIfDue() {
+    if (!ringCount) return;
+    if (ringCount >= LEARNING_LOG_FLUSH_RECORDS || currentTime() - oldestBufferedAt >= LEARNING_LOG_FLUSH_SECS * 1000) flushLearningLog();
+}
+
+// =================================================================
+// ==                INCREMENTAL ANALYZER                         ==
+// =================================================================
+static void proposeScheduleChange(int dayOfWeek, int hour, const AdjustmentBucket& bucket) {
+    ScheduleProposal proposal;
+    proposal.dayOfWeek = (uint8_t)dayOfWeek;
+    proposal.hour = (uint8_t)hour;
+    proposal.adjustments = bucket.count;
+    proposal.targetTempF = (float)bucket.sumDeciF / bucket.count / 10.0f;
+
+    // Replace an earlier proposal for the same slot, otherwise append, dropping the oldest when full.
+    int slot = 0;
+    while (slot < scheduleProposalCount && (scheduleProposals[slot].dayOfWeek != dayOfWeek || scheduleProposals[slot].hour != hour)) slot++;
+    if (slot == MAX_SCHEDULE_PROPOSALS) {
+        memmove(&scheduleProposals[0], &scheduleProposals[1], (MAX_SCHEDULE_PROPOSALS - 1) * sizeof(ScheduleProposal));
+        slot--;
+    } else if (slot < scheduleProposalCount) {
+        memmove(&scheduleProposals[slot], &scheduleProposals[slot + 1], (scheduleProposalCount - slot - 1) * sizeof(ScheduleProposal));
+        slot = scheduleProposalCount - 1;
+    } else {
+        scheduleProposalCount++;
+    }
+    scheduleProposals[slot] = proposal;
+    learningStats.proposals++;
+    Serial.printf("Learning: %d adjustments on day %d at %02d:00, proposing %.1f F\n", proposal.adjustments, dayOfWeek, hour, proposal.targetTempF);
+}
+
+// O(1) per record: fold into its (dayOfWeek, hour) bucket. A bucket's window
+// opens at its first record and closes ADJUSTMENT_ANALYSIS_HOURS later.
+static void analyzeRecord(const LearningRecord& rec) {
+    learningStats.recordsAnalyzed++;
+    if (rec.dayOfWeek > 6 || rec.hour > 23 || rec.minuteOfYear >= MINUTES_PER_YEAR) return;
+    AdjustmentBucket& bucket = learningCheckpoint.buckets[rec.dayOfWeek][rec.hour];
+    uint32_t age = (rec.minuteOfYear + MINUTES_PER_YEAR - bucket.windowStartMinute) % MINUTES_PER_YEAR;
+    if (bucket.count == 0 || age >= ANALYSIS_WINDOW_MINUTES) {
+        bucket.windowStartMinute = rec.minuteOfYear;
+        bucket.sumDeciF = 0;
+        bucket.count = 0;
+    }
+    bucket.sumDeciF += rec.targetDeciF;
+    bucket.count++;
+    if (bucket.count >= MIN_ADJUSTMENTS_TO_LEARN) {
+        proposeScheduleChange(rec.dayOfWeek, rec.hour, bucket);
+        bucket.count = 0;
+    }
+}
+
+// Read forward from the checkpoint until the file ends or the budget runs out.
+// Returns true if the file was read to the end.
+static bool analyzeFile(const char* path, unsigned long start) {
+    File file = SPIFFS.open(path, FILE_READ);
+    if (!file || !file.seek(learningCheckpoint.offset)) return true;
+    LearningRecord chunk[ANALYZER_CHUNK_RECORDS];
+    for (;;) {
+        size_t n = file.read((uint8_t*)chunk, sizeof(chunk)) / sizeof(LearningRecord);
+        for (size_t r = 0; r < n; r++) analyzeRecord(chunk[r]);
+        learningCheckpoint.offset += n * sizeof(LearningRecord);
+        if (n) markSettingsDirty(REC_LEARNING);
+        if (n < (size_t)ANALYZER_CHUNK_RECORDS) { file.close(); return true; }
+        if (micros() - start >= LEARNING_ANALYSIS_BUDGET_US) { learningStats.budgetExhausted++; file.close(); return false; }
+    }
 }
 
 void analyze_and_learn_if_needed() {
-    // Placeholder for the full analysis logic
-}
\ No newline at end of file
+    flushLearningLogIfDue();
+    unsigned long start = micros();
+    learningStats.analyzerPasses++;
+
+    LearningCheckpoint& cp = learningCheckpoint;
+    if (cp.generation != currentGeneration) {
+        LearningLogHeader rotated;
+        bool haveRotated = readHeader(LEARNING_LOG_ROTATED_FILE, rotated);
+        if (!haveRotated || cp.generation != rotated.generation) {
+            // The file the checkpoint referred to has rotated away unread.
+            cp.generation = haveRotated ? rotated.generation : currentGeneration;
+            cp.offset = sizeof(LearningLogHeader);
+            learningStats.recordsSkipped++;
+            markSettingsDirty(REC_LEARNING);
+        }
+        if (cp.generation != currentGeneration) {
+            if (!analyzeFile(LEARNING_LOG_ROTATED_FILE, start)) return;
+            cp.generation = currentGeneration;
+            cp.offset = sizeof(LearningLogHeader);
+            markSettingsDirty(REC_LEARNING);
+        }
+    }
+    analyzeFile(LEARNING_LOG_FILE, start);
+}
@@ -1,35 +1,74 @@
 #include <Arduino.h>
 #include "config.h"
+#include "commands.h"
+#include "console.h"
+#include "controller.h"
 #include "main.h"
 #include "hvac_logic.h"
 #include "hvac_tests.h"
 #include "learning.h"
+#include "persistence.h"
+#include "pressure.h"
+#include "probes.h"
+#include "recovery.h"
+#include "relays.h"
+#include "scheduler.h"
+#include "sensors.h"
+#include "state_machine.h"
+#include "telemetry.h"
+#include "thermal_model.h"
+#include "timeseries.h"
+#include "trace.h"
 #include "utils.h"
+#include "warmstart.h"
+#include "driver/gpio.h"
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "esp_task_wdt.h"
+#include "soc/gpio_reg.h"
+#include "soc/soc.h"
 
 // -- Global variables for the main application --
-Schedule programSchedule;
-HvacPerformance performance;
-TempUnit tempUnit = DEFAULT_TEMP_UNIT;
-SystemMode systemMode = DEFAULT_SYSTEM_MODE;
-bool vacationModeActive = false;
+// The device is a controller batch of one, driving the real relays. The names
+// below alias its per-instance state so the rest of the firmware is unchanged.
+static ControllerStorage<1> thermostat(true);
+ControllerBatch& deviceController = thermostat.batch;
+Schedule& programSchedule = thermostat.programSchedule[0];
+HvacPerformance& performance = thermostat.performance[0];
+TempUnit& tempUnit = thermostat.tempUnit[0];
+SystemMode& systemMode = thermostat.systemMode[0];
+bool& vacationModeActive = thermostat.vacationModeActive[0];
+bool& systemLockedOut = thermostat.systemLockedOut[0]; // Shared with logic module
 bool systemInFaultState = false;
-bool systemLockedOut = false; // Shared with logic module
+static bool sensorStuckFault = false; // Soft: clears when the raw reading moves
 
-float currentTargetTemperature;
+CentiC currentTargetTemperature;
 FanMode currentFanMode;
-enum ThermostatState { IDLE, RECOVERING, HEATING, COOLING, FAN_ONLY };
 ThermostatState currentState = IDLE;
 
 // =================================================================
 // ==              HARDWARE ABSTRACTION & UTILITIES               ==
 // =================================================================
-void writeRelay(int p, bool v) { if (g_isTesting) g_mockRelayStates[p] = v; else digitalWrite(p, v); }
-bool readRelay(int p) { return g_isTesting ? g_mockRelayStates[p] : digitalRead(p); }
+// One store to the output register switches every changed relay together; the
+// read-modify-write is safe as no other task drives GPIO. Relay pads stay held
+// between writes, so a warm reset does not drop a running compressor.
+void writeRelays(uint16_t mask, uint16_t changed) {
+  if (g_isTesting) {
+    for (int p = 0; p < 10; p++) if (changed & RELAY_BIT(p)) g_mockRelayStates[p] = (mask & RELAY_BIT(p)) != 0;
+    return;
+  }
+  for (int p = 0; p < RELAY_PIN_LIMIT; p++) if (changed & RELAY_BIT(p)) gpio_hold_dis((gpio_num_t)p);
+  REG_WRITE(GPIO_OUT_REG, (REG_READ(GPIO_OUT_REG) & ~(uint32_t)changed) | (mask & changed));
+  for (int p = 0; p < RELAY_PIN_LIMIT; p++) if (changed & RELAY_BIT(p)) gpio_hold_en((gpio_num_t)p);
+}
 unsigned long currentTime() { return g_isTesting ? g_mockMillis : millis(); }
 
+static volatile unsigned long lastWatchdogFeed = 0;
+void feedWatchdog() { esp_task_wdt_reset(); lastWatchdogFeed = millis(); }
+unsigned long watchdogFeedAge() { return millis() - lastWatchdogFeed; }
+
+// Sensor drivers. These may block on the bus, so only the sensor task
+// (sensors.cpp) calls them; the control loop reads sensorSnapshot().
 // STUB: Replace with actual sensor reading code (e.g., for a DHT22 or SHT31)
 float readTemperature() {
   if (g_isTesting) return g_mockIndoorTempF;
@@ -46,46 +85,10 @@ float readOutdoorTemperature() {
 
 // STUB: Replace with actual sensor reading code
 float readHumidity() {
+    if (g_isTesting) return g_mockHumidity;
     return 48.0; // Stub value
 }
 
-// =================================================================
-// ==                  NVS SAVE/LOAD FUNCTIONS                    ==
-// =================================================================
-void saveSettings() {
-    nvs_handle_t my_handle;
-    esp_err_t err = nvs_open("hvac_cfg", NVS_READWRITE, &my_handle);
-    if (err != ESP_OK) { Serial.printf("Error (%s) opening NVS handle for writing!\n", esp_err_to_name(err)); return; }
-
-    nvs_set_blob(my_handle, "schedule", &programSchedule, sizeof(programSchedule));
-    nvs_set_blob(my_handle, "perf", &performance, sizeof(performance));
-    nvs_set_i8(my_handle, "tempUnit", (int8_t)tempUnit);
-    nvs_set_i8(my_handle, "systemMode", (int8_t)systemMode);
-    nvs_set_i8(my_handle, "vacation", (int8_t)vacationModeActive);
-    
-    nvs_commit(my_handle);
-    nvs_close(my_handle);
-}
-
-void loadSettings() {
-    nvs_handle_t my_handle;
-    esp_err_t err = nvs_open("hvac_cfg", NVS_READONLY, &my_handle);
-    if (err != ESP_OK) { saveSettings(); return; }
-
-    size_t required_size = sizeof(programSchedule);
-    nvs_get_blob(my_handle, "schedule", &programSchedule, &required_size);
-    
-    size_t perf_size = sizeof(performance);
-    nvs_get_blob(my_handle, "perf", &performance, &perf_size);
-
-    int8_t temp_i8;
-    if(nvs_get_i8(my_handle, "tempUnit", &temp_i8) == ESP_OK) tempUnit = (TempUnit)temp_i8;
-    if(nvs_get_i8(my_handle, "systemMode", &temp_i8) == ESP_OK) systemMode = (SystemMode)temp_i8;
-    if(nvs_get_i8(my_handle, "vacation", &temp_i8) == ESP_OK) vacationModeActive = (bool)temp_i8;
-
-    nvs_close(my_handle);
-}
-
 // =================================================================
 // ==                 SCHEDULING & CORE LOGIC                     ==
 // =================================================================
@@ -93,48 +96,134 @@ TimeInfo getCurrentTime() {
   if (g_isTesting) return g_mockTime;
   // This function MUST be implemented with a real RTC or NTP client.
   TimeInfo now;
-  now.month = 8; now.day = 7; now.dayOfWeek = 4; now.hour = 9; now.minute = 52;
+  now.month = 8; now.day = 7; now.dayOfWeek = 4; now.hour = 9; now.minute = 52; now.second = 0;
   return now;
 }
 
-int getCurrentSeason() {
-    TimeInfo now = getCurrentTime();
-    int month = now.month;
+int seasonForMonth(int month) {
     if (month == 12 || month == 1 || month == 2) return 0; // Winter
     if (month >= 3 && month <= 5) return 1;               // Spring
     if (month >= 6 && month <= 8) return 2;               // Summer
     return 3;                                             // Fall
 }
 
-void getCurrentScheduleSettings() {
-  if (vacationModeActive) {
-    currentTargetTemperature = programSchedule.vacation.targetTemperature;
-    currentFanMode = programSchedule.vacation.fanMode;
-    return;
+int getCurrentSeason() {
+    return seasonForMonth(getCurrentTime().month);
+}
+
+// Reference scan: the raw Schedule is searched afresh on every call.
+static const ScheduleEntry* scheduleForDay(const Schedule& schedule, const TimeInfo& now, int* entryCount) {
+  int day = now.dayOfWeek;
+  for (int i = 0; i < schedule.exceptionCount && i < MAX_SCHEDULE_EXCEPTIONS; i++) {
+    if (schedule.exceptions[i].month == now.month && schedule.exceptions[i].day == now.day) day = schedule.exceptions[i].programDay;
   }
-  
-  TimeInfo now = getCurrentTime();
-  ScheduleEntry* daySchedule;
-  int entryCount;
+  if (schedule.dayOverrideCount[day] > 0) { *entryCount = schedule.dayOverrideCount[day]; return schedule.dayOverride[day]; }
+  if (day >= 1 && day <= 5) { *entryCount = schedule.weekdayEntryCount; return schedule.weekday; }
+  *entryCount = schedule.weekendEntryCount; return schedule.weekend;
+}
+
+const ScheduleEntry& lookupScheduleEntry(const Schedule& schedule, bool vacation, const TimeInfo& now) {
+  if (vacation) return schedule.vacation;
 
-  if (now.dayOfWeek >= 1 && now.dayOfWeek <= 5) { daySchedule = programSchedule.weekday; entryCount = programSchedule.weekdayEntryCount; } 
-  else { daySchedule = programSchedule.weekend; entryCount = programSchedule.weekendEntryCount; }
+  int entryCount;
+  const ScheduleEntry* daySchedule = scheduleForDay(schedule, now, &entryCount);
 
-  ScheduleEntry activeEntry = daySchedule[0];
+  const ScheduleEntry* activeEntry = nullptr;
   for (int i = 0; i < entryCount; i++) {
     if (now.hour > daySchedule[i].startHour || (now.hour == daySchedule[i].startHour && now.minute >= daySchedule[i].startMinute)) {
-      activeEntry = daySchedule[i];
+      activeEntry = &daySchedule[i];
     }
   }
-  currentTargetTemperature = activeEntry.targetTemperature;
+  if (activeEntry) return *activeEntry;
+
+  // Before the day's first entry, the previous day's last entry is still in force.
+  daySchedule = scheduleForDay(schedule, timeAfterDays(now, -1), &entryCount);
+  activeEntry = &daySchedule[0];
+  for (int i = 1; i < entryCount; i++) {
+    if (daySchedule[i].startHour * 60 + daySchedule[i].startMinute >= activeEntry->startHour * 60 + activeEntry->startMinute) activeEntry = &daySchedule[i];
+  }
+  return *activeEntry;
+}
+
+unsigned long secondsUntilNextScheduleChange(const Schedule& schedule, bool vacation, const TimeInfo& now) {
+  if (vacation) return NO_SCHEDULE_CHANGE;
+  int entryCount;
+  const ScheduleEntry* daySchedule = scheduleForDay(schedule, now, &entryCount);
+
+  long secondOfDay = now.hour * 3600L + now.minute * 60L + now.second;
+  long next = 24 * 3600L; // Midnight: the day type, and so the entry list, may change
+  for (int i = 0; i < entryCount; i++) {
+    long start = daySchedule[i].startHour * 3600L + daySchedule[i].startMinute * 60L;
+    if (start > secondOfDay && start < next) next = start;
+  }
+  return (unsigned long)(next - secondOfDay);
+}
+
+// The clock is only read when the cached entry has run out.
+void getCurrentScheduleSettings() {
+  deviceController.now = currentTime();
+  const ScheduleEntry& activeEntry = scheduleCursorValid(deviceController, 0)
+      ? *deviceController.scheduleCursor[0].entry
+      : activeScheduleEntry(deviceController, 0, getCurrentTime());
+  currentTargetTemperature = setpointHeld() ? setpointHold.target : activeEntry.target;
   currentFanMode = activeEntry.fanMode;
 }
 
-bool validateSensorReadings(float indoorTempF) {
-    if (indoorTempF < MIN_PLAUSIBLE_TEMP_F || indoorTempF > MAX_PLAUSIBLE_TEMP_F) {
-        Serial.printf("CRITICAL FAULT: Indoor temperature reading (%.1f F) is outside plausible range!\n", indoorTempF);
+// The scheduler also calls this quietly at every sensor poll, so a fault
+// wakes the control task rather than waiting out the sleep.
+bool validateSensorReadings(const SensorSnapshot& sensors, bool report) {
+    float toF = (tempUnit == FAHRENHEIT) ? 1.0 : 9.0 / 5.0;
+    float indoorTempF = (tempUnit == FAHRENHEIT) ? sensors.indoor : celsiusToFahrenheit(sensors.indoor);
+    if (!(indoorTempF >= MIN_PLAUSIBLE_TEMP_F && indoorTempF <= MAX_PLAUSIBLE_TEMP_F)) { // NaN fails too
+        if (report) Serial.printf("CRITICAL FAULT: Indoor temperature reading (%.1f F) is outside plausible range!\n", indoorTempF);
+        return false;
+    }
+    if (abs(sensors.indoorRatePerMin * toF) > SENSOR_MAX_RATE_F_PER_MIN) {
+        if (report) Serial.printf("CRITICAL FAULT: Indoor temperature changing at %.1f F/min!\n", sensors.indoorRatePerMin * toF);
         return false;
     }
+    if (currentTime() - sensors.timestamp > SENSOR_STALE_SECS * 1000) {
+        if (report) Serial.println("CRITICAL FAULT: No sensor sample received; sensor task or bus hung!");
+        return false;
+    }
+    return true;
+}
+
+// Latches the fault state on a bad reading and drops every output in the
+// same pass. Returns true if it did.
+bool latchSensorFault(const SensorSnapshot& sensors) {
+    if (validateSensorReadings(sensors)) return false;
+    systemInFaultState = true;
+    deviceController.relays[0] = 0;
+    commitRelays();
+    invalidateWarmState(); // The fault needs a manual reset, which boots cold
+    return true;
+}
+
+// A flat raw reading may be a failed sensor or a still house, so it does not
+// latch the fault state: heat, cool and every output stay off, stopped as the
+// control rules would, until the reading moves again. Returns true while held.
+bool holdForStuckSensor(const SensorSnapshot& sensors) {
+    ControllerBatch& b = deviceController;
+    if (!sensors.indoorStuck) {
+        if (sensorStuckFault) {
+            Serial.println("Indoor temperature changing again; sensor fault cleared.");
+            sensorStuckFault = false;
+            requestTraceKeyframe(); // The held passes were not traced
+        }
+        return false;
+    }
+    if (!sensorStuckFault) {
+        Serial.printf("SENSOR FAULT: Indoor temperature stuck at %.1f for %lu minutes; outputs off until it changes.\n", sensors.indoor, SENSOR_STUCK_MINS);
+        sensorStuckFault = true;
+    }
+    b.now = currentTime();
+    if (relayOn(b, 0, HEATER_RELAY_PIN)) b.lastHeaterOffTime[0] = b.now;
+    if (relayOn(b, 0, COOLER_RELAY_PIN)) b.lastCoolerOffTime[0] = b.now;
+    b.cycleInProgress[0] = false;
+    b.relays[0] = 0;
+    commitRelays();
+    saveWarmState(); // A reset now must not resume what was running
     return true;
 }
 
@@ -142,11 +231,25 @@ bool validateSensorReadings(float indoorTempF) {
 // ==                     SETUP & LOOP                            ==
 // =================================================================
 void setup() {
+  bootStats = BootStats();
+  bootStats.setupMs = currentTime(); bootStats.setupUs = micros();
   Serial.begin(115200);
-  while (!Serial);
 
-  esp_task_wdt_init(10, true); 
+  esp_task_wdt_init(WATCHDOG_TIMEOUT_SECS, true); 
   esp_task_wdt_add(NULL);
+  feedWatchdog();
+
+  // Before anything that could crash: the relays stay latched only for a
+  // boot that may resume them; otherwise they drop now, not after the
+  // filesystem and NVS have come up.
+  pinMode(HEATER_RELAY_PIN, OUTPUT); pinMode(COOLER_RELAY_PIN, OUTPUT);
+  pinMode(FAN_RELAY_PIN, OUTPUT);    pinMode(FRESH_AIR_RELAY_PIN, OUTPUT);
+  pinMode(HUMIDITY_RELAY_PIN, OUTPUT);
+  if (!claimWarmState()) {
+    deviceController.relays[0] = 0;
+    writeRelays(0, RELAY_BIT(HEATER_RELAY_PIN) | RELAY_BIT(COOLER_RELAY_PIN) | RELAY_BIT(FAN_RELAY_PIN) |
+                   RELAY_BIT(FRESH_AIR_RELAY_PIN) | RELAY_BIT(HUMIDITY_RELAY_PIN));
+  }
 
   esp_err_t ret = nvs_flash_init();
   if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -156,59 +259,105 @@ void setup() {
   ESP_ERROR_CHECK(ret);
   
   loadSettings(); 
+  installPersistenceResetHooks();
   initialize_learning();
-  runTests();
+  initialize_trace();
+  initialize_timeseries();
 
-  pinMode(HEATER_RELAY_PIN, OUTPUT); pinMode(COOLER_RELAY_PIN, OUTPUT);
-  pinMode(FAN_RELAY_PIN, OUTPUT);    pinMode(FRESH_AIR_RELAY_PIN, OUTPUT);
-  pinMode(HUMIDITY_RELAY_PIN, OUTPUT);
-
-  initialize_logic_timers();
+  // A warm reset resumes with the timers and latched relays it had; anything
+  // else starts from all-off and waits out the power-on delay.
+  initialize_relays();
+  bootStats.warm = warmStart();
+  if (!bootStats.warm) {
+    deviceController.relays[0] = 0;
+    initialize_logic_timers();
+  }
+  commitRelays(); // Every relay, as the levels held through the reset are unknown
+  startSensorAcquisition();
+  startTelemetry();
+  if (PRESSURE_MONITOR_ENABLED) startPressureMonitor();
+  startConsole();
   
-  Serial.println("Initialization Complete. Applying power-on delay...");
-  delay(5000); 
+  if (!bootStats.warm) {
+    Serial.println("Initialization Complete. Applying power-on delay...");
+    delay(5000); 
+  }
   Serial.println("Starting control loop.");
 }
 
 void loop() {
-  esp_task_wdt_reset();
+  feedWatchdog();
+  uint32_t passStart = probeStart();
+  pollConsole();
+  { PROBE_SCOPE(PROBE_COMMANDS); drainCommands(); } // Applied before this pass decides
 
   if (systemInFaultState) {
     Serial.println("System in FAULT state. Manual reset required. Halting operations.");
-    writeRelay(HEATER_RELAY_PIN, LOW); writeRelay(COOLER_RELAY_PIN, LOW);
-    writeRelay(FAN_RELAY_PIN, LOW);    writeRelay(FRESH_AIR_RELAY_PIN, LOW);
-    writeRelay(HUMIDITY_RELAY_PIN, LOW);
+    deviceController.relays[0] = 0;
+    commitRelays();
+    noteCommandsDecided();
     delay(30000);
     return;
   }
 
-  getCurrentScheduleSettings();
+  { PROBE_SCOPE(PROBE_SCHEDULE); getCurrentScheduleSettings(); }
 
-  float currentTempRaw = readTemperature();
-  float outdoorTempRaw = readOutdoorTemperature();
-  float currentHumidity = readHumidity();
+  SensorSnapshot sensors;
+  { PROBE_SCOPE(PROBE_SENSORS); sensors = sensorSnapshot(); }
+  CentiC indoor = sensors.indoorCentiC;
+  CentiC outdoor = sensors.outdoorCentiC;
+  CentiRH humidity = sensors.humidityCentiRH;
 
-  if (!validateSensorReadings( (tempUnit == FAHRENHEIT) ? currentTempRaw : celsiusToFahrenheit(currentTempRaw) )) {
-    systemInFaultState = true;
-    return; 
+  if (latchSensorFault(sensors)) {
+    noteCommandsDecided();
+    return;
+  }
+  if (holdForStuckSensor(sensors)) {
+    noteCommandsDecided();
+    delay(SENSOR_POLL_INTERVAL_MS);
+    return;
   }
-  
-  analyze_and_learn_if_needed();
 
-  float currentTempC = (tempUnit == FAHRENHEIT) ? fahrenheitToCelsius(currentTempRaw) : currentTempRaw;
-  float outdoorTempC = (tempUnit == FAHRENHEIT) ? fahrenheitToCelsius(outdoorTempRaw) : outdoorTempRaw;
-  float targetTempC = (tempUnit == FAHRENHEIT) ? fahrenheitToCelsius(currentTargetTemperature) : currentTargetTemperature;
-  
-  char unitChar = (tempUnit == FAHRENHEIT) ? 'F' : 'C';
   TimeInfo now = getCurrentTime();
-  Serial.print("Time: "); Serial.print(now.hour); Serial.print(":"); if(now.minute < 10) Serial.print("0"); Serial.print(now.minute);
-  Serial.print(" | Temp: "); Serial.print(currentTempRaw, 1); Serial.print(unitChar);
-  Serial.print(", Target: "); Serial.print(currentTargetTemperature, 1); Serial.print(unitChar);
-  Serial.print(" | Humidity: "); Serial.print(currentHumidity, 1); Serial.println("%");
-
-  controlTemperature(currentTempC, targetTempC, outdoorTempC);
-  controlHumidity(currentHumidity, currentTempC, outdoorTempC);
-  controlFan(currentFanMode);
-  
-  delay(5000);
+
+  // The relays have held since the last pass; fit that interval before deciding again
+  { PROBE_SCOPE(PROBE_THERMAL_MODEL); updateThermalModel(indoor, outdoor); }
+
+  // Smart Recovery may run to the next schedule entry's target ahead of time, unless the user holds the setpoint
+  CentiC controlTarget = currentTargetTemperature;
+  if (setpointHold.active) deviceController.recovery[0].active = false;
+  else { PROBE_SCOPE(PROBE_RECOVERY); controlTarget = planRecovery(now, indoor, outdoor, currentTargetTemperature); }
+
+  ThermostatState state;
+  { PROBE_SCOPE(PROBE_CONTROL_TEMP); state = stepThermostat(indoor, controlTarget, outdoor); }
+  { PROBE_SCOPE(PROBE_CONTROL_HUMIDITY); controlHumidity(humidity, indoor, outdoor); }
+  { PROBE_SCOPE(PROBE_CONTROL_FAN); controlFan(currentFanMode); }
+  { PROBE_SCOPE(PROBE_RELAY_COMMIT); commitRelays(); } // The pass's decisions reach the pins together
+  noteCommandsDecided();
+  if (deviceController.recovery[0].active) currentState = RECOVERING;
+  else if (state == IDLE && relayOn(deviceController, 0, FAN_RELAY_PIN)) currentState = FAN_ONLY;
+  else currentState = state;
+  saveWarmState();
+  noteFirstDecision();
+  { PROBE_SCOPE(PROBE_TRACE); recordTrace(now, indoor, outdoor, humidity, controlTarget, currentFanMode); }
+  { PROBE_SCOPE(PROBE_SERIES); recordSeries(now, indoor, outdoor); }
+  {
+    PROBE_SCOPE(PROBE_TELEMETRY); // Queued; the telemetry task does the UART I/O
+    publishTelemetry(sensors, now, controlTarget, currentState);
+    publishProbeTelemetry();
+  }
+
+  // Relays are set; now is the time for bounded background work
+  { PROBE_SCOPE(PROBE_LEARNING); analyze_and_learn_if_needed(); }
+  { PROBE_SCOPE(PROBE_PERSISTENCE); persistenceTick(); }
+
+  // Sleep until the next instant a decision could change, or a reading leaves its band
+  WakePlan plan;
+  {
+    PROBE_SCOPE(PROBE_PLAN_WAKE);
+    plan = planNextWake(deviceController, 0, now, currentFanMode, indoor, controlTarget, outdoor, humidity);
+    planHoldExpiry(plan, deviceController.now);
+  }
+  probeStop(PROBE_LOOP, passStart);
+  schedulerSleep(plan);
 }
\ No newline at end of file
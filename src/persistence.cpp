@@ -0,0 +1,383 @@
+#include "persistence.h"
+#include <Arduino.h>
+#include <atomic>
+#include <mutex>
+#include "config.h"
+#include "controller.h"
+#include "hvac_tests.h"
+#include "learning.h"
+#include "main.h"
+#include "nvs.h"
+#include "probes.h"
+#include "utils.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char* const NVS_NAMESPACE = "hvac_cfg";
+static const char* const LEGACY_PERF_KEY = "perf"; // Whole-table blob written before per-row records
+
+PersistenceStats persistenceStats;
+
+// The control task changes the settings and marks them; the guard task and
+// shutdown handlers may flush meanwhile. So the masks are atomic, and a flush
+// never reads the live settings: it writes the staged copy, which the control
+// task refreshes at the end of each pass, when no change is half made. A mark
+// clears the record's staged bit, so a record changed since its last staging
+// stays pending rather than being written stale and forgotten.
+struct StagedSettings {
+  Schedule schedule;
+  TempUnit tempUnit;
+  SystemMode systemMode;
+  bool vacation;
+  LearningCheckpoint learning;
+  PerfRecord perf[2 * NUM_SEASONS];
+};
+static StagedSettings staged;
+static std::mutex stagedLock;                  // Guards staged and the mask updates
+static std::atomic<uint32_t> dirtyRecords(0);
+static std::atomic<uint32_t> stagedRecords(0); // Dirty records whose staged copy is current
+static std::atomic<unsigned long> writeBackDeadline(0); // Armed by the first change after a flush
+static std::atomic<bool> flushInProgress(false);
+static bool legacyPerfPresent = false;
+static const uint32_t PERF_RECORDS_MASK = ((1u << NUM_PERSIST_RECORDS) - 1) & ~((1u << REC_PERF_HEAT_0) - 1);
+
+// Layouts written by firmware before the integer control path: float targets
+// in the display unit and float rates in F per hour (LegacyPerformance is in
+// persistence.h). They differ in size from
+// the current records, which is how loadSettings() tells them apart.
+struct LegacyScheduleEntry { int startHour, startMinute; float targetTemperature; int fanMode; };
+struct LegacyScheduleException { int month, day, programDay; };
+struct LegacySchedule {
+  LegacyScheduleEntry weekday[MAX_DAY_ENTRIES];
+  int weekdayEntryCount;
+  LegacyScheduleEntry weekend[MAX_DAY_ENTRIES];
+  int weekendEntryCount;
+  LegacyScheduleEntry vacation;
+  LegacyScheduleEntry dayOverride[7][MAX_DAY_OVERRIDE_ENTRIES];
+  int dayOverrideCount[7];
+  LegacyScheduleException exceptions[MAX_SCHEDULE_EXCEPTIONS];
+  int exceptionCount;
+};
+// The original firmware's schedule: the same entries, without overrides or exceptions.
+struct BaselineSchedule {
+  LegacyScheduleEntry weekday[MAX_DAY_ENTRIES];
+  int weekdayEntryCount;
+  LegacyScheduleEntry weekend[MAX_DAY_ENTRIES];
+  int weekendEntryCount;
+  LegacyScheduleEntry vacation;
+};
+struct LegacyPerfRecord { float rate[NUM_PERFORMANCE_BINS]; int samples[NUM_PERFORMANCE_BINS]; };
+static_assert(sizeof(LegacySchedule) != sizeof(Schedule) && sizeof(BaselineSchedule) != sizeof(Schedule) &&
+              sizeof(BaselineSchedule) != sizeof(LegacySchedule) && sizeof(LegacyPerfRecord) != sizeof(PerfRecord), "Legacy records must differ in size");
+
+static const char* recordKey(int rec) {
+  static const char* const perfKeys[2 * NUM_SEASONS] = { "perfH0", "perfH1", "perfH2", "perfH3", "perfC0", "perfC1", "perfC2", "perfC3" };
+  switch (rec) {
+    case REC_SCHEDULE:    return "schedule";
+    case REC_TEMP_UNIT:   return "tempUnit";
+    case REC_SYSTEM_MODE: return "systemMode";
+    case REC_VACATION:    return "vacation";
+    case REC_LEARNING:    return "learnChkpt";
+    default:              return perfKeys[rec - REC_PERF_HEAT_0];
+  }
+}
+
+static void packPerf(int rec, PerfRecord& row) {
+  bool heat = rec < REC_PERF_COOL_0;
+  int season = rec - (heat ? REC_PERF_HEAT_0 : REC_PERF_COOL_0);
+  memcpy(row.rate, heat ? performance.heatRate[season] : performance.coolRate[season], sizeof(row.rate));
+  memcpy(row.samples, heat ? performance.heatSamples[season] : performance.coolSamples[season], sizeof(row.samples));
+}
+
+static void unpackPerf(int rec, const PerfRecord& row) {
+  bool heat = rec < REC_PERF_COOL_0;
+  int season = rec - (heat ? REC_PERF_HEAT_0 : REC_PERF_COOL_0);
+  memcpy(heat ? performance.heatRate[season] : performance.coolRate[season], row.rate, sizeof(row.rate));
+  memcpy(heat ? performance.heatSamples[season] : performance.coolSamples[season], row.samples, sizeof(row.samples));
+}
+
+static uint16_t saturate16(float v) { return v <= 0 ? 0 : v >= UINT16_MAX ? UINT16_MAX : (uint16_t)(v + 0.5f); }
+
+static PerfRecord convertLegacyPerf(const LegacyPerfRecord& legacy) {
+  PerfRecord row;
+  for (int bin = 0; bin < NUM_PERFORMANCE_BINS; bin++) {
+    row.rate[bin] = saturate16(legacy.rate[bin] * 500.0f / 9.0f);
+    row.samples[bin] = saturate16((float)legacy.samples[bin]);
+  }
+  return row;
+}
+
+static ScheduleEntry convertLegacyEntry(const LegacyScheduleEntry& e, TempUnit unit) {
+  return { (uint8_t)e.startHour, (uint8_t)e.startMinute, centiCFrom(e.targetTemperature, unit), (FanMode)e.fanMode };
+}
+
+static void convertLegacySchedule(const LegacySchedule& legacy, TempUnit unit, Schedule& out) {
+  for (int e = 0; e < MAX_DAY_ENTRIES; e++) {
+    out.weekday[e] = convertLegacyEntry(legacy.weekday[e], unit);
+    out.weekend[e] = convertLegacyEntry(legacy.weekend[e], unit);
+  }
+  out.weekdayEntryCount = (uint8_t)legacy.weekdayEntryCount;
+  out.weekendEntryCount = (uint8_t)legacy.weekendEntryCount;
+  out.vacation = convertLegacyEntry(legacy.vacation, unit);
+  for (int day = 0; day < 7; day++) {
+    for (int e = 0; e < MAX_DAY_OVERRIDE_ENTRIES; e++) out.dayOverride[day][e] = convertLegacyEntry(legacy.dayOverride[day][e], unit);
+    out.dayOverrideCount[day] = (uint8_t)legacy.dayOverrideCount[day];
+  }
+  for (int x = 0; x < MAX_SCHEDULE_EXCEPTIONS; x++) {
+    const LegacyScheduleException& ex = legacy.exceptions[x];
+    out.exceptions[x] = { (uint8_t)ex.month, (uint8_t)ex.day, (uint8_t)ex.programDay };
+  }
+  out.exceptionCount = (uint8_t)legacy.exceptionCount;
+}
+
+static void convertBaselineSchedule(const BaselineSchedule& baseline, TempUnit unit, Schedule& out) {
+  out = Schedule();
+  for (int e = 0; e < MAX_DAY_ENTRIES; e++) {
+    out.weekday[e] = convertLegacyEntry(baseline.weekday[e], unit);
+    out.weekend[e] = convertLegacyEntry(baseline.weekend[e], unit);
+  }
+  out.weekdayEntryCount = (uint8_t)baseline.weekdayEntryCount;
+  out.weekendEntryCount = (uint8_t)baseline.weekendEntryCount;
+  out.vacation = convertLegacyEntry(baseline.vacation, unit);
+}
+
+static bool scheduleCountsValid(const Schedule& s) {
+  if (s.weekdayEntryCount > MAX_DAY_ENTRIES || s.weekendEntryCount > MAX_DAY_ENTRIES || s.exceptionCount > MAX_SCHEDULE_EXCEPTIONS) return false;
+  for (int day = 0; day < 7; day++) if (s.dayOverrideCount[day] > MAX_DAY_OVERRIDE_ENTRIES) return false;
+  return true;
+}
+
+// Copy one record from the live settings. Control task, under stagedLock.
+static void stageRecord(int rec) {
+  switch (rec) {
+    case REC_SCHEDULE:    staged.schedule = programSchedule; break;
+    case REC_TEMP_UNIT:   staged.tempUnit = tempUnit; break;
+    case REC_SYSTEM_MODE: staged.systemMode = systemMode; break;
+    case REC_VACATION:    staged.vacation = vacationModeActive; break;
+    case REC_LEARNING:    staged.learning = learningCheckpoint; break;
+    default:              packPerf(rec, staged.perf[rec - REC_PERF_HEAT_0]); break;
+  }
+}
+
+// Write one staged record to the open handle; returns the bytes written, 0 on error.
+static size_t writeRecord(nvs_handle_t handle, int rec) {
+  const char* key = recordKey(rec);
+  const StagedSettings& s = staged;
+  switch (rec) {
+    case REC_SCHEDULE:    return nvs_set_blob(handle, key, &s.schedule, sizeof(s.schedule)) == ESP_OK ? sizeof(s.schedule) : 0;
+    case REC_TEMP_UNIT:   return nvs_set_i8(handle, key, (int8_t)s.tempUnit) == ESP_OK ? 1 : 0;
+    case REC_SYSTEM_MODE: return nvs_set_i8(handle, key, (int8_t)s.systemMode) == ESP_OK ? 1 : 0;
+    case REC_VACATION:    return nvs_set_i8(handle, key, (int8_t)s.vacation) == ESP_OK ? 1 : 0;
+    case REC_LEARNING:    return nvs_set_blob(handle, key, &s.learning, sizeof(s.learning)) == ESP_OK ? sizeof(s.learning) : 0;
+    default: {
+      const PerfRecord& row = s.perf[rec - REC_PERF_HEAT_0];
+      return nvs_set_blob(handle, key, &row, sizeof(row)) == ESP_OK ? sizeof(row) : 0;
+    }
+  }
+}
+
+// =================================================================
+// ==                    DIRTY TRACKING                           ==
+// =================================================================
+void markSettingsDirty(PersistRecord record) {
+  std::lock_guard<std::mutex> guard(stagedLock);
+  persistenceStats.marks++;
+  uint32_t bit = 1u << record;
+  stagedRecords.fetch_and(~bit);
+  uint32_t was = dirtyRecords.fetch_or(bit);
+  if (was & bit) { persistenceStats.coalesced++; return; }
+  // The deadline is set by the oldest pending change and never pushed back, so
+  // a steady stream of updates cannot postpone the write indefinitely.
+  if (!was) writeBackDeadline = currentTime() + SETTINGS_WRITE_BACK_MS;
+}
+
+void markPerformanceDirty(uint8_t perfDirtyMask) {
+  for (int season = 0; season < NUM_SEASONS; season++) {
+    if (perfDirtyMask & PERF_DIRTY_BIT(true, season)) markSettingsDirty((PersistRecord)(REC_PERF_HEAT_0 + season));
+    if (perfDirtyMask & PERF_DIRTY_BIT(false, season)) markSettingsDirty((PersistRecord)(REC_PERF_COOL_0 + season));
+  }
+}
+
+bool settingsDirty() { return dirtyRecords != 0; }
+
+// Control task only, between changes: bring the staged copy up to date.
+static void stageSettings() {
+  std::lock_guard<std::mutex> guard(stagedLock);
+  uint32_t todo = dirtyRecords & ~stagedRecords;
+  for (int rec = 0; rec < NUM_PERSIST_RECORDS; rec++) if (todo & (1u << rec)) stageRecord(rec);
+  stagedRecords.fetch_or(todo);
+}
+
+// =================================================================
+// ==                        FLUSHING                             ==
+// =================================================================
+// From the control task (owner) the live settings are staged first; from
+// another task only records staged at the end of a pass are written.
+static bool flush(bool emergency, bool owner) {
+  if (owner) stageSettings();
+  if (!dirtyRecords) return true;
+  bool expected = false;
+  if (!flushInProgress.compare_exchange_strong(expected, true)) return false; // Another task is mid-flush
+
+  bool ok = false;
+  nvs_handle_t handle;
+  esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+  if (err != ESP_OK) {
+    Serial.printf("Error (%s) opening NVS handle for writing!\n", esp_err_to_name(err));
+  } else {
+    // Take the staged pending set before writing, so a change made meanwhile re-arms.
+    uint32_t pending, failed = 0;
+    unsigned long bytes = 0, records = 0;
+    {
+      std::lock_guard<std::mutex> guard(stagedLock);
+      pending = dirtyRecords & stagedRecords;
+      dirtyRecords.fetch_and(~pending);
+      for (int rec = 0; rec < NUM_PERSIST_RECORDS; rec++) {
+        if (!(pending & (1u << rec))) continue;
+        size_t n = writeRecord(handle, rec);
+        if (n) { bytes += n; records++; } else failed |= 1u << rec;
+      }
+    }
+    bool migrating = legacyPerfPresent && (pending & PERF_RECORDS_MASK) == PERF_RECORDS_MASK;
+    if (migrating) nvs_erase_key(handle, LEGACY_PERF_KEY); // The rows now hold the whole table
+
+    unsigned long start = micros();
+    uint32_t probe = probeStart();
+    err = nvs_commit(handle);
+    if (!emergency) probeStop(PROBE_NVS_COMMIT, probe); // Probes belong to the control task
+    unsigned long commitUs = micros() - start;
+    nvs_close(handle);
+
+    if (err == ESP_OK && !failed) {
+      if (migrating) legacyPerfPresent = false;
+      ok = true;
+    } else {
+      failed = (err == ESP_OK) ? failed : pending;
+    }
+    if (failed) {
+      // Keep failed records pending and retry after another write-back window.
+      std::lock_guard<std::mutex> guard(stagedLock);
+      persistenceStats.errors++;
+      if (!dirtyRecords.fetch_or(failed)) writeBackDeadline = currentTime() + SETTINGS_WRITE_BACK_MS;
+    }
+    if (records && err == ESP_OK) {
+      persistenceStats.flushes++;
+      if (emergency) persistenceStats.emergencyFlushes++;
+      persistenceStats.recordsWritten += records;
+      persistenceStats.bytesWritten += bytes;
+      persistenceStats.lastCommitUs = commitUs;
+      persistenceStats.totalCommitUs += commitUs;
+      if (commitUs > persistenceStats.maxCommitUs) persistenceStats.maxCommitUs = commitUs;
+    }
+  }
+  flushInProgress = false;
+  return ok;
+}
+
+bool flushSettings() { return flush(false, true); }
+
+// Once per pass, when the control task has no change half made.
+void persistenceTick() {
+  if (!dirtyRecords) return;
+  if ((long)(currentTime() - writeBackDeadline) >= 0) flush(false, true);
+  else stageSettings();
+}
+
+void saveSettings() {
+  for (int rec = 0; rec < NUM_PERSIST_RECORDS; rec++) markSettingsDirty((PersistRecord)rec);
+  flushSettings();
+}
+
+void loadSettings() {
+  nvs_handle_t my_handle;
+  esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &my_handle);
+  if (err != ESP_OK) { saveSettings(); return; }
+
+  // The unit first: a legacy schedule holds its targets in it.
+  int8_t temp_i8;
+  if(nvs_get_i8(my_handle, "tempUnit", &temp_i8) == ESP_OK) tempUnit = (TempUnit)temp_i8;
+  if(nvs_get_i8(my_handle, "systemMode", &temp_i8) == ESP_OK) systemMode = (SystemMode)temp_i8;
+  if(nvs_get_i8(my_handle, "vacation", &temp_i8) == ESP_OK) vacationModeActive = (bool)temp_i8;
+
+  // The blob's size tells its layout. One of unknown size, or whose counts
+  // run past the arrays, leaves the defaults in place.
+  uint32_t migrate = 0;
+  size_t required_size = 0;
+  if (nvs_get_blob(my_handle, "schedule", nullptr, &required_size) == ESP_OK) {
+    Schedule loaded;
+    bool read = false;
+    if (required_size == sizeof(Schedule)) {
+      read = nvs_get_blob(my_handle, "schedule", &loaded, &required_size) == ESP_OK;
+    } else if (required_size == sizeof(LegacySchedule)) {
+      LegacySchedule legacy;
+      read = nvs_get_blob(my_handle, "schedule", &legacy, &required_size) == ESP_OK;
+      if (read) convertLegacySchedule(legacy, tempUnit, loaded);
+      migrate |= 1u << REC_SCHEDULE;
+    } else if (required_size == sizeof(BaselineSchedule)) {
+      BaselineSchedule baseline;
+      read = nvs_get_blob(my_handle, "schedule", &baseline, &required_size) == ESP_OK;
+      if (read) convertBaselineSchedule(baseline, tempUnit, loaded);
+      migrate |= 1u << REC_SCHEDULE;
+    }
+    if (read && scheduleCountsValid(loaded)) programSchedule = loaded;
+    else { programSchedule = Schedule(); migrate |= 1u << REC_SCHEDULE; }
+  }
+  markScheduleEdited(deviceController, 0);
+
+  // Older firmware stored the performance table as one blob. Load it, then let
+  // the per-row records (if any) override it, and rewrite it as rows.
+  LegacyPerformance legacyPerf;
+  size_t perf_size = sizeof(legacyPerf);
+  legacyPerfPresent = nvs_get_blob(my_handle, LEGACY_PERF_KEY, &legacyPerf, &perf_size) == ESP_OK && perf_size == sizeof(legacyPerf);
+  for (int season = 0; legacyPerfPresent && season < NUM_SEASONS; season++) {
+    LegacyPerfRecord row;
+    memcpy(row.rate, legacyPerf.heatRate[season], sizeof(row.rate)); memcpy(row.samples, legacyPerf.heatSamples[season], sizeof(row.samples));
+    unpackPerf(REC_PERF_HEAT_0 + season, convertLegacyPerf(row));
+    memcpy(row.rate, legacyPerf.coolRate[season], sizeof(row.rate)); memcpy(row.samples, legacyPerf.coolSamples[season], sizeof(row.samples));
+    unpackPerf(REC_PERF_COOL_0 + season, convertLegacyPerf(row));
+  }
+  for (int rec = REC_PERF_HEAT_0; rec < NUM_PERSIST_RECORDS; rec++) {
+    union { PerfRecord row; LegacyPerfRecord legacy; } stored;
+    size_t row_size = sizeof(stored);
+    if (nvs_get_blob(my_handle, recordKey(rec), &stored, &row_size) != ESP_OK) continue;
+    if (row_size == sizeof(PerfRecord)) unpackPerf(rec, stored.row);
+    else if (row_size == sizeof(LegacyPerfRecord)) { unpackPerf(rec, convertLegacyPerf(stored.legacy)); migrate |= 1u << rec; }
+  }
+
+  size_t checkpoint_size = sizeof(learningCheckpoint);
+  nvs_get_blob(my_handle, recordKey(REC_LEARNING), &learningCheckpoint, &checkpoint_size);
+
+  nvs_close(my_handle);
+
+  dirtyRecords = 0;
+  stagedRecords = 0;
+  if (legacyPerfPresent) migrate |= PERF_RECORDS_MASK;
+  for (int rec = 0; rec < NUM_PERSIST_RECORDS; rec++) {
+    if (migrate & (1u << rec)) markSettingsDirty((PersistRecord)rec);
+  }
+  if (migrate) flushSettings();
+}
+
+// =================================================================
+// ==                      RESET HOOKS                            ==
+// =================================================================
+// esp_restart() (OTA, remote reboot) runs the shutdown handlers, so flush there.
+static void flushOnShutdown() { flush(true, false); }
+
+// The task watchdog panics from an ISR, where flash cannot be written, so this
+// guard task flushes pending settings when the control task has not fed the
+// watchdog for close to the timeout. A brownout resets without any callback;
+// the write-back deadline bounds what that can lose.
+static void persistenceGuardTask(void* param) {
+  (void)param;
+  for (;;) {
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    if (dirtyRecords && watchdogFeedAge() > WATCHDOG_TIMEOUT_SECS * 1000 - WATCHDOG_FLUSH_MARGIN_MS) flush(true, false);
+  }
+}
+
+void installPersistenceResetHooks() {
+  esp_register_shutdown_handler(flushOnShutdown);
+  if (!g_isTesting) xTaskCreate(persistenceGuardTask, "persist_guard", 4096, nullptr, 1, nullptr);
+}
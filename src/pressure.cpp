@@ -0,0 +1,175 @@
+#include "pressure.h"
+#include <Arduino.h>
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "config.h"
+#include "hvac_tests.h"
+#include "main.h"
+#include "spsc_ring.h"
+
+static_assert(PRESSURE_DECIMATION > 0 && PRESSURE_DECIMATION <= 4096, "PRESSURE_DECIMATION must keep the window sum in 32 bits");
+static_assert(PRESSURE_OPEN_LOOP_UA < PRESSURE_LOOP_ZERO_UA && PRESSURE_SHORTED_LOOP_UA > PRESSURE_LOOP_ZERO_UA + PRESSURE_LOOP_SPAN_UA,
+              "the NE43 fault band lies outside 4-20 mA");
+
+PressureStats pressureStats;
+
+static SpscRing<PressureReading, PRESSURE_QUEUE_READINGS> readingRing;
+static PressureDecimator decimator;      // Sampler side only
+static PressureReading pending[PRESSURE_BATCH_READINGS]; // Uploader side only
+static int pendingCount = 0;
+static bool sealed = false;              // The pending batch is fixed until acknowledged
+static uint32_t batchSequence = 0, sealedAt = 0;
+static unsigned long nextAttemptAt = 0, backoffMs = 0;
+static char payload[PRESSURE_MAX_PAYLOAD];
+
+static int32_t analogSource() { return (int32_t)(analogReadMilliVolts(PRESSURE_ADC_PIN) * 1000 / PRESSURE_SHUNT_OHMS); }
+static PressureSource source = analogSource;
+static PressureTransport transport = nullptr;
+
+// =================================================================
+// ==                 LOOP CURRENT AND DECIMATION                 ==
+// =================================================================
+PressureStatus classifyLoopCurrent(uint32_t microAmps) {
+  if (microAmps < PRESSURE_OPEN_LOOP_UA) return PRESSURE_OPEN_LOOP;
+  if (microAmps > PRESSURE_SHORTED_LOOP_UA) return PRESSURE_SHORTED_LOOP;
+  return PRESSURE_OK;
+}
+
+// Rounds to nearest, so a reading a little under 4 mA gives a small negative pressure.
+CentiPa loopCurrentToCentiPa(uint32_t microAmps) {
+  int64_t scaled = ((int64_t)microAmps - PRESSURE_LOOP_ZERO_UA) * (PRESSURE_RANGE_HIGH_CENTIPA - PRESSURE_RANGE_LOW_CENTIPA);
+  int64_t half = PRESSURE_LOOP_SPAN_UA / 2;
+  int64_t offset = scaled >= 0 ? (scaled + half) / PRESSURE_LOOP_SPAN_UA : -((-scaled + half) / PRESSURE_LOOP_SPAN_UA);
+  return (CentiPa)(PRESSURE_RANGE_LOW_CENTIPA + offset);
+}
+
+// A boxcar: an integrate-and-dump over the window, which is also a first-order
+// CIC, needing one add per sample and one divide per reading. Unlike a
+// higher-order CIC it can leave single samples out, which fault handling needs.
+bool decimatePressureSample(PressureDecimator& d, uint32_t microAmps, uint32_t at, PressureReading& out) {
+  if (microAmps > 0xFFFF) microAmps = 0xFFFF;
+  PressureStatus status = classifyLoopCurrent(microAmps);
+  d.sumAll += microAmps;
+  d.count++;
+  if (status == PRESSURE_OK) { d.sum += microAmps; d.good++; }
+  else if (status == PRESSURE_OPEN_LOOP) d.open++;
+  else d.shorted++;
+  if (d.count < PRESSURE_DECIMATION) return false;
+
+  out.timestampMs = at;
+  out.samples = d.good;
+  if (d.good * 2 >= d.count) {
+    out.status = PRESSURE_OK;
+    out.loopMicroAmps = (uint16_t)((d.sum + d.good / 2) / d.good);
+    out.pressure = loopCurrentToCentiPa(out.loopMicroAmps);
+  } else {
+    out.status = d.open >= d.shorted ? PRESSURE_OPEN_LOOP : PRESSURE_SHORTED_LOOP;
+    out.loopMicroAmps = (uint16_t)(d.sumAll / d.count);
+    out.pressure = 0;
+  }
+  d = PressureDecimator{};
+  return true;
+}
+
+size_t encodePressureBatch(const PressureReading* readings, int count, uint32_t sequence, uint32_t now, char* out, size_t size) {
+  size_t n = snprintf(out, size, "{\"seq\":%lu,\"now\":%lu,\"r\":[", (unsigned long)sequence, (unsigned long)now);
+  for (int i = 0; i < count && n < size; i++) {
+    const PressureReading& r = readings[i];
+    n += snprintf(out + n, size - n, "%s[%lu,%ld,%u,%u]", i ? "," : "", (unsigned long)r.timestampMs, (long)r.pressure,
+                  (unsigned)r.loopMicroAmps, (unsigned)r.status);
+  }
+  if (n < size) n += snprintf(out + n, size - n, "]}");
+  return n < size ? n : 0;
+}
+
+// =================================================================
+// ==                  SAMPLER (PRODUCER TASK)                    ==
+// =================================================================
+void samplePressure(unsigned long now) {
+  int32_t microAmps = source();
+  if (microAmps < 0) { pressureStats.sourceErrors++; return; }
+  if (!pressureStats.samples) pressureStats.firstSampleAt = now;
+  pressureStats.lastSampleAt = now;
+  pressureStats.samples++;
+  PressureReading r;
+  if (!decimatePressureSample(decimator, (uint32_t)microAmps, (uint32_t)now, r)) return;
+  pressureStats.readings++;
+  if (r.status == PRESSURE_OPEN_LOOP) pressureStats.openLoop++;
+  if (r.status == PRESSURE_SHORTED_LOOP) pressureStats.shortedLoop++;
+  if (!readingRing.push(r)) pressureStats.dropped++;
+}
+
+// =================================================================
+// ==                 UPLOADER (CONSUMER TASK)                    ==
+// =================================================================
+size_t uploadPressure(unsigned long now) {
+  if (!sealed) {
+    while (pendingCount < PRESSURE_BATCH_READINGS && readingRing.pop(&pending[pendingCount])) pendingCount++;
+    if (!pendingCount) return 0;
+    if (pendingCount < PRESSURE_BATCH_READINGS && (uint32_t)now - pending[0].timestampMs < PRESSURE_BATCH_MAX_AGE_SECS * 1000) return 0;
+    sealed = true;
+    sealedAt = (uint32_t)now;
+    batchSequence++;
+  }
+  if (!transport || (long)(now - nextAttemptAt) < 0) return 0;
+
+  size_t len = encodePressureBatch(pending, pendingCount, batchSequence, sealedAt, payload, sizeof(payload));
+  if (!transport(payload, len)) {
+    pressureStats.failures++;
+    backoffMs = backoffMs ? std::min(backoffMs * 2, PRESSURE_RETRY_MAX_SECS * 1000) : PRESSURE_RETRY_MIN_SECS * 1000;
+    nextAttemptAt = now + backoffMs;
+    return 0;
+  }
+  size_t sent = pendingCount;
+  pressureStats.batches++;
+  pressureStats.readingsSent += sent;
+  pressureStats.bytesSent += len;
+  pendingCount = 0;
+  sealed = false;
+  backoffMs = 0;
+  nextAttemptAt = now;
+  return sent;
+}
+
+static void samplerTask(void* param) {
+  (void)param;
+  for (;;) {
+    samplePressure(currentTime());
+    vTaskDelay(pdMS_TO_TICKS(PRESSURE_SAMPLE_INTERVAL_MS));
+  }
+}
+
+static void uploaderTask(void* param) {
+  (void)param;
+  for (;;) {
+    uploadPressure(currentTime());
+    vTaskDelay(pdMS_TO_TICKS(PRESSURE_UPLOAD_POLL_MS));
+  }
+}
+
+void startPressureMonitor() {
+  static bool started = false;
+  if (g_isTesting) {
+    PressureReading r;
+    while (readingRing.pop(&r)) {}
+    decimator = PressureDecimator{};
+    pendingCount = 0; sealed = false; backoffMs = 0; nextAttemptAt = 0;
+    pressureStats = PressureStats{};
+    return;
+  }
+  if (started) return;
+  started = true;
+  xTaskCreate(samplerTask, "pressure", 2048, nullptr, 2, nullptr);
+  xTaskCreate(uploaderTask, "uplink", 4096, nullptr, 1, nullptr);
+}
+
+void setPressureSource(PressureSource s) { source = s ? s : analogSource; }
+void setPressureTransport(PressureTransport t) { transport = t; }
+
+float pressureSampleRateHz() {
+  unsigned long span = pressureStats.lastSampleAt - pressureStats.firstSampleAt;
+  return pressureStats.samples > 1 && span ? (pressureStats.samples - 1) * 1000.0f / span : 0.0f;
+}
+
+size_t pressureMemoryBytes() { return sizeof(readingRing) + sizeof(decimator) + sizeof(pending) + sizeof(payload); }
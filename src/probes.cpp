@@ -0,0 +1,55 @@
+#include "probes.h"
+#include <Arduino.h>
+#include "config.h"
+
+ProbeHistogram probeHistograms[NUM_PROBES];
+
+const char* probeName(ProbeStage stage) {
+  switch (stage) {
+    case PROBE_LOOP:             return "loop";
+    case PROBE_SENSORS:          return "sensors";
+    case PROBE_SCHEDULE:         return "schedule";
+    case PROBE_RECOVERY:         return "recovery";
+    case PROBE_CONTROL_TEMP:     return "control_temp";
+    case PROBE_CONTROL_HUMIDITY: return "control_humidity";
+    case PROBE_CONTROL_FAN:      return "control_fan";
+    case PROBE_TELEMETRY:        return "telemetry";
+    case PROBE_LEARNING:         return "learning";
+    case PROBE_PERSISTENCE:      return "persistence";
+    case PROBE_NVS_COMMIT:       return "nvs_commit";
+    case PROBE_PLAN_WAKE:        return "plan_wake";
+    case PROBE_THERMAL_MODEL:    return "thermal_model";
+    case PROBE_TRACE:            return "trace";
+    case PROBE_RELAY_COMMIT:     return "relay_commit";
+    case PROBE_SERIES:           return "series";
+    case PROBE_COMMANDS:         return "commands";
+    case PROBE_COMMAND_LATENCY:  return "command_latency";
+    default:                     return "unknown";
+  }
+}
+
+void resetProbes() { memset(probeHistograms, 0, sizeof(probeHistograms)); }
+
+uint32_t probePercentileUs(const ProbeHistogram& h, int percent) {
+  if (h.count == 0) return 0;
+  uint64_t rank = ((uint64_t)h.count * percent + 99) / 100;
+  uint64_t seen = 0;
+  for (int b = 0; b < PROBE_BUCKETS; b++) {
+    seen += h.buckets[b];
+    if (seen >= rank) {
+      uint64_t upper = b ? ((1ULL << b) - 1) : 0;
+      return (uint32_t)((std::min<uint64_t>(upper, h.maxCycles) + PROBE_CYCLES_PER_US - 1) / PROBE_CYCLES_PER_US);
+    }
+  }
+  return (h.maxCycles + PROBE_CYCLES_PER_US - 1) / PROBE_CYCLES_PER_US;
+}
+
+int formatProbeLine(ProbeStage stage, char* out, size_t size) {
+  const ProbeHistogram& h = probeHistograms[stage];
+  if (!HVAC_PROBES) return snprintf(out, size, "%-16s (probes compiled out)", probeName(stage));
+  return snprintf(out, size, "%-16s n=%-8lu min=%luus p50<=%luus p99<=%luus max=%luus mean=%.1fus",
+                  probeName(stage), (unsigned long)h.count, (unsigned long)(h.count ? h.minCycles / PROBE_CYCLES_PER_US : 0),
+                  (unsigned long)probePercentileUs(h, 50), (unsigned long)probePercentileUs(h, 99),
+                  (unsigned long)(h.maxCycles / PROBE_CYCLES_PER_US),
+                  h.count ? (double)h.totalCycles / h.count / PROBE_CYCLES_PER_US : 0.0);
+}
@@ -0,0 +1,103 @@
+#include "psychrometrics.h"
+#include <cmath>
+#include "config.h"
+
+// exp() for the compile-time table: halve the argument into |x| <= 0.5, sum
+// the Taylor series and square back up.
+static constexpr double constexprExp(double x) {
+  int halvings = 0;
+  while (x > 0.5 || x < -0.5) { x /= 2; halvings++; }
+  double term = 1, sum = 1;
+  for (int n = 1; n < 20; n++) { term *= x / n; sum += term; }
+  while (halvings-- > 0) sum *= sum;
+  return sum;
+}
+
+static constexpr double MAGNUS_A = 17.625, MAGNUS_B = 243.04, MAGNUS_E0_HPA = 6.1094;
+static constexpr double WATER_VAPOUR_MG_K_PER_M3_HPA = 216685.0; // 100 Pa/hPa * 1e6 mg/kg / 461.5 J/(kg K)
+
+struct SvpTable {
+  uint32_t q20[PSYCHRO_TABLE_SIZE];
+  constexpr SvpTable() : q20() {
+    for (int i = 0; i < PSYCHRO_TABLE_SIZE; i++) {
+      double t = (PSYCHRO_MIN_CENTI_C + i * PSYCHRO_STEP_CENTI_C) / 100.0;
+      q20[i] = (uint32_t)(MAGNUS_E0_HPA * constexprExp(MAGNUS_A * t / (MAGNUS_B + t)) * (1 << PSYCHRO_SVP_FRAC_BITS) + 0.5);
+    }
+  }
+};
+static constexpr SvpTable svpTable;
+static_assert(svpTable.q20[(0 - PSYCHRO_MIN_CENTI_C) / PSYCHRO_STEP_CENTI_C] == 6406170, "0 C must be 6.1094 hPa");
+
+static const int32_t WINDOW_EFFICIENCY_Q16 = (int32_t)(WINDOW_EFFICIENCY_FACTOR * 65536 + 0.5f);
+
+static inline int32_t clampCentiC(int32_t centiC) {
+  return centiC < PSYCHRO_MIN_CENTI_C ? PSYCHRO_MIN_CENTI_C : centiC > PSYCHRO_MAX_CENTI_C ? PSYCHRO_MAX_CENTI_C : centiC;
+}
+
+int32_t toCentiC(float tempC) {
+  if (!(tempC > PSYCHRO_MIN_CENTI_C / 100.0f)) return PSYCHRO_MIN_CENTI_C; // Also NaN
+  if (tempC > PSYCHRO_MAX_CENTI_C / 100.0f) return PSYCHRO_MAX_CENTI_C;
+  return (int32_t)(tempC * 100.0f + (tempC < 0 ? -0.5f : 0.5f));
+}
+
+// Interpolates the table at a temperature in centi-C with 8 fraction bits.
+static uint32_t interpolateSvp(int32_t centiC8) {
+  const int32_t STEP8 = PSYCHRO_STEP_CENTI_C << 8;
+  int32_t min8 = PSYCHRO_MIN_CENTI_C * 256, max8 = PSYCHRO_MAX_CENTI_C * 256;
+  uint32_t offset = (uint32_t)((centiC8 < min8 ? min8 : centiC8 > max8 ? max8 : centiC8) - min8);
+  uint32_t index = offset / STEP8, frac = offset % STEP8;
+  if (frac == 0) return svpTable.q20[index];
+  return svpTable.q20[index] + (uint32_t)((uint64_t)(svpTable.q20[index + 1] - svpTable.q20[index]) * frac / STEP8);
+}
+
+uint32_t saturationVapourPressure(int32_t centiC) {
+  return interpolateSvp(clampCentiC(centiC) * 256);
+}
+
+// Vapour pressure of air at centiC and rhCenti, hPa in Q20.
+static uint32_t vapourPressure(int32_t centiC, int32_t rhCenti) {
+  if (rhCenti <= 0) return 0;
+  return (uint32_t)((uint64_t)saturationVapourPressure(centiC) * (uint32_t)rhCenti / 10000);
+}
+
+int32_t dewPoint(int32_t centiC, int32_t rhCenti) {
+  uint32_t e = vapourPressure(centiC, rhCenti);
+  if (e <= svpTable.q20[0]) return PSYCHRO_MIN_CENTI_C;
+  if (e >= svpTable.q20[PSYCHRO_TABLE_SIZE - 1]) return PSYCHRO_MAX_CENTI_C;
+  // The table is increasing: find lo with q20[lo] <= e < q20[lo + 1] and invert the interpolation.
+  int lo = 0, hi = PSYCHRO_TABLE_SIZE - 1;
+  while (hi - lo > 1) {
+    int mid = (lo + hi) / 2;
+    if (svpTable.q20[mid] <= e) lo = mid; else hi = mid;
+  }
+  uint32_t span = svpTable.q20[hi] - svpTable.q20[lo];
+  uint32_t frac = ((e - svpTable.q20[lo]) * PSYCHRO_STEP_CENTI_C + span / 2) / span;
+  return PSYCHRO_MIN_CENTI_C + lo * PSYCHRO_STEP_CENTI_C + (int32_t)frac;
+}
+
+uint32_t absoluteHumidity(int32_t centiC, int32_t rhCenti) {
+  uint64_t kelvinScaled = (uint64_t)(clampCentiC(centiC) + 27315) << PSYCHRO_SVP_FRAC_BITS; // Centi-kelvin
+  uint64_t scaled = (uint64_t)vapourPressure(centiC, rhCenti) * (uint64_t)(WATER_VAPOUR_MG_K_PER_M3_HPA * 100);
+  return (uint32_t)((scaled + kelvinScaled / 2) / kelvinScaled);
+}
+
+int32_t maxHumidityForWindow(int32_t indoorCentiC, int32_t outdoorCentiC) {
+  indoorCentiC = clampCentiC(indoorCentiC); outdoorCentiC = clampCentiC(outdoorCentiC);
+  // The window temperature keeps 8 fraction bits: rounding it to 0.01 C alone would cost up to 0.03 %RH.
+  int32_t window8 = outdoorCentiC * 256 + (int32_t)(((int64_t)WINDOW_EFFICIENCY_Q16 * (indoorCentiC - outdoorCentiC) + 0x80) >> 8);
+  uint32_t esDewPoint = interpolateSvp(window8 - 200 * 256), esIndoor = saturationVapourPressure(indoorCentiC);
+  // RH = es(dew point) / es(indoor): the Magnus exp(alpha_td - alpha_t) as a table ratio.
+  uint32_t rh = (uint32_t)(((uint64_t)esDewPoint * 10000 + esIndoor / 2) / esIndoor);
+  if (rh > 9500) return 9500; if (rh < 1000) return 1000;
+  return (int32_t)rh;
+}
+
+double referenceMaxHumidityForWindow(double indoorTempC, double outdoorTempC) {
+  double estimatedWindowTemp = outdoorTempC + WINDOW_EFFICIENCY_FACTOR * (indoorTempC - outdoorTempC);
+  double targetDewPoint = estimatedWindowTemp - 2.0;
+  double alpha_td = (MAGNUS_A * targetDewPoint) / (MAGNUS_B + targetDewPoint);
+  double alpha_t = (MAGNUS_A * indoorTempC) / (MAGNUS_B + indoorTempC);
+  double maxRH = 100.0 * exp(alpha_td - alpha_t);
+  if (maxRH > 95.0) return 95.0; if (maxRH < 10.0) return 10.0;
+  return maxRH;
+}
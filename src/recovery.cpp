@@ -0,0 +1,86 @@
+#include "recovery.h"
+#include <Arduino.h>
+#include "config.h"
+#include "controller.h"
+#include "hvac_logic.h"
+#include "main.h"
+#include "schedule.h"
+
+bool smartRecoveryEnabled = ENABLE_SMART_RECOVERY;
+RecoveryStats recoveryStats;
+
+static const unsigned long LOOKAHEAD_HORIZON_SECS = 7 * 24 * 3600UL;
+static constexpr int32_t RECOVERY_LEAD_MARGIN_PCT = (int32_t)(RECOVERY_LEAD_MARGIN * 100 + 0.5f);
+
+// A bin with enough cycles is used as learned. Otherwise interpolate between
+// the nearest well-sampled bins either side, or take the nearest one if only
+// one side has data.
+int32_t estimateRecoveryRate(const HvacPerformance& perf, int season, int bin, bool heating) {
+  const uint16_t* rate = heating ? perf.heatRate[season] : perf.coolRate[season];
+  const uint16_t* samples = heating ? perf.heatSamples[season] : perf.coolSamples[season];
+  if (samples[bin] >= MIN_RECOVERY_SAMPLES) return rate[bin];
+
+  int lo = bin - 1, hi = bin + 1;
+  while (lo >= 0 && samples[lo] < MIN_RECOVERY_SAMPLES) lo--;
+  while (hi < NUM_PERFORMANCE_BINS && samples[hi] < MIN_RECOVERY_SAMPLES) hi++;
+  if (lo >= 0 && hi < NUM_PERFORMANCE_BINS) return rate[lo] + ((int32_t)rate[hi] - rate[lo]) * (bin - lo) / (hi - lo);
+  if (lo >= 0) return rate[lo];
+  if (hi < NUM_PERFORMANCE_BINS) return rate[hi];
+  return samples[bin] > 0 ? rate[bin] : 0;
+}
+
+void invalidateRecovery(ControllerBatch& b, int i) {
+  b.recovery[i].nextValid = false;
+  b.recovery[i].rateValid = false;
+}
+
+CentiC planRecovery(ControllerBatch& b, int i, const TimeInfo& now, CentiC current, CentiC outdoor, CentiC scheduledTarget) {
+  RecoveryState& r = b.recovery[i];
+  const ScheduleCursor& cursor = b.scheduleCursor[i];
+  r.startPlanned = false;
+  if (b.vacationModeActive[i] || b.systemLockedOut[i] || b.systemMode[i] == SYS_OFF) { r.active = false; return scheduledTarget; }
+
+  if (!r.nextValid || r.nextKey != cursor.validUntil) {
+    ScheduleChange change;
+    r.hasNext = findNextTargetChange(b.compiledSchedule[i], now, LOOKAHEAD_HORIZON_SECS, &change);
+    if (r.hasNext) { r.nextTarget = change.entry->target; r.nextChangeAt = b.now + (ControlMillis)(change.secondsUntil * 1000); }
+    r.nextKey = cursor.validUntil;
+    r.nextValid = true;
+    r.active = false;
+    recoveryStats.lookaheads++;
+  }
+  if (!r.hasNext || (int32_t)(r.nextChangeAt - b.now) <= 0) { r.active = false; return scheduledTarget; }
+  if (r.active) return r.nextTarget;
+
+  SystemMode mode = b.systemMode[i];
+  bool heating = r.nextTarget > scheduledTarget;
+  if (heating ? (mode != SYS_HEAT && mode != SYS_AUTO) : (mode != SYS_COOL && mode != SYS_AUTO)) return scheduledTarget;
+  int32_t need = heating ? r.nextTarget - current : current - r.nextTarget;
+  if (need <= 0) return scheduledTarget;
+
+  int bin = getPerformanceBin(outdoor);
+  if (!r.rateValid || r.rateSeason != b.season || r.rateBin != bin || r.rateHeating != heating) {
+    r.ratePerHour = estimateRecoveryRate(b.performance[i], b.season, bin, heating);
+    r.rateSeason = b.season; r.rateBin = bin; r.rateHeating = heating; r.rateValid = true;
+    recoveryStats.rateEstimates++;
+  }
+  if (r.ratePerHour <= 0) return scheduledTarget; // Nothing learned yet
+
+  // need * 3600 s/h * margin, with need < 2^15: fits in 32 bits as need * 36 * percent.
+  r.leadSecs = std::min((unsigned long)(need * 36 * RECOVERY_LEAD_MARGIN_PCT / r.ratePerHour), MAX_RECOVERY_TIME_MINS * 60UL);
+  r.startAt = r.nextChangeAt - r.leadSecs * 1000;
+  r.startPlanned = true;
+  if ((int32_t)(b.now - r.startAt) < 0) return scheduledTarget;
+
+  r.active = true;
+  recoveryStats.recoveries++;
+  return r.nextTarget;
+}
+
+CentiC planRecovery(const TimeInfo& now, CentiC current, CentiC outdoor, CentiC scheduledTarget) {
+  RecoveryState& r = deviceController.recovery[0];
+  if (!smartRecoveryEnabled) { r.active = r.startPlanned = false; return scheduledTarget; }
+  deviceController.now = currentTime();
+  deviceController.season = seasonForMonth(now.month);
+  return planRecovery(deviceController, 0, now, current, outdoor, scheduledTarget);
+}
@@ -0,0 +1,56 @@
+#include "relays.h"
+#include "config.h"
+#include "controller.h"
+#include "main.h"
+
+static_assert(HEATER_RELAY_PIN < RELAY_PIN_LIMIT && COOLER_RELAY_PIN < RELAY_PIN_LIMIT && FAN_RELAY_PIN < RELAY_PIN_LIMIT &&
+              FRESH_AIR_RELAY_PIN < RELAY_PIN_LIMIT && HUMIDITY_RELAY_PIN < RELAY_PIN_LIMIT, "relay pins must fit the 16-bit mask");
+
+RelayStats relayStats;
+
+static uint16_t committed = 0;
+static bool committedKnown = false; // False until the first write after boot
+
+uint16_t applyRelayInterlocks(uint16_t mask, uint8_t* tripped) {
+  const uint16_t heatCool = RELAY_BIT(HEATER_RELAY_PIN) | RELAY_BIT(COOLER_RELAY_PIN);
+  const uint16_t airflow = heatCool | RELAY_BIT(FRESH_AIR_RELAY_PIN);
+  uint8_t trips = 0;
+  if ((mask & heatCool) == heatCool) { mask &= ~heatCool; trips |= INTERLOCK_HEAT_AND_COOL; }
+  if ((mask & airflow) && !(mask & RELAY_BIT(FAN_RELAY_PIN))) { mask |= RELAY_BIT(FAN_RELAY_PIN); trips |= INTERLOCK_FAN_FORCED; }
+  if (tripped) *tripped = trips;
+  return mask;
+}
+
+uint8_t commitRelays(ControllerBatch& b, int i) {
+  uint8_t tripped;
+  b.relays[i] = applyRelayInterlocks(b.relays[i], &tripped);
+  if (tripped & INTERLOCK_HEAT_AND_COOL) {
+    // Both stopped here, outside the control rules: start their min-off times
+    // and drop the cycle, whose rate would be learned from a fault.
+    b.lastHeaterOffTime[i] = b.now;
+    b.lastCoolerOffTime[i] = b.now;
+    b.cycleInProgress[i] = false;
+  }
+  if (!b.hardwareRelays) return tripped;
+
+  relayStats.commits++;
+  if (tripped & INTERLOCK_HEAT_AND_COOL) relayStats.heatCoolTrips++;
+  if (tripped & INTERLOCK_FAN_FORCED) relayStats.fanTrips++;
+  uint16_t changed = committedKnown ? (uint16_t)((b.relays[i] ^ committed) & RELAY_OUTPUTS) : RELAY_OUTPUTS;
+  if (!changed) return tripped;
+  writeRelays(b.relays[i], changed);
+  relayStats.writes++;
+  if (committedKnown) { // After boot the old levels are unknown, so nothing is counted
+    for (int pin = 0; pin < RELAY_PIN_LIMIT; pin++) if (changed & RELAY_BIT(pin)) relayStats.transitions[pin]++;
+  }
+  committed = b.relays[i] & RELAY_OUTPUTS;
+  committedKnown = true;
+  return tripped;
+}
+
+// =================================================================
+// ==                   DEVICE (SINGLE INSTANCE)                  ==
+// =================================================================
+void initialize_relays() { committedKnown = false; }
+uint8_t commitRelays() { return commitRelays(deviceController, 0); }
+uint16_t committedRelays() { return committed; }
@@ -0,0 +1,154 @@
+#include "schedule.h"
+#include <Arduino.h>
+#include "config.h"
+#include "controller.h"
+
+static const long SECONDS_PER_DAY = 24 * 3600L;
+
+// The entries a program day runs, in the order they were entered.
+static const ScheduleEntry* sourceEntries(const Schedule& schedule, int day, int* count) {
+  if (schedule.dayOverrideCount[day] > 0) { *count = std::min((int)schedule.dayOverrideCount[day], MAX_DAY_OVERRIDE_ENTRIES); return schedule.dayOverride[day]; }
+  if (day >= 1 && day <= 5) { *count = std::min((int)schedule.weekdayEntryCount, MAX_DAY_ENTRIES); return schedule.weekday; }
+  *count = std::min((int)schedule.weekendEntryCount, MAX_DAY_ENTRIES); return schedule.weekend;
+}
+
+// Emit one day: entries sorted by start time (a later entry wins a tie). If
+// the first starts after midnight, a carried transition leads the day: the
+// previous date's last entry stays in force until then, resolved at lookup
+// because it depends on which program that date ran.
+static int compileDay(const Schedule& schedule, int day, ScheduleTransition* out) {
+  int count;
+  const ScheduleEntry* entries = sourceEntries(schedule, day, &count);
+  if (count < 1) count = 1;
+
+  ScheduleTransition sorted[MAX_DAY_ENTRIES];
+  for (int i = 0; i < count; i++) {
+    ScheduleTransition t = { (uint16_t)(entries[i].startHour * 60 + entries[i].startMinute), false, entries[i] };
+    int j = i;
+    while (j > 0 && sorted[j - 1].startMinute > t.startMinute) { sorted[j] = sorted[j - 1]; j--; }
+    sorted[j] = t;
+  }
+
+  int n = 0;
+  if (sorted[0].startMinute > 0) { out[n] = sorted[0]; out[n].startMinute = 0; out[n++].carried = true; }
+  for (int i = 0; i < count; i++) {
+    if (n > 0 && !out[n - 1].carried && sorted[i].startMinute == out[n - 1].startMinute) out[n - 1].entry = sorted[i].entry;
+    else out[n++] = sorted[i];
+  }
+  return n;
+}
+
+void compileSchedule(const Schedule& schedule, CompiledSchedule& out) {
+  int n = 0;
+  for (int day = 0; day < 7; day++) {
+    out.dayStart[day] = (uint8_t)n;
+    int dayCount = compileDay(schedule, day, &out.transitions[n]);
+    for (int hour = 0, t = n; hour < 24; hour++) {
+      while (t + 1 < n + dayCount && out.transitions[t + 1].startMinute <= hour * 60) t++;
+      out.hourIndex[day][hour] = (uint8_t)t;
+    }
+    n += dayCount;
+  }
+  out.dayStart[7] = (uint8_t)n;
+
+  memset(out.exceptionDays, 0, sizeof(out.exceptionDays));
+  out.exceptionCount = 0;
+  for (int i = 0; i < std::min((int)schedule.exceptionCount, MAX_SCHEDULE_EXCEPTIONS); i++) {
+    const ScheduleException& ex = schedule.exceptions[i];
+    if (ex.month < 1 || ex.month > 12 || ex.day < 1 || ex.day > 31 || ex.programDay > 6) continue;
+    out.exceptions[out.exceptionCount++] = ex;
+    out.exceptionDays[ex.month - 1] |= 1u << (ex.day - 1);
+  }
+  out.vacation = schedule.vacation;
+}
+
+int programDayFor(const CompiledSchedule& cs, const TimeInfo& now) {
+  if (now.month >= 1 && now.month <= 12 && now.day >= 1 && now.day <= 31 && (cs.exceptionDays[now.month - 1] & (1u << (now.day - 1)))) {
+    for (int i = cs.exceptionCount - 1; i >= 0; i--) {
+      if (cs.exceptions[i].month == now.month && cs.exceptions[i].day == now.day) return cs.exceptions[i].programDay;
+    }
+  }
+  return now.dayOfWeek;
+}
+
+ScheduleLookup lookupCompiledSchedule(const CompiledSchedule& cs, bool vacation, const TimeInfo& now) {
+  ScheduleLookup result;
+  if (vacation) { result.entry = &cs.vacation; result.secondsValid = NO_SCHEDULE_CHANGE; return result; }
+
+  int day = programDayFor(cs, now);
+  int minuteOfDay = now.hour * 60 + now.minute;
+  int t = cs.hourIndex[day][now.hour];
+  int end = cs.dayStart[day + 1];
+  while (t + 1 < end && cs.transitions[t + 1].startMinute <= minuteOfDay) t++;
+
+  // Past the day's last transition the next change is midnight, where the
+  // date (and so the program day) moves on.
+  long next = (t + 1 < end) ? cs.transitions[t + 1].startMinute * 60L : SECONDS_PER_DAY;
+  if (cs.transitions[t].carried) {
+    int previousDay = programDayFor(cs, timeAfterDays(now, -1));
+    result.entry = &cs.transitions[cs.dayStart[previousDay + 1] - 1].entry;
+  } else {
+    result.entry = &cs.transitions[t].entry;
+  }
+  result.secondsValid = (unsigned long)(next - (minuteOfDay * 60L + now.second));
+  return result;
+}
+
+bool findNextTargetChange(const CompiledSchedule& cs, const TimeInfo& now, unsigned long horizonSecs, ScheduleChange* out) {
+  ScheduleLookup step = lookupCompiledSchedule(cs, false, now);
+  CentiC target = step.entry->target;
+  unsigned long elapsed = 0;
+  long secondOfDay = now.hour * 3600L + now.minute * 60L + now.second;
+  // Each step lands on the next transition or midnight, so a week of steps
+  // covers any schedule.
+  for (int guard = 0; guard < MAX_WEEK_TRANSITIONS + 14; guard++) {
+    elapsed += step.secondsValid;
+    if (elapsed > horizonSecs) return false;
+    long total = secondOfDay + (long)elapsed;
+    TimeInfo t = timeAfterDays(now, (int)(total / SECONDS_PER_DAY));
+    long sod = total % SECONDS_PER_DAY;
+    t.hour = (int)(sod / 3600); t.minute = (int)(sod / 60 % 60); t.second = (int)(sod % 60);
+    step = lookupCompiledSchedule(cs, false, t);
+    if (step.entry->target != target) { out->entry = step.entry; out->secondsUntil = elapsed; return true; }
+  }
+  return false;
+}
+
+// Moves the date (month, day, day of week) by whole days; the time of day is kept.
+TimeInfo timeAfterDays(const TimeInfo& t, int days) {
+  static const int DAYS_IN_MONTH[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+  TimeInfo r = t;
+  r.dayOfWeek = ((r.dayOfWeek + days) % 7 + 7) % 7;
+  if (r.month < 1 || r.month > 12) return r;
+  for (; days > 0; days--) {
+    if (++r.day > DAYS_IN_MONTH[r.month - 1]) { r.day = 1; r.month = r.month % 12 + 1; }
+  }
+  for (; days < 0; days++) {
+    if (--r.day < 1) { r.month = (r.month + 10) % 12 + 1; r.day = DAYS_IN_MONTH[r.month - 1]; }
+  }
+  return r;
+}
+
+// =================================================================
+// ==                 PER-INSTANCE CURSOR                         ==
+// =================================================================
+bool scheduleCursorValid(const ControllerBatch& b, int i) {
+  const ScheduleCursor& c = b.scheduleCursor[i];
+  return c.entry && !b.scheduleEdited[i] && c.vacation == b.vacationModeActive[i] && (!c.expires || (int32_t)(b.now - c.validUntil) < 0);
+}
+
+const ScheduleEntry& activeScheduleEntry(ControllerBatch& b, int i, const TimeInfo& now) {
+  ScheduleCursor& c = b.scheduleCursor[i];
+  if (scheduleCursorValid(b, i)) return *c.entry;
+  if (b.scheduleEdited[i]) { compileSchedule(b.programSchedule[i], b.compiledSchedule[i]); b.scheduleEdited[i] = false; }
+  ScheduleLookup found = lookupCompiledSchedule(b.compiledSchedule[i], b.vacationModeActive[i], now);
+  c.entry = found.entry;
+  c.vacation = b.vacationModeActive[i];
+  c.expires = found.secondsValid != NO_SCHEDULE_CHANGE;
+  c.validUntil = b.now + (ControlMillis)(found.secondsValid * 1000);
+  return *c.entry;
+}
+
+// Both also drop the recovery lookahead, which was keyed on the old cursor.
+void markScheduleEdited(ControllerBatch& b, int i) { b.scheduleEdited[i] = true; b.scheduleCursor[i].entry = nullptr; b.recovery[i].nextValid = false; }
+void invalidateScheduleCursor(ControllerBatch& b, int i) { b.scheduleCursor[i].entry = nullptr; b.recovery[i].nextValid = false; }
@@ -0,0 +1,167 @@
+#include "scheduler.h"
+#include <Arduino.h>
+#include <atomic>
+#include "config.h"
+#include "controller.h"
+#include "hvac_logic.h"
+#include "hvac_tests.h"
+#include "main.h"
+#include "psychrometrics.h"
+#include "sensors.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+SchedulerStats schedulerStats;
+
+static VirtualTimeHook virtualTimeHook = nullptr;
+static std::atomic<bool> virtualWakePending{false}; // Set by producers on other threads (commands.h)
+static TaskHandle_t volatile controlTask = nullptr;
+
+static const int16_t NO_LOWER_BOUND = INT16_MIN;
+static const int16_t NO_UPPER_BOUND = INT16_MAX;
+
+// Keep the earliest future deadline. Deadlines at or before now have already
+// been acted on by the pass that just ran.
+static void considerDeadline(WakePlan& plan, ControlMillis now, ControlMillis deadline, WakeReason reason) {
+  if ((int32_t)(deadline - now) <= 0) return;
+  if ((int32_t)(deadline - plan.wakeAt) < 0) { plan.wakeAt = deadline; plan.reason = reason; }
+}
+
+// A bound is only useful if the reading has not already passed it; otherwise
+// the rule is waiting on a timer, which is planned separately. Bounds are the
+// first reading at which a rule fires, so a strict comparison in the rule
+// moves its bound one step past the threshold.
+static void raiseLower(int16_t& bound, int value, int reading) { if (reading > value && value > bound) bound = (int16_t)value; }
+static void lowerUpper(int16_t& bound, int value, int reading) { if (reading < value && value < bound) bound = (int16_t)value; }
+
+WakePlan planNextWake(ControllerBatch& b, int i, const TimeInfo& time, FanMode fanMode,
+                      CentiC temp, CentiC target, CentiC outdoor, CentiRH humidity) {
+  ControlMillis now = b.now;
+  WakePlan plan;
+  plan.wakeAt = now + MAX_CONTROL_SLEEP_MS; plan.reason = WAKE_SENSOR_SAMPLE;
+  plan.lowTemp = NO_LOWER_BOUND; plan.highTemp = NO_UPPER_BOUND;
+  plan.lowHumidity = NO_LOWER_BOUND; plan.highHumidity = NO_UPPER_BOUND;
+
+  activeScheduleEntry(b, i, time); // Normally already current from this pass
+  const ScheduleCursor& cursor = b.scheduleCursor[i];
+  if (cursor.expires) considerDeadline(plan, now, cursor.validUntil, WAKE_SCHEDULE);
+  const RecoveryState& recovery = b.recovery[i];
+  if (recovery.startPlanned && !recovery.active) considerDeadline(plan, now, recovery.startAt, WAKE_RECOVERY);
+
+  bool isHeatingOn = relayOn(b, i, HEATER_RELAY_PIN);
+  bool isCoolingOn = relayOn(b, i, COOLER_RELAY_PIN);
+  bool isFreshAirOn = relayOn(b, i, FRESH_AIR_RELAY_PIN);
+
+  // The cycle protection rules compare with '>', so each fires 1 ms after its limit.
+  if (isHeatingOn) {
+    considerDeadline(plan, now, b.lastHeaterOnTime[i] + MIN_HEATER_RUN_TIME_MS + 1, WAKE_HEATER_TIMER);
+    considerDeadline(plan, now, b.lastHeaterOnTime[i] + MAX_HEATER_RUN_TIME_MS + 1, WAKE_HEATER_TIMER);
+  } else {
+    considerDeadline(plan, now, b.lastHeaterOffTime[i] + MIN_HEATER_OFF_TIME_MS + 1, WAKE_HEATER_TIMER);
+  }
+  if (isCoolingOn) {
+    considerDeadline(plan, now, b.lastCoolerOnTime[i] + MIN_COOLER_RUN_TIME_MS + 1, WAKE_COOLER_TIMER);
+    considerDeadline(plan, now, b.lastCoolerOnTime[i] + MAX_COOLER_RUN_TIME_MS + 1, WAKE_COOLER_TIMER);
+  } else {
+    considerDeadline(plan, now, b.lastCoolerOffTime[i] + MIN_COOLER_OFF_TIME_MS + 1, WAKE_COOLER_TIMER);
+  }
+  if (fanMode == FAN_CIRCULATE && !isHeatingOn && !isCoolingOn && !isFreshAirOn) {
+    unsigned long phase = b.isFanCirculating[i] ? FAN_CIRCULATE_ON_TIME_MS : FAN_CIRCULATE_OFF_TIME_MS;
+    considerDeadline(plan, now, b.lastFanCycleTime[i] + phase, WAKE_FAN_CYCLE);
+  }
+
+  if (!b.systemLockedOut[i]) {
+    SystemMode mode = b.systemMode[i];
+    CentiC deadband = temperatureDeadband(b.tempUnit[i]);
+    if (mode == SYS_HEAT || mode == SYS_AUTO) {
+      if (isHeatingOn || (isFreshAirOn && b.freshAirForHeating[i])) lowerUpper(plan.highTemp, target, temp);
+      else raiseLower(plan.lowTemp, target - deadband - 1, temp);
+    }
+    if (mode == SYS_COOL || mode == SYS_AUTO) {
+      if (isCoolingOn || (isFreshAirOn && !b.freshAirForHeating[i])) raiseLower(plan.lowTemp, target, temp);
+      else lowerUpper(plan.highTemp, target + deadband + 1, temp);
+    }
+  }
+
+  int humidityTarget = std::min((int32_t)HUMIDITY_TARGET_CENTI, maxHumidityForWindow(temp, outdoor));
+  if (relayOn(b, i, HUMIDITY_RELAY_PIN)) lowerUpper(plan.highHumidity, humidityTarget, humidity);
+  else raiseLower(plan.lowHumidity, humidityTarget - HUMIDITY_DEADBAND_CENTI - 1, humidity);
+
+  return plan;
+}
+
+bool outsideWakeBand(const WakePlan& plan, CentiC temp, CentiRH humidity) {
+  return temp <= plan.lowTemp || temp >= plan.highTemp || humidity <= plan.lowHumidity || humidity >= plan.highHumidity;
+}
+
+// The latest filtered sample against the band, without running the control
+// rules. A sample the control pass would fault on (implausible, too fast, or
+// stale from a hung sensor task) wakes it too, whatever the band.
+static bool sampleLeavesBand(const WakePlan& plan) {
+  schedulerStats.sensorPolls++;
+  SensorSnapshot sensors = sensorSnapshot();
+  return outsideWakeBand(plan, sensors.indoorCentiC, sensors.humidityCentiRH) || !validateSensorReadings(sensors, false);
+}
+
+// Virtual clock: time only moves when we move it, in sensor-poll steps, giving
+// the registered plant model a chance to evolve before each sample.
+static WakeReason virtualSleep(const WakePlan& plan) {
+  while ((int32_t)(plan.wakeAt - (ControlMillis)g_mockMillis) > 0) {
+    unsigned long step = std::min((unsigned long)(ControlMillis)(plan.wakeAt - (ControlMillis)g_mockMillis), SENSOR_POLL_INTERVAL_MS);
+    if (virtualTimeHook) virtualTimeHook(g_mockMillis, g_mockMillis + step);
+    g_mockMillis += step;
+    if (virtualWakePending.exchange(false)) return WAKE_EXTERNAL;
+    if ((int32_t)(plan.wakeAt - (ControlMillis)g_mockMillis) > 0 && sampleLeavesBand(plan)) return WAKE_THRESHOLD;
+  }
+  return plan.reason;
+}
+
+// Device: block on a task notification so other tasks and ISRs can wake the
+// control pass at once. Each poll interval feeds the watchdog and samples.
+static WakeReason deviceSleep(const WakePlan& plan) {
+  controlTask = xTaskGetCurrentTaskHandle();
+  for (;;) {
+    int32_t remaining = (int32_t)(plan.wakeAt - (ControlMillis)currentTime());
+    if (remaining <= 0) return plan.reason;
+    unsigned long wait = std::min((unsigned long)remaining, SENSOR_POLL_INTERVAL_MS);
+    if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait)) > 0) return WAKE_EXTERNAL;
+    feedWatchdog();
+    if ((int32_t)(plan.wakeAt - (ControlMillis)currentTime()) > 0 && sampleLeavesBand(plan)) return WAKE_THRESHOLD;
+  }
+}
+
+WakeReason schedulerSleep(const WakePlan& plan) {
+  WakeReason reason = g_isTesting ? virtualSleep(plan) : deviceSleep(plan);
+  schedulerStats.wakes[reason]++;
+  return reason;
+}
+
+void wakeScheduler() {
+  if (g_isTesting) { virtualWakePending = true; return; }
+  TaskHandle_t task = controlTask;
+  if (task) xTaskNotifyGive(task);
+}
+
+void wakeSchedulerFromISR() {
+  TaskHandle_t task = controlTask;
+  if (!task) return;
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(task, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+void setVirtualTimeHook(VirtualTimeHook hook) { virtualTimeHook = hook; }
+
+const char* wakeReasonName(WakeReason reason) {
+  switch (reason) {
+    case WAKE_SENSOR_SAMPLE: return "sensor sample";
+    case WAKE_SCHEDULE:      return "schedule";
+    case WAKE_RECOVERY:      return "recovery";
+    case WAKE_HEATER_TIMER:  return "heater timer";
+    case WAKE_COOLER_TIMER:  return "cooler timer";
+    case WAKE_FAN_CYCLE:     return "fan cycle";
+    case WAKE_THRESHOLD:     return "threshold";
+    case WAKE_EXTERNAL:      return "external";
+    default:                 return "unknown";
+  }
+}
@@ -0,0 +1,140 @@
+#include "sensors.h"
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "config.h"
+#include "hvac_tests.h"
+#include "main.h"
+#include "utils.h"
+
+static_assert(SENSOR_MEDIAN_WINDOW % 2 == 1 && SENSOR_MEDIAN_WINDOW <= 7, "SENSOR_MEDIAN_WINDOW must be small and odd");
+
+SensorStats sensorStats;
+
+static SpscRing<SensorSnapshot, SENSOR_RING_SIZE> sampleRing;
+static SensorSnapshot latest; // Consumer side only
+
+// =================================================================
+// ==                 STREAMING FILTERS (PRODUCER)                ==
+// =================================================================
+struct ChannelFilter {
+  float window[SENSOR_MEDIAN_WINDOW];
+  int next;
+  bool seeded;
+  float ema;
+  float lastRaw;
+  unsigned long lastChangeAt;
+};
+
+static ChannelFilter indoorFilter, outdoorFilter, humidityFilter;
+static uint32_t sampleSequence;
+
+// Fixed-size window, so sorting a copy is constant work per sample.
+static float windowMedian(const float* window) {
+  float sorted[SENSOR_MEDIAN_WINDOW];
+  for (int i = 0; i < SENSOR_MEDIAN_WINDOW; i++) {
+    int j = i;
+    while (j > 0 && sorted[j - 1] > window[i]) { sorted[j] = sorted[j - 1]; j--; }
+    sorted[j] = window[i];
+  }
+  return sorted[SENSOR_MEDIAN_WINDOW / 2];
+}
+
+// Returns the median; updates the EMA, and *ratePerMin if given.
+static float filterSample(ChannelFilter& f, float raw, unsigned long at, float* ratePerMin) {
+  if (!f.seeded) {
+    for (int i = 0; i < SENSOR_MEDIAN_WINDOW; i++) f.window[i] = raw;
+    f.ema = raw; f.lastRaw = raw; f.lastChangeAt = at; f.next = 0; f.seeded = true;
+  }
+  if (raw != f.lastRaw) { f.lastRaw = raw; f.lastChangeAt = at; }
+  f.window[f.next] = raw;
+  f.next = (f.next + 1) % SENSOR_MEDIAN_WINDOW;
+  float median = windowMedian(f.window);
+
+  const float alpha = (float)SENSOR_SAMPLE_INTERVAL_SECS / (SENSOR_EMA_TAU_SECS + SENSOR_SAMPLE_INTERVAL_SECS);
+  float previous = f.ema;
+  f.ema += alpha * (median - f.ema);
+  if (ratePerMin) *ratePerMin = (f.ema - previous) * 60.0f / SENSOR_SAMPLE_INTERVAL_SECS;
+  return median;
+}
+
+// A filtered reading into the control representation; out-of-range and NaN
+// readings saturate, and validateSensorReadings() rejects them.
+static CentiC readingToCentiC(float value) {
+  if (!(value > -300.0f)) return -30000;
+  if (value > 300.0f) return 30000;
+  return centiCFrom(value, tempUnit);
+}
+
+static void resetFilters() {
+  indoorFilter.seeded = outdoorFilter.seeded = humidityFilter.seeded = false;
+}
+
+// One blocking read of every driver, filtered and queued for the control task.
+static void acquireSample(unsigned long at) {
+  SensorSnapshot s;
+  s.valid = true;
+  s.timestamp = at;
+  s.sequence = ++sampleSequence;
+  s.indoorRaw = readTemperature();
+  s.indoor = filterSample(indoorFilter, s.indoorRaw, at, &s.indoorRatePerMin);
+  s.indoorSmoothed = indoorFilter.ema;
+  s.indoorStuck = at - indoorFilter.lastChangeAt >= SENSOR_STUCK_MINS * 60000UL;
+  s.outdoor = filterSample(outdoorFilter, readOutdoorTemperature(), at, nullptr);
+  s.humidity = filterSample(humidityFilter, readHumidity(), at, nullptr);
+  s.indoorCentiC = readingToCentiC(s.indoor);
+  s.outdoorCentiC = readingToCentiC(s.outdoor);
+  s.humidityCentiRH = centiRH(std::max(0.0f, std::min(100.0f, s.humidity)));
+  sensorStats.samples++;
+  if (!sampleRing.push(s)) sensorStats.overruns++;
+}
+
+static void sensorTask(void* param) {
+  (void)param;
+  for (;;) {
+    vTaskDelay(pdMS_TO_TICKS(SENSOR_SAMPLE_INTERVAL_MS));
+    acquireSample(currentTime());
+  }
+}
+
+// =================================================================
+// ==                 VIRTUAL SAMPLER (g_isTesting)               ==
+// =================================================================
+// Stands in for the task: takes every sample due since the last call, each
+// reading the mocks as they are now. A backwards or longer-than-the-ring jump
+// of the mock clock is a restart, so the filters start again.
+static bool virtualStarted = false;
+static unsigned long lastVirtualSampleAt;
+
+static void virtualCatchUp() {
+  unsigned long now = g_mockMillis;
+  if (!virtualStarted || (long)(now - lastVirtualSampleAt) < 0 || now - lastVirtualSampleAt > SENSOR_RING_SIZE * SENSOR_SAMPLE_INTERVAL_MS) {
+    resetFilters();
+    lastVirtualSampleAt = now - SENSOR_SAMPLE_INTERVAL_MS;
+    virtualStarted = true;
+  }
+  while (now - lastVirtualSampleAt >= SENSOR_SAMPLE_INTERVAL_MS) {
+    lastVirtualSampleAt += SENSOR_SAMPLE_INTERVAL_MS;
+    acquireSample(lastVirtualSampleAt);
+  }
+}
+
+// =================================================================
+// ==                      CONSUMER API                           ==
+// =================================================================
+void startSensorAcquisition() {
+  if (g_isTesting) { virtualStarted = false; return; }
+  static bool started = false;
+  if (started) return;
+  started = true;
+  acquireSample(currentTime()); // The first control pass has a reading
+  xTaskCreate(sensorTask, "sensors", 4096, nullptr, 2, nullptr);
+}
+
+SensorSnapshot sensorSnapshot() {
+  if (g_isTesting) virtualCatchUp();
+  SensorSnapshot s;
+  while (sampleRing.pop(&s)) latest = s;
+  sensorStats.drains++;
+  return latest;
+}
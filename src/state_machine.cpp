@@ -0,0 +1,272 @@
+#include "state_machine.h"
+#include <array>
+#include <utility>
+#include <Arduino.h>
+#include "config.h"
+#include "controller.h"
+#include "hvac_logic.h"
+#include "main.h"
+#include "persistence.h"
+
+static_assert(TEMPERATURE_DEADBAND_F >= 0, "heat and cool demand must lie outside the satisfied bands");
+
+static StateTraceHook traceHook = nullptr;
+
+const char* stateTransitionName(StateTransition transition) {
+  switch (transition) {
+    case TRANSITION_LOCKOUT:           return "lockout";
+    case TRANSITION_HEAT_RELEASED:     return "heat_released";
+    case TRANSITION_HEAT_MAX_RUN:      return "heat_max_run";
+    case TRANSITION_HEAT_SATISFIED:    return "heat_satisfied";
+    case TRANSITION_HEAT_DAMPER_CLOSE: return "heat_damper_close";
+    case TRANSITION_HEAT_DAMPER_OPEN:  return "heat_damper_open";
+    case TRANSITION_HEAT_START:        return "heat_start";
+    case TRANSITION_COOL_RELEASED:     return "cool_released";
+    case TRANSITION_COOL_MAX_RUN:      return "cool_max_run";
+    case TRANSITION_COOL_SATISFIED:    return "cool_satisfied";
+    case TRANSITION_COOL_DAMPER_CLOSE: return "cool_damper_close";
+    case TRANSITION_COOL_DAMPER_OPEN:  return "cool_damper_open";
+    case TRANSITION_COOL_START:        return "cool_start";
+    default:                           return "none";
+  }
+}
+
+// The heater or cooler wins over the damper; heat and cool together never
+// survive a commit (relays.h), so the heater's precedence is moot.
+static inline ThermostatState stateOf(uint16_t relays, bool freshAirForHeating) {
+  if (relays & RELAY_BIT(HEATER_RELAY_PIN)) return HEATING;
+  if (relays & RELAY_BIT(COOLER_RELAY_PIN)) return COOLING;
+  if (relays & RELAY_BIT(FRESH_AIR_RELAY_PIN)) return freshAirForHeating ? ECONOMIZER_HEATING : ECONOMIZER_COOLING;
+  return IDLE;
+}
+
+ThermostatState thermostatStateOf(const ControllerBatch& b, int i) { return stateOf(b.relays[i], b.freshAirForHeating[i]); }
+
+void setStateTraceHook(StateTraceHook hook) { traceHook = hook; }
+
+// =================================================================
+// ==                       TRANSITION TABLE                      ==
+// =================================================================
+constexpr uint8_t IN(ThermostatState s) { return (uint8_t)(1u << s); }
+constexpr uint8_t ANY_STATE = 0xFF;
+constexpr uint8_t ECONOMIZING = IN(ECONOMIZER_HEATING) | IN(ECONOMIZER_COOLING);
+
+struct StateRule { StateTransition transition; uint8_t from; };
+
+// In firing order, which carries part of each guard: a rule is only tried
+// once every rule above it for the state has declined. The heating rules
+// still apply with the cooler on, and the cooling rules with the heater on,
+// when the mode is changed under a running cycle, as in controlHeating() and
+// controlCooling(); the released rules come first, as releaseStage() does.
+constexpr StateRule STATE_RULES[] = {
+  { TRANSITION_LOCKOUT,           ANY_STATE },
+  { TRANSITION_HEAT_RELEASED,     IN(HEATING) },
+  { TRANSITION_COOL_RELEASED,     IN(COOLING) },
+  { TRANSITION_HEAT_MAX_RUN,      IN(HEATING) },
+  { TRANSITION_HEAT_SATISFIED,    IN(HEATING) },
+  { TRANSITION_HEAT_DAMPER_CLOSE, IN(HEATING) | IN(COOLING) | ECONOMIZING },
+  { TRANSITION_HEAT_DAMPER_OPEN,  IN(IDLE) | IN(COOLING) | ECONOMIZING },
+  { TRANSITION_HEAT_START,        IN(IDLE) | ECONOMIZING },
+  { TRANSITION_COOL_MAX_RUN,      IN(COOLING) },
+  { TRANSITION_COOL_SATISFIED,    IN(COOLING) },
+  { TRANSITION_COOL_DAMPER_CLOSE, IN(COOLING) | IN(HEATING) | ECONOMIZING },
+  { TRANSITION_COOL_DAMPER_OPEN,  IN(IDLE) | IN(HEATING) | ECONOMIZING },
+  { TRANSITION_COOL_START,        IN(IDLE) | ECONOMIZING },
+};
+
+template <class E, bool Economizer>
+constexpr bool fitted(StateTransition t) {
+  switch (t) {
+    case TRANSITION_LOCKOUT: return true;
+    case TRANSITION_HEAT_DAMPER_CLOSE: case TRANSITION_HEAT_DAMPER_OPEN: return E::heat && Economizer;
+    case TRANSITION_COOL_DAMPER_CLOSE: case TRANSITION_COOL_DAMPER_OPEN: return E::cool && Economizer;
+    case TRANSITION_HEAT_RELEASED: case TRANSITION_HEAT_MAX_RUN: case TRANSITION_HEAT_SATISFIED: case TRANSITION_HEAT_START: return E::heat;
+    default: return E::cool;
+  }
+}
+
+// The rules for one state and one set of equipment, resolved at compile time.
+template <class E, bool Economizer, ThermostatState S>
+struct StateTable {
+  static constexpr bool applies(const StateRule& r) { return (r.from & IN(S)) && fitted<E, Economizer>(r.transition); }
+  static constexpr size_t count() {
+    size_t n = 0;
+    for (const StateRule& r : STATE_RULES) if (applies(r)) n++;
+    return n;
+  }
+  static constexpr std::array<StateTransition, count()> rules() {
+    std::array<StateTransition, count()> out{};
+    size_t n = 0;
+    for (const StateRule& r : STATE_RULES) if (applies(r)) out[n++] = r.transition;
+    return out;
+  }
+};
+
+// =================================================================
+// ==                    GUARDS AND ACTIONS                       ==
+// =================================================================
+struct Pass {
+  ControllerBatch& b;
+  int i;
+  CentiC temp, target, outdoor;
+  bool heating, cooling, freshAir; // Relays at the start of the pass
+};
+
+static inline bool heatingDecides(const Pass& p) {
+  SystemMode mode = p.b.systemMode[p.i];
+  return mode == SYS_HEAT || (mode == SYS_AUTO && !p.cooling && !(p.freshAir && !p.b.freshAirForHeating[p.i]));
+}
+
+static inline bool coolingDecides(const Pass& p) {
+  SystemMode mode = p.b.systemMode[p.i];
+  return mode == SYS_COOL || (mode == SYS_AUTO && !p.heating && !(p.freshAir && p.b.freshAirForHeating[p.i]));
+}
+
+static inline bool heatDemand(const Pass& p) { return p.temp < p.target - temperatureDeadband(p.b.tempUnit[p.i]); }
+static inline bool coolDemand(const Pass& p) { return p.temp > p.target + temperatureDeadband(p.b.tempUnit[p.i]); }
+
+// A heat pump's two relays are one compressor, which rests between runs in either direction.
+template <class E>
+static inline bool heaterRested(const ControllerBatch& b, int i) {
+  return b.now - b.lastHeaterOffTime[i] > MIN_HEATER_OFF_TIME_MS && (!E::sharedCompressor || b.now - b.lastCoolerOffTime[i] > MIN_COOLER_OFF_TIME_MS);
+}
+
+template <class E>
+static inline bool coolerRested(const ControllerBatch& b, int i) {
+  return b.now - b.lastCoolerOffTime[i] > MIN_COOLER_OFF_TIME_MS && (!E::sharedCompressor || b.now - b.lastHeaterOffTime[i] > MIN_HEATER_OFF_TIME_MS);
+}
+
+static void startCycle(Pass& p, int pin, ControlMillis& lastOnTime) {
+  ControllerBatch& b = p.b;
+  setRelay(b, p.i, pin, HIGH);
+  lastOnTime = b.now; b.cycleStartTime[p.i] = b.now; b.cycleInProgress[p.i] = true;
+  b.cycleStartTemp[p.i] = p.temp; b.cycleStartOutdoorTemp[p.i] = p.outdoor;
+}
+
+static void endCycle(Pass& p, int pin, ControlMillis& lastOffTime, bool isHeating) {
+  setRelay(p.b, p.i, pin, LOW);
+  lastOffTime = p.b.now;
+  updatePerformanceData(p.b, p.i, isHeating, p.temp);
+}
+
+// Guards are inlined into every state that tries them; they are a few loads
+// and compares. Only the table order stands between them: HEAT_DAMPER_CLOSE,
+// for one, is tried only once HEAT_SATISFIED has declined.
+template <class E, StateTransition T>
+static inline bool guard(const Pass& p) {
+  const ControllerBatch& b = p.b;
+  const int i = p.i;
+  const ControlMillis now = b.now;
+  if constexpr (T == TRANSITION_LOCKOUT) return b.systemLockedOut[i];
+  else if constexpr (T == TRANSITION_HEAT_RELEASED) return !heatingDecides(p) && now - b.lastHeaterOnTime[i] > MIN_HEATER_RUN_TIME_MS;
+  else if constexpr (T == TRANSITION_COOL_RELEASED) return !coolingDecides(p) && now - b.lastCoolerOnTime[i] > MIN_COOLER_RUN_TIME_MS;
+  else if constexpr (T == TRANSITION_HEAT_MAX_RUN) return heatingDecides(p) && now - b.lastHeaterOnTime[i] > MAX_HEATER_RUN_TIME_MS;
+  else if constexpr (T == TRANSITION_HEAT_SATISFIED) return heatingDecides(p) && p.temp >= p.target && now - b.lastHeaterOnTime[i] > MIN_HEATER_RUN_TIME_MS;
+  else if constexpr (T == TRANSITION_HEAT_DAMPER_CLOSE) return heatingDecides(p) && p.temp >= p.target && p.freshAir;
+  else if constexpr (T == TRANSITION_HEAT_DAMPER_OPEN) return heatingDecides(p) && heatDemand(p) && p.outdoor > p.temp + freshAirDifferential(b.tempUnit[i]);
+  else if constexpr (T == TRANSITION_HEAT_START) return heatingDecides(p) && heatDemand(p) && heaterRested<E>(b, i) && !p.cooling;
+  else if constexpr (T == TRANSITION_COOL_MAX_RUN) return coolingDecides(p) && now - b.lastCoolerOnTime[i] > MAX_COOLER_RUN_TIME_MS;
+  else if constexpr (T == TRANSITION_COOL_SATISFIED) return coolingDecides(p) && p.temp <= p.target && now - b.lastCoolerOnTime[i] > MIN_COOLER_RUN_TIME_MS;
+  else if constexpr (T == TRANSITION_COOL_DAMPER_CLOSE) return coolingDecides(p) && p.temp <= p.target && p.freshAir;
+  else if constexpr (T == TRANSITION_COOL_DAMPER_OPEN) return coolingDecides(p) && coolDemand(p) && p.outdoor < p.temp - freshAirDifferential(b.tempUnit[i]);
+  else return coolingDecides(p) && coolDemand(p) && coolerRested<E>(b, i) && !p.heating;
+}
+
+// Actions are out of line, one copy each however many states can fire them:
+// they run on a small share of passes, and inlining them per state would
+// multiply the code for nothing.
+template <StateTransition T>
+static __attribute__((noinline)) void act(Pass& p) {
+  ControllerBatch& b = p.b;
+  const int i = p.i;
+  if constexpr (T == TRANSITION_LOCKOUT) {
+    b.relays[i] &= ~(RELAY_BIT(HEATER_RELAY_PIN) | RELAY_BIT(COOLER_RELAY_PIN) | RELAY_BIT(FRESH_AIR_RELAY_PIN));
+  } else if constexpr (T == TRANSITION_HEAT_RELEASED || T == TRANSITION_HEAT_MAX_RUN || T == TRANSITION_HEAT_SATISFIED) {
+    endCycle(p, HEATER_RELAY_PIN, b.lastHeaterOffTime[i], true);
+    if (T == TRANSITION_HEAT_MAX_RUN || (T == TRANSITION_HEAT_RELEASED && b.now - b.lastHeaterOnTime[i] > MAX_HEATER_RUN_TIME_MS)) countMaxRunTrip(b, i, true);
+  } else if constexpr (T == TRANSITION_COOL_RELEASED || T == TRANSITION_COOL_MAX_RUN || T == TRANSITION_COOL_SATISFIED) {
+    endCycle(p, COOLER_RELAY_PIN, b.lastCoolerOffTime[i], false);
+    if (T == TRANSITION_COOL_MAX_RUN || (T == TRANSITION_COOL_RELEASED && b.now - b.lastCoolerOnTime[i] > MAX_COOLER_RUN_TIME_MS)) countMaxRunTrip(b, i, false);
+  } else if constexpr (T == TRANSITION_HEAT_DAMPER_CLOSE || T == TRANSITION_COOL_DAMPER_CLOSE) {
+    setRelay(b, i, FRESH_AIR_RELAY_PIN, LOW);
+  } else if constexpr (T == TRANSITION_HEAT_DAMPER_OPEN || T == TRANSITION_COOL_DAMPER_OPEN) {
+    bool heating = T == TRANSITION_HEAT_DAMPER_OPEN;
+    setRelay(b, i, FRESH_AIR_RELAY_PIN, HIGH); setRelay(b, i, heating ? HEATER_RELAY_PIN : COOLER_RELAY_PIN, LOW);
+    b.freshAirForHeating[i] = heating;
+  } else if constexpr (T == TRANSITION_HEAT_START) {
+    startCycle(p, HEATER_RELAY_PIN, b.lastHeaterOnTime[i]);
+  } else {
+    startCycle(p, COOLER_RELAY_PIN, b.lastCoolerOnTime[i]);
+  }
+}
+
+template <class E, StateTransition T>
+static inline bool fire(Pass& p) {
+  if (!guard<E, T>(p)) return false;
+  act<T>(p);
+  return true;
+}
+
+// Tries the state's rules in order, unrolled, stopping at the first that fires.
+template <class E, bool Economizer, ThermostatState S, size_t... I>
+static inline StateTransition runRules(Pass& p, std::index_sequence<I...>) {
+  constexpr auto rules = StateTable<E, Economizer, S>::rules();
+  StateTransition fired = NUM_STATE_TRANSITIONS;
+  (void)((fire<E, rules[I]>(p) && (fired = rules[I], true)) || ...);
+  return fired;
+}
+
+template <class E, bool Economizer, ThermostatState S>
+static inline StateTransition runState(Pass& p) {
+  return runRules<E, Economizer, S>(p, std::make_index_sequence<StateTable<E, Economizer, S>::count()>{});
+}
+
+template <EquipmentProfile Profile, bool Economizer>
+ThermostatState stepThermostat(ControllerBatch& b, int i, CentiC temp, CentiC target, CentiC outdoor) {
+  typedef EquipmentTraits<Profile> E;
+  const uint16_t relays = b.relays[i];
+  const ThermostatState from = stateOf(relays, b.freshAirForHeating[i]);
+  Pass p = { b, i, temp, target, outdoor, relayOn(b, i, HEATER_RELAY_PIN), relayOn(b, i, COOLER_RELAY_PIN), relayOn(b, i, FRESH_AIR_RELAY_PIN) };
+
+  StateTransition fired;
+  switch (from) {
+    case HEATING:            fired = runState<E, Economizer, HEATING>(p); break;
+    case COOLING:            fired = runState<E, Economizer, COOLING>(p); break;
+    case ECONOMIZER_HEATING: fired = runState<E, Economizer, ECONOMIZER_HEATING>(p); break;
+    case ECONOMIZER_COOLING: fired = runState<E, Economizer, ECONOMIZER_COOLING>(p); break;
+    default:                 fired = runState<E, Economizer, IDLE>(p); break;
+  }
+  if (fired == NUM_STATE_TRANSITIONS) return b.state[i] = from;
+
+  ThermostatState to = stateOf(b.relays[i], b.freshAirForHeating[i]);
+  b.state[i] = to;
+  if (traceHook && (to != from || b.relays[i] != relays)) traceHook(i, from, to, fired, b.now);
+  return to;
+}
+
+template ThermostatState stepThermostat<EQUIPMENT_HEAT_ONLY, false>(ControllerBatch&, int, CentiC, CentiC, CentiC);
+template ThermostatState stepThermostat<EQUIPMENT_HEAT_ONLY, true>(ControllerBatch&, int, CentiC, CentiC, CentiC);
+template ThermostatState stepThermostat<EQUIPMENT_COOL_ONLY, false>(ControllerBatch&, int, CentiC, CentiC, CentiC);
+template ThermostatState stepThermostat<EQUIPMENT_COOL_ONLY, true>(ControllerBatch&, int, CentiC, CentiC, CentiC);
+template ThermostatState stepThermostat<EQUIPMENT_HEAT_COOL, false>(ControllerBatch&, int, CentiC, CentiC, CentiC);
+template ThermostatState stepThermostat<EQUIPMENT_HEAT_COOL, true>(ControllerBatch&, int, CentiC, CentiC, CentiC);
+template ThermostatState stepThermostat<EQUIPMENT_HEAT_PUMP, false>(ControllerBatch&, int, CentiC, CentiC, CentiC);
+template ThermostatState stepThermostat<EQUIPMENT_HEAT_PUMP, true>(ControllerBatch&, int, CentiC, CentiC, CentiC);
+
+ThermostatState stepThermostat(ControllerBatch& b, int i, CentiC temp, CentiC target, CentiC outdoor) {
+  return stepThermostat<EQUIPMENT_PROFILE, EQUIPMENT_ECONOMIZER>(b, i, temp, target, outdoor);
+}
+
+// =================================================================
+// ==                   DEVICE (SINGLE INSTANCE)                  ==
+// =================================================================
+ThermostatState stepThermostat(CentiC temp, CentiC target, CentiC outdoor) {
+  deviceController.now = currentTime();
+  deviceController.season = getCurrentSeason();
+  ThermostatState state = stepThermostat(deviceController, 0, temp, target, outdoor);
+  if (deviceController.performanceDirty[0]) {
+    markPerformanceDirty(deviceController.performanceDirty[0]);
+    deviceController.performanceDirty[0] = 0;
+  }
+  return state;
+}
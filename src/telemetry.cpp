@@ -0,0 +1,199 @@
+#include "telemetry.h"
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "config.h"
+#include "controller.h"
+#include "hvac_tests.h"
+#include "main.h"
+#include "probes.h"
+#include "utils.h"
+
+static_assert(sizeof(TelemetryFrame) == 22 && sizeof(TelemetryProbeFrame) == 24, "telemetry frames are a wire format");
+
+TelemetryStats telemetryStats;
+
+// Ring slots hold either frame type, tagged by size.
+struct TelemetryRecord {
+  uint8_t size;
+  uint8_t bytes[TELEMETRY_MAX_FRAME];
+};
+
+static SpscRing<TelemetryRecord, TELEMETRY_RING_FRAMES> frameRing;
+static uint16_t nextSequence = 0;
+static volatile bool textMode = TELEMETRY_TEXT_OUTPUT;
+
+static void serialSink(const uint8_t* data, size_t len) { Serial.write(data, len); }
+static TelemetrySink sink = serialSink;
+
+// =================================================================
+// ==                   FRAME ENCODING                            ==
+// =================================================================
+// COBS: no 0x00 inside the encoding, so 0x00 marks the frame end and a
+// receiver resynchronises at the next one.
+static size_t encodeBytes(const uint8_t* frame, size_t size, uint8_t* out) {
+  uint8_t raw[TELEMETRY_MAX_FRAME + 2];
+  memcpy(raw, frame, size);
+  uint16_t crc = crc16(raw, size);
+  raw[size] = crc & 0xFF; raw[size + 1] = crc >> 8;
+
+  size_t codeAt = 0, n = 1;
+  uint8_t code = 1;
+  for (size_t i = 0; i < size + 2; i++) {
+    if (raw[i] == 0) { out[codeAt] = code; codeAt = n++; code = 1; }
+    else { out[n++] = raw[i]; code++; }
+  }
+  out[codeAt] = code;
+  out[n++] = 0;
+  return n;
+}
+
+size_t encodeTelemetryFrame(const TelemetryFrame& frame, uint8_t* out) { return encodeBytes((const uint8_t*)&frame, sizeof(frame), out); }
+size_t encodeTelemetryFrame(const TelemetryProbeFrame& frame, uint8_t* out) { return encodeBytes((const uint8_t*)&frame, sizeof(frame), out); }
+
+size_t decodeTelemetryBytes(const uint8_t* in, size_t len, uint8_t out[TELEMETRY_MAX_FRAME]) {
+  uint8_t raw[TELEMETRY_MAX_FRAME + 2];
+  size_t n = 0, i = 0;
+  while (i < len) {
+    uint8_t code = in[i++];
+    if (code == 0 || i + code - 1 > len) return 0;
+    for (int k = 1; k < code; k++) { if (n == sizeof(raw)) return 0; raw[n++] = in[i++]; }
+    if (code < 0xFF && i < len) { if (n == sizeof(raw)) return 0; raw[n++] = 0; }
+  }
+  if (n < 3) return 0;
+  size_t size = n - 2;
+  if (crc16(raw, size) != (uint16_t)(raw[size] | raw[size + 1] << 8)) return 0;
+  memcpy(out, raw, size);
+  return size;
+}
+
+bool decodeTelemetryFrame(const uint8_t* in, size_t len, TelemetryFrame* frame) {
+  uint8_t raw[TELEMETRY_MAX_FRAME];
+  if (decodeTelemetryBytes(in, len, raw) != sizeof(TelemetryFrame) || raw[0] != TELEMETRY_VERSION) return false;
+  memcpy(frame, raw, sizeof(TelemetryFrame));
+  return true;
+}
+
+bool decodeTelemetryFrame(const uint8_t* in, size_t len, TelemetryProbeFrame* frame) {
+  uint8_t raw[TELEMETRY_MAX_FRAME];
+  if (decodeTelemetryBytes(in, len, raw) != sizeof(TelemetryProbeFrame) || raw[0] != TELEMETRY_PROBE_FRAME) return false;
+  memcpy(frame, raw, sizeof(TelemetryProbeFrame));
+  return true;
+}
+
+int formatTelemetryText(const TelemetryFrame& f, char* out, size_t size) {
+  char unit = (f.flags & TELEMETRY_FLAG_FAHRENHEIT) ? 'F' : 'C';
+  return snprintf(out, size, "Time: %d:%02d | Temp: %.1f%c, Target: %.1f%c%s | Humidity: %.1f%%\r\n",
+                  f.minuteOfDay / 60, f.minuteOfDay % 60, f.indoorFiltered / 100.0, unit, f.target / 100.0, unit,
+                  f.state == RECOVERING ? " (recovering)" : "", f.humidity / 100.0);
+}
+
+int formatTelemetryText(const TelemetryProbeFrame& f, char* out, size_t size) {
+  return snprintf(out, size, "Probe %s: n=%lu min=%luus p50<=%luus p99<=%luus max=%luus\r\n",
+                  f.stage < NUM_PROBES ? probeName((ProbeStage)f.stage) : "?", (unsigned long)f.count, (unsigned long)f.minUs,
+                  (unsigned long)f.p50Us, (unsigned long)f.p99Us, (unsigned long)f.maxUs);
+}
+
+// =================================================================
+// ==                PRODUCER (CONTROL TASK)                      ==
+// =================================================================
+static int16_t hundredths(float v) { return (int16_t)lroundf(std::max(-327.0f, std::min(327.0f, v)) * 100.0f); }
+
+static bool enqueueRecord(const void* frame, size_t size) {
+  TelemetryRecord r;
+  r.size = (uint8_t)size;
+  memcpy(r.bytes, frame, size);
+  telemetryStats.published++;
+  if (frameRing.push(r)) return true;
+  telemetryStats.dropped++;
+  return false;
+}
+
+bool enqueueTelemetry(TelemetryFrame frame) { frame.sequence = nextSequence++; return enqueueRecord(&frame, sizeof(frame)); }
+bool enqueueTelemetry(TelemetryProbeFrame frame) { frame.sequence = nextSequence++; return enqueueRecord(&frame, sizeof(frame)); }
+
+void publishTelemetry(const SensorSnapshot& sensors, const TimeInfo& now, CentiC target, ThermostatState state) {
+  TelemetryFrame f;
+  f.version = TELEMETRY_VERSION;
+  f.state = (uint8_t)state;
+  f.timestampMs = (uint32_t)currentTime();
+  f.minuteOfDay = (uint16_t)(now.hour * 60 + now.minute);
+  f.indoorRaw = hundredths(sensors.indoorRaw);
+  f.indoorFiltered = hundredths(sensors.indoor);
+  f.outdoor = hundredths(sensors.outdoor);
+  f.target = (int16_t)centiCToCentiUnit(target, tempUnit);
+  f.humidity = (uint16_t)sensors.humidityCentiRH;
+  const ControllerBatch& b = deviceController;
+  f.relays = (relayOn(b, 0, HEATER_RELAY_PIN) ? TELEMETRY_RELAY_HEATER : 0) | (relayOn(b, 0, COOLER_RELAY_PIN) ? TELEMETRY_RELAY_COOLER : 0) |
+             (relayOn(b, 0, FAN_RELAY_PIN) ? TELEMETRY_RELAY_FAN : 0) | (relayOn(b, 0, FRESH_AIR_RELAY_PIN) ? TELEMETRY_RELAY_FRESH_AIR : 0) |
+             (relayOn(b, 0, HUMIDITY_RELAY_PIN) ? TELEMETRY_RELAY_HUMIDIFIER : 0);
+  f.flags = (systemLockedOut ? TELEMETRY_FLAG_LOCKED_OUT : 0) | (tempUnit == FAHRENHEIT ? TELEMETRY_FLAG_FAHRENHEIT : 0) |
+            (vacationModeActive ? TELEMETRY_FLAG_VACATION : 0) | (sensors.indoorStuck ? TELEMETRY_FLAG_SENSOR_STUCK : 0);
+  enqueueTelemetry(f);
+  if (g_isTesting) drainTelemetry(); // No drain task on the virtual clock
+}
+
+void publishProbeTelemetry() {
+  static unsigned long lastPublished = 0;
+  if (!HVAC_PROBES || currentTime() - lastPublished < TELEMETRY_PROBE_INTERVAL_SECS * 1000) return;
+  lastPublished = currentTime();
+  for (int stage = 0; stage < NUM_PROBES; stage++) {
+    const ProbeHistogram& h = probeHistograms[stage];
+    if (h.count == 0) continue;
+    TelemetryProbeFrame f;
+    f.kind = TELEMETRY_PROBE_FRAME;
+    f.stage = (uint8_t)stage;
+    f.count = h.count;
+    f.minUs = h.minCycles / PROBE_CYCLES_PER_US;
+    f.p50Us = probePercentileUs(h, 50);
+    f.p99Us = probePercentileUs(h, 99);
+    f.maxUs = (h.maxCycles + PROBE_CYCLES_PER_US - 1) / PROBE_CYCLES_PER_US;
+    enqueueTelemetry(f);
+  }
+  if (g_isTesting) drainTelemetry();
+}
+
+// =================================================================
+// ==                  CONSUMER (DRAIN TASK)                      ==
+// =================================================================
+size_t drainTelemetry() {
+  TelemetryRecord r;
+  size_t count = 0;
+  while (frameRing.pop(&r)) {
+    uint8_t buf[112];
+    static_assert(TELEMETRY_MAX_ENCODED <= sizeof(buf), "telemetry buffer");
+    size_t len;
+    if (!textMode) {
+      len = encodeBytes(r.bytes, r.size, buf);
+    } else if (r.bytes[0] == TELEMETRY_PROBE_FRAME) {
+      TelemetryProbeFrame f; memcpy(&f, r.bytes, sizeof(f));
+      len = std::min((size_t)formatTelemetryText(f, (char*)buf, sizeof(buf)), sizeof(buf) - 1);
+    } else {
+      TelemetryFrame f; memcpy(&f, r.bytes, sizeof(f));
+      len = std::min((size_t)formatTelemetryText(f, (char*)buf, sizeof(buf)), sizeof(buf) - 1);
+    }
+    sink(buf, len);
+    telemetryStats.bytesOut += len;
+    count++;
+  }
+  telemetryStats.shipped += count;
+  return count;
+}
+
+static void telemetryTask(void* param) {
+  (void)param;
+  for (;;) {
+    drainTelemetry();
+    vTaskDelay(pdMS_TO_TICKS(TELEMETRY_DRAIN_INTERVAL_MS));
+  }
+}
+
+void startTelemetry() {
+  static bool started = false;
+  if (g_isTesting || started) return;
+  started = true;
+  xTaskCreate(telemetryTask, "telemetry", 3072, nullptr, 1, nullptr);
+}
+
+void setTelemetryTextMode(bool text) { textMode = text; }
+void setTelemetrySink(TelemetrySink s) { sink = s ? s : serialSink; }
@@ -0,0 +1,203 @@
+#include "thermal_model.h"
+#include <Arduino.h>
+#include <math.h>
+#include <string.h>
+#include "config.h"
+#include "controller.h"
+#include "hvac_logic.h"
+#include "main.h"
+
+static const float MS_PER_HOUR = 3600000.0f;
+static const float NOISE_VAR = 0.1f;          // (C/h)^2: expected slope noise, scales P against the priors
+static const float P_TRACE_MAX = 1000.0f;     // Stop forgetting beyond this, so unexcited parameters do not wind up
+static const float SEED_INDOOR_C = 20.0f;     // Indoor temperature assumed for the learned cycle rates
+static const float DEFAULT_LOSS = 0.05f;      // 1/h: a 20 h time constant
+static const float DEFAULT_HEAT_GAIN = 3.0f, DEFAULT_COOL_GAIN = 2.0f; // C/h
+
+// Outdoor temperature at the middle of each performance bin (the outer bins take 5 F beyond their edge).
+static constexpr CentiC PERFORMANCE_BIN_CENTRES[NUM_PERFORMANCE_BINS] = {
+  centiCFromF(5), centiCFromF(15), centiCFromF(25), centiCFromF(35), centiCFromF(45), centiCFromF(55), centiCFromF(65), centiCFromF(75)
+};
+
+static float toC(CentiC c) { return c * 0.01f; }
+
+// Gain implied by the learned rates: rate = gain -/+ loss * (indoor - outdoor), weighted by samples.
+static bool seedGain(const uint16_t* rate, const uint16_t* samples, bool heating, float* gain) {
+  float sum = 0; uint32_t n = 0;
+  for (int bin = 0; bin < NUM_PERFORMANCE_BINS; bin++) {
+    if (!samples[bin]) continue;
+    float drift = DEFAULT_LOSS * (SEED_INDOOR_C - toC(PERFORMANCE_BIN_CENTRES[bin]));
+    sum += samples[bin] * (toC(rate[bin]) + (heating ? drift : -drift));
+    n += samples[bin];
+  }
+  if (n == 0 || sum <= 0) return false;
+  *gain = sum / n;
+  return true;
+}
+
+void seedThermalModel(ThermalModel& m, const HvacPerformance& perf, int season) {
+  memset(&m, 0, sizeof(m));
+  float heat = DEFAULT_HEAT_GAIN, cool = DEFAULT_COOL_GAIN;
+  bool heatLearned = seedGain(perf.heatRate[season], perf.heatSamples[season], true, &heat);
+  bool coolLearned = seedGain(perf.coolRate[season], perf.coolSamples[season], false, &cool);
+  m.theta[THERMAL_LOSS] = DEFAULT_LOSS;
+  m.theta[THERMAL_HEAT_GAIN] = heat;
+  m.theta[THERMAL_COOL_GAIN] = cool;
+  // Prior variances: a learned gain is trusted to about 1 C/h, a default to 2 C/h.
+  m.P[THERMAL_LOSS][THERMAL_LOSS] = 0.01f / NOISE_VAR;
+  m.P[THERMAL_HEAT_GAIN][THERMAL_HEAT_GAIN] = (heatLearned ? 1.0f : 4.0f) / NOISE_VAR;
+  m.P[THERMAL_COOL_GAIN][THERMAL_COOL_GAIN] = (coolLearned ? 1.0f : 4.0f) / NOISE_VAR;
+  m.P[THERMAL_INTERNAL_GAIN][THERMAL_INTERNAL_GAIN] = 0.25f / NOISE_VAR;
+  m.residualVar = NOISE_VAR;
+  m.seeded = true;
+}
+
+// One recursive least squares step on the slope y (C/h) against regressors phi.
+static void rlsUpdate(ThermalModel& m, const float* phi, float y) {
+  const int n = NUM_THERMAL_PARAMS;
+  float Pphi[n], denom = 0, error = y, trace = 0;
+  for (int r = 0; r < n; r++) {
+    Pphi[r] = 0;
+    for (int c = 0; c < n; c++) Pphi[r] += m.P[r][c] * phi[c];
+    error -= m.theta[r] * phi[r];
+    trace += m.P[r][r];
+  }
+  float lambda = trace < P_TRACE_MAX ? THERMAL_MODEL_FORGETTING : 1.0f;
+  for (int r = 0; r < n; r++) denom += phi[r] * Pphi[r];
+  denom += lambda;
+  for (int r = 0; r < n; r++) m.theta[r] += Pphi[r] / denom * error;
+  // P = (P - P phi phi' P / denom) / lambda, kept symmetric.
+  for (int r = 0; r < n; r++) {
+    for (int c = r; c < n; c++) {
+      float v = (m.P[r][c] - Pphi[r] * Pphi[c] / denom) / lambda;
+      m.P[r][c] = m.P[c][r] = v;
+    }
+  }
+  m.residualVar = THERMAL_MODEL_FORGETTING * m.residualVar + (1 - THERMAL_MODEL_FORGETTING) * error * error;
+  m.updates++;
+}
+
+static void openInterval(ThermalModel& m, ControlMillis now, CentiC indoor) {
+  m.intervalOpen = true;
+  m.disturbed = false;
+  m.intervalStart = now;
+  m.startTemp = indoor;
+  memset(m.sumPhi, 0, sizeof(m.sumPhi));
+}
+
+void updateThermalModel(ThermalModel& m, ControlMillis now, CentiC indoor, CentiC outdoor, bool heating, bool cooling, bool freshAir) {
+  if (m.intervalOpen) {
+    ControlMillis elapsedMs = now - m.lastAt;
+    if (elapsedMs > 2 * THERMAL_MODEL_SAMPLE_SECS * 1000) {
+      openInterval(m, now, indoor); // A gap in the passes: the relays between are unknown
+    } else {
+      // Trapezoid for the temperatures; the relays held through the step.
+      float hours = elapsedMs / MS_PER_HOUR;
+      float spread = 0.5f * (toC(m.lastTemp) + toC(indoor) - toC(m.lastOutdoor) - toC(outdoor));
+      m.sumPhi[THERMAL_LOSS] -= spread * hours;
+      if (heating) m.sumPhi[THERMAL_HEAT_GAIN] += hours;
+      if (cooling) m.sumPhi[THERMAL_COOL_GAIN] -= hours;
+      m.sumPhi[THERMAL_INTERNAL_GAIN] += hours;
+      if (freshAir) m.disturbed = true;
+      ControlMillis intervalMs = now - m.intervalStart;
+      if (intervalMs >= THERMAL_MODEL_SAMPLE_SECS * 1000) {
+        if (!m.disturbed) {
+          float span = intervalMs / MS_PER_HOUR, phi[NUM_THERMAL_PARAMS];
+          for (int p = 0; p < NUM_THERMAL_PARAMS; p++) phi[p] = m.sumPhi[p] / span;
+          rlsUpdate(m, phi, (toC(indoor) - toC(m.startTemp)) / span);
+          if (phi[THERMAL_HEAT_GAIN] > 0.5f && m.heatSamples < UINT16_MAX) m.heatSamples++;
+          if (phi[THERMAL_COOL_GAIN] < -0.5f && m.coolSamples < UINT16_MAX) m.coolSamples++;
+        }
+        openInterval(m, now, indoor);
+      }
+    }
+  } else {
+    openInterval(m, now, indoor);
+  }
+  m.lastAt = now;
+  m.lastTemp = indoor; m.lastOutdoor = outdoor;
+}
+
+// Uncertainty of the starting rate against the rate itself.
+static uint8_t rateConfidence(const ThermalModel& m, const float* phi, float rate, bool heating) {
+  float quad = 0;
+  for (int r = 0; r < NUM_THERMAL_PARAMS; r++) {
+    float row = 0;
+    for (int c = 0; c < NUM_THERMAL_PARAMS; c++) row += m.P[r][c] * phi[c];
+    quad += phi[r] * row;
+  }
+  float relative = sqrtf(std::max(0.0f, m.residualVar * quad)) / fabsf(rate);
+  float confidence = 100.0f * (1.0f - 2.0f * relative);
+  uint16_t samples = heating ? m.heatSamples : m.coolSamples;
+  if (samples < THERMAL_MODEL_MIN_SAMPLES) confidence *= (float)samples / THERMAL_MODEL_MIN_SAMPLES;
+  return (uint8_t)std::max(0.0f, std::min(100.0f, confidence));
+}
+
+ThermalPrediction predictTimeToTarget(const ThermalModel& m, CentiC current, CentiC target, CentiC outdoor) {
+  ThermalPrediction out = { true, 0, 0 };
+  bool heating = target > current;
+  float t0 = toC(current), tt = toC(target), to = toC(outdoor), loss = m.theta[THERMAL_LOSS];
+  float gain = m.theta[THERMAL_INTERNAL_GAIN] + (heating ? m.theta[THERMAL_HEAT_GAIN] : -m.theta[THERMAL_COOL_GAIN]);
+  float phi[NUM_THERMAL_PARAMS] = { -(t0 - to), heating ? 1.0f : 0.0f, heating ? 0.0f : -1.0f, 1.0f };
+  float rate = gain - loss * (t0 - to);
+  if (heating ? rate <= 0 : rate >= 0) { out.reachable = false; return out; }
+  out.confidence = rateConfidence(m, phi, rate, heating);
+  if (target == current) return out;
+
+  float hours;
+  if (loss < 1e-4f) {
+    hours = (tt - t0) / gain;
+  } else {
+    float equilibrium = to + gain / loss; // Where the equipment would hold the house
+    if (heating ? tt >= equilibrium : tt <= equilibrium) { out.reachable = false; return out; }
+    hours = logf((equilibrium - t0) / (equilibrium - tt)) / loss;
+  }
+  out.seconds = (uint32_t)std::min(hours * 3600.0f, 4.0e9f);
+  return out;
+}
+
+uint8_t seedPerformanceFromModel(const ThermalModel& m, HvacPerformance& perf, int season, CentiC indoor) {
+  uint8_t filled = 0;
+  for (int heating = 0; heating < 2; heating++) {
+    uint16_t* rate = heating ? perf.heatRate[season] : perf.coolRate[season];
+    uint16_t* samples = heating ? perf.heatSamples[season] : perf.coolSamples[season];
+    if ((heating ? m.heatSamples : m.coolSamples) < THERMAL_MODEL_MIN_SAMPLES) continue;
+    for (int bin = 0; bin < NUM_PERFORMANCE_BINS; bin++) {
+      if (samples[bin]) continue;
+      float ti = toC(indoor), to = toC(PERFORMANCE_BIN_CENTRES[bin]);
+      float phi[NUM_THERMAL_PARAMS] = { -(ti - to), heating ? 1.0f : 0.0f, heating ? 0.0f : -1.0f, 1.0f };
+      float slope = 0;
+      for (int p = 0; p < NUM_THERMAL_PARAMS; p++) slope += m.theta[p] * phi[p];
+      if (heating ? slope <= 0 : slope >= 0) continue;
+      if (rateConfidence(m, phi, slope, heating) < THERMAL_MODEL_SEED_CONFIDENCE) continue;
+      rate[bin] = (uint16_t)std::min(fabsf(slope) * 100.0f + 0.5f, (float)UINT16_MAX); // Tables hold CentiC/h
+      samples[bin] = 1;
+      filled |= PERF_DIRTY_BIT(heating, season);
+    }
+  }
+  return filled;
+}
+
+void updateThermalModel(ControllerBatch& b, int i, CentiC indoor, CentiC outdoor) {
+  ThermalModel& m = b.thermalModel[i];
+  if (!m.seeded) seedThermalModel(m, b.performance[i], b.season);
+  uint32_t updates = m.updates;
+  updateThermalModel(m, b.now, indoor, outdoor, relayOn(b, i, HEATER_RELAY_PIN), relayOn(b, i, COOLER_RELAY_PIN),
+                     relayOn(b, i, FRESH_AIR_RELAY_PIN));
+  if (m.updates == updates) return;
+  uint8_t filled = seedPerformanceFromModel(m, b.performance[i], b.season, indoor);
+  if (filled) { b.performanceDirty[i] |= filled; b.recovery[i].rateValid = false; }
+}
+
+// =================================================================
+// ==                   DEVICE (SINGLE INSTANCE)                  ==
+// =================================================================
+void updateThermalModel(CentiC indoor, CentiC outdoor) {
+  deviceController.now = currentTime();
+  deviceController.season = getCurrentSeason();
+  updateThermalModel(deviceController, 0, indoor, outdoor);
+}
+
+ThermalPrediction predictTimeToTarget(CentiC current, CentiC target, CentiC outdoor) {
+  return predictTimeToTarget(deviceController.thermalModel[0], current, target, outdoor);
+}
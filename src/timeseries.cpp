@@ -0,0 +1,477 @@
+#include "timeseries.h"
+#include <Arduino.h>
+#include <stdio.h>
+#include <string.h>
+#include "config.h"
+#include "controller.h"
+#include "learning.h"
+#include "main.h"
+#include "utils.h"
+#include "SPIFFS.h"
+
+static const char TIER_LETTERS[NUM_SERIES_TIERS] = { 'm', 'h', 'd' };
+static const int SEGMENTS[NUM_SERIES_TIERS] = { SERIES_MINUTE_SEGMENTS, SERIES_HOUR_SEGMENTS, SERIES_DAY_SEGMENTS };
+static const int SEGMENT_RECORDS[NUM_SERIES_TIERS] = { SERIES_MINUTE_SEGMENT_RECORDS, SERIES_HOUR_SEGMENT_RECORDS, SERIES_DAY_SEGMENT_RECORDS };
+static const int MAX_SEGMENTS = std::max(SERIES_MINUTE_SEGMENTS, std::max(SERIES_HOUR_SEGMENTS, SERIES_DAY_SEGMENTS));
+static const int PENDING_RECORDS = SERIES_FLUSH_RECORDS;
+static const int SCAN_CHUNK_RECORDS = 16;
+static const int RELAY_PINS[NUM_SERIES_RELAYS] = { HEATER_RELAY_PIN, COOLER_RELAY_PIN, FAN_RELAY_PIN, FRESH_AIR_RELAY_PIN, HUMIDITY_RELAY_PIN };
+static const uint32_t RELAY_WATTS[NUM_SERIES_RELAYS] = { HEATER_INPUT_WATTS, COOLER_INPUT_WATTS, FAN_INPUT_WATTS, FRESH_AIR_INPUT_WATTS, HUMIDIFIER_INPUT_WATTS };
+static const uint64_t MS_PER_MINUTE = 60000;
+static const uint32_t NO_MINUTE = 0xFFFFFFFFUL;
+
+static_assert(SERIES_FLUSH_RECORDS < 60, "A flush must come before the hour closes, so the hour and day tiers never hold more than one pending record");
+static_assert(SERIES_MINUTE_SEGMENTS >= 2 && SERIES_HOUR_SEGMENTS >= 2 && SERIES_DAY_SEGMENTS >= 2, "A tier needs a segment to recycle");
+
+SeriesStats seriesStats;
+
+// The newest segment is appended to; the others, in ring order after it, are
+// older. A segment with sequence 0 has never been written.
+struct TierRing {
+  uint32_t sequence[MAX_SEGMENTS];
+  uint32_t firstMinute[MAX_SEGMENTS];
+  uint16_t count[MAX_SEGMENTS];
+  int newest; // -1 until the first append
+  uint32_t nextSequence;
+  uint32_t lastMinute; // Start of the newest bucket in the tier, NO_MINUTE if empty
+  SeriesBucket pending[PENDING_RECORDS];
+  int pendingCount;
+};
+
+// Everything the store holds in RAM.
+static struct {
+  TierRing tiers[NUM_SERIES_TIERS];
+  SeriesTotals open[NUM_SERIES_TIERS]; // The open minute; closed minutes of the open hour; closed hours of the open day
+  bool primed;                         // False until the first pass after boot
+  uint64_t cursorMs;                   // Series clock: minutes * 60000
+  uint32_t year;
+  unsigned long lastMs;
+  uint16_t lastRelays;
+  bool lastFreshAirForHeating;
+} store;
+
+// =================================================================
+// ==                           BUCKETS                           ==
+// =================================================================
+void clearSeriesTotals(SeriesTotals& t) {
+  memset(&t, 0, sizeof(t));
+  t.indoorMin = t.outdoorMin = INT16_MAX;
+  t.indoorMax = t.outdoorMax = INT16_MIN;
+}
+
+static void openTotals(SeriesTotals& t, uint32_t startMinute) { clearSeriesTotals(t); t.startMinute = startMinute; }
+
+static bool hasData(const SeriesTotals& t) { return t.milliseconds || t.samples; }
+
+static void addTotals(SeriesTotals& into, const SeriesTotals& t) {
+  into.milliseconds += t.milliseconds;
+  for (int r = 0; r < NUM_SERIES_RELAYS; r++) { into.onMilliseconds[r] += t.onMilliseconds[r]; into.starts[r] += t.starts[r]; }
+  into.economizerHeatMilliseconds += t.economizerHeatMilliseconds;
+  into.economizerCoolMilliseconds += t.economizerCoolMilliseconds;
+  if (!t.samples) return;
+  into.samples += t.samples;
+  into.indoorSum += t.indoorSum; into.outdoorSum += t.outdoorSum;
+  into.indoorMin = std::min(into.indoorMin, t.indoorMin); into.indoorMax = std::max(into.indoorMax, t.indoorMax);
+  into.outdoorMin = std::min(into.outdoorMin, t.outdoorMin); into.outdoorMax = std::max(into.outdoorMax, t.outdoorMax);
+}
+
+static void addBucket(SeriesTotals& into, const SeriesBucket& b) {
+  into.milliseconds += b.seconds * 1000ULL;
+  for (int r = 0; r < NUM_SERIES_RELAYS; r++) { into.onMilliseconds[r] += b.onSeconds[r] * 1000ULL; into.starts[r] += b.starts[r]; }
+  into.economizerHeatMilliseconds += b.economizerHeatSeconds * 1000ULL;
+  into.economizerCoolMilliseconds += b.economizerCoolSeconds * 1000ULL;
+  if (!b.samples) return;
+  into.samples += b.samples;
+  into.indoorSum += (int64_t)b.indoorMean * b.samples; into.outdoorSum += (int64_t)b.outdoorMean * b.samples;
+  into.indoorMin = std::min(into.indoorMin, b.indoorMin); into.indoorMax = std::max(into.indoorMax, b.indoorMax);
+  into.outdoorMin = std::min(into.outdoorMin, b.outdoorMin); into.outdoorMax = std::max(into.outdoorMax, b.outdoorMax);
+}
+
+static uint32_t roundSeconds(uint64_t ms) { return (uint32_t)((ms + 500) / 1000); }
+
+static CentiC meanOf(int64_t sum, uint32_t samples) {
+  return (CentiC)((sum + (sum >= 0 ? (int64_t)samples / 2 : -(int64_t)samples / 2)) / (int64_t)samples);
+}
+
+static SeriesBucket bucketOf(const SeriesTotals& t) {
+  SeriesBucket b = {};
+  b.startMinute = t.startMinute;
+  b.seconds = roundSeconds(t.milliseconds);
+  for (int r = 0; r < NUM_SERIES_RELAYS; r++) { b.onSeconds[r] = roundSeconds(t.onMilliseconds[r]); b.starts[r] = (uint16_t)std::min(t.starts[r], (uint32_t)UINT16_MAX); }
+  b.economizerHeatSeconds = roundSeconds(t.economizerHeatMilliseconds);
+  b.economizerCoolSeconds = roundSeconds(t.economizerCoolMilliseconds);
+  b.samples = t.samples;
+  if (t.samples) {
+    b.indoorMean = meanOf(t.indoorSum, t.samples); b.indoorMin = t.indoorMin; b.indoorMax = t.indoorMax;
+    b.outdoorMean = meanOf(t.outdoorSum, t.samples); b.outdoorMin = t.outdoorMin; b.outdoorMax = t.outdoorMax;
+  }
+  b.crc = crc16((const uint8_t*)&b, offsetof(SeriesBucket, crc));
+  return b;
+}
+
+static bool validBucket(const SeriesBucket& b) { return b.crc == crc16((const uint8_t*)&b, offsetof(SeriesBucket, crc)); }
+
+uint32_t seriesEnergyWh(const SeriesTotals& t) {
+  uint64_t wattMs = 0;
+  for (int r = 0; r < NUM_SERIES_RELAYS; r++) wattMs += t.onMilliseconds[r] * RELAY_WATTS[r];
+  return (uint32_t)((wattMs + 1800000) / 3600000);
+}
+
+// The fan runs either way, so the saving is the heater or cooler input alone.
+uint32_t economizerSavingsWh(const SeriesTotals& t) {
+  uint64_t wattMs = t.economizerHeatMilliseconds * HEATER_INPUT_WATTS + t.economizerCoolMilliseconds * COOLER_INPUT_WATTS;
+  return (uint32_t)((wattMs + 1800000) / 3600000);
+}
+
+// =================================================================
+// ==                       SEGMENT FILES                         ==
+// =================================================================
+static void segmentPath(int tier, int segment, char* out, size_t size) {
+  snprintf(out, size, "/series_%c%d.bin", TIER_LETTERS[tier], segment);
+}
+
+static uint32_t recordOffset(int index) { return sizeof(SeriesSegmentHeader) + index * sizeof(SeriesBucket); }
+
+static bool readRecord(File& file, int index, SeriesBucket& out) {
+  return file.seek(recordOffset(index)) && file.read((uint8_t*)&out, sizeof(out)) == sizeof(out);
+}
+
+static void loadTier(int tier) {
+  TierRing& ring = store.tiers[tier];
+  memset(&ring, 0, sizeof(ring));
+  ring.newest = -1;
+  ring.lastMinute = NO_MINUTE;
+  for (int s = 0; s < SEGMENTS[tier]; s++) {
+    char path[32];
+    segmentPath(tier, s, path, sizeof(path));
+    File file = SPIFFS.open(path, FILE_READ);
+    if (!file) continue;
+    SeriesSegmentHeader header;
+    SeriesBucket first;
+    if (file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) && header.magic == SERIES_MAGIC && header.tier == tier) {
+      ring.sequence[s] = header.sequence;
+      // A torn append leaves a partial record at the end, which is ignored.
+      ring.count[s] = (uint16_t)std::min((file.size() - sizeof(header)) / sizeof(SeriesBucket), (size_t)SEGMENT_RECORDS[tier]);
+      if (ring.count[s] && readRecord(file, 0, first)) ring.firstMinute[s] = first.startMinute;
+      if (ring.newest < 0 || header.sequence > ring.sequence[ring.newest]) ring.newest = s;
+      ring.nextSequence = std::max(ring.nextSequence, header.sequence + 1);
+    }
+    file.close();
+  }
+  if (ring.nextSequence == 0) ring.nextSequence = 1;
+  if (ring.newest >= 0 && ring.count[ring.newest]) {
+    char path[32];
+    segmentPath(tier, ring.newest, path, sizeof(path));
+    File file = SPIFFS.open(path, FILE_READ);
+    SeriesBucket last;
+    if (file && readRecord(file, ring.count[ring.newest] - 1, last)) ring.lastMinute = last.startMinute;
+    file.close();
+  }
+}
+
+// Opens the next segment in the ring, truncating whatever it held.
+static bool startSegment(int tier) {
+  TierRing& ring = store.tiers[tier];
+  int s = (ring.newest + 1) % SEGMENTS[tier];
+  char path[32];
+  segmentPath(tier, s, path, sizeof(path));
+  File file = SPIFFS.open(path, FILE_WRITE);
+  if (!file) return false;
+  SeriesSegmentHeader header = { SERIES_MAGIC, (uint8_t)tier, {}, ring.nextSequence };
+  bool ok = file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+  file.close();
+  if (!ok) return false;
+  if (ring.sequence[s]) seriesStats.segmentsRecycled++;
+  ring.sequence[s] = ring.nextSequence++;
+  ring.count[s] = 0;
+  ring.newest = s;
+  seriesStats.bytesWritten += sizeof(header);
+  return true;
+}
+
+static bool flushTier(int tier) {
+  TierRing& ring = store.tiers[tier];
+  int done = 0;
+  while (done < ring.pendingCount) {
+    if ((ring.newest < 0 || ring.count[ring.newest] >= SEGMENT_RECORDS[tier]) && !startSegment(tier)) break;
+    int s = ring.newest;
+    int n = std::min(ring.pendingCount - done, SEGMENT_RECORDS[tier] - ring.count[s]);
+    char path[32];
+    segmentPath(tier, s, path, sizeof(path));
+    File file = SPIFFS.open(path, FILE_APPEND);
+    if (!file) break;
+    size_t bytes = file.write((const uint8_t*)&ring.pending[done], n * sizeof(SeriesBucket));
+    file.close();
+    seriesStats.bytesWritten += bytes;
+    if (bytes != n * sizeof(SeriesBucket)) break;
+    if (!ring.count[s]) ring.firstMinute[s] = ring.pending[done].startMinute;
+    ring.count[s] += n;
+    done += n;
+  }
+  bool ok = done == ring.pendingCount;
+  if (!ok) seriesStats.writeErrors += ring.pendingCount - done; // Dropped: RAM stays bounded
+  ring.pendingCount = 0;
+  return ok;
+}
+
+bool flushTimeseries() {
+  bool ok = true, any = false;
+  for (int tier = 0; tier < NUM_SERIES_TIERS; tier++) {
+    if (!store.tiers[tier].pendingCount) continue;
+    any = true;
+    ok &= flushTier(tier);
+  }
+  if (any) seriesStats.flushes++;
+  return ok;
+}
+
+static void append(int tier, const SeriesTotals& t) {
+  TierRing& ring = store.tiers[tier];
+  if (ring.pendingCount == PENDING_RECORDS) flushTimeseries();
+  ring.pending[ring.pendingCount++] = bucketOf(t);
+  ring.lastMinute = t.startMinute;
+  if (tier == SERIES_MINUTES && ring.pendingCount >= SERIES_FLUSH_RECORDS) flushTimeseries();
+}
+
+// =================================================================
+// ==                          SCANNING                           ==
+// =================================================================
+// Calls fn for each stored bucket of the tier starting in [from, to), oldest
+// first, flash then the pending records.
+template <class Fn>
+static void scanTier(int tier, uint32_t from, uint32_t to, SeriesQueryCost* cost, Fn fn) {
+  TierRing& ring = store.tiers[tier];
+  if (ring.newest >= 0) {
+    for (int k = 1; k <= SEGMENTS[tier]; k++) {
+      int s = (ring.newest + k) % SEGMENTS[tier];
+      if (!ring.sequence[s] || !ring.count[s]) continue;
+      if (ring.firstMinute[s] >= to) break;
+      // Later segments start after this one ends; skip it if the next already starts at or before from.
+      uint32_t nextFirst = NO_MINUTE;
+      for (int j = k + 1; j <= SEGMENTS[tier]; j++) {
+        int next = (ring.newest + j) % SEGMENTS[tier];
+        if (ring.sequence[next] && ring.count[next]) { nextFirst = ring.firstMinute[next]; break; }
+      }
+      if (nextFirst == NO_MINUTE && ring.pendingCount) nextFirst = ring.pending[0].startMinute;
+      if (nextFirst != NO_MINUTE && nextFirst <= from) continue;
+
+      char path[32];
+      segmentPath(tier, s, path, sizeof(path));
+      File file = SPIFFS.open(path, FILE_READ);
+      if (!file) continue;
+      int lo = 0, hi = ring.count[s];
+      if (ring.firstMinute[s] < from) {
+        lo = 1;
+        while (lo < hi) { // First record at or after from
+          int mid = (lo + hi) / 2;
+          SeriesBucket probe;
+          if (cost) cost->reads[tier]++;
+          if (!readRecord(file, mid, probe)) { hi = mid; break; }
+          if (probe.startMinute < from) lo = mid + 1; else hi = mid;
+        }
+      }
+      SeriesBucket chunk[SCAN_CHUNK_RECORDS];
+      bool past = false;
+      for (int at = lo; at < ring.count[s] && !past; at += SCAN_CHUNK_RECORDS) {
+        int n = std::min(SCAN_CHUNK_RECORDS, ring.count[s] - at);
+        if (cost) cost->reads[tier]++;
+        if (!file.seek(recordOffset(at))) break;
+        n = (int)(file.read((uint8_t*)chunk, n * sizeof(SeriesBucket)) / sizeof(SeriesBucket));
+        for (int r = 0; r < n; r++) {
+          if (!validBucket(chunk[r])) { seriesStats.badRecords++; continue; }
+          if (chunk[r].startMinute >= to) { past = true; break; }
+          if (chunk[r].startMinute >= from) fn(chunk[r]);
+        }
+        if (n < std::min(SCAN_CHUNK_RECORDS, ring.count[s] - at)) break;
+      }
+      file.close();
+      if (past) return;
+    }
+  }
+  for (int p = 0; p < ring.pendingCount; p++) {
+    if (ring.pending[p].startMinute >= to) return;
+    if (ring.pending[p].startMinute >= from) fn(ring.pending[p]);
+  }
+}
+
+// =================================================================
+// ==                           CLOCK                             ==
+// =================================================================
+static uint32_t floorTo(uint32_t minute, uint32_t step) { return minute - minute % step; }
+static uint32_t ceilTo(uint32_t minute, uint32_t step) { return minute % step ? minute - minute % step + step : minute; }
+
+// The wall clock on the series timeline, rolling the year over when the
+// minute of the year falls far behind the series clock.
+static uint64_t wallSeriesMs(const TimeInfo& wall, uint32_t reference) {
+  uint32_t minute = store.year * MINUTES_PER_YEAR + minuteOfYear(wall);
+  if (reference != NO_MINUTE && minute + MINUTES_PER_YEAR / 2 < reference) { store.year++; minute += MINUTES_PER_YEAR; }
+  return minute * MS_PER_MINUTE + (uint64_t)std::min(std::max(wall.second, 0), 59) * 1000;
+}
+
+static uint32_t cursorMinute() { return (uint32_t)(store.cursorMs / MS_PER_MINUTE); }
+
+static void closeBucket(int tier) {
+  SeriesTotals& t = store.open[tier];
+  if (!hasData(t)) return;
+  append(tier, t);
+  if (tier + 1 < NUM_SERIES_TIERS) addTotals(store.open[tier + 1], t);
+  if (tier == SERIES_MINUTES) seriesStats.minutesClosed++;
+  else if (tier == SERIES_HOURS) seriesStats.hoursClosed++;
+  else seriesStats.daysClosed++;
+}
+
+// Moves the open buckets to the given minute, closing each tier whose bucket it leaves.
+static void rollTo(uint32_t minute) {
+  if (minute == store.open[SERIES_MINUTES].startMinute) return;
+  for (int tier = 0; tier < NUM_SERIES_TIERS; tier++) {
+    uint32_t start = floorTo(minute, SERIES_TIER_MINUTES[tier]);
+    if (start == store.open[tier].startMinute) break;
+    closeBucket(tier);
+    openTotals(store.open[tier], start);
+  }
+}
+
+// The relays of the last pass held for ms from the cursor: split at minute boundaries.
+static void accrue(uint64_t ms) {
+  while (ms) {
+    uint64_t boundary = (cursorMinute() + 1) * MS_PER_MINUTE;
+    uint64_t part = std::min(ms, boundary - store.cursorMs);
+    SeriesTotals& t = store.open[SERIES_MINUTES];
+    t.milliseconds += part;
+    for (int r = 0; r < NUM_SERIES_RELAYS; r++) if (store.lastRelays & RELAY_BIT(RELAY_PINS[r])) t.onMilliseconds[r] += part;
+    if (store.lastRelays & RELAY_BIT(FRESH_AIR_RELAY_PIN)) {
+      if (store.lastFreshAirForHeating) t.economizerHeatMilliseconds += part; else t.economizerCoolMilliseconds += part;
+    }
+    store.cursorMs += part;
+    ms -= part;
+    rollTo(cursorMinute());
+  }
+}
+
+// First pass after boot or an erase: place the series clock, roll up into
+// the hour and day tiers whatever closed below them while the store was
+// down, and rebuild the open hour and day from the tiers below.
+static void prime(unsigned long nowMs, const TimeInfo& wall) {
+  uint32_t last = NO_MINUTE;
+  for (int tier = 0; tier < NUM_SERIES_TIERS; tier++) {
+    uint32_t tierLast = store.tiers[tier].lastMinute;
+    if (tierLast != NO_MINUTE) last = last == NO_MINUTE ? tierLast + SERIES_TIER_MINUTES[tier] - 1 : std::max(last, tierLast + SERIES_TIER_MINUTES[tier] - 1);
+  }
+  store.year = last == NO_MINUTE ? 0 : last / MINUTES_PER_YEAR;
+  store.cursorMs = wallSeriesMs(wall, last);
+  if (last != NO_MINUTE) store.cursorMs = std::max(store.cursorMs, (last + 1) * MS_PER_MINUTE);
+  uint32_t minute = cursorMinute();
+
+  for (int tier = SERIES_HOURS; tier < NUM_SERIES_TIERS; tier++) {
+    uint32_t step = SERIES_TIER_MINUTES[tier];
+    uint32_t openStart = floorTo(minute, step);
+    uint32_t tierLast = store.tiers[tier].lastMinute;
+    uint32_t from = tierLast == NO_MINUTE ? 0 : tierLast + step;
+    SeriesTotals& t = store.open[tier];
+    openTotals(t, NO_MINUTE);
+    scanTier(tier - 1, from, openStart, nullptr, [&](const SeriesBucket& b) {
+      uint32_t start = floorTo(b.startMinute, step);
+      if (start != t.startMinute) { if (hasData(t)) append(tier, t); openTotals(t, start); }
+      addBucket(t, b);
+    });
+    if (hasData(t)) append(tier, t);
+    openTotals(t, openStart);
+    scanTier(tier - 1, openStart, tier == SERIES_HOURS ? minute : floorTo(minute, SERIES_TIER_MINUTES[SERIES_HOURS]), nullptr,
+             [&](const SeriesBucket& b) { addBucket(t, b); });
+  }
+  openTotals(store.open[SERIES_MINUTES], minute);
+  store.primed = true;
+  store.lastMs = nowMs;
+}
+
+// =================================================================
+// ==                          PUBLIC API                         ==
+// =================================================================
+void initialize_timeseries() {
+  memset(&store, 0, sizeof(store));
+  for (int tier = 0; tier < NUM_SERIES_TIERS; tier++) loadTier(tier);
+}
+
+void eraseTimeseries() {
+  for (int tier = 0; tier < NUM_SERIES_TIERS; tier++) {
+    for (int s = 0; s < SEGMENTS[tier]; s++) {
+      char path[32];
+      segmentPath(tier, s, path, sizeof(path));
+      SPIFFS.remove(path);
+    }
+  }
+  initialize_timeseries();
+}
+
+void recordSeries(unsigned long nowMs, const TimeInfo& wall, uint16_t relays, bool freshAirForHeating, CentiC indoor, CentiC outdoor) {
+  seriesStats.passes++;
+  bool first = !store.primed;
+  if (first) {
+    prime(nowMs, wall);
+  } else {
+    unsigned long elapsed = nowMs - store.lastMs;
+    if (elapsed <= SERIES_MAX_GAP_SECS * 1000) accrue(elapsed);
+    else seriesStats.gaps++;
+    uint64_t wallMs = wallSeriesMs(wall, cursorMinute());
+    if (wallMs > store.cursorMs) { store.cursorMs = wallMs; rollTo(cursorMinute()); }
+    store.lastMs = nowMs;
+  }
+
+  SeriesTotals& t = store.open[SERIES_MINUTES];
+  uint16_t started = first ? 0 : relays & ~store.lastRelays;
+  for (int r = 0; r < NUM_SERIES_RELAYS; r++) if (started & RELAY_BIT(RELAY_PINS[r])) t.starts[r]++;
+  t.samples++;
+  t.indoorSum += indoor; t.outdoorSum += outdoor;
+  t.indoorMin = std::min(t.indoorMin, indoor); t.indoorMax = std::max(t.indoorMax, indoor);
+  t.outdoorMin = std::min(t.outdoorMin, outdoor); t.outdoorMax = std::max(t.outdoorMax, outdoor);
+  store.lastRelays = relays;
+  store.lastFreshAirForHeating = freshAirForHeating;
+}
+
+uint32_t seriesNowMinute() { return store.primed ? cursorMinute() : 0; }
+
+bool querySeries(uint32_t from, uint32_t to, SeriesTotals& out, SeriesQueryCost* cost) {
+  openTotals(out, from);
+  if (cost) memset(cost, 0, sizeof(*cost));
+  if (from >= to) return false;
+
+  // Whole days, then whole hours, then minutes: [from, h0) [h0, d0) [d0, d1) [d1, h1) [h1, to).
+  const uint32_t HOUR = SERIES_TIER_MINUTES[SERIES_HOURS], DAY = SERIES_TIER_MINUTES[SERIES_DAYS];
+  uint32_t d0 = ceilTo(from, DAY), d1 = floorTo(to, DAY);
+  if (d0 >= d1) d0 = d1 = std::min(std::max(ceilTo(from, HOUR), from), to);
+  uint32_t h0 = std::min(ceilTo(from, HOUR), d0), h1 = std::max(floorTo(to, HOUR), d1);
+  if (h0 >= h1) h0 = h1 = d0 = d1 = from;
+  const struct { int tier; uint32_t from, to; } RANGES[] = {
+    { SERIES_MINUTES, from, h0 }, { SERIES_HOURS, h0, d0 }, { SERIES_DAYS, d0, d1 }, { SERIES_HOURS, d1, h1 }, { SERIES_MINUTES, h1, to },
+  };
+
+  bool found = false;
+  for (const auto& range : RANGES) {
+    if (range.from >= range.to) continue;
+    scanTier(range.tier, range.from, range.to, cost, [&](const SeriesBucket& b) {
+      addBucket(out, b);
+      if (cost) cost->buckets[range.tier]++;
+      found = true;
+    });
+    // The open bucket of this tier is the sum of it and every open bucket below.
+    if (store.primed && store.open[range.tier].startMinute >= range.from && store.open[range.tier].startMinute < range.to) {
+      for (int tier = range.tier; tier >= 0; tier--) { found |= hasData(store.open[tier]); addTotals(out, store.open[tier]); }
+    }
+  }
+  return found;
+}
+
+size_t timeseriesRamBytes() { return sizeof(store); }
+
+size_t timeseriesFlashBytes() {
+  size_t bytes = 0;
+  for (int tier = 0; tier < NUM_SERIES_TIERS; tier++) bytes += SEGMENTS[tier] * (sizeof(SeriesSegmentHeader) + SEGMENT_RECORDS[tier] * sizeof(SeriesBucket));
+  return bytes;
+}
+
+// =================================================================
+// ==                   DEVICE (SINGLE INSTANCE)                  ==
+// =================================================================
+void recordSeries(const TimeInfo& now, CentiC indoor, CentiC outdoor) {
+  recordSeries(currentTime(), now, deviceController.relays[0], deviceController.freshAirForHeating[0], indoor, outdoor);
+}
@@ -0,0 +1,251 @@
+#include "trace.h"
+#include <Arduino.h>
+#include <string.h>
+#include "config.h"
+#include "controller.h"
+#include "hvac_logic.h"
+#include "main.h"
+#include "relays.h"
+#include "state_machine.h"
+#include "SPIFFS.h"
+
+static const int RELAY_PINS[] = { HEATER_RELAY_PIN, COOLER_RELAY_PIN, FAN_RELAY_PIN, FRESH_AIR_RELAY_PIN, HUMIDITY_RELAY_PIN };
+
+TraceStats traceStats;
+
+static TraceCodec codec;
+static uint8_t buffer[TRACE_BUFFER_BYTES];
+static size_t buffered = 0;
+static unsigned long bufferedRecords = 0;
+static ControlMillis oldestBufferedAt = 0;
+static uint32_t currentGeneration = 0;
+static TraceSink sink = nullptr;
+
+// =================================================================
+// ==                        RECORD CODING                        ==
+// =================================================================
+static uint32_t zigzag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+static int32_t unzigzag(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+static uint8_t* putVarint(uint8_t* p, uint32_t v) {
+  while (v >= 0x80) { *p++ = (uint8_t)(v | 0x80); v >>= 7; }
+  *p++ = (uint8_t)v;
+  return p;
+}
+
+static bool getVarint(const uint8_t*& p, const uint8_t* end, uint32_t& v) {
+  v = 0;
+  for (int shift = 0; shift < 35 && p < end; shift += 7) {
+    uint8_t byte = *p++;
+    v |= (uint32_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) return true;
+  }
+  return false;
+}
+
+static int32_t secondOfDay(const TimeInfo& t) { return (t.hour * 60 + t.minute) * 60 + t.second; }
+static uint8_t packSettings(const TracePass& p) { return (uint8_t)(p.systemMode | p.fanMode << 2 | p.tempUnit << 4); }
+
+size_t encodeTracePass(TraceCodec& c, const TracePass& pass, const WarmState* state, uint8_t* out) {
+  bool keyframe = state || !c.primed;
+  if (keyframe) memset(&c.last, 0, sizeof(c.last));
+  const TracePass& last = c.last;
+  uint16_t fields = keyframe ? (uint16_t)TRACE_FIELDS : 0;
+  if (!keyframe) {
+    if (secondOfDay(pass.time) != secondOfDay(last.time)) fields |= TRACE_CLOCK;
+    if (pass.indoor != last.indoor) fields |= TRACE_INDOOR;
+    if (pass.outdoor != last.outdoor) fields |= TRACE_OUTDOOR;
+    if (pass.humidity != last.humidity) fields |= TRACE_HUMIDITY;
+    if (pass.target != last.target) fields |= TRACE_TARGET;
+    if (pass.relays != last.relays) fields |= TRACE_RELAYS;
+    if (pass.time.month != last.time.month || pass.time.day != last.time.day || pass.time.dayOfWeek != last.time.dayOfWeek) fields |= TRACE_DATE;
+    if (packSettings(pass) != packSettings(last)) fields |= TRACE_SETTINGS;
+  }
+
+  uint8_t* p = putVarint(out, fields);
+  p = putVarint(p, pass.timestampMs - last.timestampMs);
+  if (fields & TRACE_CLOCK) p = putVarint(p, zigzag(secondOfDay(pass.time) - secondOfDay(last.time)));
+  if (fields & TRACE_INDOOR) p = putVarint(p, zigzag(pass.indoor - last.indoor));
+  if (fields & TRACE_OUTDOOR) p = putVarint(p, zigzag(pass.outdoor - last.outdoor));
+  if (fields & TRACE_HUMIDITY) p = putVarint(p, zigzag(pass.humidity - last.humidity));
+  if (fields & TRACE_TARGET) p = putVarint(p, zigzag(pass.target - last.target));
+  if (fields & TRACE_RELAYS) *p++ = pass.relays;
+  if (fields & TRACE_DATE) { *p++ = (uint8_t)pass.time.month; *p++ = (uint8_t)pass.time.day; *p++ = (uint8_t)pass.time.dayOfWeek; }
+  if (fields & TRACE_SETTINGS) *p++ = packSettings(pass);
+  if (keyframe) { memcpy(p, state, sizeof(WarmState)); p += sizeof(WarmState); }
+  c.last = pass;
+  c.primed = true;
+  return p - out;
+}
+
+size_t decodeTracePass(TraceCodec& c, const uint8_t* in, size_t len, TracePass& pass, WarmState* state, bool* keyframe) {
+  const uint8_t* p = in;
+  const uint8_t* end = in + len;
+  uint32_t fields, v;
+  if (!getVarint(p, end, fields) || (fields & ~(uint32_t)TRACE_FIELDS)) return 0;
+  bool isKeyframe = fields & TRACE_KEYFRAME;
+  if (!isKeyframe && !c.primed) return 0;
+  TracePass next = c.last;
+  if (isKeyframe) { memset(&next, 0, sizeof(next)); fields = TRACE_FIELDS; }
+
+  if (!getVarint(p, end, v)) return 0;
+  next.timestampMs += v;
+  if (fields & TRACE_CLOCK) {
+    if (!getVarint(p, end, v)) return 0;
+    int32_t second = secondOfDay(next.time) + unzigzag(v);
+    if (second < 0 || second >= 24 * 3600) return 0;
+    next.time.hour = second / 3600; next.time.minute = second / 60 % 60; next.time.second = second % 60;
+  }
+  CentiC* temps[] = { &next.indoor, &next.outdoor, &next.humidity, &next.target };
+  for (int f = 0; f < 4; f++) {
+    if (!(fields & (TRACE_INDOOR << f))) continue;
+    if (!getVarint(p, end, v)) return 0;
+    *temps[f] = (CentiC)(*temps[f] + unzigzag(v));
+  }
+  if (fields & TRACE_RELAYS) { if (p >= end) return 0; next.relays = *p++; }
+  if (fields & TRACE_DATE) {
+    if (end - p < 3) return 0;
+    next.time.month = *p++; next.time.day = *p++; next.time.dayOfWeek = *p++;
+    if (next.time.month < 1 || next.time.month > 12 || next.time.day < 1 || next.time.day > 31 || next.time.dayOfWeek > 6) return 0;
+  }
+  if (fields & TRACE_SETTINGS) {
+    if (p >= end) return 0;
+    uint8_t s = *p++;
+    if ((s & 3) > SYS_AUTO || (s >> 2 & 3) > FAN_CIRCULATE || (s >> 4) > FAHRENHEIT) return 0;
+    next.systemMode = (SystemMode)(s & 3); next.fanMode = (FanMode)(s >> 2 & 3); next.tempUnit = (TempUnit)(s >> 4);
+  }
+  if (isKeyframe) {
+    if ((size_t)(end - p) < sizeof(WarmState)) return 0;
+    if (state) memcpy(state, p, sizeof(WarmState));
+    p += sizeof(WarmState);
+  }
+  if (keyframe) *keyframe = isKeyframe;
+  pass = next;
+  c.last = next;
+  c.primed = true;
+  return p - in;
+}
+
+// =================================================================
+// ==                          REPLAY                             ==
+// =================================================================
+uint8_t traceRelayMask(const ControllerBatch& b, int i) {
+  uint8_t mask = 0;
+  for (int pin : RELAY_PINS) if (relayOn(b, i, pin)) mask |= RELAY_BIT(pin);
+  return mask;
+}
+
+void loadTraceKeyframe(ControllerBatch& b, int i, const TracePass& pass, const WarmState& state) {
+  b.now = pass.timestampMs;
+  initialize_logic_timers(b, i, b.now);
+  applyWarmState(b, i, state, 0);
+  b.systemMode[i] = pass.systemMode;
+  b.tempUnit[i] = pass.tempUnit;
+}
+
+// The same routines, in the same order, as loop() after Smart Recovery, and the commit's interlocks.
+uint8_t replayTracePass(ControllerBatch& b, int i, const TracePass& pass) {
+  b.now = pass.timestampMs; // Both 32 bits: the replay wraps where the recording did
+  b.season = seasonForMonth(pass.time.month);
+  b.systemMode[i] = pass.systemMode;
+  b.tempUnit[i] = pass.tempUnit;
+  stepThermostat(b, i, pass.indoor, pass.target, pass.outdoor);
+  controlHumidity(b, i, pass.humidity, pass.indoor, pass.outdoor);
+  controlFan(b, i, pass.fanMode);
+  commitRelays(b, i);
+  return traceRelayMask(b, i);
+}
+
+// =================================================================
+// ==                   DEVICE (SINGLE INSTANCE)                  ==
+// =================================================================
+static bool createTrace(uint32_t generation) {
+  File file = SPIFFS.open(TRACE_FILE, FILE_WRITE);
+  if (!file) return false;
+  TraceHeader header = { TRACE_MAGIC, TRACE_VERSION, 0, generation };
+  file.write((const uint8_t*)&header, sizeof(header));
+  file.close();
+  currentGeneration = generation;
+  codec.primed = false; // Each file opens with a keyframe
+  return true;
+}
+
+static void rotateTrace() {
+  SPIFFS.remove(TRACE_ROTATED_FILE);
+  SPIFFS.rename(TRACE_FILE, TRACE_ROTATED_FILE);
+  createTrace(currentGeneration + 1);
+  traceStats.rotations++;
+}
+
+// SPIFFS is mounted by initialize_learning().
+void initialize_trace() {
+  codec.primed = false; // A boot breaks the sequence
+  buffered = 0; bufferedRecords = 0;
+  if (sink) return;
+  File file = SPIFFS.open(TRACE_FILE, FILE_READ);
+  TraceHeader header;
+  if (file && file.read((uint8_t*)&header, sizeof(header)) == sizeof(header) && header.magic == TRACE_MAGIC && header.version == TRACE_VERSION) {
+    currentGeneration = header.generation;
+    file.close();
+    return;
+  }
+  if (file) file.close();
+  createTrace(currentGeneration + 1);
+}
+
+bool flushTrace() {
+  if (!buffered) return true;
+  if (sink) {
+    sink(buffer, buffered);
+  } else {
+    if (!SPIFFS.exists(TRACE_FILE) && !createTrace(currentGeneration + 1)) return false;
+    File file = SPIFFS.open(TRACE_FILE, FILE_APPEND);
+    if (!file) return false;
+    file.write(buffer, buffered);
+    size_t size = file.size();
+    file.close();
+    if (size >= TRACE_MAX_BYTES) rotateTrace();
+  }
+  traceStats.flushes++;
+  traceStats.bytes += buffered;
+  buffered = 0; bufferedRecords = 0;
+  return true;
+}
+
+void recordTrace(const TimeInfo& now, CentiC indoor, CentiC outdoor, CentiRH humidity, CentiC target, FanMode fanMode) {
+  if (!TRACE_CAPTURE_ENABLED) return;
+  const ControllerBatch& b = deviceController;
+  if (buffered && b.now - oldestBufferedAt >= TRACE_FLUSH_SECS * 1000) flushTrace();
+  if (buffered + TRACE_MAX_RECORD > sizeof(buffer) && !flushTrace()) {
+    traceStats.dropped += bufferedRecords; // Filesystem unavailable: the next record starts afresh
+    buffered = 0; bufferedRecords = 0;
+    codec.primed = false;
+  }
+  if (!buffered) oldestBufferedAt = b.now;
+
+  TracePass pass;
+  pass.timestampMs = b.now;
+  pass.time = now;
+  pass.indoor = indoor; pass.outdoor = outdoor; pass.humidity = humidity; pass.target = target;
+  pass.systemMode = b.systemMode[0]; pass.fanMode = fanMode; pass.tempUnit = b.tempUnit[0];
+  pass.relays = traceRelayMask(b, 0);
+  WarmState state;
+  bool keyframe = !codec.primed;
+  if (keyframe) captureWarmState(b, 0, 0, state);
+  buffered += encodeTracePass(codec, pass, keyframe ? &state : nullptr, buffer + buffered);
+  bufferedRecords++;
+  traceStats.records++;
+  if (keyframe) traceStats.keyframes++;
+}
+
+void requestTraceKeyframe() { codec.primed = false; }
+
+void setTraceSink(TraceSink newSink) {
+  flushTrace();
+  sink = newSink;
+  codec.primed = false;
+  if (sink) {
+    TraceHeader header = { TRACE_MAGIC, TRACE_VERSION, 0, ++currentGeneration };
+    sink((const uint8_t*)&header, sizeof(header));
+  }
+}
@@ -0,0 +1,148 @@
+#include "warmstart.h"
+#include <Arduino.h>
+#include <stddef.h>
+#include <sys/time.h>
+#include "config.h"
+#include "controller.h"
+#include "hvac_tests.h"
+#include "main.h"
+#include "utils.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+
+BootStats bootStats;
+
+static const uint32_t WARM_STATE_MAGIC = 0x57415231; // "WAR1"
+static const int RELAY_PINS[] = { HEATER_RELAY_PIN, COOLER_RELAY_PIN, FAN_RELAY_PIN, FRESH_AIR_RELAY_PIN, HUMIDITY_RELAY_PIN };
+static const unsigned long MAX_AGE_MS = 0x7FFFFFFF; // Keeps now - age a valid past time
+
+enum WarmFlags : uint8_t {
+  WARM_FAN_CIRCULATING = 1, WARM_FRESH_AIR_FOR_HEATING = 2, WARM_CYCLE_IN_PROGRESS = 4, WARM_LOCKED_OUT = 8
+};
+
+// Not cleared by the startup code: survives every reset but power-on.
+RTC_NOINIT_ATTR static WarmState retained;
+
+// Taken out of RTC memory at the top of setup(), so a boot that crashes
+// before its first pass saves again leaves nothing to resume.
+static WarmState claimed;
+static bool claimedValid = false;
+
+static uint16_t warmCrc(const WarmState& s) { return crc16((const uint8_t*)&s, offsetof(WarmState, crc)); }
+
+// Time that keeps running through a reset: the RTC-backed system time. An
+// NTP step between the save and the reset shows up as an implausible age.
+static uint64_t retainedClockUs() {
+  if (g_isTesting) return (uint64_t)g_mockMillis * 1000;
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static uint32_t ageOf(ControlMillis now, ControlMillis at) { return now - at; }
+static ControlMillis rebase(ControlMillis now, uint32_t age, unsigned long elapsedMs) {
+  return now - (ControlMillis)std::min((unsigned long)age + elapsedMs, MAX_AGE_MS);
+}
+
+void captureWarmState(const ControllerBatch& b, int i, uint64_t clockUs, WarmState& s) {
+  s = WarmState{};
+  ControlMillis now = b.now;
+  s.magic = WARM_STATE_MAGIC;
+  s.size = sizeof(WarmState);
+  for (int pin : RELAY_PINS) if (relayOn(b, i, pin)) s.relays |= RELAY_BIT(pin);
+  s.savedAtUs = clockUs;
+  s.heaterOnAge = ageOf(now, b.lastHeaterOnTime[i]); s.heaterOffAge = ageOf(now, b.lastHeaterOffTime[i]);
+  s.coolerOnAge = ageOf(now, b.lastCoolerOnTime[i]); s.coolerOffAge = ageOf(now, b.lastCoolerOffTime[i]);
+  s.fanCycleAge = ageOf(now, b.lastFanCycleTime[i]);
+  s.cycleStartAge = ageOf(now, b.cycleStartTime[i]);
+  s.firstHeaterMaxRunAge = ageOf(now, b.firstHeaterMaxRunTriggerTime[i]);
+  s.firstCoolerMaxRunAge = ageOf(now, b.firstCoolerMaxRunTriggerTime[i]);
+  s.cycleStartTemp = b.cycleStartTemp[i]; s.cycleStartOutdoorTemp = b.cycleStartOutdoorTemp[i];
+  s.heaterMaxRunTriggers = (uint8_t)std::min(b.heaterMaxRunTriggers[i], 255);
+  s.coolerMaxRunTriggers = (uint8_t)std::min(b.coolerMaxRunTriggers[i], 255);
+  s.flags = (b.isFanCirculating[i] ? WARM_FAN_CIRCULATING : 0) | (b.freshAirForHeating[i] ? WARM_FRESH_AIR_FOR_HEATING : 0) |
+            (b.cycleInProgress[i] ? WARM_CYCLE_IN_PROGRESS : 0) | (b.systemLockedOut[i] ? WARM_LOCKED_OUT : 0);
+  s.crc = warmCrc(s);
+}
+
+void saveWarmState(const ControllerBatch& b, int i, uint64_t clockUs) {
+  WarmState s;
+  captureWarmState(b, i, clockUs, s);
+  retained = s;
+}
+
+static bool warmStateValid(const WarmState& s, uint64_t clockUs) {
+  if (s.magic != WARM_STATE_MAGIC || s.size != sizeof(WarmState) || s.crc != warmCrc(s)) return false;
+  return clockUs >= s.savedAtUs && clockUs - s.savedAtUs <= WARM_START_MAX_AGE_SECS * 1000000ULL;
+}
+
+void applyWarmState(ControllerBatch& b, int i, const WarmState& s, unsigned long elapsedMs) {
+  ControlMillis now = b.now;
+  b.lastHeaterOnTime[i] = rebase(now, s.heaterOnAge, elapsedMs); b.lastHeaterOffTime[i] = rebase(now, s.heaterOffAge, elapsedMs);
+  b.lastCoolerOnTime[i] = rebase(now, s.coolerOnAge, elapsedMs); b.lastCoolerOffTime[i] = rebase(now, s.coolerOffAge, elapsedMs);
+  b.lastFanCycleTime[i] = rebase(now, s.fanCycleAge, elapsedMs);
+  b.cycleStartTime[i] = rebase(now, s.cycleStartAge, elapsedMs);
+  b.firstHeaterMaxRunTriggerTime[i] = rebase(now, s.firstHeaterMaxRunAge, elapsedMs);
+  b.firstCoolerMaxRunTriggerTime[i] = rebase(now, s.firstCoolerMaxRunAge, elapsedMs);
+  b.cycleStartTemp[i] = s.cycleStartTemp; b.cycleStartOutdoorTemp[i] = s.cycleStartOutdoorTemp;
+  b.heaterMaxRunTriggers[i] = s.heaterMaxRunTriggers; b.coolerMaxRunTriggers[i] = s.coolerMaxRunTriggers;
+  b.isFanCirculating[i] = s.flags & WARM_FAN_CIRCULATING;
+  b.freshAirForHeating[i] = s.flags & WARM_FRESH_AIR_FOR_HEATING;
+  b.cycleInProgress[i] = s.flags & WARM_CYCLE_IN_PROGRESS;
+  b.systemLockedOut[i] = s.flags & WARM_LOCKED_OUT;
+  // On the device this writes the latched level back before releasing the hold, so the pin does not glitch.
+  for (int pin : RELAY_PINS) setRelay(b, i, pin, (s.relays & RELAY_BIT(pin)) != 0);
+}
+
+bool restoreWarmState(ControllerBatch& b, int i, uint64_t clockUs) {
+  if (!warmStateValid(retained, clockUs)) return false;
+  WarmState s = retained;
+  applyWarmState(b, i, s, (unsigned long)((clockUs - s.savedAtUs) / 1000));
+  return true;
+}
+
+// =================================================================
+// ==                   DEVICE (SINGLE INSTANCE)                  ==
+// =================================================================
+static bool resetKeepsState(esp_reset_reason_t reason) {
+  switch (reason) {
+    case ESP_RST_SW: case ESP_RST_PANIC: case ESP_RST_INT_WDT: case ESP_RST_TASK_WDT:
+    case ESP_RST_WDT: case ESP_RST_BROWNOUT:
+      return true;
+    default:
+      return false; // Power-on, external pin, deep sleep: RTC memory is not trusted
+  }
+}
+
+bool claimWarmState() {
+  claimed = retained;
+  claimedValid = resetKeepsState(esp_reset_reason()) && warmStateValid(claimed, retainedClockUs());
+  retained.magic = 0;
+  return claimedValid;
+}
+
+bool warmStart() {
+  uint64_t clockUs = retainedClockUs();
+  if (!claimedValid || !warmStateValid(claimed, clockUs)) return false;
+  claimedValid = false;
+  deviceController.now = currentTime();
+  applyWarmState(deviceController, 0, claimed, (unsigned long)((clockUs - claimed.savedAtUs) / 1000));
+  return true;
+}
+
+void saveWarmState() {
+  saveWarmState(deviceController, 0, retainedClockUs());
+}
+
+void invalidateWarmState() {
+  retained.magic = 0;
+}
+
+void noteFirstDecision() {
+  if (bootStats.decided) return;
+  bootStats.decided = true;
+  bootStats.decisionMs = currentTime();
+  bootStats.decisionUs = micros();
+  Serial.printf("Boot: %s start, first control decision %lu ms after setup()\n",
+                bootStats.warm ? "warm" : "cold", bootStats.decisionMs - bootStats.setupMs);
+}
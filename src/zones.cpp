@@ -0,0 +1,135 @@
+#include "zones.h"
+#include <Arduino.h>
+#include <algorithm>
+#include "config.h"
+#include "controller.h"
+#include "hvac_logic.h"
+#include "utils.h"
+
+// Stages 2..MAX_STAGES share stage 1's protection times for their mode.
+static const unsigned long STAGE_MIN_RUN_MS[NUM_STAGE_MODES] = { MIN_HEATER_RUN_TIME_MS, MIN_COOLER_RUN_TIME_MS };
+static const unsigned long STAGE_MIN_OFF_MS[NUM_STAGE_MODES] = { MIN_HEATER_OFF_TIME_MS, MIN_COOLER_OFF_TIME_MS };
+static const unsigned long STAGE_MAX_RUN_MS[NUM_STAGE_MODES] = { MAX_HEATER_RUN_TIME_MS, MAX_COOLER_RUN_TIME_MS };
+static const int STAGE_1_PINS[NUM_STAGE_MODES] = { HEATER_RELAY_PIN, COOLER_RELAY_PIN };
+
+void initZoneGroup(ZoneGroup& g, int zones, int heatStages, int coolStages, ControlMillis now) {
+  g = ZoneGroup{};
+  g.zoneCount = std::max(1, std::min(zones, MAX_ZONES));
+  g.stageCount[STAGE_HEAT] = std::max(1, std::min(heatStages, MAX_STAGES));
+  g.stageCount[STAGE_COOL] = std::max(1, std::min(coolStages, MAX_STAGES));
+  g.damperOpen = (uint16_t)((1u << g.zoneCount) - 1);
+  for (int z = 0; z < MAX_ZONES; z++) g.damperChangedAt[z] = now - DAMPER_MIN_DWELL_MS;
+  for (int m = 0; m < NUM_STAGE_MODES; m++) {
+    for (int k = 0; k < MAX_STAGES - 1; k++) g.stageOffTime[m][k] = now - (STAGE_MIN_OFF_MS[m] + 1000);
+  }
+}
+
+// Demand per zone and the lead for each mode, in one sweep.
+static void aggregateDemand(ZoneGroup& g) {
+  int heatLead = 0, coolLead = 0;
+  for (int z = 0; z < g.zoneCount; z++) {
+    int32_t d = (int32_t)g.target[z] - g.temp[z];
+    g.demand[z] = (int16_t)std::max((int32_t)INT16_MIN, std::min(d, (int32_t)INT16_MAX));
+    if (g.demand[z] > g.demand[heatLead]) heatLead = z;
+    if (g.demand[z] < g.demand[coolLead]) coolLead = z;
+  }
+  g.lead[STAGE_HEAT] = (int8_t)heatLead;
+  g.lead[STAGE_COOL] = (int8_t)coolLead;
+}
+
+// Stages 2 and up for one mode, lowest first, so a stage that drops out takes
+// the ones above it out in the same pass.
+static void controlStages(ZoneGroup& g, const ControllerBatch& b, int i, StageMode m) {
+  ControlMillis now = b.now;
+  CentiC tempDeadbandC = temperatureDeadband(b.tempUnit[i]);
+  CentiC stepC = centiCDeltaFrom(STAGE_UP_ERROR_F, b.tempUnit[i]);
+  int lead = g.lead[m];
+  int32_t errorC = m == STAGE_HEAT ? g.demand[lead] : -(int32_t)g.demand[lead];
+  bool belowOn = relayOn(b, i, STAGE_1_PINS[m]);
+  ControlMillis belowOnTime = m == STAGE_HEAT ? b.lastHeaterOnTime[i] : b.lastCoolerOnTime[i];
+
+  for (int s = 2; s <= g.stageCount[m]; s++) {
+    int k = s - 2;
+    uint8_t bit = (uint8_t)(1u << k);
+    bool isOn = g.stagesOn[m] & bit;
+    if (isOn) {
+      if (!belowOn) { // The stage below stopped (satisfied, max-run or lockout): no min-run to honour
+        g.stagesOn[m] &= ~bit; g.stageOffTime[m][k] = now;
+      } else if (now - g.stageOnTime[m][k] > STAGE_MAX_RUN_MS[m]) {
+        g.stagesOn[m] &= ~bit; g.stageOffTime[m][k] = now;
+        if (g.stageMaxRunTriggers[m][k] > 0 && (now - g.firstStageMaxRunTime[m][k] > MAX_RUN_LOCKOUT_MS)) { g.stageMaxRunTriggers[m][k] = 1; g.firstStageMaxRunTime[m][k] = now; }
+        else { if (g.stageMaxRunTriggers[m][k] == 0) g.firstStageMaxRunTime[m][k] = now; g.stageMaxRunTriggers[m][k]++; if (g.stageMaxRunTriggers[m][k] >= MAX_RUN_TRIGGER_COUNT) { g.stagesLockedOut[m] |= bit; } }
+      } else if (errorC <= tempDeadbandC && (now - g.stageOnTime[m][k] > STAGE_MIN_RUN_MS[m])) {
+        g.stagesOn[m] &= ~bit; g.stageOffTime[m][k] = now;
+      }
+    } else if (belowOn && !(g.stagesLockedOut[m] & bit) && (now - g.stageOffTime[m][k] > STAGE_MIN_OFF_MS[m])) {
+      bool farOut = errorC > tempDeadbandC + (int32_t)(s - 1) * stepC;
+      bool slow = errorC > tempDeadbandC && (now - belowOnTime >= STAGE_UP_DELAY_MS);
+      if (farOut || slow) { g.stagesOn[m] |= bit; g.stageOnTime[m][k] = now; }
+    }
+    belowOn = g.stagesOn[m] & bit;
+    belowOnTime = g.stageOnTime[m][k];
+  }
+}
+
+// Zones calling in the running mode, topped up by demand to MIN_OPEN_DAMPERS;
+// everything while idle. Opening is immediate, closing waits out the dwell.
+static void controlDampers(ZoneGroup& g, const ControllerBatch& b, int i) {
+  ControlMillis now = b.now;
+  bool freshAir = relayOn(b, i, FRESH_AIR_RELAY_PIN);
+  bool heating = relayOn(b, i, HEATER_RELAY_PIN) || (freshAir && b.freshAirForHeating[i]);
+  bool cooling = relayOn(b, i, COOLER_RELAY_PIN) || (freshAir && !b.freshAirForHeating[i]);
+  uint16_t all = (uint16_t)((1u << g.zoneCount) - 1), want = all;
+
+  if (heating != cooling) {
+    int sign = heating ? 1 : -1;
+    want = 0;
+    for (int z = 0; z < g.zoneCount; z++) if (sign * g.demand[z] > 0) want |= (uint16_t)(1u << z);
+    int minOpen = std::min(MIN_OPEN_DAMPERS, g.zoneCount);
+    while (__builtin_popcount(want) < minOpen) {
+      int best = -1;
+      for (int z = 0; z < g.zoneCount; z++) {
+        if (!(want & (1u << z)) && (best < 0 || sign * g.demand[z] > sign * g.demand[best])) best = z;
+      }
+      want |= (uint16_t)(1u << best);
+    }
+  }
+
+  for (int z = 0; z < g.zoneCount; z++) {
+    uint16_t bit = (uint16_t)(1u << z);
+    bool isOpen = g.damperOpen & bit;
+    if ((want & bit) && !isOpen) { g.damperOpen |= bit; g.damperChangedAt[z] = now; }
+    else if (!(want & bit) && isOpen && (now - g.damperChangedAt[z] >= DAMPER_MIN_DWELL_MS)) { g.damperOpen &= ~bit; g.damperChangedAt[z] = now; }
+  }
+}
+
+static bool startedAny(const RelaySnapshot& before, const RelaySnapshot& after) {
+  return (after.heating && !before.heating) || (after.cooling && !before.cooling) || (after.freshAir && !before.freshAir);
+}
+
+void controlZones(ZoneGroup& g, ControllerBatch& b, int i, CentiC outdoor) {
+  aggregateDemand(g);
+  if (!enforceLockout(b, i)) {
+    // In AUTO both leads can call at once, which one zone never does: the
+    // larger error goes first, and if it starts anything the other waits.
+    RelaySnapshot pass = relaySnapshot(b, i);
+    int heatLead = g.lead[STAGE_HEAT], coolLead = g.lead[STAGE_COOL];
+    bool coolFirst = -(int32_t)g.demand[coolLead] > g.demand[heatLead];
+    if (!releaseStage(b, i, pass, g.temp[pass.heating ? heatLead : coolLead])) {
+      if (coolFirst) controlCooling(b, i, pass, g.temp[coolLead], g.target[coolLead], outdoor);
+      else controlHeating(b, i, pass, g.temp[heatLead], g.target[heatLead], outdoor);
+      if (!startedAny(pass, relaySnapshot(b, i))) {
+        if (coolFirst) controlHeating(b, i, pass, g.temp[heatLead], g.target[heatLead], outdoor);
+        else controlCooling(b, i, pass, g.temp[coolLead], g.target[coolLead], outdoor);
+      }
+    }
+  }
+  controlStages(g, b, i, STAGE_HEAT);
+  controlStages(g, b, i, STAGE_COOL);
+  controlDampers(g, b, i);
+}
+
+int runningStages(const ZoneGroup& g, const ControllerBatch& b, int i, StageMode mode) {
+  if (!relayOn(b, i, STAGE_1_PINS[mode])) return 0;
+  return 1 + __builtin_popcount(g.stagesOn[mode]);
+}